@@ -37,14 +37,31 @@ private:
 #define CONF_DERECHO_EXTERNAL_PORT "DERECHO/external_port"
 #define CONF_DERECHO_HEARTBEAT_MS "DERECHO/heartbeat_ms"
 #define CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS "DERECHO/sst_poll_cq_timeout_ms"
+#define CONF_DERECHO_SST_PREDICATE_THREADS "DERECHO/sst_predicate_threads"
+#define CONF_DERECHO_SST_PREDICATE_THREAD_CORES "DERECHO/sst_predicate_thread_cores"
+#define CONF_DERECHO_IDLE_SPIN_US "DERECHO/idle_spin_us"
+#define CONF_DERECHO_IDLE_BACKOFF_US "DERECHO/idle_backoff_us"
+#define CONF_DERECHO_IDLE_WAIT_US "DERECHO/idle_wait_us"
+#define CONF_DERECHO_SENDER_THREADS "DERECHO/sender_threads"
 #define CONF_DERECHO_RESTART_TIMEOUT_MS "DERECHO/restart_timeout_ms"
 #define CONF_DERECHO_ENABLE_BACKUP_RESTART_LEADERS "DERECHO/enable_backup_restart_leaders"
 #define CONF_DERECHO_DISABLE_PARTITIONING_SAFETY "DERECHO/disable_partitioning_safety"
 #define CONF_DERECHO_MAX_NODE_ID "DERECHO/max_node_id"
+#define CONF_DERECHO_PERSISTENCE_THREADS "DERECHO/persistence_threads"
 
 #define CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE "DERECHO/max_p2p_request_payload_size"
 #define CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE "DERECHO/max_p2p_reply_payload_size"
 #define CONF_DERECHO_P2P_WINDOW_SIZE "DERECHO/p2p_window_size"
+#define CONF_DERECHO_P2P_REQUEST_THREADS "DERECHO/p2p_request_threads"
+#define CONF_DERECHO_P2P_INITIAL_WINDOW_SIZE "DERECHO/p2p_initial_window_size"
+#define CONF_DERECHO_P2P_INITIAL_PAYLOAD_SIZE "DERECHO/p2p_initial_payload_size"
+#define CONF_DERECHO_P2P_MEMORY_BUDGET_MB "DERECHO/p2p_memory_budget_mb"
+#define CONF_DERECHO_ORDERED_SEND_BATCH_SIZE "DERECHO/ordered_send_batch_size"
+#define CONF_DERECHO_ORDERED_SEND_BATCH_DELAY_US "DERECHO/ordered_send_batch_delay_us"
+#define CONF_DERECHO_RDMC_BUFFER_REGION_SIZE_MB "DERECHO/rdmc_buffer_region_size_mb"
+#define CONF_DERECHO_RDMC_BUFFER_HUGEPAGES "DERECHO/rdmc_buffer_hugepages"
+#define CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE "DERECHO/state_transfer_chunk_size"
+#define CONF_DERECHO_STATE_TRANSFER_PROGRESS_INTERVAL_MS "DERECHO/state_transfer_progress_interval_ms"
 #define CONF_DERECHO_JSON_LAYOUT "DERECHO/json_layout"
 #define CONF_DERECHO_JSON_LAYOUT_PATH "DERECHO/json_layout_path"
 
@@ -65,6 +82,10 @@ private:
 #define CONF_PERS_MAX_LOG_ENTRY "PERS/max_log_entry"
 #define CONF_PERS_MAX_DATA_SIZE "PERS/max_data_size"
 #define CONF_PERS_PRIVATE_KEY_FILE "PERS/private_key_file"
+#define CONF_PERS_DELTA_CHECKPOINT_INTERVAL "PERS/delta_checkpoint_interval"
+#define CONF_PERS_DELTA_CHECKPOINT_BYTES "PERS/delta_checkpoint_bytes"
+#define CONF_PERS_DELTA_CACHE_SIZE "PERS/delta_cache_size"
+#define CONF_PERS_GROUP_COMMIT "PERS/group_commit"
 #define CONF_LOGGER_DEFAULT_LOG_NAME "LOGGER/default_log_name"
 #define CONF_LOGGER_DEFAULT_LOG_LEVEL "LOGGER/default_log_level"
     // Configuration Table:
@@ -85,13 +106,30 @@ private:
             {CONF_DERECHO_EXTERNAL_PORT, "32645"},
             {CONF_SUBGROUP_DEFAULT_RDMC_SEND_ALGORITHM, "binomial_send"},
             {CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS, "2000"},
+            {CONF_DERECHO_SST_PREDICATE_THREADS, "1"},
+            {CONF_DERECHO_SST_PREDICATE_THREAD_CORES, ""},
+            {CONF_DERECHO_IDLE_SPIN_US, "50"},
+            {CONF_DERECHO_IDLE_BACKOFF_US, "200"},
+            {CONF_DERECHO_IDLE_WAIT_US, "200"},
+            {CONF_DERECHO_SENDER_THREADS, "1"},
             {CONF_DERECHO_RESTART_TIMEOUT_MS, "2000"},
             {CONF_DERECHO_DISABLE_PARTITIONING_SAFETY, "true"},
             {CONF_DERECHO_ENABLE_BACKUP_RESTART_LEADERS, "false"},
             {CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE, "10240"},
             {CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE, "10240"},
             {CONF_DERECHO_P2P_WINDOW_SIZE, "16"},
+            {CONF_DERECHO_P2P_REQUEST_THREADS, "1"},
+            {CONF_DERECHO_P2P_INITIAL_WINDOW_SIZE, "4"},
+            {CONF_DERECHO_P2P_INITIAL_PAYLOAD_SIZE, "1024"},
+            {CONF_DERECHO_P2P_MEMORY_BUDGET_MB, "0"},
+            {CONF_DERECHO_ORDERED_SEND_BATCH_SIZE, "1"},
+            {CONF_DERECHO_ORDERED_SEND_BATCH_DELAY_US, "100"},
+            {CONF_DERECHO_RDMC_BUFFER_REGION_SIZE_MB, "64"},
+            {CONF_DERECHO_RDMC_BUFFER_HUGEPAGES, "true"},
+            {CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE, "1048576"},
+            {CONF_DERECHO_STATE_TRANSFER_PROGRESS_INTERVAL_MS, "5000"},
             {CONF_DERECHO_MAX_NODE_ID, "1024"},
+            {CONF_DERECHO_PERSISTENCE_THREADS, "1"},
             // [SUBGROUP/<subgroupname>]
             {CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE, "10240"},
             {CONF_SUBGROUP_DEFAULT_MAX_REPLY_PAYLOAD_SIZE, "10240"},
@@ -111,6 +149,10 @@ private:
             {CONF_PERS_MAX_LOG_ENTRY, "1048576"},       // 1M log entries.
             {CONF_PERS_MAX_DATA_SIZE, "549755813888"},  // 512G total data size.
             {CONF_PERS_PRIVATE_KEY_FILE, "private_key.pem"},
+            {CONF_PERS_DELTA_CHECKPOINT_INTERVAL, "0"},  // no checkpoint by number of versions.
+            {CONF_PERS_DELTA_CHECKPOINT_BYTES, "0"},     // no checkpoint by size of deltas.
+            {CONF_PERS_DELTA_CACHE_SIZE, "0"},           // no cache of reconstructed states.
+            {CONF_PERS_GROUP_COMMIT, "false"},
             // [LOGGER]
             {CONF_LOGGER_DEFAULT_LOG_NAME, "derecho_debug"},
             {CONF_LOGGER_DEFAULT_LOG_LEVEL, "info"}};
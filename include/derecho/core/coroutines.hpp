@@ -0,0 +1,437 @@
+/**
+ * @file coroutines.hpp
+ *
+ * C++20 coroutine support for RPC function calls: awaitables for the results
+ * of ordered_send and p2p_send, a Task type for writing coroutines that await
+ * them, and a small executor that resumes those coroutines when Derecho's
+ * threads deliver the results they are waiting for. For example:
+ *
+ *     derecho::rpc::Task<> put_then_get(Replicated<Cache>& cache) {
+ *         auto put_replies = co_await cache.ordered_send<RPC_NAME(put)>("key", "value");
+ *         for(auto& reply_pair : put_replies) {
+ *             bool stored = co_await std::move(reply_pair.second);
+ *         }
+ *         derecho::rpc::QueryResults<std::string> get_results = cache.ordered_send<RPC_NAME(get)>("key");
+ *         co_await derecho::rpc::global_persistence_done(get_results);
+ *     }
+ *     ...
+ *     derecho::rpc::CoroutineExecutor executor(4);
+ *     executor.spawn(put_then_get(cache));
+ *
+ * Derecho itself is built as C++17, so this header is only available to
+ * application code compiled with coroutine support (e.g. -std=c++20).
+ */
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "derecho/core/coroutines.hpp requires C++20 coroutine support (e.g. -std=c++20)"
+#endif
+
+#include "detail/rpc_utils.hpp"
+#include <derecho/utils/logger.hpp>
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+
+namespace derecho {
+namespace rpc {
+
+template <typename T = void>
+class Task;
+
+/**
+ * A small pool of threads that resumes coroutines. When a coroutine running
+ * on a CoroutineExecutor awaits the result of an RPC function call, the
+ * Derecho thread that delivers the result (the RPC listener, the P2P request
+ * worker, or a persistence or view-change thread) only queues the coroutine
+ * here, so application code never runs on Derecho's own threads. A coroutine
+ * that is not running on a CoroutineExecutor is instead resumed directly on
+ * the delivering thread, and must not block there.
+ *
+ * The executor must outlive every coroutine that runs on it.
+ */
+class CoroutineExecutor {
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::queue<std::coroutine_handle<>> ready_coroutines;
+    bool running = true;
+    std::vector<std::thread> workers;
+
+    static CoroutineExecutor*& current_executor() {
+        static thread_local CoroutineExecutor* executor = nullptr;
+        return executor;
+    }
+
+    void worker_loop() {
+        pthread_setname_np(pthread_self(), "coro_executor");
+        current_executor() = this;
+        while(true) {
+            std::coroutine_handle<> next;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_cv.wait(lock, [this]() { return !ready_coroutines.empty() || !running; });
+                if(ready_coroutines.empty()) {
+                    break;
+                }
+                next = ready_coroutines.front();
+                ready_coroutines.pop();
+            }
+            next.resume();
+        }
+        current_executor() = nullptr;
+    }
+
+public:
+    /**
+     * Starts the executor.
+     * @param num_threads The number of threads that resume coroutines
+     */
+    explicit CoroutineExecutor(unsigned int num_threads = 1) {
+        for(unsigned int i = 0; i < num_threads; ++i) {
+            workers.emplace_back(&CoroutineExecutor::worker_loop, this);
+        }
+    }
+    CoroutineExecutor(const CoroutineExecutor&) = delete;
+    ~CoroutineExecutor() {
+        shutdown();
+    }
+
+    /** Queues a suspended coroutine to be resumed on one of the executor's threads. */
+    void post(std::coroutine_handle<> coroutine) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            ready_coroutines.push(coroutine);
+        }
+        queue_cv.notify_one();
+    }
+
+    /**
+     * Starts running a Task on this executor, without waiting for it. The Task
+     * destroys itself when it finishes; an exception that escapes it is logged.
+     */
+    void spawn(Task<void> task);
+
+    /**
+     * Stops the executor's threads once every coroutine queued so far has
+     * been resumed. Coroutines that are still waiting for an RPC result will
+     * not be resumed.
+     */
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            running = false;
+        }
+        queue_cv.notify_all();
+        for(auto& worker : workers) {
+            if(worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    /** @return The executor that is running the calling thread, or nullptr if there is none */
+    static CoroutineExecutor* current() {
+        return current_executor();
+    }
+};
+
+namespace detail {
+
+/**
+ * The part of a Task's promise that does not depend on its result type.
+ */
+struct TaskPromiseBase {
+    /** The coroutine that is awaiting this Task, if any */
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    /** True if the Task was started with CoroutineExecutor::spawn, and owns itself */
+    bool detached = false;
+
+    /**
+     * Resumes the awaiting coroutine when a Task finishes, or destroys the
+     * Task if nothing is awaiting it.
+     */
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {
+            TaskPromiseBase& promise = finished.promise();
+            if(promise.continuation) {
+                return promise.continuation;
+            }
+            if(promise.detached) {
+                if(promise.exception) {
+                    try {
+                        std::rethrow_exception(promise.exception);
+                    } catch(const std::exception& e) {
+                        dbg_default_error("Spawned coroutine ended with an uncaught exception: {}", e.what());
+                    } catch(...) {
+                        dbg_default_error("Spawned coroutine ended with an uncaught exception");
+                    }
+                }
+                finished.destroy();
+            }
+            return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    /** Tasks are lazy: they start running when awaited or spawned */
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : public TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    template <typename V>
+    void return_value(V&& v) {
+        value.emplace(std::forward<V>(v));
+    }
+    T result() {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : public TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+}  // namespace detail
+
+/**
+ * The return type of a coroutine that awaits RPC results. A Task does not
+ * start running until it is either awaited by another coroutine, which then
+ * receives its result, or started with CoroutineExecutor::spawn.
+ * @tparam T The type of the value the coroutine co_returns
+ */
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+private:
+    std::coroutine_handle<promise_type> coroutine;
+
+    friend promise_type;
+    friend class CoroutineExecutor;
+    explicit Task(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+public:
+    Task(Task&& other) noexcept : coroutine(std::exchange(other.coroutine, {})) {}
+    Task(const Task&) = delete;
+    ~Task() {
+        if(coroutine) {
+            coroutine.destroy();
+        }
+    }
+
+    /**
+     * Awaiting a Task runs it, and resumes the awaiting coroutine with its
+     * result (or rethrows its exception) once it finishes.
+     */
+    auto operator co_await() noexcept {
+        struct TaskAwaiter {
+            std::coroutine_handle<promise_type> coroutine;
+
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                coroutine.promise().continuation = awaiting;
+                return coroutine;
+            }
+            T await_resume() { return coroutine.promise().result(); }
+        };
+        return TaskAwaiter{coroutine};
+    }
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+/**
+ * Arranges for a suspended coroutine to be resumed once a completion is
+ * ready: on the executor the coroutine is running on, if any, or else
+ * directly on the thread that sets the completion. Since a completion has
+ * only one continuation, a result that is being awaited cannot also have a
+ * callback registered on it (e.g. with QueryResults::on_reply).
+ */
+inline void resume_when_ready(CompletionBase& completion, std::coroutine_handle<> awaiting) {
+    CoroutineExecutor* executor = CoroutineExecutor::current();
+    completion.then([executor, awaiting]() {
+        if(executor) {
+            executor->post(awaiting);
+        } else {
+            awaiting.resume();
+        }
+    });
+}
+
+}  // namespace detail
+
+struct AwaitableAccess {
+    template <typename T>
+    static CompletionBase& completion(ReplyFuture<T>& reply) {
+        return *reply.completion;
+    }
+    template <typename Ret>
+    static CallCompletions<Ret>& completions(QueryResults<Ret>& results) {
+        return *results.completions;
+    }
+};
+
+/**
+ * Awaits one node's reply to an RPC function call. Like ReplyFuture::get(),
+ * this consumes the ReplyFuture.
+ */
+template <typename T>
+class ReplyAwaiter {
+    ReplyFuture<T> reply;
+
+public:
+    explicit ReplyAwaiter(ReplyFuture<T>&& reply) : reply(std::move(reply)) {}
+    bool await_ready() const { return reply.is_ready(); }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        detail::resume_when_ready(AwaitableAccess::completion(reply), awaiting);
+    }
+    T await_resume() { return reply.get(); }
+};
+
+template <typename T>
+ReplyAwaiter<T> operator co_await(ReplyFuture<T>& reply) {
+    return ReplyAwaiter<T>(std::move(reply));
+}
+
+template <typename T>
+ReplyAwaiter<T> operator co_await(ReplyFuture<T>&& reply) {
+    return ReplyAwaiter<T>(std::move(reply));
+}
+
+/**
+ * Awaits the ReplyMap of a QueryResults that the coroutine keeps, and
+ * returns a reference to it, like QueryResults::get().
+ */
+template <typename Ret>
+class ReplyMapAwaiter {
+    QueryResults<Ret>& results;
+
+public:
+    explicit ReplyMapAwaiter(QueryResults<Ret>& results) : results(results) {}
+    bool await_ready() const { return AwaitableAccess::completions(results).reply_map.is_ready(); }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        detail::resume_when_ready(AwaitableAccess::completions(results).reply_map, awaiting);
+    }
+    typename QueryResults<Ret>::ReplyMap& await_resume() { return results.get(); }
+};
+
+/**
+ * Awaits the ReplyMap of a temporary QueryResults, such as the return value
+ * of ordered_send, and returns the map of node IDs to ReplyFutures itself
+ * (or, for a void function, the set of node IDs), which remains valid after
+ * the QueryResults is gone.
+ */
+template <typename Ret>
+class OwningReplyMapAwaiter {
+    QueryResults<Ret> results;
+
+public:
+    explicit OwningReplyMapAwaiter(QueryResults<Ret>&& results) : results(std::move(results)) {}
+    bool await_ready() { return AwaitableAccess::completions(results).reply_map.is_ready(); }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        detail::resume_when_ready(AwaitableAccess::completions(results).reply_map, awaiting);
+    }
+    auto await_resume() { return std::move(results.get().rmap); }
+};
+
+template <typename Ret>
+ReplyMapAwaiter<Ret> operator co_await(QueryResults<Ret>& results) {
+    return ReplyMapAwaiter<Ret>(results);
+}
+
+template <typename Ret>
+OwningReplyMapAwaiter<Ret> operator co_await(QueryResults<Ret>&& results) {
+    return OwningReplyMapAwaiter<Ret>(std::move(results));
+}
+
+/**
+ * Awaits one of the events tracked by a QueryResults, such as global
+ * persistence. The QueryResults must stay alive until the event happens.
+ */
+class EventAwaiter {
+    Completion<void>& event;
+
+public:
+    explicit EventAwaiter(Completion<void>& event) : event(event) {}
+    bool await_ready() const { return event.is_ready(); }
+    void await_suspend(std::coroutine_handle<> awaiting) {
+        detail::resume_when_ready(event, awaiting);
+    }
+    void await_resume() { event.get(); }
+};
+
+/**
+ * Awaits local persistence of the update caused by an RPC function call; the
+ * coroutine equivalent of QueryResults::await_local_persistence().
+ */
+template <typename Ret>
+EventAwaiter local_persistence_done(QueryResults<Ret>& results) {
+    return EventAwaiter(AwaitableAccess::completions(results).local_persistence);
+}
+
+/**
+ * Awaits global persistence of the update caused by an RPC function call; the
+ * coroutine equivalent of QueryResults::await_global_persistence().
+ */
+template <typename Ret>
+EventAwaiter global_persistence_done(QueryResults<Ret>& results) {
+    return EventAwaiter(AwaitableAccess::completions(results).global_persistence);
+}
+
+/**
+ * Awaits verification of the signature on the update caused by an RPC
+ * function call; the coroutine equivalent of
+ * QueryResults::await_signature_verification().
+ */
+template <typename Ret>
+EventAwaiter signature_verification_done(QueryResults<Ret>& results) {
+    return EventAwaiter(AwaitableAccess::completions(results).signature_verified);
+}
+
+inline void CoroutineExecutor::spawn(Task<void> task) {
+    std::coroutine_handle<detail::TaskPromise<void>> coroutine = std::exchange(task.coroutine, {});
+    coroutine.promise().detached = true;
+    post(coroutine);
+}
+
+}  // namespace rpc
+}  // namespace derecho
@@ -9,3 +9,7 @@
 #include "subgroup_functions.hpp"
 #include "subgroup_info.hpp"
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
+
+#if defined(__cpp_impl_coroutine)
+#include "coroutines.hpp"
+#endif
@@ -0,0 +1,250 @@
+/**
+ * @file completion.hpp
+ *
+ * A lightweight one-shot completion, used in place of std::promise/std::future
+ * for the results of RPC function calls.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace derecho {
+
+namespace rpc {
+
+/**
+ * The part of a Completion that does not depend on its value type. A
+ * Completion is set at most once, to either a value or an exception, and does
+ * not allocate any shared state: it is embedded in the object that produces
+ * its value (a pooled PendingResults), which must stay alive while anyone can
+ * still read it. All of its synchronization is in one atomic state word, so
+ * setting a completion no one is waiting on costs two atomic operations, and
+ * threads that do wait sleep on a futex on that word. A single continuation
+ * can be registered with then(); it runs on the thread that sets the
+ * completion, which must keep the owning object alive while it does so.
+ */
+class CompletionBase {
+protected:
+    /** Set by the one thread that gets to set the completion */
+    static constexpr uint32_t CLAIMED = 1;
+    /** Set once the value or exception has been stored */
+    static constexpr uint32_t READY = 2;
+    /** Set once a continuation has been stored */
+    static constexpr uint32_t HAS_CONTINUATION = 4;
+    /** Set when a thread may be sleeping on the futex */
+    static constexpr uint32_t HAS_WAITERS = 8;
+
+    std::atomic<uint32_t> state{0};
+    std::exception_ptr exception;
+    std::function<void()> continuation;
+
+    /**
+     * @return True if the caller is the first to try to set this completion,
+     * in which case it must store a value or exception and then call publish()
+     */
+    bool claim() {
+        return !(state.fetch_or(CLAIMED, std::memory_order_acquire) & CLAIMED);
+    }
+
+    /**
+     * Marks a claimed completion ready, then wakes up its waiters and runs
+     * its continuation, if any.
+     */
+    void publish() {
+        const uint32_t previous = state.fetch_or(READY, std::memory_order_acq_rel);
+        if(previous & HAS_WAITERS) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAKE_PRIVATE, INT_MAX,
+                    nullptr, nullptr, 0);
+        }
+        if(previous & HAS_CONTINUATION) {
+            continuation();
+        }
+    }
+
+    /**
+     * Sleeps until the state word changes from current, or the timeout (if
+     * not null) expires.
+     */
+    void sleep(uint32_t current, const struct timespec* timeout) {
+        if(!(current & HAS_WAITERS)) {
+            if(!state.compare_exchange_strong(current, current | HAS_WAITERS, std::memory_order_acquire)) {
+                return;
+            }
+            current |= HAS_WAITERS;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAIT_PRIVATE, current,
+                timeout, nullptr, 0);
+    }
+
+    void rethrow_if_exception() const {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+public:
+    CompletionBase() = default;
+    CompletionBase(const CompletionBase&) = delete;
+    CompletionBase& operator=(const CompletionBase&) = delete;
+
+    /** @return True if a value or exception has been set */
+    bool is_ready() const {
+        return state.load(std::memory_order_acquire) & READY;
+    }
+
+    /**
+     * Sets the completion to an exception, unless it has already been set.
+     * @return True if this call set the completion
+     */
+    bool set_exception(std::exception_ptr e) {
+        if(!claim()) {
+            return false;
+        }
+        exception = e;
+        publish();
+        return true;
+    }
+
+    /** Blocks until a value or exception has been set. */
+    void wait() {
+        uint32_t current = state.load(std::memory_order_acquire);
+        while(!(current & READY)) {
+            sleep(current, nullptr);
+            current = state.load(std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * Blocks until a value or exception has been set, or the timeout expires.
+     * @return True if the completion is ready
+     */
+    template <typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period>& timeout) {
+        using namespace std::chrono;
+        const auto deadline = steady_clock::now() + timeout;
+        uint32_t current = state.load(std::memory_order_acquire);
+        while(!(current & READY)) {
+            const auto remaining = duration_cast<nanoseconds>(deadline - steady_clock::now());
+            if(remaining.count() <= 0) {
+                return false;
+            }
+            const struct timespec relative_timeout {
+                static_cast<time_t>(remaining.count() / 1000000000),
+                        static_cast<long>(remaining.count() % 1000000000)
+            };
+            sleep(current, &relative_timeout);
+            current = state.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    /**
+     * Registers a function to run once a value or exception is set. It runs
+     * on the thread that sets the completion, or right away on the calling
+     * thread if the completion is already ready. Only one continuation may be
+     * registered between two resets.
+     */
+    void then(std::function<void()> f) {
+        assert(!(state.load(std::memory_order_relaxed) & HAS_CONTINUATION));
+        continuation = std::move(f);
+        uint32_t current = state.load(std::memory_order_acquire);
+        while(!(current & READY)) {
+            if(state.compare_exchange_weak(current, current | HAS_CONTINUATION, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+        continuation();
+    }
+
+    /** Makes the completion reusable; nobody may be using it concurrently. */
+    void reset() {
+        state.store(0, std::memory_order_relaxed);
+        exception = nullptr;
+        continuation = nullptr;
+    }
+};
+
+/**
+ * A one-shot completion for a value of type T; see CompletionBase.
+ */
+template <typename T>
+class Completion : public CompletionBase {
+    std::optional<T> value;
+
+public:
+    /**
+     * Sets the value, unless the completion has already been set.
+     * @return True if this call set the completion
+     */
+    template <typename V>
+    bool set_value(V&& v) {
+        if(!claim()) {
+            return false;
+        }
+        value.emplace(std::forward<V>(v));
+        publish();
+        return true;
+    }
+
+    /**
+     * Blocks until the completion is ready, then returns its value or
+     * rethrows its exception.
+     */
+    T& get() {
+        wait();
+        rethrow_if_exception();
+        return *value;
+    }
+
+    void reset() {
+        CompletionBase::reset();
+        value.reset();
+    }
+};
+
+/**
+ * A one-shot completion that carries no value, only the fact that some event
+ * has happened (or an exception); see CompletionBase.
+ */
+template <>
+class Completion<void> : public CompletionBase {
+public:
+    /**
+     * Marks the event as having happened, unless the completion has already
+     * been set.
+     * @return True if this call set the completion
+     */
+    bool set_value() {
+        if(!claim()) {
+            return false;
+        }
+        publish();
+        return true;
+    }
+
+    /**
+     * Blocks until the completion is ready, then rethrows its exception if it
+     * has one.
+     */
+    void get() {
+        wait();
+        rethrow_if_exception();
+    }
+};
+
+}  // namespace rpc
+}  // namespace derecho
@@ -133,5 +133,14 @@ public:
      * @return A LockedReference to the TCP socket connected to that node.
      */
     derecho::LockedReference<std::unique_lock<std::mutex>, socket> get_socket(node_id_t node_id);
+
+    /**
+     * Gets a locked reference to all the TCP sockets, indexed by node ID,
+     * for a caller that uses several of them at once, possibly from several
+     * threads. As with get_socket(), no other tcp_connections methods can be
+     * called while the caller holds the locked reference.
+     * @return A LockedReference to the map from node ID to socket.
+     */
+    derecho::LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, socket>> get_all_sockets();
 };
 }  // namespace tcp
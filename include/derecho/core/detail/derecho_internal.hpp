@@ -73,7 +73,12 @@ using rpc_handler_t = std::function<void(subgroup_id_t, node_id_t, persistent::v
 struct UserMessageCallbacks {
     /** A function to be called each time a message reaches global stability in the group. */
     message_callback_t global_stability_callback;
-    /** A function to be called when a new version of a subgroup's state finishes persisting locally */
+    /**
+     * A function to be called when a new version of a subgroup's state finishes persisting locally.
+     * It runs on a persistence thread. Calls for the same subgroup never overlap and report increasing
+     * versions, but if DERECHO/persistence_threads is greater than 1, calls for different subgroups
+     * can run concurrently and in any relative order, so the function must be thread-safe.
+     */
     persistence_callback_t local_persistence_callback = nullptr;
     /** A function to be called when a new version of a subgroup's state has been persisted on all replicas */
     persistence_callback_t global_persistence_callback = nullptr;
@@ -51,13 +51,9 @@ auto ExternalClientCaller<T, ExternalGroupType>::p2p_send(node_id_t dest_node, A
 
     auto return_pair = wrapped_this->template send<rpc::to_internal_tag<true>(tag)>(
             [this, &dest_node](size_t size) -> char* {
-                const std::size_t max_p2p_request_payload_size = getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE);
-                if(size <= max_p2p_request_payload_size) {
-                    return (char*)group.get_sendbuffer_ptr(dest_node,
-                                                           sst::REQUEST_TYPE::P2P_REQUEST);
-                } else {
-                    throw derecho_exception("The size of serialized args exceeds the maximum message size (CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE).");
-                }
+                //Requests larger than a P2P request slot are sent in chunks
+                return (char*)group.get_sendbuffer_ptr(dest_node,
+                                                       sst::REQUEST_TYPE::P2P_REQUEST, size);
             },
             std::forward<Args>(args)...);
     group.finish_p2p_send(dest_node, subgroup_id, return_pair.pending);
@@ -102,10 +98,12 @@ ExternalGroup<ReplicatedTypes...>::ExternalGroup(std::vector<DeserializationCont
         max_payload_sizes[subgroup_id] = max_payload_size;
     }
 
+    //Match the RPC reply window the group members lay out, which scales with their ordered_send batches
+    const uint32_t ordered_send_batch_size = std::max(getConfUInt32(CONF_DERECHO_ORDERED_SEND_BATCH_SIZE), 1u);
     p2p_connections = std::make_unique<sst::P2PConnectionManager>(sst::P2PParams{
             my_id,
             getConfUInt32(CONF_DERECHO_P2P_WINDOW_SIZE),
-            view_max_rpc_window_size,
+            view_max_rpc_window_size * ordered_send_batch_size,
             getConfUInt64(CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE) + sizeof(header),
             getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE) + sizeof(header),
             view_max_rpc_reply_payload_size + sizeof(header),
@@ -178,6 +176,7 @@ void ExternalGroup<ReplicatedTypes...>::clean_up() {
             pending_results_iter != fulfilled_pending_results_pair.second.end();) {
             //Garbage-collect PendingResults references that are obsolete
             if(pending_results_iter->get().all_responded()) {
+                pending_results_iter->get().release();
                 pending_results_iter = fulfilled_pending_results_pair.second.erase(pending_results_iter);
             } else {
                 for(uint32_t shard_num = 0;
@@ -238,11 +237,11 @@ ExternalClientCaller<SubgroupType, ExternalGroup<ReplicatedTypes...>>& ExternalG
 }
 
 template <typename... ReplicatedTypes>
-volatile char* ExternalGroup<ReplicatedTypes...>::get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type) {
+volatile char* ExternalGroup<ReplicatedTypes...>::get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type, std::size_t size) {
     volatile char* buf;
     do {
         try {
-            buf = p2p_connections->get_sendbuffer_ptr(dest_id, type);
+            buf = p2p_connections->get_sendbuffer_ptr(dest_id, type, size);
         } catch(std::out_of_range& map_error) {
             throw node_removed_from_group_exception(dest_id);
         }
@@ -254,12 +253,27 @@ volatile char* ExternalGroup<ReplicatedTypes...>::get_sendbuffer_ptr(uint32_t de
 template <typename... ReplicatedTypes>
 void ExternalGroup<ReplicatedTypes...>::finish_p2p_send(node_id_t dest_id, subgroup_id_t dest_subgroup_id, rpc::PendingBase& pending_results_handle) {
     try {
-        p2p_connections->send(dest_id);
+        p2p_connections->send(dest_id, sst::REQUEST_TYPE::P2P_REQUEST);
     } catch(std::out_of_range& map_error) {
+        pending_results_handle.release();
         throw node_removed_from_group_exception(dest_id);
     }
     pending_results_handle.fulfill_map({dest_id});
-    fulfilled_pending_results[dest_subgroup_id].push_back(pending_results_handle);
+    std::list<rpc::PendingBase_ref>& fulfilled = fulfilled_pending_results[dest_subgroup_id];
+    fulfilled.push_back(pending_results_handle);
+    //Release the PendingResults that have all their replies, once the list has doubled since the last sweep
+    std::size_t& sweep_size = fulfilled_results_sweep_size[dest_subgroup_id];
+    if(fulfilled.size() >= sweep_size) {
+        for(auto pending_results_iter = fulfilled.begin(); pending_results_iter != fulfilled.end();) {
+            if(pending_results_iter->get().all_responded()) {
+                pending_results_iter->get().release();
+                pending_results_iter = fulfilled.erase(pending_results_iter);
+            } else {
+                pending_results_iter++;
+            }
+        }
+        sweep_size = std::max<std::size_t>(2 * fulfilled.size(), 64);
+    }
 }
 
 template <typename... ReplicatedTypes>
@@ -292,7 +306,7 @@ std::exception_ptr ExternalGroup<ReplicatedTypes...>::receive_message(
 }
 
 template <typename... ReplicatedTypes>
-void ExternalGroup<ReplicatedTypes...>::p2p_message_handler(node_id_t sender_id, char* msg_buf) {
+void ExternalGroup<ReplicatedTypes...>::p2p_message_handler(node_id_t sender_id, char* msg_buf, std::unique_ptr<char[]> owned_buf) {
     using namespace remote_invocation_utilities;
     const std::size_t header_size = header_space();
     std::size_t payload_size;
@@ -306,15 +320,11 @@ void ExternalGroup<ReplicatedTypes...>::p2p_message_handler(node_id_t sender_id,
         receive_message(indx, received_from, msg_buf + header_size, payload_size,
                         [this, &reply_size, &sender_id](size_t _size) -> char* {
                             reply_size = _size;
-                            if(reply_size <= p2p_connections->get_max_p2p_reply_size()) {
-                                return (char*)p2p_connections->get_sendbuffer_ptr(
-                                        sender_id, sst::REQUEST_TYPE::P2P_REPLY);
-                            } else {
-                                throw buffer_overflow_exception("Size of a P2P reply exceeds the maximum P2P reply message size");
-                            }
+                            return (char*)p2p_connections->get_sendbuffer_ptr(
+                                    sender_id, sst::REQUEST_TYPE::P2P_REPLY, reply_size);
                         });
         if(reply_size > 0) {
-            p2p_connections->send(sender_id);
+            p2p_connections->send(sender_id, sst::REQUEST_TYPE::P2P_REPLY);
         }
     } else if(RPC_HEADER_FLAG_TST(flags, CASCADE)) {
         // TODO: what is the lifetime of msg_buf? discuss with Sagar to make
@@ -325,6 +335,7 @@ void ExternalGroup<ReplicatedTypes...>::p2p_message_handler(node_id_t sender_id,
         // send to fifo queue.
         std::unique_lock<std::mutex> lock(request_queue_mutex);
         p2p_request_queue.emplace(sender_id, msg_buf);
+        p2p_request_queue.back().msg_copy = std::move(owned_buf);
         request_queue_cv.notify_one();
     }
 }
@@ -348,7 +359,7 @@ void ExternalGroup<ReplicatedTypes...>::p2p_request_worker() {
             if(thread_shutdown) {
                 break;
             }
-            request = p2p_request_queue.front();
+            request = std::move(p2p_request_queue.front());
             p2p_request_queue.pop();
         }
         retrieve_header(nullptr, request.msg_buf, payload_size, indx, received_from, flags);
@@ -361,20 +372,16 @@ void ExternalGroup<ReplicatedTypes...>::p2p_request_worker() {
         receive_message(indx, received_from, request.msg_buf + header_size, payload_size,
                         [this, &reply_size, &request](size_t _size) -> char* {
                             reply_size = _size;
-                            if(reply_size <= p2p_connections->get_max_p2p_reply_size()) {
-                                return (char*)p2p_connections->get_sendbuffer_ptr(
-                                        request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
-                            } else {
-                                throw buffer_overflow_exception("Size of a P2P reply exceeds the maximum P2P reply size.");
-                            }
+                            return (char*)p2p_connections->get_sendbuffer_ptr(
+                                    request.sender_id, sst::REQUEST_TYPE::P2P_REPLY, reply_size);
                         });
         if(reply_size > 0) {
-            p2p_connections->send(request.sender_id);
+            p2p_connections->send(request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
         } else {
             // hack for now to "simulate" a reply for p2p_sends to functions that do not generate a reply
             char* buf = p2p_connections->get_sendbuffer_ptr(request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
             buf[0] = 0;
-            p2p_connections->send(request.sender_id);
+            p2p_connections->send(request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
         }
     }
 }
@@ -388,16 +395,15 @@ void ExternalGroup<ReplicatedTypes...>::p2p_receive_loop() {
     struct timespec last_time, cur_time;
     clock_gettime(CLOCK_REALTIME, &last_time);
 
+    sst::P2PMessageBatch batch;
     // loop event
     while(!thread_shutdown) {
         //No need to get a View lock here, since ExternalGroup doesn't have a ViewManager or view-change events
-        auto optional_reply_pair = p2p_connections->probe_all();
-        if(optional_reply_pair) {
-            auto reply_pair = optional_reply_pair.value();
-            if(reply_pair.first != INVALID_NODE_ID) {
-                p2p_message_handler(reply_pair.first, (char*)reply_pair.second);
-                p2p_connections->update_incoming_seq_num(reply_pair.first);
+        if(p2p_connections->probe_all(batch)) {
+            for(sst::IncomingMessage& message : batch.messages) {
+                p2p_message_handler(batch.sender_id, message.buf, std::move(message.owned_buf));
             }
+            p2p_connections->update_incoming_seq_nums(batch);
 
             // update last time
             clock_gettime(CLOCK_REALTIME, &last_time);
@@ -253,9 +253,7 @@ std::set<std::pair<subgroup_id_t, node_id_t>> Group<ReplicatedTypes...>::constru
                 if(old_object != replicated_objects.template get<FirstType>().end() && old_object->second.get_shard_num() != shard_num) {
                     dbg_default_debug("Deleting old Replicated Object state for type {}; I was reassigned from shard {} to shard {}",
                                       typeid(FirstType).name(), old_object->second.get_shard_num(), shard_num);
-                    // also erase from objects_by_subgroup_id
-                    objects_by_subgroup_id.erase(subgroup_id);
-                    replicated_objects.template get<FirstType>().erase(old_object);
+                    retire_object<FirstType>(old_object);
                 }
                 //Determine if there is existing state for this shard on another node
                 bool has_previous_leader = old_shard_leaders.size() > subgroup_id
@@ -267,7 +265,12 @@ std::set<std::pair<subgroup_id_t, node_id_t>> Group<ReplicatedTypes...>::constru
                     dbg_default_debug("Constructing a Replicated Object for type {}, subgroup {}, shard {}",
                                       typeid(FirstType).name(), subgroup_id, shard_num);
                     if(has_previous_leader) {
-                        subgroups_to_receive.emplace(subgroup_id, old_shard_leaders[subgroup_id][shard_num]);
+                        //After a view change, the state may come from any member that was already in the shard
+                        subgroups_to_receive.emplace(subgroup_id,
+                                                     in_restart ? old_shard_leaders[subgroup_id][shard_num]
+                                                                : ViewManager::choose_state_transfer_sender(
+                                                                        curr_view, subgroup_id, shard_num, my_id,
+                                                                        old_shard_leaders[subgroup_id][shard_num]));
                     }
                     if(has_previous_leader && !has_persistent_fields<FirstType>::value) {
                         /* Construct an "empty" Replicated<T>, since all of T's state will
@@ -300,8 +303,7 @@ std::set<std::pair<subgroup_id_t, node_id_t>> Group<ReplicatedTypes...>::constru
             if(old_object != replicated_objects.template get<FirstType>().end()) {
                 dbg_default_debug("Deleting old Replicated Object state (of type {}) for subgroup {} because this node is no longer a member",
                                   typeid(FirstType).name(), subgroup_index);
-                objects_by_subgroup_id.erase(subgroup_id);
-                replicated_objects.template get<FirstType>().erase(old_object);
+                retire_object<FirstType>(old_object);
             }
             // Create an ExternalCaller for the subgroup if we don't already have one
             external_callers.template get<FirstType>().emplace(
@@ -312,6 +314,16 @@ std::set<std::pair<subgroup_id_t, node_id_t>> Group<ReplicatedTypes...>::constru
     return functional_insert(subgroups_to_receive, construct_objects<RestTypes...>(curr_view, old_shard_leaders, in_restart));
 }
 
+template <typename... ReplicatedTypes>
+template <typename T>
+void Group<ReplicatedTypes...>::retire_object(typename replicated_index_map<T>::iterator object) {
+    objects_by_subgroup_id.erase(object->second.get_subgroup_id());
+    object->second.retire();
+    //This node may be the only one that can send the object's state to the new members of its shard
+    retired_objects.emplace_back(std::make_shared<typename replicated_index_map<T>::node_type>(
+            replicated_objects.template get<T>().extract(object)));
+}
+
 template <typename... ReplicatedTypes>
 void Group<ReplicatedTypes...>::set_up_components() {
     //Give PersistenceManager this pointer to break the circular dependency
@@ -382,31 +394,10 @@ ShardIterator<SubgroupType> Group<ReplicatedTypes...>::get_shard_iterator(uint32
 
 template <typename... ReplicatedTypes>
 void Group<ReplicatedTypes...>::receive_objects(const std::set<std::pair<subgroup_id_t, node_id_t>>& subgroups_and_leaders) {
-    //This will receive one object from each shard leader in ascending order of subgroup ID
-    for(const auto& subgroup_and_leader : subgroups_and_leaders) {
-        LockedReference<std::unique_lock<std::mutex>, tcp::socket> leader_socket
-                = view_manager.get_transfer_socket(subgroup_and_leader.second);
-        ReplicatedObject* subgroup_object = objects_by_subgroup_id.at(subgroup_and_leader.first);
-        try {
-            if(subgroup_object->is_persistent()) {
-                persistent::version_t log_tail_length = subgroup_object->get_minimum_latest_persisted_version();
-                dbg_default_debug("Sending log tail length of {} for subgroup {} to node {}.",
-                                  log_tail_length, subgroup_and_leader.first, subgroup_and_leader.second);
-                leader_socket.get().write(log_tail_length);
-            }
-            dbg_default_debug("Receiving Replicated Object state for subgroup {} from node {}",
-                              subgroup_and_leader.first, subgroup_and_leader.second);
-            std::size_t buffer_size;
-            leader_socket.get().read(buffer_size);
-            std::unique_ptr<char[]> buffer = std::make_unique<char[]>(buffer_size);
-            leader_socket.get().read(buffer.get(), buffer_size);
-            subgroup_object->receive_object(buffer.get());
-        } catch(tcp::socket_error& e) {
-            //Convert socket exceptions to a more readable error message, since this will cause a crash
-            throw derecho_exception("Fatal error: Node " + std::to_string(subgroup_and_leader.second) + " failed during state transfer!");
-        }
-    }
-    dbg_default_debug("Done receiving all Replicated Objects from subgroup leaders");
+    //This receives all the objects at once, along with any objects this node is sending
+    view_manager.transfer_objects(subgroups_and_leaders);
+    //Every object this node was sending has been sent
+    retired_objects.clear();
 }
 
 template <typename... ReplicatedTypes>
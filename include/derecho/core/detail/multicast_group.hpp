@@ -1,6 +1,7 @@
 #pragma once
 
 #include <assert.h>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <list>
@@ -20,6 +21,7 @@
 #include "derecho_internal.hpp"
 #include "derecho_sst.hpp"
 #include "persistence_manager.hpp"
+#include "rdmc_buffer_pool.hpp"
 #include <derecho/conf/conf.hpp>
 #include <derecho/mutils-serialization/SerializationMacros.hpp>
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
@@ -164,29 +166,6 @@ struct DerechoParams : public mutils::ByteRepresentable {
                                   heartbeat_ms, rdmc_send_algorithm, state_transfer_port);
 };
 
-/**
- * Represents a block of memory used to store a message. This object contains
- * both the array of bytes in which the message is stored and the corresponding
- * RDMA memory region (which has registered that array of bytes as its buffer).
- * This is a move-only type, since memory regions can't be copied.
- */
-struct MessageBuffer {
-    std::unique_ptr<char[]> buffer;
-    std::shared_ptr<rdma::memory_region> mr;
-
-    MessageBuffer() {}
-    MessageBuffer(size_t size) {
-        if(size != 0) {
-            buffer = std::unique_ptr<char[]>(new char[size]);
-            mr = std::make_shared<rdma::memory_region>(buffer.get(), size);
-        }
-    }
-    MessageBuffer(const MessageBuffer&) = delete;
-    MessageBuffer(MessageBuffer&&) = default;
-    MessageBuffer& operator=(const MessageBuffer&) = delete;
-    MessageBuffer& operator=(MessageBuffer&&) = default;
-};
-
 /**
  * A structure containing an RDMC message (which consists of some bytes in a
  * registered memory region) and some associated metadata. Note that the
@@ -246,6 +225,30 @@ struct SubgroupSettings {
     DerechoParams profile;
 };
 
+/**
+ * The part of a subgroup's settings that the send path and the predicates read
+ * on every evaluation, precomputed once per view from its SubgroupSettings so
+ * that these reads involve no map lookups, copies, or counting loops.
+ */
+struct SubgroupHotSettings {
+    /** True if this node is a member of the subgroup; if false, the other fields are unset */
+    bool is_member = false;
+    /** The operation mode of the shard */
+    Mode mode = Mode::ORDERED;
+    /** The number of members of this node's shard */
+    uint32_t num_shard_members = 0;
+    /** The number of senders in this node's shard */
+    uint32_t num_shard_senders = 0;
+    /** This node's sender rank within the shard, or -1 if it is not a sender */
+    int32_t sender_rank = -1;
+    /** The num_received column of this node's messages, num_received_offset + sender_rank */
+    uint32_t own_num_received_column = 0;
+    /** The size of the sending window of the shard */
+    int32_t window_size = 0;
+    /** The SST row indexes of the members of this node's shard, in the same order as SubgroupSettings::members */
+    std::vector<uint32_t> member_sst_indices;
+};
+
 /**
  * Additional message-delivery-related callbacks needed by MulticastGroup that
  * are not in the user-facing set of callbacks defined in UserMessageCallbacks.
@@ -271,6 +274,12 @@ struct MulticastGroupCallbacks {
      * verification callback in UserMessageCallbacks).
      */
     verified_callback_t global_verified_callback;
+    /**
+     * A callback to notify internal components that some of this node's
+     * messages in a subgroup have been delivered (or received, in an
+     * unordered subgroup), so its send window may have room again.
+     */
+    std::function<void(subgroup_id_t)> send_window_callback;
 };
 
 /** Implements the low-level mechanics of tracking multicasts in a Derecho group,
@@ -297,6 +306,9 @@ private:
     /** Maps subgroup IDs (for subgroups this node is a member of) to an immutable
      * set of configuration options for that subgroup. */
     const std::map<subgroup_id_t, SubgroupSettings> subgroup_settings_map;
+    /** Indexed by subgroup ID; the precomputed settings read by the send path
+     * and the predicates, which don't change for the lifetime of the view. */
+    const std::vector<SubgroupHotSettings> hot_settings;
     /** Used for synchronizing receives by RDMC and SST */
     std::vector<std::list<int32_t>> received_intervals;
     /** Maps subgroup IDs for which this node is a sender to the RDMC group it should use to send.
@@ -304,11 +316,65 @@ private:
     std::map<subgroup_id_t, uint32_t> subgroup_to_rdmc_group;
     /** Offset to add to member ranks to form RDMC group numbers. */
     uint16_t rdmc_group_num_offset;
+    /** The number of the first RDMC group created in this view; the groups
+     * created are the ones numbered up to (excluding) rdmc_group_num_offset. */
+    const uint16_t first_rdmc_group_num;
     /** false if RDMC groups haven't been created successfully */
     bool rdmc_sst_groups_created = false;
-    /** Stores message buffers not currently in use. Protected by
-     * msg_state_mtx */
-    std::map<uint32_t, std::vector<MessageBuffer>> free_message_buffers;
+
+    /** A message whose send was deferred to the subgroup's sender thread */
+    struct DeferredSend {
+        std::vector<char> payload;
+        bool cooked_send;
+    };
+
+    /**
+     * The message-tracking state of one subgroup. Each subgroup's state has
+     * its own lock, so that the send, receive, delivery and persistence paths
+     * of different subgroups don't contend with each other. The lock also
+     * protects this subgroup's entries in the per-subgroup vectors below.
+     */
+    struct SubgroupState {
+        std::recursive_mutex mtx;
+        bool pending_sst_send = false;
+        /** Messages that are currently being received, by sender ID */
+        std::map<node_id_t, RDMCMessage> current_receives;
+        /** Messages that have finished sending/receiving but aren't yet
+         * globally stable, by sequence number */
+        std::map<message_id_t, RDMCMessage> locally_stable_rdmc_messages;
+        /** Same map as locally_stable_rdmc_messages, but for SST messages */
+        std::map<message_id_t, SSTMessage> locally_stable_sst_messages;
+        /** The set of timestamps associated with currently-pending (not yet
+         * delivered) messages. Used to compute the stability frontier. */
+        std::set<uint64_t> pending_message_timestamps;
+        /** Tracks the timestamps of messages that are currently being written
+         * to persistent storage */
+        std::map<message_id_t, uint64_t> pending_persistence;
+        /** Messages that are currently being written to persistent storage */
+        std::map<message_id_t, RDMCMessage> non_persistent_messages;
+        /** Messages that are currently being written to persistent storage */
+        std::map<message_id_t, SSTMessage> non_persistent_sst_messages;
+        /** Protects deferred_sends. Taken after mtx, never before it. */
+        std::mutex deferred_sends_mutex;
+        /** Signaled when deferred sends leave the queue, or the group is wedged */
+        std::condition_variable deferred_sends_cv;
+        /** Messages sent to this subgroup from upcalls in other subgroups,
+         * which the sender thread puts in the send window in order. It holds
+         * at most one send window of messages. */
+        std::queue<DeferredSend> deferred_sends;
+        /** Set by a try_send from an upcall that found mtx taken, so that the
+         * sender thread raises the send window callback once it gets mtx. */
+        std::atomic<bool> send_ready_wanted{false};
+    };
+    /**
+     * The pool that the buffers of RDMC messages are allocated from, shared
+     * with the previous and next views' groups. It is declared before every
+     * member that can hold a MessageBuffer, so that it is destroyed after them.
+     */
+    std::shared_ptr<RDMCBufferPool> buffer_pool;
+    /** Indexed by subgroup ID; entries for subgroups this node does not
+     * belong to are unused. Never resized after construction. */
+    std::vector<SubgroupState> subgroup_states;
 
     /** Index to be used the next time get_sendbuffer_ptr is called.
      * When next_message is not none, then next_message.index = future_message_index-1 */
@@ -317,7 +383,6 @@ private:
     /** next_message is the message that will be sent when send is called the next time.
      * It is std::nullopt when there is no message to send. */
     std::vector<std::optional<RDMCMessage>> next_sends;
-    std::map<uint32_t, bool> pending_sst_sends;
     std::vector<uint32_t> committed_sst_index;
     std::vector<uint32_t> num_nulls_queued;
     std::vector<int32_t> first_null_index;
@@ -327,26 +392,9 @@ private:
     /** one per subgroup */
     std::vector<std::optional<RDMCMessage>> current_sends;
 
-    /** Messages that are currently being received. */
-    std::map<std::pair<subgroup_id_t, node_id_t>, RDMCMessage> current_receives;
     /** Receiver lambdas for shards that have only one member. */
     std::map<subgroup_id_t, std::function<void(char*, size_t)>> singleton_shard_receive_handlers;
 
-    /** Messages that have finished sending/receiving but aren't yet globally stable.
-     * Organized by [subgroup number] -> [sequence number] -> [message] */
-    std::map<subgroup_id_t, std::map<message_id_t, RDMCMessage>> locally_stable_rdmc_messages;
-    /** Same map as locally_stable_rdmc_messages, but for SST messages */
-    std::map<subgroup_id_t, std::map<message_id_t, SSTMessage>> locally_stable_sst_messages;
-    /** For each subgroup, the set of timestamps associated with currently-pending
-     * (not yet delivered) messages. Used to compute the stability frontier. */
-    std::map<subgroup_id_t, std::set<uint64_t>> pending_message_timestamps;
-    /** Tracks the timestamps of messages that are currently being written to persistent storage */
-    std::map<subgroup_id_t, std::map<message_id_t, uint64_t>> pending_persistence;
-    /** Messages that are currently being written to persistent storage */
-    std::map<subgroup_id_t, std::map<message_id_t, RDMCMessage>> non_persistent_messages;
-    /** Messages that are currently being written to persistent storage */
-    std::map<subgroup_id_t, std::map<message_id_t, SSTMessage>> non_persistent_sst_messages;
-
     /** The next message ID that can be delivered in each subgroup, indexed by subgroup number. */
     std::vector<message_id_t> next_message_to_deliver;
     /**
@@ -361,16 +409,35 @@ private:
      */
     std::vector<persistent::version_t> minimum_verified_version;
 
-    std::recursive_mutex msg_state_mtx;
-    std::condition_variable_any sender_cv;
+    /** Taken only while wedging this group and while a new view's group takes
+     * over its state; everything else is protected by the SubgroupState locks. */
+    std::mutex msg_state_mtx;
+
+    /**
+     * A thread that sends messages with RDMC in a fixed set of subgroups,
+     * woken by notify_sender() when one of them may be able to send.
+     */
+    struct SenderThread {
+        /** The subgroups this thread sends in, served round-robin */
+        std::vector<subgroup_id_t> subgroups;
+        std::mutex wakeup_mutex;
+        std::condition_variable wakeup_cv;
+        /** Incremented by every notify_sender(); protected by wakeup_mutex */
+        uint64_t wakeup_count = 0;
+        std::thread thread;
+    };
 
     /** The time, in milliseconds, that a sender can wait to send a message before it is considered failed. */
     unsigned int sender_timeout;
 
     /** Indicates that the group is being destroyed. */
     std::atomic<bool> thread_shutdown{false};
-    /** The background thread that sends messages with RDMC. */
-    std::thread sender_thread;
+    /** The background threads that send messages with RDMC; the number is
+     * set by CONF_DERECHO_SENDER_THREADS. */
+    std::vector<std::unique_ptr<SenderThread>> sender_threads;
+    /** Indexed by subgroup ID; the index in sender_threads of the thread that
+     * sends in the subgroup, or -1 if this node is not a sender in it. */
+    std::vector<int32_t> sender_thread_of;
 
     std::thread timeout_thread;
 
@@ -394,9 +461,21 @@ private:
      * alert it when a new version needs to be persisted. */
     PersistenceManager& persistence_manager;
 
-    /** Continuously waits for a new pending send, then sends it. This function
-     * implements the sender thread. */
-    void send_loop();
+    /** Continuously waits for a new pending send in one of the thread's
+     * subgroups, then sends it. This function implements the sender threads.
+     * @param thread_index The index of the thread in sender_threads */
+    void send_loop(uint32_t thread_index);
+
+    /** Divides the subgroups in which this node is a sender among the
+     * configured number of sender threads. Must be called before anything
+     * can call notify_sender(). */
+    void create_sender_threads();
+    /** Starts the threads set up by create_sender_threads(). */
+    void start_sender_threads();
+
+    /** Wakes up the sender thread of a subgroup, because a message may have
+     * become ready to send in it. Does nothing if this node is not a sender. */
+    void notify_sender(subgroup_id_t subgroup_num);
 
     /** Checks for failures when a sender reaches its timeout. This function
      * implements the timeout thread. */
@@ -497,9 +576,29 @@ private:
 
     // Internally used to automatically send a NULL message
     void get_buffer_and_send_auto_null(subgroup_id_t subgroup_num);
+
+    /**
+     * Queues a message sent from an upcall in another subgroup, for the
+     * subgroup's sender thread to put in the send window. Waiting for this
+     * subgroup's lock from the upcall, which holds the other subgroup's lock,
+     * could deadlock with an upcall in this subgroup sending to that one.
+     * Once a send window of messages is queued, this blocks like a send to a
+     * full window, until the sender thread takes one or the group is wedged.
+     * @return false if the group was wedged before the message was queued
+     */
+    bool defer_send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                    const std::function<void(char* buf)>& msg_generator, bool cooked_send);
+    /**
+     * Puts a subgroup's deferred sends in the send window, in order, until
+     * the window is full. Call with the subgroup's lock held.
+     * @return true if no deferred sends are left
+     */
+    bool flush_deferred_sends(subgroup_id_t subgroup_num);
     /* Get a pointer into the current buffer, to write data into it before sending
      * Now this is a private function, called by send internally */
     char* get_sendbuffer_ptr(subgroup_id_t subgroup_num, long long unsigned int payload_size, bool cooked_send);
+    /** Sends the message written to the buffer returned by get_sendbuffer_ptr. */
+    void commit_send(subgroup_id_t subgroup_num);
 
 public:
     /**
@@ -546,14 +645,31 @@ public:
 
     void deliver_messages_upto(const std::vector<int32_t>& max_indices_for_senders, subgroup_id_t subgroup_num, uint32_t num_shard_senders);
     /** Send now internally calls get_sendbuffer_ptr.
-	The user function that generates the message is supplied to send */
+	The user function that generates the message is supplied to send.
+	A send from an upcall in another subgroup is deferred to the sender thread
+	of subgroup_num, and returns as soon as the message is queued; it only
+	blocks if a send window of such messages is queued already. */
     bool send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
               const std::function<void(char* buf)>& msg_generator, bool cooked_send);
+    /**
+     * Like send, but makes only one attempt to get a buffer, and returns
+     * false right away if the subgroup's send window is full. It is never
+     * deferred: from an upcall in another subgroup, it also returns false if
+     * it can't take the subgroup's lock without waiting.
+     */
+    bool try_send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                  const std::function<void(char* buf)>& msg_generator, bool cooked_send);
     bool check_pending_sst_sends(subgroup_id_t subgroup_num);
 
     const uint64_t compute_global_stability_frontier(subgroup_id_t subgroup_num);
 
-    /** Stops all sending and receiving in this group, in preparation for shutting it down. */
+    /**
+     * Stops all sending and receiving in this group, in preparation for shutting it down.
+     * Must not be called while holding a SubgroupState lock: removing the subgroup
+     * predicates waits for any of their triggers that is running on another thread,
+     * and those triggers take their subgroup's lock. msg_state_mtx is only taken once
+     * the predicates are removed, for the same reason.
+     */
     void wedge();
     /** Debugging function; prints the current state of the SST to stdout. */
     void debug_print();
@@ -565,6 +681,39 @@ public:
     const std::map<subgroup_id_t, SubgroupSettings>& get_subgroup_settings() {
         return subgroup_settings_map;
     }
-    std::vector<uint32_t> get_shard_sst_indices(subgroup_id_t subgroup_num);
+    const std::vector<uint32_t>& get_shard_sst_indices(subgroup_id_t subgroup_num) const;
+
+    /**
+     * Precomputes the per-view hot settings of every subgroup.
+     * @param members The members of the view, in SST row order
+     * @param total_num_subgroups The total number of subgroups in the Group
+     * @param subgroup_settings_by_id The SubgroupSettings of the subgroups
+     * this node belongs to, indexed by subgroup ID
+     * @return A vector indexed by subgroup ID; entries for subgroups this node
+     * does not belong to have is_member == false
+     */
+    static std::vector<SubgroupHotSettings> compute_hot_settings(
+            const std::vector<node_id_t>& members,
+            uint32_t total_num_subgroups,
+            const std::map<subgroup_id_t, SubgroupSettings>& subgroup_settings_by_id);
+
+    /**
+     * The sending window check of the sender thread and get_sendbuffer_ptr:
+     * whether every member of this node's shard has made room for the message
+     * with index msg_index. In ordered mode, members must have delivered
+     * enough messages; in unordered mode, they must have received enough of
+     * this node's messages.
+     * @param hot The hot settings of the subgroup
+     * @param subgroup_num The subgroup ID
+     * @param delivered_num The delivered_num field of the SST
+     * @param num_received The num_received field of the SST
+     * @param msg_index The index of the message to send
+     * @return True if the message fits in the window
+     */
+    static bool window_has_room(const SubgroupHotSettings& hot,
+                                subgroup_id_t subgroup_num,
+                                const sst::SSTFieldVector<message_id_t>& delivered_num,
+                                const sst::SSTFieldVector<int32_t>& num_received,
+                                message_id_t msg_index);
 };
 }  // namespace derecho
@@ -0,0 +1,117 @@
+/**
+ * @file opcode_dispatch_table.hpp
+ *
+ * A flat index from RPC opcodes to copies of the handler functions registered
+ * in RPCManager's receivers map, used to dispatch incoming RPC messages.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "rpc_utils.hpp"
+
+namespace derecho {
+
+namespace rpc {
+
+/**
+ * A read-only snapshot of a map from Opcodes to receive functions, laid out
+ * for fast lookup: the subgroup ID of an opcode indexes a dense array of
+ * per-subgroup hash tables, each a power-of-two-sized range of one flat
+ * vector that is at most half full and uses linear probing. The table holds
+ * copies of the receive functions, so it stays valid after entries are erased
+ * from the map, but it must be rebuilt to see changes to the map.
+ */
+class OpcodeDispatchTable {
+    struct Entry {
+        Opcode opcode;
+        /** Empty if the slot is empty */
+        receive_fun_t function;
+    };
+    /** The slots of one subgroup's hash table in entries */
+    struct SubgroupRange {
+        uint32_t offset;
+        uint32_t mask;
+    };
+    std::vector<Entry> entries;
+    /** Indexed by subgroup ID */
+    std::vector<SubgroupRange> subgroup_ranges;
+
+    static uint32_t slot_hash(const Opcode& opcode) {
+        const uint64_t key = opcode.function_id
+                             ^ (static_cast<uint64_t>(opcode.class_id) << 40)
+                             ^ static_cast<uint64_t>(opcode.is_reply);
+        return static_cast<uint32_t>((key * 0x9e3779b97f4a7c15ULL) >> 32);
+    }
+
+public:
+    /** Constructs an empty table, which finds no functions. */
+    OpcodeDispatchTable() = default;
+
+    /**
+     * Builds a table that indexes all the entries of a receivers map.
+     * @param receivers The map from Opcodes to receive functions
+     */
+    explicit OpcodeDispatchTable(const std::map<Opcode, receive_fun_t>& receivers) {
+        if(receivers.empty()) {
+            return;
+        }
+        // Since the map is ordered by class ID first, count per subgroup before laying out
+        std::map<subgroup_id_t, uint32_t> functions_per_subgroup;
+        subgroup_id_t max_subgroup_id = 0;
+        for(const auto& receiver : receivers) {
+            functions_per_subgroup[receiver.first.subgroup_id]++;
+            max_subgroup_id = std::max(max_subgroup_id, receiver.first.subgroup_id);
+        }
+        // Subgroups without functions share one empty slot at offset 0
+        subgroup_ranges.assign(static_cast<std::size_t>(max_subgroup_id) + 1, SubgroupRange{0, 0});
+        uint32_t num_slots = 1;
+        for(const auto& subgroup_count : functions_per_subgroup) {
+            uint32_t size = 2;
+            while(size < 2 * subgroup_count.second) {
+                size *= 2;
+            }
+            subgroup_ranges[subgroup_count.first] = SubgroupRange{num_slots, size - 1};
+            num_slots += size;
+        }
+        entries.assign(num_slots, Entry{Opcode{}, receive_fun_t{}});
+        for(const auto& receiver : receivers) {
+            const SubgroupRange& range = subgroup_ranges[receiver.first.subgroup_id];
+            uint32_t slot = slot_hash(receiver.first) & range.mask;
+            while(entries[range.offset + slot].function) {
+                slot = (slot + 1) & range.mask;
+            }
+            entries[range.offset + slot] = Entry{receiver.first, receiver.second};
+        }
+    }
+
+    /**
+     * @param opcode An RPC opcode
+     * @return The receive function for the opcode, or null if there is none.
+     * It points into the table, so it is valid as long as the table is.
+     */
+    const receive_fun_t* find(const Opcode& opcode) const {
+        if(opcode.subgroup_id >= subgroup_ranges.size()) {
+            return nullptr;
+        }
+        const SubgroupRange& range = subgroup_ranges[opcode.subgroup_id];
+        uint32_t slot = slot_hash(opcode) & range.mask;
+        while(true) {
+            const Entry& entry = entries[range.offset + slot];
+            if(!entry.function) {
+                return nullptr;
+            }
+            if(entry.opcode == opcode) {
+                return &entry.function;
+            }
+            slot = (slot + 1) & range.mask;
+        }
+    }
+};
+
+}  // namespace rpc
+}  // namespace derecho
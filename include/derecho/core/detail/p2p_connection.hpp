@@ -1,11 +1,13 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <optional>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #ifdef USE_VERBS_API
@@ -31,20 +33,218 @@ struct RequestParams {
     uint32_t window_sizes[num_request_types];
     uint32_t max_msg_sizes[num_request_types];
     uint64_t offsets[num_request_types];
+    /**
+     * The offset in the P2P buffers of the words in which each side
+     * acknowledges the messages it has consumed, one per request type
+     */
+    uint64_t ack_offset;
+    /**
+     * The offset in the P2P buffers of the words through which the two sides
+     * agree to switch their connection to buffers of another size class
+     */
+    uint64_t control_offset;
+    /** The size of each of the incoming and outgoing P2P buffers */
+    uint64_t buffer_size;
+};
+
+/**
+ * The types of messages through which the two sides of a P2P connection agree
+ * to switch to buffers of another size class.
+ */
+enum class ResizeMessageType : uint8_t {
+    NONE = 0,
+    PROPOSE,
+    ACCEPT,
+    REJECT
+};
+
+struct ResizeMessage {
+    ResizeMessageType type;
+    uint32_t size_class;
 };
 
+/**
+ * An incoming message found by P2PConnection::probe. A message that fit in
+ * one slot is read in place from the connection's incoming buffer; a message
+ * that was sent in several chunks has been reassembled into owned_buf, and
+ * buf points to its beginning.
+ */
+struct IncomingMessage {
+    char* buf;
+    std::unique_ptr<char[]> owned_buf;
+};
+
+/**
+ * A P2P connection carries three types of messages, each in its own window of
+ * fixed-size slots in the incoming and outgoing buffers. A slot ends with two
+ * words: a "chunk word," which is zero if the slot holds a whole message, and
+ * a sequence number, which the sender writes last to make the slot ready.
+ * Messages larger than a slot are streamed through consecutive slots of their
+ * type, with the total size of the message in the chunk word of each one, and
+ * reassembled by the receiver. The buffers also hold one acknowledgment word
+ * per type, in which the receiver periodically publishes how many slots of
+ * that type it has consumed, so that the sender knows when it can reuse them.
+ *
+ * The window and slot sizes of a connection are given by its size class, and
+ * a connection can move to a larger size class without being torn down: one
+ * side registers buffers of the new class and proposes the switch through the
+ * control words of the current buffers, including the key and address of its
+ * new incoming buffer and the number of messages of each type it has sent,
+ * after which it sends nothing until the other side answers. If the other
+ * side accepts, it answers with the same information for its own new buffers.
+ * From then on, each side sends to the other's new buffer with fresh sequence
+ * numbers, and reads its old incoming buffer until it has received as many
+ * messages as the other side reported, before reading the new one. The
+ * proposing side confirms its switch through the new buffers, since until
+ * then it may still write acknowledgments to the accepting side's old ones.
+ */
 class P2PConnection {
     const uint32_t my_node_id;
     const uint32_t remote_id;
-    const RequestParams& request_params;
+    /** The buffer layout of each size class, owned by the P2PConnectionManager */
+    const std::vector<RequestParams>& buffer_layouts;
+    uint32_t size_class;
+    /** The layout of the current buffers, i.e. buffer_layouts[size_class] */
+    RequestParams request_params;
     std::unique_ptr<volatile char[]> incoming_p2p_buffer;
     std::unique_ptr<volatile char[]> outgoing_p2p_buffer;
+    /** Null for a connection that does not use RDMA, see make_loopback_pair */
     std::unique_ptr<resources> res;
+    /**
+     * Without RDMA, the remote side's incoming buffer, to which remote writes
+     * are copied; for the connection of a node to itself, its own incoming buffer
+     */
+    volatile char* loopback_remote_buffer = nullptr;
     std::map<REQUEST_TYPE, std::atomic<uint64_t>> incoming_seq_nums_map, outgoing_seq_nums_map;
-    REQUEST_TYPE prev_mode;
-    REQUEST_TYPE last_type;
+
+    /** The incoming sequence number last published in the acknowledgment word of each type */
+    uint64_t published_seq_nums[num_request_types] = {};
+    /** Whether the slots consumed since the last acknowledgment of each type included chunks */
+    bool consumed_chunks[num_request_types] = {};
+    /** A large incoming message of each type that is being reassembled */
+    struct Reassembly {
+        std::unique_ptr<char[]> buffer;
+        uint64_t size = 0;
+        uint64_t received = 0;
+    };
+    Reassembly reassemblies[num_request_types];
+
+    /** The number of P2P_REPLY messages received, each of which completes a P2P_REQUEST */
+    uint64_t num_replies_received = 0;
+    /** The number of P2P_REQUEST messages sent */
+    uint64_t num_requests_sent = 0;
+    /**
+     * For each P2P_REQUEST slot, 1 + the index of the request message last
+     * sent in it, or 0 if it last held a chunk of a large request. The remote
+     * node may still be reading a single-slot request in place until it sends
+     * the reply, but it copies chunks out of the slots when it consumes them.
+     */
+    std::vector<uint64_t> request_slot_owners;
+
+    /** A large outgoing message of each type that is being sent in chunks */
+    struct LargeSend {
+        std::vector<char> buffer;
+        std::size_t size = 0;
+        std::size_t offset = 0;
+        bool pending = false;
+    };
+    LargeSend large_sends[num_request_types];
+
+    /** The number of complete P2P_REQUEST messages received, each of which needs a reply */
+    uint64_t num_requests_received = 0;
+    /** The number of complete P2P_REPLY messages sent */
+    uint64_t num_replies_sent = 0;
+    /** Whether a slot of each type was returned by get_sendbuffer_ptr and not sent yet */
+    bool send_buffer_claimed[num_request_types] = {};
+    /** Whether the last attempt to get a slot of each type found none free */
+    bool send_stalled[num_request_types] = {};
+    /** The number of signs of a too-small size class seen since the last take_pressure_events() */
+    uint32_t pressure_events = 0;
+
+    /** The buffers of the size class this side has proposed, while the proposal is pending */
+    std::unique_ptr<volatile char[]> next_incoming_buffer;
+    std::unique_ptr<volatile char[]> next_outgoing_buffer;
+    uint32_t proposed_size_class = 0;
+    /** True from the time this side proposes a resize until the remote side answers */
+    bool resize_proposed = false;
+    /** The number of resize proposals this side has sent, which is also the serial number of the last one */
+    uint64_t resize_proposals_sent = 0;
+    /** The serial number of the last resize proposal received from the remote side */
+    uint64_t last_proposal_received = 0;
+
+    /**
+     * After a switch, the previous incoming buffer, which is still read (with
+     * its own layout) until all the messages the remote node sent to it have
+     * been consumed; null otherwise
+     */
+    std::unique_ptr<volatile char[]> draining_buffer;
+    RequestParams draining_params;
+    /**
+     * The number of messages of each type the remote node sent to the
+     * draining buffer. If this side accepted the switch, the number of RPC
+     * replies is only known once the proposer confirms it.
+     */
+    uint64_t drain_seq_nums[num_request_types] = {};
+    /**
+     * The buffers replaced by the last switch, once drained. They are kept
+     * until RDMA operations posted on them are done and every request read
+     * in place from the incoming one has been replied to.
+     */
+    std::unique_ptr<volatile char[]> retired_incoming_buffer;
+    std::unique_ptr<volatile char[]> retired_outgoing_buffer;
+    uint64_t retired_buffer_size = 0;
+    /** num_requests_received when the draining buffer was retired */
+    uint64_t requests_received_before_switch = 0;
+    std::chrono::steady_clock::time_point switch_time;
+    /**
+     * The serial number of the proposal this side accepted last, whose
+     * proposer must confirm its switch before the retired buffers are freed
+     */
+    uint64_t awaited_switch_confirmation = 0;
+
+    P2PConnection(uint32_t my_node_id, uint32_t remote_id, const std::vector<RequestParams>& buffer_layouts,
+                  uint32_t size_class, bool use_rdma);
+    /** Writes a range of the outgoing buffer to the same range of the remote side's incoming buffer. */
+    void post_remote_write(uint64_t offset, uint64_t size);
+    static uint64_t getOffsetSeqNum(const RequestParams& params, REQUEST_TYPE type, uint64_t seq_num);
+    static uint64_t getOffsetBuf(const RequestParams& params, REQUEST_TYPE type, uint64_t seq_num);
     uint64_t getOffsetSeqNum(REQUEST_TYPE type, uint64_t seq_num);
+    uint64_t getOffsetChunkWord(REQUEST_TYPE type, uint64_t seq_num);
     uint64_t getOffsetBuf(REQUEST_TYPE type, uint64_t seq_num);
+    uint64_t getOffsetAck(REQUEST_TYPE type);
+    /** @return True if the next outgoing slot of the given type can be reused */
+    bool is_slot_available(REQUEST_TYPE type);
+    /**
+     * Writes the first data_size bytes of an outgoing slot and its chunk word
+     * to the remote node, then its sequence number.
+     */
+    void write_slot(REQUEST_TYPE type, uint64_t seq_num, std::size_t data_size);
+    /** @return A control word of the current incoming or outgoing buffer */
+    volatile uint64_t& incoming_control_word(uint32_t index) const;
+    volatile uint64_t& outgoing_control_word(uint32_t index) const;
+    /**
+     * @return True if no thread on this side is in the middle of sending a
+     * message, so the outgoing buffer can be switched between two messages
+     */
+    bool is_send_idle() const;
+    /**
+     * Allocates buffers of the given size class in next_incoming_buffer and
+     * next_outgoing_buffer and registers them with the RDMA connection.
+     * @return The key through which the remote node can write to the new
+     * incoming buffer
+     */
+    uint64_t prepare_next_buffers(uint32_t new_size_class);
+    /**
+     * Starts sending to the remote node's new buffer, and starts draining the
+     * current incoming buffer, after which the next one is read.
+     * @param remote_seq_nums_word The first of the control words holding the
+     * number of messages of each type the remote node sent to the current
+     * incoming buffer
+     */
+    void switch_to_next_buffers(uint32_t new_size_class, uint64_t remote_key, uint64_t remote_addr,
+                                uint32_t remote_seq_nums_word);
+    /** Retires the draining buffer if every message sent to it has been consumed. */
+    void finish_draining();
 
 protected:
     friend class P2PConnectionManager;
@@ -52,33 +252,132 @@ protected:
     uint32_t num_rdma_writes = 0;
 
 public:
-    P2PConnection(uint32_t my_node_id, uint32_t remote_id, uint64_t p2p_buf_size, const RequestParams& request_params);
+    /** The number of 64-bit control words that follow the acknowledgment words in a P2P buffer */
+    static constexpr uint32_t num_control_words = 14;
+
+    P2PConnection(uint32_t my_node_id, uint32_t remote_id, const std::vector<RequestParams>& buffer_layouts,
+                  uint32_t size_class);
     ~P2PConnection();
 
     /**
-     * Returns a pointer into an incoming message buffer if there is a new
-     * incoming message from the remote node, or a null pointer if there are
-     * no new messages.
+     * Creates the two sides of a connection between two nodes in the same
+     * process, which copy their remote writes to each other's buffers instead
+     * of using RDMA. They can switch size classes like RDMA connections.
+     */
+    static std::pair<std::unique_ptr<P2PConnection>, std::unique_ptr<P2PConnection>> make_loopback_pair(
+            uint32_t first_node_id, uint32_t second_node_id, const std::vector<RequestParams>& buffer_layouts,
+            uint32_t size_class);
+
+    /** @return The size class of the buffers currently in use */
+    uint32_t get_size_class() const;
+    /**
+     * @return The total size of the buffers this connection has allocated,
+     * including those of a pending resize and retired ones
+     */
+    uint64_t get_buffer_memory() const;
+    /** @return The offset of the byte written by the failure detector */
+    uint64_t get_heartbeat_offset() const;
+    /**
+     * Returns the number of times since the last call that a sender found no
+     * free slot, a message had to be sent in chunks, or a whole window of
+     * messages arrived at once, and resets it.
+     */
+    uint32_t take_pressure_events();
+    /** @return True if this side has proposed a resize that has not been answered */
+    bool is_resize_pending() const;
+    /**
+     * Proposes to the remote node to switch to buffers of a larger size
+     * class. Until the remote node answers, no new messages can be sent,
+     * except RPC replies, whose number is sent with the switch confirmation.
+     * @return False if no proposal was made, because a message is being sent
+     * or the last switch is not finished
+     */
+    bool propose_resize(uint32_t new_size_class);
+    /** @return True if the remote node has sent a resize message that has not been received */
+    bool has_resize_message();
+    /**
+     * Receives the resize message that has_resize_message() found. A
+     * proposal must be answered with accept_resize() or reject_resize(); an
+     * answer to this side's proposal must be handled with complete_resize()
+     * or abandon_resize().
      */
-    char* probe();
+    ResizeMessage receive_resize_message();
     /**
-     * Increments the sequence number of the incoming message type last
-     * retrieved by probe(). This assumes that it is called immediately
-     * after a successful call to probe().
+     * @return True if the last proposal received can be accepted, i.e. it is
+     * for a larger size class, no message is being sent from this side, and
+     * the last switch is finished
      */
-    void update_incoming_seq_num();
+    bool can_accept_resize(uint32_t new_size_class) const;
+    /** Accepts the last proposal received and switches to the new buffers. */
+    void accept_resize(uint32_t new_size_class);
+    /** Rejects the last proposal received. */
+    void reject_resize();
+    /** Switches to the new buffers after the remote node accepted this side's proposal. */
+    void complete_resize();
+    /** Gives up this side's proposal, and frees the buffers allocated for it. */
+    void abandon_resize();
+    /**
+     * Frees the buffers replaced by the last resize, if they have been
+     * drained, the remote node no longer writes to them, it happened at least
+     * grace_period ago, and all the requests received in them have been
+     * replied to.
+     * @return The number of bytes freed
+     */
+    uint64_t release_retired_buffers(std::chrono::steady_clock::duration grace_period);
+
+    /**
+     * @return The largest message of the given type that fits in one slot
+     */
+    std::size_t get_max_slot_payload_size(REQUEST_TYPE type) const;
+    /**
+     * Finds every new incoming message from the remote node, i.e. all the
+     * consecutive ready slots of each request type starting at its incoming
+     * sequence number, without consuming them. Chunks of large messages are
+     * copied out of their slots; a large message is only returned once its
+     * last chunk has arrived.
+     * @param messages A vector to which the new complete messages are
+     * appended, grouped by request type and in sequence-number order within
+     * each type
+     * @param slot_counts Set to the number of new slots of each type
+     * @return The total number of new slots
+     */
+    uint32_t probe(std::vector<IncomingMessage>& messages, uint32_t (&slot_counts)[num_request_types]);
+    /**
+     * Consumes slots found by probe() by advancing the incoming sequence
+     * number of each request type by the corresponding count, and
+     * acknowledges them to the remote node if it may be waiting for them.
+     */
+    void update_incoming_seq_nums(const uint32_t (&slot_counts)[num_request_types]);
     /**
      * Returns a pointer to the beginning of the next available message buffer
      * for the specified request type, or a null pointer if no message buffer
-     * is available.
+     * is available. Only RPC replies can be sent while a resize proposal is
+     * pending.
      */
     char* get_sendbuffer_ptr(REQUEST_TYPE type);
     /**
-     * Sends the next outgoing message, i.e. the one populated by the most
-     * recent call to get_sendbuffer_ptr. This assumes the message's
-     * REQUEST_TYPE is the same as the one supplied to the most recent call
-     * to get_sendbuffer_ptr.
+     * Returns a pointer to a buffer for a message of the specified type that
+     * is too large for one slot. The message will be sent in chunks by
+     * send_next_chunk().
+     * @param type The type of the message
+     * @param size The size of the message in bytes
+     */
+    char* get_large_sendbuffer_ptr(REQUEST_TYPE type, std::size_t size);
+    /**
+     * Sends the next outgoing message of the specified type, i.e. the one
+     * populated by the most recent call to get_sendbuffer_ptr for that type.
+     */
+    void send(REQUEST_TYPE type);
+    /**
+     * @return True if a message of the specified type from
+     * get_large_sendbuffer_ptr has not been completely sent
+     */
+    bool has_large_send_pending(REQUEST_TYPE type) const;
+    /**
+     * Sends the next chunk of the message of the specified type from
+     * get_large_sendbuffer_ptr, if there is a free slot for it.
+     * @return False if all the slots of the type are still in use
      */
-    void send();
+    bool send_next_chunk(REQUEST_TYPE type);
 };
 }  // namespace sst
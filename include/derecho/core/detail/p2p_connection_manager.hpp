@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -32,10 +33,60 @@ struct P2PParams {
     failure_upcall_t failure_upcall;
 };
 
+/**
+ * The new messages that one call to P2PConnectionManager::probe_all found on
+ * one connection. The messages are read in place from the connection's
+ * incoming buffer; the connection's incoming sequence numbers only move past
+ * them when the batch is passed to update_incoming_seq_nums.
+ */
+struct P2PMessageBatch {
+    /** The ID of the node the messages came from */
+    node_id_t sender_id;
+    /** The messages to deliver, in order. Null replies are left out. */
+    std::vector<IncomingMessage> messages;
+    /** The number of message slots of each request type the batch consumes */
+    uint32_t slot_counts[num_request_types];
+};
+
+/**
+ * Counters describing the batches returned by P2PConnectionManager::probe_all.
+ */
+struct P2PBatchStats {
+    static constexpr std::size_t NUM_HISTOGRAM_BUCKETS = 8;
+    uint64_t num_batches;
+    uint64_t num_messages;
+    uint64_t max_batch_size;
+    /**
+     * Entry i counts the batches of between 2^i and 2^(i+1) - 1 messages;
+     * the last entry also counts all larger batches.
+     */
+    uint64_t batch_size_histogram[NUM_HISTOGRAM_BUCKETS];
+};
+
 class P2PConnectionManager {
     const node_id_t my_node_id;
 
-    RequestParams request_params;
+    /**
+     * The buffer layout of each size class of P2P connections. Connections
+     * start in size class 0, and each class doubles the windows and slots of
+     * the one before it, up to the configured window and message sizes,
+     * which make up the last class.
+     */
+    std::vector<RequestParams> buffer_layouts;
+    /** The most memory all P2P connection buffers may take before connections stop growing; 0 for no limit */
+    uint64_t buffer_memory_budget;
+    /** The memory currently allocated for P2P connection buffers, or reserved for a resize */
+    std::atomic<uint64_t> buffer_memory_used{0};
+    /** How often probe_all checks whether connections should grow */
+    static constexpr std::chrono::milliseconds resize_check_interval{100};
+    /** The number of pressure events in one interval that make a connection grow */
+    static constexpr uint32_t resize_pressure_threshold = 8;
+    /** How long the buffers replaced by a resize stay registered, so that RDMA operations on them can finish */
+    static constexpr std::chrono::seconds retired_buffer_grace_period{1};
+    /** probe_all only reads the clock once in this many calls */
+    static constexpr uint32_t probes_per_resize_clock_check = 1024;
+    uint32_t probes_since_resize_clock_check = 0;
+    std::chrono::steady_clock::time_point next_resize_check_time;
     /**
      * Contains one entry per possible Node ID; the vector index is the node ID.
      * Each entry is a pair consisting of a mutex protecting that entry and a
@@ -54,14 +105,65 @@ class P2PConnectionManager {
      * updates from write conflicts.
      */
     char* active_p2p_connections;
+    /**
+     * The IDs of the nodes that currently have a connection, in increasing
+     * order, so that loops over the connections cost time proportional to the
+     * number of peers rather than to the maximum node ID. Guarded by
+     * connections_mutex, which add_connections and remove_connections hold
+     * for their whole update; when both are needed, connections_mutex must be
+     * locked before any of the mutexes in p2p_connections.
+     */
+    std::vector<node_id_t> active_node_ids;
+    /** Incremented (under connections_mutex) every time active_node_ids changes */
+    std::atomic<uint64_t> active_node_ids_version{0};
+    std::mutex connections_mutex;
+
+    /**
+     * The polling thread's own copy of active_node_ids, refreshed from it when
+     * active_node_ids_version changes, so probe_all does not need to lock
+     * connections_mutex on every call.
+     */
+    std::vector<node_id_t> probe_order;
+    uint64_t probe_order_version = 0;
+    /** The position in probe_order at which the next call to probe_all starts */
+    std::size_t next_probe_position = 0;
+
+    /**
+     * The counters behind get_batch_stats(). They are only written by the
+     * thread that calls probe_all, but can be read from any thread.
+     */
+    std::atomic<uint64_t> num_batches{0};
+    std::atomic<uint64_t> num_batched_messages{0};
+    std::atomic<uint64_t> max_batch_size{0};
+    std::atomic<uint64_t> batch_size_histogram[P2PBatchStats::NUM_HISTOGRAM_BUCKETS] = {};
+    void record_batch(uint32_t batch_size);
 
-    uint64_t p2p_buf_size;
     std::atomic<bool> thread_shutdown{false};
     std::thread timeout_thread;
 
     void check_failures_loop();
     failure_upcall_t failure_upcall;
-    std::mutex connections_mutex;
+    /** @return A copy of active_node_ids, taken under connections_mutex */
+    std::vector<node_id_t> get_active_node_ids();
+    /**
+     * Takes the given number of bytes from the buffer memory budget.
+     * @return False if that would exceed the budget, in which case nothing is taken
+     */
+    bool reserve_buffer_memory(uint64_t bytes);
+    void release_buffer_memory(uint64_t bytes);
+    /**
+     * Called by probe_all with the lock on a connection held, when the remote
+     * node has sent a resize message on it.
+     */
+    void handle_resize_message(node_id_t node_id, P2PConnection& connection);
+    /**
+     * Called by probe_all every resize_check_interval: frees the buffers
+     * retired by finished resizes, and proposes to grow each connection on
+     * which senders ran out of slots, messages had to be sent in chunks, or
+     * windows filled up often enough in the last interval, if the budget
+     * allows it.
+     */
+    void check_buffer_sizes();
 
 public:
     P2PConnectionManager(const P2PParams params);
@@ -73,41 +175,74 @@ public:
     bool contains_node(const node_id_t node_id);
     /**
      * @return the size of the byte array used for sending a single P2P reply
-     * in any of the P2P connections. No messages larger than this can be sent.
+     * in a P2P connection of the largest size class. Larger messages, or
+     * messages on smaller connections, are sent in chunks.
      */
     std::size_t get_max_p2p_reply_size();
     /**
      * @return the size of the byte array used for sending a single RPC reply
-     * in any of the P2P connections. No messages larger than this can be sent.
+     * in a P2P connection of the largest size class. Larger messages, or
+     * messages on smaller connections, are sent in chunks.
      */
     std::size_t get_max_rpc_reply_size();
     /**
-     * Increments the sequence number of the last-received message type for
-     * the specified node's connection.
+     * Checks the P2P connection buffers for new messages. Connections are
+     * served round-robin: each call resumes the scan where the previous one
+     * stopped, and stops at the first connection that has new messages,
+     * collecting all of that connection's ready messages into one batch, so
+     * that a busy low-numbered peer cannot starve the others. Only checks the
+     * connections that currently exist. This is also where connections agree
+     * to grow to a larger size class. Must only be called from one thread at
+     * a time.
+     * @param batch Filled in with the new messages, if any were found; its
+     * messages vector is cleared first, so one batch object can be reused
+     * for every call
+     * @return True if a connection had new messages. The batch can then still
+     * contain no messages to deliver, if they were all null replies, but it
+     * must be passed to update_incoming_seq_nums either way.
+     */
+    bool probe_all(P2PMessageBatch& batch);
+    /**
+     * Consumes the messages in a batch returned by probe_all, advancing the
+     * incoming sequence numbers of the sender's connection once for the
+     * whole batch. Call it after all the batch's messages have been handled.
+     */
+    void update_incoming_seq_nums(const P2PMessageBatch& batch);
+    /**
+     * @return A snapshot of the counters describing the batches returned by
+     * probe_all so far
      */
-    void update_incoming_seq_num(node_id_t node_id);
+    P2PBatchStats get_batch_stats() const;
     /**
-     * Checks all the P2P connection buffers for new messages. If any
-     * connection has a new message, this returns a pair containing the
-     * sender's ID and a pointer into the message buffer.
-     * @return (remote node ID, message byte buffer)
+     * @return The memory currently allocated for the buffers of all P2P
+     * connections, in bytes
      */
-    std::optional<std::pair<node_id_t, char*>> probe_all();
+    uint64_t get_buffer_memory_used() const;
     /**
-     * Returns a pointer to the beginning of the next available message buffer
-     * for the specified request type in the specified node's P2P connection
-     * channel, or a null pointer if no such message buffer is available.
+     * Returns a pointer to the beginning of a buffer for the next outgoing
+     * message of the specified request type in the specified node's P2P
+     * connection channel. A message that fits in one slot is written directly
+     * in the next slot; a larger one is written in a separate buffer and
+     * streamed through the slots by send(). If there is no free slot, this
+     * returns a null pointer for a P2P request, and waits for one to be freed
+     * for the other request types, since replies cannot be postponed.
      * @param node_id The ID of the remote node that will be sent to
      * @param type The type of P2P message to send
-     * @return A pointer to the beginning of a message buffer, or null
+     * @param size The size of the message in bytes, if it is known
+     * @return A pointer to the beginning of a message buffer, or null if
+     * there is no free slot or no connection to the node
      */
-    char* get_sendbuffer_ptr(node_id_t node_id, REQUEST_TYPE type);
+    char* get_sendbuffer_ptr(node_id_t node_id, REQUEST_TYPE type, std::size_t size = 0);
     /**
-     * Sends the next outgoing message to the specified node, i.e. the one
-     * populated by the most recent call to get_sendbuffer_ptr.
+     * Sends the next outgoing message of the specified type to the specified
+     * node, i.e. the one populated by the most recent call to
+     * get_sendbuffer_ptr for that type. A message that did not fit in one
+     * slot is sent one chunk at a time, waiting for the remote node to free
+     * each slot, so this can block.
      * @param node_id The ID of the remote node to send to.
+     * @param type The type of the message
      */
-    void send(node_id_t node_id);
+    void send(node_id_t node_id, REQUEST_TYPE type);
     /**
      * Compares the set of P2P connections to a list of known live nodes and
      * removes any connections to nodes not in that list. This is used to
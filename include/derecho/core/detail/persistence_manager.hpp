@@ -9,15 +9,17 @@
 #include <chrono>
 #include <errno.h>
 #include <list>
-#include <queue>
+#include <memory>
 #include <semaphore.h>
 #include <thread>
+#include <vector>
 
 #include "derecho_internal.hpp"
 #include "replicated_interface.hpp"
 #include <derecho/openssl/signature.hpp>
 #include <derecho/persistent/PersistentInterface.hpp>
 #include <derecho/utils/logger.hpp>
+#include <derecho/utils/mpsc_queue.hpp>
 
 namespace derecho {
 
@@ -40,41 +42,54 @@ public:
         persistent::version_t version;
     };
 private:
-    /** Thread handle */
-    std::thread persist_thread;
     /**
-     * A flag to signal the persistent thread to shutdown; set to true when the
+     * The requests of one subgroup. A lane is handled by at most one
+     * persistence thread at a time, so the requests of a subgroup are handled
+     * in order, while different subgroups can be handled in parallel.
+     */
+    struct PersistLane {
+        /** Requests for this subgroup, shared with the threads that post them */
+        MPSCQueue<ThreadRequest> requests;
+        /** The number of requests pushed to the queue and not yet popped */
+        std::atomic<uint32_t> pending{0};
+        /** Set while a persistence thread owns this lane */
+        std::atomic_flag busy = ATOMIC_FLAG_INIT;
+        /**
+         * The latest version that has been persisted successfully in this
+         * subgroup. Updated each time a persistence request completes.
+         */
+        persistent::version_t last_persisted_version = -1;
+    };
+    /** The number of persistence threads */
+    const uint32_t num_persist_threads;
+    /** Thread handles */
+    std::vector<std::thread> persist_threads;
+    /**
+     * A flag to signal the persistent threads to shutdown; set to true when the
      * group is destroyed.
      */
     std::atomic<bool> thread_shutdown;
     /**
      * A semaphore that counts the number of persistence requests available for
-     * the persistence thread to handle
+     * the persistence threads to handle
      */
     sem_t persistence_request_sem;
+    /** One request lane per subgroup, indexed by subgroup ID */
+    std::vector<std::unique_ptr<PersistLane>> persist_lanes;
     /**
-     * Queue of requests for the persistence thread, which is shared with other
-     * threads (e.g. the predicates thread) so they can make requests
+     * The Verifiers to use for verifying other replicas' signatures over
+     * persistent log entries, one for each persistence thread, if signatures
+     * are enabled. This will be empty if signatures are disabled.
      */
-    std::queue<ThreadRequest> persistence_request_queue;
-    /** A test-and-set lock guarding the persistence request queue */
-    std::atomic_flag prq_lock = ATOMIC_FLAG_INIT;
-    /**
-     * The latest version that has been persisted successfully in each subgroup
-     * (indexed by subgroup number). Updated each time a persistence request completes.
-     */
-    std::vector<persistent::version_t> last_persisted_version;
-    /**
-     * The Verifier to use for verifying other replicas' signatures over
-     * persistent log entries, if signatures are enabled. This will be null if
-     * signatures are disabled.
-     */
-    std::unique_ptr<openssl::Verifier> signature_verifier;
+    std::vector<std::unique_ptr<openssl::Verifier>> signature_verifiers;
     /** The size of a signature (which is a constant), or 0 if signatures are disabled. */
     std::size_t signature_size;
     /**
      * The persistence callback(s), which will be called to notify clients that
      * a particular version has finished persisting locally (on this node).
+     * They are called by the thread that owns the subgroup's lane, so the calls
+     * for one subgroup are serialized and in version order, while the calls for
+     * different subgroups may run concurrently on different threads.
      */
     std::list<persistence_callback_t> persistence_callbacks;
     /** Reference to the ReplicatedObjects map in the Group that owns this PersistenceManager. */
@@ -86,10 +101,20 @@ private:
      * also needs a reference to PersistenceManager.
      */
     ViewManager* view_manager;
+    /** The main loop of a persistence thread */
+    void persist_loop(uint32_t thread_index);
+    /**
+     * Handles the requests in a lane, unless another thread is handling them.
+     * @return true if any request was handled
+     */
+    bool drain_lane(PersistLane& lane, uint32_t thread_index);
+    /** Enqueues a request to the lane of its subgroup and wakes up a persistence thread */
+    void post_request(const ThreadRequest& request);
     /** Helper function that handles a single persistence request */
-    void handle_persist_request(subgroup_id_t subgroup_id, persistent::version_t version);
+    void handle_persist_request(PersistLane& lane, subgroup_id_t subgroup_id, persistent::version_t version);
     /** Helper function that handles a single verification request */
-    void handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version);
+    void handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version,
+                               openssl::Verifier& signature_verifier);
 public:
     /**
      * Constructor.
@@ -109,18 +134,23 @@ public:
      */
     virtual ~PersistenceManager();
 
-    /** Initializes the ViewManager pointer. Must be called before start(). */
+    /**
+     * Initializes the ViewManager pointer and the per-subgroup request lanes.
+     * Must be called before start() and before any request is posted.
+     */
     void set_view_manager(ViewManager& view_manager);
 
     /** Adds another function to the list of persistence callbacks, which are
-     * called when a version finishes persisting locally. */
+     * called when a version finishes persisting locally. The function must be
+     * safe to call concurrently for different subgroups; calls for the same
+     * subgroup are serialized and in version order. */
     void add_persistence_callback(const persistence_callback_t& callback);
 
     //This method is probably unnecessary since ViewManager should have other ways of determining the signature size.
     /** @return the size of a signature on an update in this group. */
     std::size_t get_signature_size() const;
 
-    /** Start the persistent thread. */
+    /** Start the persistent threads. */
     void start();
 
     /** post a persistence request */
@@ -141,7 +171,7 @@ public:
     void make_version(const subgroup_id_t& subgroup_id,
                       const persistent::version_t& version, const HLC& mhlc);
 
-    /** shutdown the thread
+    /** shutdown the threads
      * @wait - wait till the thread finished or not.
      */
     void shutdown(bool wait);
@@ -0,0 +1,174 @@
+/**
+ * @file rdmc_buffer_pool.hpp
+ *
+ * A pool of registered memory from which the message buffers of RDMC sends
+ * and receives are allocated.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <derecho/rdmc/rdmc.hpp>
+
+namespace derecho {
+
+class RDMCBufferPool;
+
+/**
+ * Returns a block of memory to the RDMCBufferPool it was allocated from.
+ */
+struct PooledBufferDeleter {
+    RDMCBufferPool* pool = nullptr;
+    uint32_t size_class = 0;
+    uint32_t region_index = 0;
+    void operator()(char* block) const;
+};
+
+/**
+ * Represents a block of memory used to store a message. This object contains
+ * both a pointer to the bytes in which the message is stored and the RDMA
+ * memory region that contains them, along with their offset in that region.
+ * The block is returned to the RDMCBufferPool it came from when the
+ * MessageBuffer is destroyed. This is a move-only type.
+ */
+struct MessageBuffer {
+    std::unique_ptr<char[], PooledBufferDeleter> buffer;
+    std::shared_ptr<rdma::memory_region> mr;
+    /** The offset of buffer within mr */
+    std::size_t offset = 0;
+
+    MessageBuffer() {}
+    MessageBuffer(const MessageBuffer&) = delete;
+    MessageBuffer(MessageBuffer&&) = default;
+    MessageBuffer& operator=(const MessageBuffer&) = delete;
+    MessageBuffer& operator=(MessageBuffer&&) = default;
+};
+
+/**
+ * A slab allocator for RDMC message buffers. Memory is obtained in a few
+ * large regions, backed by huge pages if possible, each of which is
+ * registered with the RDMA provider only once. Regions are carved into
+ * blocks whose sizes are powers of two, starting at MIN_BLOCK_SIZE, and each
+ * message gets the smallest block that fits it, so a small message in a
+ * subgroup with a large max_msg_size does not pin a max_msg_size buffer.
+ * Freed blocks are kept on a free list for their size class and are never
+ * returned to the system. Blocks larger than a region get a region of their
+ * own. One pool is shared by all the subgroups of a group, and is passed
+ * from each MulticastGroup to its successor across view changes; it must
+ * outlive every MessageBuffer allocated from it.
+ */
+class RDMCBufferPool {
+public:
+    /** A snapshot of how much memory the pool uses. */
+    struct Usage {
+        /** The number of registered regions */
+        std::size_t num_regions;
+        /** The total size of the registered regions, in bytes */
+        std::size_t registered_bytes;
+        /** The part of registered_bytes that is backed by huge pages */
+        std::size_t hugepage_bytes;
+        /** The total size of the blocks currently allocated to messages, in bytes */
+        std::size_t allocated_bytes;
+        /** The number of allocated blocks, by size class */
+        std::vector<std::size_t> allocated_blocks;
+        /** The number of free blocks, by size class */
+        std::vector<std::size_t> free_blocks;
+    };
+
+    /** The size of the smallest size class; larger classes double in size */
+    static constexpr std::size_t MIN_BLOCK_SIZE = 4096;
+
+    /** A function that registers a region of memory with the RDMA provider */
+    using RegisterFunction = std::function<std::shared_ptr<rdma::memory_region>(char*, std::size_t)>;
+
+private:
+    struct Region {
+        char* memory;
+        /** The usable (and registered) size of the region */
+        std::size_t size;
+        /** The size of the mapping, which is rounded up to whole huge pages */
+        std::size_t mapped_size;
+        bool hugepages;
+        std::shared_ptr<rdma::memory_region> mr;
+    };
+    struct FreeBlock {
+        char* block;
+        uint32_t region_index;
+    };
+
+    /** The size of the regions that blocks are carved from */
+    const std::size_t region_size;
+    const RegisterFunction register_region;
+
+    /** Protects all of the members below */
+    std::mutex pool_mutex;
+    /** True if regions should be backed by huge pages; cleared once mapping them fails */
+    bool use_hugepages;
+    /** Free blocks, indexed by size class */
+    std::vector<std::vector<FreeBlock>> free_lists;
+    std::vector<Region> regions;
+    static constexpr uint32_t NO_REGION = UINT32_MAX;
+    /** The index of the region that new blocks are currently carved from, if any */
+    uint32_t carving_region = NO_REGION;
+    /** The offset of the first uncarved byte in the carving region */
+    std::size_t carving_offset = 0;
+    std::size_t registered_bytes = 0;
+    /** The number of allocated blocks, indexed by size class */
+    std::vector<std::size_t> allocated_blocks;
+
+    static uint32_t size_class_of(std::size_t size);
+    static std::size_t block_size_of(uint32_t size_class) {
+        return MIN_BLOCK_SIZE << size_class;
+    }
+
+    /**
+     * Maps and registers a new region of the given size, preferably backed
+     * by huge pages.
+     * @return The index of the new region
+     */
+    uint32_t add_region(std::size_t size);
+    /**
+     * Puts the uncarved rest of the carving region on the free lists, in the
+     * largest blocks that fit.
+     */
+    void retire_carving_region();
+
+    friend struct PooledBufferDeleter;
+    void release(char* block, uint32_t size_class, uint32_t region_index);
+
+public:
+    /**
+     * Creates an empty pool; its first region is mapped by the first allocation.
+     * @param region_size The size of each region, in bytes; rounded up to a
+     * power of two
+     * @param use_hugepages Whether to back regions with huge pages, if the
+     * system has enough of them
+     * @param register_region The function that registers each new region;
+     * by default, it is registered as an rdma::memory_region. Tests can
+     * replace it to use the pool without RDMA.
+     */
+    RDMCBufferPool(std::size_t region_size, bool use_hugepages, RegisterFunction register_region = nullptr);
+    /** Unmaps all the regions; every block must have been released. */
+    ~RDMCBufferPool();
+    RDMCBufferPool(const RDMCBufferPool&) = delete;
+    RDMCBufferPool& operator=(const RDMCBufferPool&) = delete;
+
+    /**
+     * Allocates a registered block of at least the given size, mapping a new
+     * region if no free block of its size class is left.
+     * @param size The number of bytes needed
+     * @return A MessageBuffer holding the block
+     */
+    MessageBuffer allocate(std::size_t size);
+
+    /** @return The current memory usage of the pool */
+    Usage get_usage();
+};
+
+}  // namespace derecho
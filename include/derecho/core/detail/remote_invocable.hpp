@@ -54,20 +54,12 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
         return nullptr;
     }
 
-    /* Maps invocation-instance IDs to results sets
-       Weijia: Although the maximum pending RPC is controlled by the window
-       size option in the configuration, the user application may not retrieve
-       the results on time. Therefore, the results may piled up and we need more
-       slots for the results than window size. We hardwired this to 4K here.
-       TODO: Obviously, this is not space efficient. Let's find a better RPC
-       return value mechanism.
+    /**
+     * The PendingResults of this function's outstanding RPC calls, indexed by
+     * invocation ID. Owned by this RemoteInvoker, but disposed of with close()
+     * since it may have to outlive it (see ReplySlotPool).
      */
-
-#define MAX_CONCURRENT_RPCS_PER_INVOKER (4096)
-    PendingResults<Ret> results_vector[MAX_CONCURRENT_RPCS_PER_INVOKER];
-    std::atomic<unsigned short> invocation_id_sequencer;
-    // std::mutex map_lock; - we don't need a lock on the result map anymore.
-    using lock_t = std::unique_lock<std::mutex>;
+    ReplySlotPool<Ret>* const reply_slots;
 
     /* use this from within a derived class to retrieve precisely this RemoteInvoker
      * (this way, all the inherited RemoteInvoker methods in the subclass do not need
@@ -114,23 +106,20 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
      */
     send_return send(const std::function<char*(int)>& out_alloc,
                      const std::decay_t<Args>&... remote_args) {
-        // auto invocation_id = mutils::long_rand();
-        std::size_t invocation_id = invocation_id_sequencer++;
-        invocation_id %= MAX_CONCURRENT_RPCS_PER_INVOKER;
-        std::size_t size = mutils::bytes_size(invocation_id);
+        std::size_t size = sizeof(std::size_t);
         size += (mutils::bytes_size(remote_args) + ... + 0);
 
+        //Only take a slot once the buffer has been allocated, since out_alloc may throw
         char* serialized_args = out_alloc(size);
+        auto slot = reply_slots->allocate();
+        const std::size_t invocation_id = slot.first;
+        PendingResults<Ret>& pending_results = slot.second;
         {
             auto v = serialized_args + mutils::to_bytes(invocation_id, serialized_args);
             auto check_size = mutils::bytes_size(invocation_id) + serialize_all(v, remote_args...);
             assert_always(check_size == size);
         }
 
-        // lock_t l{map_lock};
-        results_vector[invocation_id].reset();
-        PendingResults<Ret>& pending_results = results_vector[invocation_id];
-
         dbg_default_trace("Ready to send an RPC call message with invocation ID {}", invocation_id);
         return send_return{size, serialized_args, pending_results.get_future(),
                            pending_results};
@@ -149,45 +138,28 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
             const node_id_t& nid, const char* response,
             const std::function<definitely_char*(int)>&) {
         bool is_exception = response[0];
-        long int invocation_id = ((long int*)(response + 1))[0];
-        // lock_t l{map_lock};
-        // we unlock the map here to avoid the deadlock:
-        // The p2p handler thread, on receiving an RPC REPLY may get this lock
-        // before sst_detect thread finish handling the corresponding ordered
-        // send locally. However, sst_detect thread may be so slow that it
-        // hasn't finish deliverying of a previous ordered send, therefore waits
-        // for the map_lock in the following call stack:
-        // - RPCManager::rpc_message_handler() ->
-        // - RPCManager::parse_and_receive() ->
-        // - RPCManager::receive_message()->
-        // - receivers->at(indx)->
-        // - RemoteInvoker::receive_response().
-        // therefore, the promise for the next ordered_send, on which the
-        // p2p handler thread is waiting for, cannot be fulfilled.
-        // dead lock!!!
-        // We use this workaround by just release the results_map lock as early
-        // because we have 64K slots and we assume after 64K messages, this
-        // corresponding ordered_send has been finished already.
-        // TODO: make a better plan along with garbage collection.
-        // l.unlock();
-        // TODO: garbage collection for the responses.
-        // More on May-7th (Weijia):
-        // We don't need to lock the results container (now results_vector)
-        // anymore. The vector is initialized at the beginning. The p2p rpc
-        // reuse the slot by reseting it. No deleting, insertion, or
-        // replacement operations at all. But we still need a better garbage
-        // collection mechanism.
+        const uint64_t invocation_id = ((const uint64_t*)(response + 1))[0];
+        // The pool is only locked while looking up the slot, not while setting
+        // the reply: set_value() blocks until the reply map is fulfilled, which
+        // the thread delivering the corresponding ordered_send may only do after
+        // taking locks held by the thread that calls this function.
+        PendingResults<Ret>* pending_results = reply_slots->hold(invocation_id);
+        if(pending_results == nullptr) {
+            dbg_default_warn("Dropping a stale RPC reply from node {} for invocation ID {}", nid, invocation_id);
+            return recv_ret{Opcode(), 0, nullptr, nullptr};
+        }
         if(is_exception) {
             //If the exception bit is set, the response contains a serialized remote_exception_info
             auto exception_info = mutils::from_bytes_noalloc<remote_exception_info>(nullptr, response + 1 + sizeof(invocation_id));
             dbg_default_trace("Received an exception from node {} in response to invocation ID {}", nid, invocation_id);
             rls_default_error("Received an exception from node {}. Exception message: {}", nid, exception_info->exception_what);
-            results_vector[invocation_id].set_exception(nid, std::make_exception_ptr(
-                                                                     remote_exception_occurred{nid, exception_info->exception_name, exception_info->exception_what}));
+            pending_results->set_exception(nid, std::make_exception_ptr(
+                                                        remote_exception_occurred{nid, exception_info->exception_name, exception_info->exception_what}));
         } else {
             dbg_default_trace("Received an RPC response for invocation ID {} from node {}", invocation_id, nid);
-            results_vector[invocation_id].set_value(nid, *mutils::from_bytes<Ret>(dsm, response + 1 + sizeof(invocation_id)));
+            pending_results->set_value(nid, std::move(*mutils::from_bytes<Ret>(dsm, response + 1 + sizeof(invocation_id))));
         }
+        pending_results->release();
         return recv_ret{Opcode(), 0, nullptr, nullptr};
     }
 
@@ -222,18 +194,6 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
         return receive_response(choice, &dsm, nid, response, f);
     }
 
-    /**
-     * Populates the pending-results map of a particular invocation of the remote-invocable
-     * function, given the list of nodes that will be contacted to call the function.
-     * @param invocation_id The ID referring to a particular invocation of the function
-     * @param who The list of nodes that will service this RPC call
-     */
-    inline void fulfill_pending_results_vector(long int invocation_id, const node_list_t& who) {
-        // I think this function is never called
-        assert_always(false);
-        results_vector[invocation_id].fulfill_map(who);
-    }
-
     /**
      * Constructs a RemoteInvoker that provides RPC call marshalling and
      * response-handling for a specific function tag and function type (the one
@@ -249,11 +209,17 @@ struct RemoteInvoker<Tag, std::function<Ret(Args...)>> {
                   std::map<Opcode, receive_fun_t>& receivers)
             : invoke_opcode{class_id, instance_id, Tag, false},
               reply_opcode{class_id, instance_id, Tag, true},
-              invocation_id_sequencer(0) {
+              reply_slots(new ReplySlotPool<Ret>()) {
         receivers.emplace(reply_opcode, [this](auto... a) {
             return this->receive_response(a...);
         });
     }
+
+    RemoteInvoker(const RemoteInvoker&) = delete;
+
+    ~RemoteInvoker() {
+        reply_slots->close();
+    }
 };
 
 /**
@@ -431,6 +397,16 @@ struct const_partial_wrapped {
     fun_t fun;
 };
 
+/**
+ * A const_partial_wrapped for a P2P-callable function that is safe to run
+ * concurrently with other P2P requests to the same object, even ones from the
+ * same node (see tag_p2p_concurrent()). It is bound to an instance exactly like
+ * a const_partial_wrapped; RPCManager only uses the type to learn which
+ * functions it may dispatch concurrently.
+ */
+template <FunctionTag Tag, typename Ret, typename Class, typename... Arguments>
+struct concurrent_partial_wrapped : public const_partial_wrapped<Tag, Ret, Class, Arguments...> {};
+
 /**
  * Converts a partial_wrapped<> containing a pointer-to-member-function to a
  * wrapped<> containing the same function as a std::function. It does this by
@@ -555,6 +531,33 @@ partial_wrapped<to_internal_tag<true>(Tag), Ret, NewClass, Args...> tag_p2p(Ret
     return tag<to_internal_tag<true>(Tag), NewClass, Ret, Args...>(fun);
 }
 
+/**
+ * User-facing function that registers a const member function as a
+ * "P2P-callable" RPC function, exactly like tag_p2p(), and also declares that
+ * it is safe to run concurrently with other P2P requests. Normally, the P2P
+ * requests that one node sends to one subgroup are handled one at a time, in
+ * the order they were sent; when there is more than one P2P request thread
+ * (see DERECHO/p2p_request_threads), calls to this function can be spread
+ * across all of them instead.
+ * @param fun A pointer-to-member-function from the class in the template parameters
+ * @return A concurrent_partial_wrapped struct, which is bound to an instance
+ * like the const_partial_wrapped returned by tag_p2p()
+ */
+template <FunctionTag Tag, typename NewClass, typename Ret, typename... Args>
+concurrent_partial_wrapped<to_internal_tag<true>(Tag), Ret, NewClass, Args...> tag_p2p_concurrent(Ret (NewClass::*fun)(Args...) const) {
+    return {tag<to_internal_tag<true>(Tag), NewClass, Ret, Args...>(fun)};
+}
+
+/**
+ * Generates a nice error message when a user attempts to tag a non-const
+ * method as a concurrent P2P target, just like the non-const tag_p2p().
+ */
+template <FunctionTag Tag, typename NewClass, typename Ret, typename... Args>
+partial_wrapped<to_internal_tag<true>(Tag), Ret, NewClass, Args...> tag_p2p_concurrent(Ret (NewClass::*fun)(Args...)) {
+    static_assert(std::is_const<decltype(fun)>::value, "Non-const methods cannot be tagged as P2P-callable!");
+    return tag<to_internal_tag<true>(Tag), NewClass, Ret, Args...>(fun);
+}
+
 /* Technically, RemoteInvocablePairs specializes this template for the cases
  * where the parameter pack is a list of types of the form wrapped<id, FunType>
  * However, there is only one specialization, so using RemoteInvocablePairs for
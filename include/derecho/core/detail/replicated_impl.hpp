@@ -87,12 +87,20 @@ Replicated<T>::Replicated(Replicated&& rhs) : persistent_registry(std::move(rhs.
 
 template <typename T>
 Replicated<T>::~Replicated() {
-    // hack to check if the object was merely moved
+    // hack to check if the object was merely moved (or retired)
     if(wrapped_this) {
         group_rpc_manager.destroy_remote_invocable_class(subgroup_id);
     }
 }
 
+template <typename T>
+void Replicated<T>::retire() {
+    if(wrapped_this) {
+        group_rpc_manager.destroy_remote_invocable_class(subgroup_id);
+        wrapped_this.reset();
+    }
+}
+
 template <typename T>
 template <rpc::FunctionTag tag, typename... Args>
 auto Replicated<T>::p2p_send(node_id_t dest_node, Args&&... args) const {
@@ -105,13 +113,9 @@ auto Replicated<T>::p2p_send(node_id_t dest_node, Args&&... args) const {
         auto return_pair = wrapped_this->template send<rpc::to_internal_tag<true>(tag)>(
                 //Invoke the sending function with a buffer-allocator that uses the P2P request buffers
                 [this, &dest_node](size_t size) -> char* {
-                    const std::size_t max_p2p_request_payload_size = getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE);
-                    if(size <= max_p2p_request_payload_size) {
-                        return (char*)group_rpc_manager.get_sendbuffer_ptr(dest_node,
-                                                                           sst::REQUEST_TYPE::P2P_REQUEST);
-                    } else {
-                        throw buffer_overflow_exception("The size of a P2P message exceeds the maximum P2P message size.");
-                    }
+                    //Requests larger than a P2P request slot are sent in chunks
+                    return (char*)group_rpc_manager.get_sendbuffer_ptr(dest_node,
+                                                                       sst::REQUEST_TYPE::P2P_REQUEST, size);
                 },
                 std::forward<Args>(args)...);
         group_rpc_manager.finish_p2p_send(dest_node, subgroup_id, return_pair.pending);
@@ -123,18 +127,18 @@ auto Replicated<T>::p2p_send(node_id_t dest_node, Args&&... args) const {
 
 template <typename T>
 template <rpc::FunctionTag tag, typename... Args>
-auto Replicated<T>::ordered_send(Args&&... args) {
+auto Replicated<T>::ordered_send_impl(bool blocking, Args&&... args) {
     if(is_valid()) {
         size_t payload_size_for_multicast_send = wrapped_this->template get_size_for_ordered_send<rpc::to_internal_tag<false>(tag)>(std::forward<Args>(args)...);
 
         using Ret = typename std::remove_pointer<decltype(wrapped_this->template getReturnType<rpc::to_internal_tag<false>(tag)>(
                 std::forward<Args>(args)...))>::type;
-        //These pointers help "return" the PendingResults/QueryResults out of the lambda
-        rpc::QueryResults<Ret>* results_ptr;
+        //These help "return" the PendingResults/QueryResults out of the lambda without a heap allocation
+        std::optional<rpc::QueryResults<Ret>> results;
         rpc::PendingResults<Ret>* pending_ptr;
         auto serializer = [&](char* buffer) {
             //By the time this lambda runs, the current thread will be holding a read lock on view_mutex
-            const std::size_t max_payload_size = group_rpc_manager.view_manager.get_max_payload_sizes().at(subgroup_id);
+            const std::size_t max_payload_size = group_rpc_manager.view_manager.max_payload_sizes.at(subgroup_id);
             auto send_return_struct = wrapped_this->template send<rpc::to_internal_tag<false>(tag)>(
                     //Invoke the sending function with a buffer-allocator that uses the buffer supplied as an argument to the serializer
                     [&buffer, &max_payload_size](size_t size) -> char* {
@@ -145,19 +149,51 @@ auto Replicated<T>::ordered_send(Args&&... args) {
                         }
                     },
                     std::forward<Args>(args)...);
-            results_ptr = new rpc::QueryResults<Ret>(std::move(send_return_struct.results));
+            results.emplace(std::move(send_return_struct.results));
             pending_ptr = &send_return_struct.pending;
         };
 
-        std::shared_lock<std::shared_timed_mutex> view_read_lock(group_rpc_manager.view_manager.view_mutex);
-        group_rpc_manager.view_manager.view_change_cv.wait(view_read_lock, [&]() {
-            return group_rpc_manager.view_manager.curr_view
-                    ->multicast_group->send(subgroup_id, payload_size_for_multicast_send, serializer, true);
-        });
+        if(group_rpc_manager.is_ordered_send_batching_enabled()) {
+            group_rpc_manager.add_to_ordered_send_batch(subgroup_id, payload_size_for_multicast_send,
+                                                        [&](char* buffer) -> rpc::PendingBase& {
+                                                            serializer(buffer);
+                                                            return *pending_ptr;
+                                                        },
+                                                        blocking);
+            return results;
+        }
+        if(blocking) {
+            std::shared_lock<std::shared_timed_mutex> view_read_lock(group_rpc_manager.view_manager.view_mutex);
+            group_rpc_manager.view_manager.view_change_cv.wait(view_read_lock, [&]() {
+                return group_rpc_manager.view_manager.curr_view
+                        ->multicast_group->send(subgroup_id, payload_size_for_multicast_send, serializer, true);
+            });
+        } else if(!group_rpc_manager.view_manager.try_send(subgroup_id, payload_size_for_multicast_send, serializer, true)) {
+            return results;
+        }
         group_rpc_manager.finish_rpc_send(subgroup_id, *pending_ptr);
-        //Warning: Even though the move-constructor will clean up all the state in *results_ptr, this
-        //still leaks the memory allocated on the heap by new QueryResults<Ret>() in the serializer lambda
-        return std::move(*results_ptr);
+        return results;
+    } else {
+        throw empty_reference_exception{"Attempted to use an empty Replicated<T>"};
+    }
+}
+
+template <typename T>
+template <rpc::FunctionTag tag, typename... Args>
+auto Replicated<T>::ordered_send(Args&&... args) {
+    return std::move(*ordered_send_impl<tag>(true, std::forward<Args>(args)...));
+}
+
+template <typename T>
+template <rpc::FunctionTag tag, typename... Args>
+auto Replicated<T>::try_ordered_send(Args&&... args) {
+    return ordered_send_impl<tag>(false, std::forward<Args>(args)...);
+}
+
+template <typename T>
+void Replicated<T>::set_send_ready_callback(std::function<void()> callback) {
+    if(is_valid()) {
+        group_rpc_manager.view_manager.set_send_ready_callback(subgroup_id, std::move(callback));
     } else {
         throw empty_reference_exception{"Attempted to use an empty Replicated<T>"};
     }
@@ -166,7 +202,9 @@ auto Replicated<T>::ordered_send(Args&&... args) {
 template <typename T>
 void Replicated<T>::send(unsigned long long int payload_size,
                          const std::function<void(char* buf)>& msg_generator) {
-    group_rpc_manager.view_manager.send(subgroup_id, payload_size, msg_generator);
+    if(!group_rpc_manager.view_manager.send(subgroup_id, payload_size, msg_generator)) {
+        throw rpc::sender_removed_from_group_exception();
+    }
 }
 
 template <typename T>
@@ -188,7 +226,12 @@ void Replicated<T>::send_object_raw(tcp::socket& receiver_socket) const {
     auto bind_socket_write = [&receiver_socket](const char* bytes, std::size_t size) {
         receiver_socket.write(bytes, size);
     };
-    mutils::post_object(bind_socket_write, **user_object_ptr);
+    post_object(bind_socket_write);
+}
+
+template <typename T>
+void Replicated<T>::post_object(const std::function<void(char const* const, std::size_t)>& write_func) const {
+    mutils::post_object(write_func, **user_object_ptr);
 }
 
 template <typename T>
@@ -287,7 +330,9 @@ ExternalCaller<T>::ExternalCaller(uint32_t type_id, node_id_t nid, subgroup_id_t
           subgroup_id(subgroup_id),
           group_rpc_manager(group_rpc_manager),
           wrapped_this(rpc::make_remote_invoker<T>(nid, type_id, subgroup_id,
-                                                   T::register_functions(), *group_rpc_manager.receivers)) {}
+                                                   T::register_functions(), *group_rpc_manager.receivers)) {
+    group_rpc_manager.rebuild_dispatch_table();
+}
 
 //This is literally copied and pasted from Replicated<T>. I wish I could let them share code with inheritance,
 //but I'm afraid that will introduce unnecessary overheads.
@@ -302,13 +347,9 @@ auto ExternalCaller<T>::p2p_send(node_id_t dest_node, Args&&... args) {
         }
         auto return_pair = wrapped_this->template send<rpc::to_internal_tag<true>(tag)>(
                 [this, &dest_node](size_t size) -> char* {
-                    const std::size_t max_payload_size = group_rpc_manager.view_manager.get_max_payload_sizes().at(subgroup_id);
-                    if(size <= max_payload_size) {
-                        return (char*)group_rpc_manager.get_sendbuffer_ptr(dest_node,
-                                                                           sst::REQUEST_TYPE::P2P_REQUEST);
-                    } else {
-                        throw buffer_overflow_exception("The size of a P2P message exceeds the maximum P2P message size.");
-                    }
+                    //Requests larger than a P2P request slot are sent in chunks
+                    return (char*)group_rpc_manager.get_sendbuffer_ptr(dest_node,
+                                                                       sst::REQUEST_TYPE::P2P_REQUEST, size);
                 },
                 std::forward<Args>(args)...);
         group_rpc_manager.finish_p2p_send(dest_node, subgroup_id, return_pair.pending);
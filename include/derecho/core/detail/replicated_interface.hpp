@@ -4,6 +4,8 @@
 #include <derecho/openssl/signature.hpp>
 #include <derecho/tcp/tcp.hpp>
 
+#include <functional>
+
 namespace derecho {
 
 /**
@@ -18,6 +20,7 @@ public:
     virtual std::size_t object_size() const = 0;
     virtual void send_object(tcp::socket& receiver_socket) const = 0;
     virtual void send_object_raw(tcp::socket& receiver_socket) const = 0;
+    virtual void post_object(const std::function<void(char const* const, std::size_t)>& write_func) const = 0;
     virtual std::size_t receive_object(char* buffer) = 0;
     virtual bool is_persistent() const = 0;
     virtual bool is_signed() const = 0;
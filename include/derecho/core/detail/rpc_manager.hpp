@@ -6,21 +6,31 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
 #include <exception>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <semaphore.h>
+#include <set>
+#include <thread>
 #include <vector>
 
 #include "../derecho_type_definitions.hpp"
 #include "../view.hpp"
 #include "derecho_internal.hpp"
+#include "opcode_dispatch_table.hpp"
 #include "p2p_connection_manager.hpp"
 #include "remote_invocable.hpp"
 #include "rpc_utils.hpp"
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
 #include <derecho/utils/logger.hpp>
+#include <derecho/utils/mpsc_queue.hpp>
 
 namespace derecho {
 
@@ -81,6 +91,15 @@ class RPCManager {
      * from the targets of an earlier remote call.
      * Note that a FunctionID is (class ID, subgroup ID, Function Tag). */
     std::unique_ptr<std::map<Opcode, receive_fun_t>> receivers;
+    /**
+     * The index of receivers that receive_message uses to look up incoming
+     * opcodes. It is replaced by rebuild_dispatch_table() every time entries
+     * are added to or removed from receivers, and only read and written with
+     * std::atomic_load and std::atomic_store. A thread that is dispatching a
+     * message holds its own reference to the table, which keeps the table it
+     * found alive until the receive function returns.
+     */
+    std::shared_ptr<const OpcodeDispatchTable> dispatch_table;
     /** An emtpy DeserializationManager, in case we need it later. */
     // mutils::DeserializationManager dsm{{}};
     // Weijia: I prefer the deserialization context vector.
@@ -112,32 +131,34 @@ class RPCManager {
      * the PendingResults' corresponding RPC messages were sent, so the front of
      * the queue corresponds to the oldest in-flight RPC message (i.e. the next
      * one to be received in rpc_message_handler()). Note that the PendingResults
-     * objects themselves live in the RemoteInvocableClass that sent the message.
+     * objects themselves live in the reply-slot pools of the RemoteInvocableClass
+     * that sent the message; RPCManager holds each one until it is removed from
+     * completed_pending_results.
      */
     std::map<subgroup_id_t, std::queue<PendingBase_ref>> pending_results_to_fulfill;
     /**
      * For each subgroup, contains a map from version number to the PendingResults
-     * for that version's RPC call (i.e., a set of PendingResults indexed by
-     * version number). These RPC messages have been delivered locally but RPCManager
+     * for that version's RPC calls (i.e., a set of PendingResults indexed by
+     * version number; the calls batched into one message share a version). These RPC messages have been delivered locally but RPCManager
      * still needs to use the PendingResults to report that persistence has finished.
      */
-    std::map<subgroup_id_t, std::map<persistent::version_t, PendingBase_ref>> results_awaiting_local_persistence;
+    std::map<subgroup_id_t, std::multimap<persistent::version_t, PendingBase_ref>> results_awaiting_local_persistence;
     /**
      * For each subgroup, contains a map from version number to the PendingResults
-     * for that version's RPC call (i.e., a set of PendingResults indexed by
-     * version number). These RPC messages have been persisted locally but RPCManager
+     * for that version's RPC calls (i.e., a set of PendingResults indexed by
+     * version number; the calls batched into one message share a version). These RPC messages have been persisted locally but RPCManager
      * still needs to use the PendingResults to report that global persistence has finished.
      */
-    std::map<subgroup_id_t, std::map<persistent::version_t, PendingBase_ref>> results_awaiting_global_persistence;
+    std::map<subgroup_id_t, std::multimap<persistent::version_t, PendingBase_ref>> results_awaiting_global_persistence;
     /**
      * For each subgroup, contains a map from version number to the PendingResults
-     * for that version's RPC call (i.e., a set of PendingResults indexed by
-     * version number). These RPC messages have finished global persistence but
+     * for that version's RPC calls (i.e., a set of PendingResults indexed by
+     * version number; the calls batched into one message share a version). These RPC messages have finished global persistence but
      * were sent to subgroups with signatures enabled, so RPCManager still
      * needs to use the PendingResults to report that the signature
      * verification has finished.
      */
-    std::map<subgroup_id_t, std::map<persistent::version_t, PendingBase_ref>> results_awaiting_signature;
+    std::map<subgroup_id_t, std::multimap<persistent::version_t, PendingBase_ref>> results_awaiting_signature;
     /**
      * For each subgroup, contains a list of PendingResults references for RPC
      * messages that have completed all of their promise events (fulfilling
@@ -148,6 +169,100 @@ class RPCManager {
      * can't possibly get a removed_node_exception)
      */
     std::map<subgroup_id_t, std::list<PendingBase_ref>> completed_pending_results;
+    /**
+     * For each subgroup, the size completed_pending_results must reach before
+     * release_completed_results() sweeps it again.
+     */
+    std::map<subgroup_id_t, std::size_t> completed_results_sweep_size;
+    static constexpr std::size_t MIN_COMPLETED_RESULTS_SWEEP_SIZE = 64;
+
+    /**
+     * The ordered_send calls to one subgroup that have been packed into the
+     * next multicast message but not sent yet.
+     */
+    struct OrderedSendBatch {
+        /** Held while calls are added to the batch and while it is sent */
+        std::mutex mutex;
+        /** The cooked RPC messages of the calls, back to back, each with its own header */
+        std::vector<char> buffer;
+        /** The PendingResults of the calls, in the same order as their messages */
+        std::vector<PendingBase_ref> pending_results;
+        /** When the oldest call in the batch was added */
+        std::chrono::steady_clock::time_point first_call_time;
+    };
+    /**
+     * The most ordered_send calls that are packed into one multicast message,
+     * from DERECHO/ordered_send_batch_size; 1 if batching is disabled.
+     */
+    const uint32_t ordered_send_batch_size;
+    /** The longest an ordered_send call waits in a batch for more calls, from DERECHO/ordered_send_batch_delay_us */
+    const std::chrono::microseconds ordered_send_batch_delay;
+    /** The batch of each subgroup, created by its first ordered_send call; guarded by ordered_send_batches_mutex */
+    std::map<subgroup_id_t, std::unique_ptr<OrderedSendBatch>> ordered_send_batches;
+    std::mutex ordered_send_batches_mutex;
+    /** Notified when a batch receives its first call, or on shutdown */
+    std::condition_variable ordered_send_batches_cv;
+    /** Set when a batch receives its first call, so that the flush thread recomputes its deadline */
+    bool ordered_send_batch_started = false;
+    /** The thread that sends batches whose delay has expired; implemented by ordered_send_flush_loop() */
+    std::thread ordered_send_flush_thread;
+
+    /** Sends batches whose oldest call has waited for ordered_send_batch_delay. */
+    void ordered_send_flush_loop();
+
+    /**
+     * The body of add_to_ordered_send_batch(), which locks the batch's mutex.
+     * @param failed_calls Receives the calls that can no longer be sent; the
+     * caller must fail them with fail_ordered_send_calls() once it no longer
+     * holds the batch's mutex
+     */
+    bool add_call_to_ordered_send_batch(subgroup_id_t subgroup_id, OrderedSendBatch& batch,
+                                        std::size_t size, std::size_t max_payload_size,
+                                        const std::function<PendingBase&(char*)>& serializer,
+                                        bool blocking, std::vector<PendingBase_ref>& failed_calls);
+
+    /**
+     * Sends all the calls in a batch as one multicast message, and registers
+     * their PendingResults to await replies. Must be called with the batch's
+     * mutex held.
+     * @param blocking Whether to wait for room in the subgroup's send window
+     * @param failed_calls Receives the calls of the batch if this node is no
+     * longer a member of the subgroup, in which case the batch is emptied
+     * @return False if blocking was false and the send window was full, in
+     * which case the batch is left unchanged
+     */
+    bool send_ordered_send_batch(subgroup_id_t subgroup_id, OrderedSendBatch& batch, bool blocking,
+                                 std::vector<PendingBase_ref>& failed_calls);
+
+    /**
+     * Empties a batch that can no longer be sent, appending its calls to
+     * failed_calls. Must be called with the batch's mutex held.
+     */
+    void take_ordered_send_calls(OrderedSendBatch& batch, std::vector<PendingBase_ref>& failed_calls);
+
+    /**
+     * Delivers a sender_removed_from_group_exception to each call, and
+     * releases RPCManager's hold on it so that its reply slot can be reused.
+     * Since the exceptions can run callbacks registered on the QueryResults,
+     * this must not be called with a batch's mutex held.
+     */
+    void fail_ordered_send_calls(std::vector<PendingBase_ref>& failed_calls);
+
+    /**
+     * Fails the calls waiting in a subgroup's batch, because this node left
+     * the subgroup or its Replicated Object is being destroyed. If a sender
+     * holds the batch's mutex, the batch is left to that sender, which fails
+     * the calls itself once its send finds this node out of the subgroup.
+     */
+    void fail_ordered_send_batch(subgroup_id_t subgroup_id);
+
+    /**
+     * Delivers one RPC call in an ordered multicast message, and sends its
+     * reply, or fulfills its PendingResults if this node sent it.
+     */
+    void receive_ordered_call(subgroup_id_t subgroup_id, node_id_t sender_id,
+                              persistent::version_t version, uint64_t timestamp,
+                              char* call_buf, std::size_t call_size);
 
     bool thread_start = false;
     /** Mutex for thread_start_cv. */
@@ -157,13 +272,16 @@ class RPCManager {
     std::atomic<bool> thread_shutdown{false};
     /** The thread that listens for incoming P2P RPC calls; implemented by p2p_receive_loop() */
     std::thread rpc_listener_thread;
-    /** The thread that processes P2P requests in FIFO order; implemented by p2p_request_worker() */
-    std::thread request_worker_thread;
     /** A simple struct representing a P2P request message.
      *  Encapsulates the parameters to a p2p_message_handler call. */
     struct p2p_req {
         node_id_t sender_id;
         char* msg_buf;
+        /**
+         * A copy of the message, which msg_buf points into, if it had to be
+         * copied out of the P2P connection's buffer before being handled.
+         */
+        std::unique_ptr<char[]> msg_copy;
         p2p_req() : sender_id(0),
                     msg_buf(nullptr) {}
         p2p_req(node_id_t _sender_id,
@@ -171,25 +289,94 @@ class RPCManager {
                 : sender_id(_sender_id),
                   msg_buf(_msg_buf) {}
     };
-    /** P2P requests that need to be handled by the worker thread. */
-    std::queue<p2p_req> p2p_request_queue;
-    std::mutex request_queue_mutex;
-    /** Notified when the request worker thread has work to do. */
-    std::condition_variable request_queue_cv;
+    /**
+     * The P2P requests from a set of (sender, subgroup) pairs. A lane is
+     * handled by at most one P2P request thread at a time, so the requests in
+     * it run in the order they arrived, while different lanes can be handled
+     * in parallel.
+     */
+    struct P2PRequestLane {
+        /** Requests in this lane, pushed by the P2P listening thread */
+        MPSCQueue<p2p_req> requests;
+        /** The number of requests pushed to the queue and not yet popped */
+        std::atomic<uint32_t> pending{0};
+        /** Set while a P2P request thread owns this lane */
+        std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    };
+    /** The number of lanes per P2P request thread, so that busy senders rarely share a lane */
+    static constexpr uint32_t P2P_REQUEST_LANES_PER_THREAD = 8;
+    /** The number of threads that handle P2P requests, from DERECHO/p2p_request_threads */
+    const uint32_t num_p2p_request_threads;
+    /** The threads that handle P2P requests; implemented by p2p_request_worker() */
+    std::vector<std::thread> p2p_request_threads;
+    /** The request lanes; a single lane if there is a single P2P request thread */
+    std::vector<std::unique_ptr<P2PRequestLane>> p2p_request_lanes;
+    /** Counts the P2P requests available for the P2P request threads to handle */
+    sem_t p2p_request_sem;
+    /** The lane the next request to a concurrent P2P function will be put in; only used by the listening thread */
+    std::size_t next_concurrent_lane = 0;
+    /**
+     * The opcodes of the P2P functions that were registered with
+     * tag_p2p_concurrent(), whose requests do not need to run in order.
+     * Like receivers, this only changes while the view_mutex is locked for
+     * writing, and it is read by the listening thread with the view_mutex
+     * locked for reading.
+     */
+    std::set<Opcode> concurrent_p2p_functions;
+    /**
+     * One mutex per node ID, held while a P2P request thread writes and sends
+     * a reply to that node, since the P2P connection can only have one
+     * outgoing reply in progress at a time.
+     */
+    std::vector<std::mutex> p2p_reply_mutexes;
+    /**
+     * One mutex per node ID, held while a delivery thread writes and sends a
+     * reply to an ordered call from that node. Subgroups are delivered by
+     * different threads, which would otherwise be given the same RPC_REPLY
+     * slot of the connection.
+     */
+    std::vector<std::mutex> rpc_reply_mutexes;
 
     /** Listens for P2P RPC calls over the RDMA P2P connections and handles them. */
     void p2p_receive_loop();
 
-    /** Handles non-cascading P2P Send requests in FIFO order. */
-    void p2p_request_worker();
+    /** The main loop of a P2P request thread, which handles non-cascading P2P requests. */
+    void p2p_request_worker(uint32_t thread_index);
+
+    /**
+     * Handles the requests in a lane, unless another thread is handling them.
+     */
+    void drain_p2p_request_lane(P2PRequestLane& lane);
+
+    /** Executes a P2P request and sends its reply. */
+    void handle_p2p_request(const p2p_req& request);
+
+    /**
+     * Does nothing for RPC functions that were not registered with
+     * tag_p2p_concurrent(); see the overload below.
+     */
+    template <typename PartialWrapped>
+    void register_concurrent_function(uint32_t, uint32_t, const PartialWrapped&) {}
+
+    /** Records that a P2P function was registered with tag_p2p_concurrent(). */
+    template <FunctionTag Tag, typename Ret, typename Class, typename... Args>
+    void register_concurrent_function(uint32_t type_id, uint32_t instance_id,
+                                      const concurrent_partial_wrapped<Tag, Ret, Class, Args...>&) {
+        concurrent_p2p_functions.insert(Opcode{type_id, instance_id, Tag, false});
+    }
+
+    /** Replaces dispatch_table with a table built from the current contents of receivers. */
+    void rebuild_dispatch_table();
 
     /**
      * Handler to be called by p2p_receive_loop each time it receives a
      * peer-to-peer message over an RDMA P2P connection.
      * @param sender_id The ID of the node that sent the message
      * @param msg_buf A pointer to a buffer containing the message
+     * @param owned_buf The buffer msg_buf points to, if the message was
+     * reassembled from chunks rather than read in place from the P2P buffer
      */
-    void p2p_message_handler(node_id_t sender_id, char* msg_buf);
+    void p2p_message_handler(node_id_t sender_id, char* msg_buf, std::unique_ptr<char[]> owned_buf);
 
     /** Reports to the view manager that the given node has failed if it's internal member.
      * Otherwise clean up p2p_connections and external sockets in lf.cpp
@@ -227,16 +414,42 @@ class RPCManager {
     std::exception_ptr parse_and_receive(char* buf, std::size_t size,
                                          const std::function<char*(int)>& out_alloc);
 
+    /**
+     * Removes the PendingResults that have received all of their replies from
+     * a subgroup's completed_pending_results and releases them, so that their
+     * reply slots can be reused. The list is only swept once it has doubled in
+     * size since the last sweep. Must be called with pending_results_mutex held.
+     * @param subgroup_id The subgroup whose completed list should be swept
+     */
+    void release_completed_results(subgroup_id_t subgroup_id);
+
 public:
     RPCManager(ViewManager& group_view_manager,
                const std::vector<DeserializationContext*>& deserialization_context)
             : nid(getConfUInt32(CONF_DERECHO_LOCAL_ID)),
               receivers(new std::decay_t<decltype(*receivers)>()),
-              view_manager(group_view_manager) {
+              dispatch_table(std::make_shared<OpcodeDispatchTable>()),
+              view_manager(group_view_manager),
+              ordered_send_batch_size(std::max(getConfUInt32(CONF_DERECHO_ORDERED_SEND_BATCH_SIZE), 1u)),
+              ordered_send_batch_delay(getConfUInt32(CONF_DERECHO_ORDERED_SEND_BATCH_DELAY_US)),
+              num_p2p_request_threads(std::max(getConfUInt32(CONF_DERECHO_P2P_REQUEST_THREADS), 1u)),
+              p2p_reply_mutexes(getConfUInt32(CONF_DERECHO_MAX_NODE_ID)),
+              rpc_reply_mutexes(getConfUInt32(CONF_DERECHO_MAX_NODE_ID)) {
         for(const auto& deserialization_context_ptr : deserialization_context) {
             rdv.push_back(deserialization_context_ptr);
         }
+        if(sem_init(&p2p_request_sem, 0, 0) != 0) {
+            throw derecho_exception("Cannot initialize p2p_request_sem:errno=" + std::to_string(errno));
+        }
+        //With a single thread, one lane keeps the requests in the order they arrived
+        const uint32_t num_lanes = num_p2p_request_threads == 1 ? 1 : num_p2p_request_threads * P2P_REQUEST_LANES_PER_THREAD;
+        for(uint32_t i = 0; i < num_lanes; ++i) {
+            p2p_request_lanes.emplace_back(std::make_unique<P2PRequestLane>());
+        }
         rpc_listener_thread = std::thread(&RPCManager::p2p_receive_loop, this);
+        if(ordered_send_batch_size > 1) {
+            ordered_send_flush_thread = std::thread(&RPCManager::ordered_send_flush_loop, this);
+        }
     }
 
     ~RPCManager();
@@ -276,8 +489,11 @@ public:
         //which is the result of the user calling tag<Tag>(&UserProvidedClass::method) on each RPC method
         //Use callFunc to unpack the tuple into a variadic parameter pack for build_remoteinvocableclass
         return mutils::callFunc([&](const auto&... unpacked_functions) {
-            return build_remote_invocable_class<UserProvidedClass>(nid, type_id, instance_id, *receivers,
-                                                                   bind_to_instance(cls, unpacked_functions)...);
+            (register_concurrent_function(type_id, instance_id, unpacked_functions), ...);
+            auto invocable_class = build_remote_invocable_class<UserProvidedClass>(nid, type_id, instance_id, *receivers,
+                                                                                   bind_to_instance(cls, unpacked_functions)...);
+            rebuild_dispatch_table();
+            return invocable_class;
         },
                                 funs);
     }
@@ -297,7 +513,8 @@ public:
      * Handler to be called by MulticastGroup when it receives a message that
      * appears to be a "cooked send" RPC message. Parses the message and
      * delivers it to the appropriate RPC function registered with this RPCManager,
-     * then sends a reply to the sender if one is needed.
+     * then sends a reply to the sender if one is needed. A message that holds a
+     * batch of ordered_send calls is delivered one call at a time, in order.
      * @param subgroup_id The internal subgroup number of the subgroup this
      * message was received in
      * @param sender_id The ID of the node that sent the message
@@ -343,19 +560,49 @@ public:
      * the "promise object" in pending_results_handle to await replies.
      * @param subgroup_id The subgroup in which this message is being sent
      * @param pending_results_handle A reference to the "promise object" in the
-     * send_return for this send.
+     * send_return for this send. RPCManager takes over one of its holders and
+     * releases it once the call has completed.
      * @return True if the send was successful, false if the current view is wedged
      */
     bool finish_rpc_send(subgroup_id_t subgroup_id, PendingBase& pending_results_handle);
 
+    /** @return True if ordered_send calls are batched into shared multicast messages */
+    bool is_ordered_send_batching_enabled() const {
+        return ordered_send_batch_size > 1;
+    }
+
+    /**
+     * Adds an ordered_send call to its subgroup's batch, and sends the batch
+     * if it is full. The batch is sent before the call is added if it is
+     * already full or the call does not fit in the rest of the subgroup's
+     * maximum payload.
+     * @param subgroup_id The subgroup the call is sent to
+     * @param size The size of the call's RPC message, including its header
+     * @param serializer A function that writes the call's RPC message to the
+     * buffer it is given and returns the call's PendingResults. RPCManager
+     * takes over one of its holders and releases it once the call has
+     * completed.
+     * @param blocking Whether to wait for room in the send window when the
+     * batch must be sent before the call is added
+     * If this node has left the subgroup, the calls in the batch, including
+     * this one, fail with a sender_removed_from_group_exception.
+     * @return False if blocking was false and the call could not be added
+     * because the send window was full; the serializer is not called then
+     */
+    bool add_to_ordered_send_batch(subgroup_id_t subgroup_id, std::size_t size,
+                                   const std::function<PendingBase&(char*)>& serializer,
+                                   bool blocking = true);
+
     /**
      * Retrieves a buffer for sending P2P messages from the RPCManager's pool of
      * P2P RDMA connections. After filling it with data, the next call to
      * finish_p2p_send will send it.
      * @param dest_id The ID of the node that the P2P message will be sent to
      * @param type The type of P2P message that will be sent
+     * @param size The size of the message in bytes; messages that do not fit
+     * in one P2P slot are sent in chunks
      */
-    volatile char* get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type);
+    volatile char* get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type, std::size_t size);
 
     /**
      * Sends the next P2P message buffer over an RDMA connection to the specified node,
@@ -363,7 +610,8 @@ public:
      * @param dest_node The node to send the message to
      * @param dest_subgroup_id The subgroup ID of the subgroup that node is in
      * @param pending_results_handle A reference to the "promise object" in the
-     * send_return for this send.
+     * send_return for this send. RPCManager takes over one of its holders and
+     * releases it once the call has completed, or if the send fails.
      */
     void finish_p2p_send(node_id_t dest_node, subgroup_id_t dest_subgroup_id, PendingBase& pending_results_handle);
 };
@@ -6,12 +6,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
@@ -23,6 +27,7 @@
 
 #include "../derecho_exception.hpp"
 #include "../derecho_type_definitions.hpp"
+#include "completion.hpp"
 #include "derecho_internal.hpp"
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
 #include <derecho/utils/logger.hpp>
@@ -51,41 +56,27 @@ constexpr std::size_t hash_cstr(Carr&& c_str) {
 
 /**
  * A helper function that examines a C-string to determine whether it matches
- * one of the two method-registering macros in register_rpc_functions, P2P_TARGETS
- * and ORDERED_TARGETS. This is used by the REGISTER_RPC_FUNCTIONS macro to
- * ensure that it is only called with the correct arguments.
+ * one of the method-registering macros in register_rpc_functions, P2P_TARGETS,
+ * ORDERED_TARGETS and CONCURRENT_P2P_TARGETS. This is used by the
+ * REGISTER_RPC_FUNCTIONS macro to ensure that it is only called with the
+ * correct arguments.
  */
 template <typename Carr>
 constexpr bool well_formed_macro(Carr&& c_str) {
-    constexpr char option1[] = "P2P_TARGETS";
-    constexpr std::size_t length1 = 11;
-    constexpr char option2[] = "ORDERED_TARGETS";
-    constexpr std::size_t length2 = 15;
-    bool option1_active = false;
-    bool option2_active = false;
-    std::size_t index = 0;
-    for(char c : c_str) {
-        if(c == 0 || (index >= length1 && option1_active) || (index >= length2 && option2_active))
-            return true;
-        else if(!option1_active && !option2_active && index == 0) {
-            //first iter
-            if(c == option1[0])
-                option1_active = true;
-            else if(c == option2[0])
-                option2_active = true;
-            else
-                return false;
-            ++index;
-        } else if(option1_active) {
-            if(c != option1[index]) return false;
-            ++index;
-        } else if(option2_active) {
-            if(c != option2[index]) return false;
+    constexpr const char* options[] = {"P2P_TARGETS", "ORDERED_TARGETS", "CONCURRENT_P2P_TARGETS"};
+    if(c_str[0] == 0) {
+        return true;
+    }
+    for(const char* option : options) {
+        std::size_t index = 0;
+        while(option[index] != 0 && c_str[index] == option[index]) {
             ++index;
-        } else
-            return false;
+        }
+        if(option[index] == 0) {
+            return true;
+        }
     }
-    return true;
+    return false;
 }
 
 using FunctionTag = unsigned long long;
@@ -208,12 +199,248 @@ using receive_fun_t = std::function<recv_ret(
         mutils::RemoteDeserialization_v* rdv, const node_id_t&, const char* recv_buf,
         const std::function<char*(int)>& out_alloc)>;
 
+/**
+ * Interface of the pools that PendingBase objects are allocated from (see
+ * ReplySlotPool). A pooled PendingBase is handed back to its pool once all of
+ * its holders have released it.
+ */
+class PendingSlotPool {
+public:
+    virtual void recycle(uint32_t slot_index) = 0;
+    virtual ~PendingSlotPool() {}
+};
+
+/**
+ * Abstract base type for PendingResults. This allows us to store a pointer to
+ * any template specialization of PendingResults without knowing the template
+ * parameter.
+ */
+class PendingBase {
+private:
+    /** The pool this object is a slot of, or nullptr if it is not pooled */
+    PendingSlotPool* pool = nullptr;
+    uint32_t slot_index = 0;
+    /**
+     * The number of holders that have not released this object yet. A pooled
+     * PendingBase is handed out with two: the QueryResults returned to the
+     * caller, and the RPCManager (or ExternalGroup) that delivers its events.
+     */
+    std::atomic<uint32_t> holders{0};
+
+public:
+    virtual void fulfill_map(const node_list_t&) = 0;
+    virtual void set_persistent_version(persistent::version_t, uint64_t) = 0;
+    virtual void set_local_persistence() = 0;
+    virtual void set_global_persistence() = 0;
+    virtual void set_signature_verified() = 0;
+    virtual void set_exception_for_removed_node(const node_id_t&) = 0;
+    virtual void set_exception_for_caller_removed() = 0;
+    virtual bool all_responded() const = 0;
+    virtual void reset() = 0;
+    virtual ~PendingBase() {}
+
+    /**
+     * Makes this object the slot at slot_index of a pool.
+     */
+    void set_pool(PendingSlotPool* owner, uint32_t index) {
+        pool = owner;
+        slot_index = index;
+    }
+
+    /**
+     * Sets the number of holders of a slot that is being handed out.
+     */
+    void set_holders(uint32_t count) {
+        holders.store(count, std::memory_order_release);
+    }
+
+    /**
+     * Adds a holder; the caller must already be one, or be acting for one.
+     */
+    void hold() {
+        if(pool != nullptr) {
+            holders.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Adds a holder, unless every holder has already released this object
+     * (in which case it may be about to be recycled).
+     * @return True if the holder was added
+     */
+    bool try_hold() {
+        uint32_t current = holders.load(std::memory_order_acquire);
+        while(current > 0) {
+            if(holders.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Releases one holder. The last holder to release a pooled object hands
+     * it back to its pool; the object must not be used after that.
+     */
+    void release() {
+        if(pool != nullptr && holders.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            pool->recycle(slot_index);
+        }
+    }
+};
+
+/**
+ * Gives the coroutine awaitables in derecho/core/coroutines.hpp access to the
+ * completions behind ReplyFutures and QueryResults.
+ */
+struct AwaitableAccess;
+
+/**
+ * The consumer end of one node's reply to an RPC function call, which has the
+ * interface of a std::future. It refers to a Completion inside the call's
+ * pooled PendingResults, and holds that PendingResults until the reply is
+ * retrieved or the ReplyFuture is destroyed.
+ * @tparam T The return type of the RPC function
+ */
+template <typename T>
+class ReplyFuture {
+private:
+    Completion<T>* completion = nullptr;
+    PendingBase* owner = nullptr;
+    friend struct AwaitableAccess;
+
+    struct adopt_hold_t {};
+    /** Constructs a ReplyFuture that takes over a hold its creator already has on owner */
+    ReplyFuture(Completion<T>* completion, PendingBase* owner, adopt_hold_t)
+            : completion(completion), owner(owner) {}
+
+public:
+    ReplyFuture() = default;
+    ReplyFuture(Completion<T>& completion, PendingBase& owner)
+            : completion(&completion), owner(&owner) {
+        owner.hold();
+    }
+    ReplyFuture(ReplyFuture&& other) : completion(other.completion), owner(other.owner) {
+        other.completion = nullptr;
+        other.owner = nullptr;
+    }
+    ReplyFuture& operator=(ReplyFuture&& other) {
+        if(this != &other) {
+            if(owner) {
+                owner->release();
+            }
+            completion = other.completion;
+            owner = other.owner;
+            other.completion = nullptr;
+            other.owner = nullptr;
+        }
+        return *this;
+    }
+    ReplyFuture(const ReplyFuture&) = delete;
+    ~ReplyFuture() {
+        if(owner) {
+            owner->release();
+        }
+    }
+
+    /** @return True if the reply has not been retrieved with get() or then() yet */
+    bool valid() const { return completion != nullptr; }
+
+    /** @return True if the reply (or an exception in its place) has arrived */
+    bool is_ready() const { return completion->is_ready(); }
+
+    /** Blocks until the reply arrives. */
+    void wait() const { completion->wait(); }
+
+    /** Blocks until the reply arrives or the timeout expires. */
+    template <typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+        return completion->wait_for(timeout) ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    /**
+     * Blocks until the reply arrives, then returns it, or rethrows the
+     * exception that was delivered in its place. Like std::future::get(), this
+     * can only be called once.
+     */
+    T get() {
+        ReplyFuture consumed(std::move(*this));
+        if constexpr(std::is_void_v<T>) {
+            consumed.completion->get();
+        } else {
+            return std::move(consumed.completion->get());
+        }
+    }
+
+    /**
+     * Registers a function to be called with this ReplyFuture once the reply
+     * arrives, so that the caller does not need to block a thread on get().
+     * The function runs on the thread that delivers the reply (or right away,
+     * if it has already arrived), and should not block. This consumes the
+     * ReplyFuture, like get().
+     * @param continuation A function that takes the ready ReplyFuture and
+     * can call get() on it without blocking
+     */
+    void then(std::function<void(ReplyFuture&)> continuation) {
+        Completion<T>* ready_completion = completion;
+        PendingBase* ready_owner = owner;
+        completion = nullptr;
+        owner = nullptr;
+        ready_completion->then([ready_completion, ready_owner, continuation]() {
+            ReplyFuture ready(ready_completion, ready_owner, adopt_hold_t{});
+            continuation(ready);
+        });
+    }
+};
+
 /**
  * The type of map contained in a QueryResults::ReplyMap. The template parameter
  * should be the return type of the query.
  */
 template <typename T>
-using futures_map = std::map<node_id_t, std::future<T>>;
+using futures_map = std::map<node_id_t, ReplyFuture<T>>;
+
+/**
+ * The completions for the events of a single RPC function call. They live in
+ * the call's PendingResults, which sets them, and are read through the
+ * corresponding QueryResults.
+ * @tparam Ret The return type of the RPC function
+ */
+template <typename Ret>
+struct CallCompletions {
+    /**
+     * Set once the RPC function call has been sent and the set of nodes that
+     * will reply is known, or to an exception if the call was never sent.
+     */
+    Completion<void> reply_map;
+    /** The nodes that will reply, which can be read once reply_map is ready */
+    std::vector<node_id_t> reply_nodes;
+    /**
+     * One completion per node in reply_nodes, at the same index. There may be
+     * more completions than nodes, since they are kept when the slot is reused.
+     */
+    std::vector<std::unique_ptr<Completion<Ret>>> replies;
+    /** The version number and timestamp assigned to the update caused by the call */
+    Completion<std::pair<persistent::version_t, uint64_t>> version;
+    /** Set when the update has finished persisting locally */
+    Completion<void> local_persistence;
+    /** Set when the update has finished persisting on all replicas */
+    Completion<void> global_persistence;
+    /** Set when the update's signature has been verified on all replicas */
+    Completion<void> signature_verified;
+
+    void reset() {
+        reply_map.reset();
+        reply_nodes.clear();
+        for(auto& reply : replies) {
+            reply->reset();
+        }
+        version.reset();
+        local_persistence.reset();
+        global_persistence.reset();
+        signature_verified.reset();
+    }
+};
 
 /**
  * Data structure that (indirectly) holds a set of futures for a single RPC
@@ -229,12 +456,10 @@ using futures_map = std::map<node_id_t, std::future<T>>;
 template <typename Ret>
 class QueryResults {
 public:
-    /** A future for a futures_map held by unique_ptr (so it can be more easily moved) */
-    using map_fut = std::future<std::unique_ptr<futures_map<Ret>>>;
     using type = Ret;
 
     /**
-     * A wrapper around a std::map from node IDs to std::futures. Implements
+     * A wrapper around a std::map from node IDs to ReplyFutures. Implements
      * the iterator interface by passing calls through to the underlying std::map,
      * so ReplyMap can be iterated over in a for-each loop as if it is actually
      * a map rather than a wrapper around a map.
@@ -248,7 +473,6 @@ public:
 
         ReplyMap(QueryResults& qr) : parent(qr){};
         ReplyMap(const ReplyMap&) = delete;
-        ReplyMap(ReplyMap&& rm) : parent(rm.parent), rmap(std::move(rm.rmap)) {}
 
         bool valid(const node_id_t& nid) {
             assert(rmap.size() == 0 || rmap.count(nid) != 0);
@@ -269,10 +493,8 @@ public:
             if(rmap.size() == 0) {
                 //This should never happen. Since the ReplyMap member is private, the only way to
                 //invoke get(nid) on a ReplyMap is to retrieve a reference to it with the parent
-                //QueryResults's wait() or get(), which must have executed the assignment
-                //replies.rmap = std::move(*pending_rmap.get()).
-                assert(parent.pending_rmap.valid());
-                rmap = std::move(*parent.pending_rmap.get());
+                //QueryResults's wait() or get(), which must have filled in rmap.
+                parent.get();
             }
             assert(rmap.size() > 0);
             assert(rmap.count(nid));
@@ -281,44 +503,40 @@ public:
         }
     };
 
-    map_fut pending_rmap;
-
 private:
+    /** The completions in the PendingResults that constructed this QueryResults */
+    CallCompletions<Ret>* completions;
+    /** That PendingResults, which this QueryResults releases when it is destroyed */
+    PendingBase* pending_slot;
     ReplyMap replies{*this};
-    /** This will be fulfilled with this RPC function call's version-timestamp pair, once it has been assigned */
-    std::future<std::pair<persistent::version_t, uint64_t>> persistent_version;
-    /** This signals that local persistence has completed for the version assigned to this RPC function call */
-    std::future<void> local_persistence_done;
-    /** This signals that global persistence has completed for the version assigned to this RPC function call */
-    std::future<void> global_persistence_done;
-    /** This signals that the signature has been verified at all replicas on the version assigned to this RPC function call */
-    std::future<void> signature_done;
+    friend struct AwaitableAccess;
 
 public:
     /**
-     * Constructs a QueryResults from a future for a reply-map (which is itself
-     * a map of futures), and the futures for the persistent events it will also
-     * track. The promise ends of these futures should reside in a corresponding
-     * PendingResults that constructed this QueryResults.
-     */
-    QueryResults(map_fut reply_map_future, std::future<std::pair<persistent::version_t, uint64_t>> persistent_version,
-                 std::future<void> local_persistence_done, std::future<void> global_persistence_done,
-                 std::future<void> signature_done)
-            : pending_rmap(std::move(reply_map_future)),
-              persistent_version(std::move(persistent_version)),
-              local_persistence_done(std::move(local_persistence_done)),
-              global_persistence_done(std::move(global_persistence_done)),
-              signature_done(std::move(signature_done)) {}
+     * Constructs a QueryResults that reads the completions of an RPC function
+     * call, which should reside in the PendingResults that constructed this
+     * QueryResults. That PendingResults is passed as pending_slot, and must
+     * already count this QueryResults as one of its holders.
+     */
+    QueryResults(CallCompletions<Ret>& completions, PendingBase* pending_slot)
+            : completions(&completions),
+              pending_slot(pending_slot) {}
     /** Move constructor for QueryResults. */
     QueryResults(QueryResults&& o)
-            : pending_rmap{std::move(o.pending_rmap)},
-              replies{std::move(o.replies)},
-              persistent_version{std::move(o.persistent_version)},
-              local_persistence_done{std::move(o.local_persistence_done)},
-              global_persistence_done{std::move(o.global_persistence_done)},
-              signature_done{std::move(o.signature_done)} {}
+            : completions(o.completions),
+              pending_slot(o.pending_slot) {
+        replies.rmap = std::move(o.replies.rmap);
+        o.pending_slot = nullptr;
+    }
     /** QueryResults, like std::future, is not copyable. */
     QueryResults(const QueryResults&) = delete;
+    ~QueryResults() {
+        //Destroy the ReplyFutures before giving up this QueryResults' own hold
+        replies.rmap.clear();
+        if(pending_slot) {
+            pending_slot->release();
+        }
+    }
 
     /**
      * Wait the specified duration; if a ReplyMap is available
@@ -327,8 +545,13 @@ public:
     template <typename Time>
     ReplyMap* wait(Time t) {
         if(replies.rmap.size() == 0) {
-            if(pending_rmap.wait_for(t) == std::future_status::ready) {
-                replies.rmap = std::move(*pending_rmap.get());
+            if(completions->reply_map.wait_for(t)) {
+                //Rethrows the exception if the call was never sent
+                completions->reply_map.get();
+                for(std::size_t i = 0; i < completions->reply_nodes.size(); ++i) {
+                    replies.rmap.emplace(completions->reply_nodes[i],
+                                         ReplyFuture<Ret>(*completions->replies[i], *pending_slot));
+                }
                 return &replies;
             } else
                 return nullptr;
@@ -361,7 +584,7 @@ public:
      * should be const anyway, so it should not generate a new version).
      */
     std::pair<persistent::version_t, uint64_t> get_persistent_version() {
-        return persistent_version.get();
+        return completions->version.get();
     }
 
     /**
@@ -375,7 +598,7 @@ public:
      * persistence events related to it.
      */
     void await_local_persistence() {
-        local_persistence_done.get();
+        completions->local_persistence.get();
     }
 
     /**
@@ -389,7 +612,7 @@ public:
      * persistence events related to it.
      */
     void await_global_persistence() {
-        global_persistence_done.get();
+        completions->global_persistence.get();
     }
 
     /**
@@ -402,7 +625,81 @@ public:
      * signature events related to it.
      */
     void await_signature_verification() {
-        signature_done.get();
+        completions->signature_verified.get();
+    }
+
+    /**
+     * Registers functions to be called as the replies to this RPC function
+     * call arrive, so that the caller does not need to block a thread on get().
+     * reply_callback is called once for each node the call was sent to, with
+     * a ready ReplyFuture holding that node's reply (or the exception that was
+     * delivered in its place). If the call is never sent, failure_callback is
+     * called instead, with the exception that get() would throw. Callbacks for
+     * replies that have already arrived run right away on the calling thread;
+     * the others run on the thread that receives the reply (or, for a
+     * node_removed_from_group_exception, the thread installing the new View),
+     * so they should be short and must not block. Replies consumed through
+     * on_reply cannot also be consumed with ReplyFuture::then().
+     */
+    void on_reply(std::function<void(node_id_t, ReplyFuture<Ret>&)> reply_callback,
+                  std::function<void(std::exception_ptr)> failure_callback = nullptr) {
+        CallCompletions<Ret>* call = completions;
+        PendingBase* owner = pending_slot;
+        auto shared_callback = std::make_shared<std::function<void(node_id_t, ReplyFuture<Ret>&)>>(
+                std::move(reply_callback));
+        call->reply_map.then([call, owner, shared_callback, failure_callback]() {
+            try {
+                call->reply_map.get();
+            } catch(...) {
+                if(failure_callback) {
+                    failure_callback(std::current_exception());
+                }
+                return;
+            }
+            for(std::size_t i = 0; i < call->reply_nodes.size(); ++i) {
+                Completion<Ret>* reply = call->replies[i].get();
+                const node_id_t node = call->reply_nodes[i];
+                reply->then([reply, owner, node, shared_callback]() {
+                    ReplyFuture<Ret> ready(*reply, *owner);
+                    (*shared_callback)(node, ready);
+                });
+            }
+        });
+    }
+
+    /**
+     * Registers a function to be called once the update caused by this RPC
+     * function call has finished persisting locally, instead of blocking on
+     * await_local_persistence(). It runs on the persistence thread (or right
+     * away, if the update has already persisted), so it should be short and
+     * must not block. Only one function can be registered.
+     */
+    void on_local_persistence(std::function<void()> callback) {
+        completions->local_persistence.then(std::move(callback));
+    }
+
+    /**
+     * Registers a function to be called once the update caused by this RPC
+     * function call has finished persisting on all replicas, instead of
+     * blocking on await_global_persistence(). It runs on the thread that
+     * detects global persistence (or right away, if that has already
+     * happened), so it should be short and must not block. Only one function
+     * can be registered.
+     */
+    void on_global_persistence(std::function<void()> callback) {
+        completions->global_persistence.then(std::move(callback));
+    }
+
+    /**
+     * Registers a function to be called once the signature on the update
+     * caused by this RPC function call has been verified on all replicas,
+     * instead of blocking on await_signature_verification(). It runs on the
+     * thread that detects verification (or right away, if that has already
+     * happened), so it should be short and must not block. Only one function
+     * can be registered.
+     */
+    void on_signature_verification(std::function<void()> callback) {
+        completions->signature_verified.then(std::move(callback));
     }
 };
 
@@ -416,7 +713,6 @@ public:
 template <>
 class QueryResults<void> {
 public:
-    using map_fut = std::future<std::unique_ptr<std::set<node_id_t>>>;
     using type = void;
 
     class ReplyMap {
@@ -428,7 +724,6 @@ public:
 
         ReplyMap(QueryResults& qr) : parent(qr){};
         ReplyMap(const ReplyMap&) = delete;
-        ReplyMap(ReplyMap&& rm) : parent(rm.parent), rmap(std::move(rm.rmap)) {}
 
         bool valid(const node_id_t& nid) {
             assert(rmap.size() == 0 || rmap.count(nid) != 0);
@@ -446,36 +741,28 @@ public:
         auto end() { return std::end(rmap); }
     };
 
-    map_fut pending_rmap;
-
 private:
+    CallCompletions<void>* completions;
+    PendingBase* pending_slot;
     ReplyMap replies{*this};
-    /** This will be fulfilled with this RPC function call's version-timestamp pair, once it has been assigned */
-    std::future<std::pair<persistent::version_t, uint64_t>> persistent_version;
-    /** This signals that local persistence has completed for the version assigned to this RPC function call */
-    std::future<void> local_persistence_done;
-    /** This signals that global persistence has completed for the version assigned to this RPC function call */
-    std::future<void> global_persistence_done;
-    /** This signals that the signature has been verified at all replicas on the version assigned to this RPC function call */
-    std::future<void> signature_done;
+    friend struct AwaitableAccess;
 
 public:
-    QueryResults(map_fut reply_map_future, std::future<std::pair<persistent::version_t, uint64_t>> persistent_version,
-                 std::future<void> local_persistence_done, std::future<void> global_persistence_done,
-                 std::future<void> signature_done)
-            : pending_rmap(std::move(reply_map_future)),
-              persistent_version(std::move(persistent_version)),
-              local_persistence_done(std::move(local_persistence_done)),
-              global_persistence_done(std::move(global_persistence_done)),
-              signature_done(std::move(signature_done)) {}
+    QueryResults(CallCompletions<void>& completions, PendingBase* pending_slot)
+            : completions(&completions),
+              pending_slot(pending_slot) {}
     QueryResults(QueryResults&& o)
-            : pending_rmap{std::move(o.pending_rmap)},
-              replies{std::move(o.replies)},
-              persistent_version{std::move(o.persistent_version)},
-              local_persistence_done{std::move(o.local_persistence_done)},
-              global_persistence_done{std::move(o.global_persistence_done)},
-              signature_done{std::move(o.signature_done)} {}
+            : completions(o.completions),
+              pending_slot(o.pending_slot) {
+        replies.rmap = std::move(o.replies.rmap);
+        o.pending_slot = nullptr;
+    }
     QueryResults(const QueryResults&) = delete;
+    ~QueryResults() {
+        if(pending_slot) {
+            pending_slot->release();
+        }
+    }
 
     /**
      * Wait the specified duration; if a ReplyMap is available
@@ -484,8 +771,9 @@ public:
     template <typename Time>
     ReplyMap* wait(Time t) {
         if(replies.rmap.size() == 0) {
-            if(pending_rmap.wait_for(t) == std::future_status::ready) {
-                replies.rmap = std::move(*pending_rmap.get());
+            if(completions->reply_map.wait_for(t)) {
+                completions->reply_map.get();
+                replies.rmap.insert(completions->reply_nodes.begin(), completions->reply_nodes.end());
                 return &replies;
             } else
                 return nullptr;
@@ -514,7 +802,7 @@ public:
      * will block unless get() has been previously called on the QueryResults.
      */
     std::pair<persistent::version_t, uint64_t> get_persistent_version() {
-        return persistent_version.get();
+        return completions->version.get();
     }
 
     /**
@@ -528,21 +816,21 @@ public:
      * persistence events related to it.
      */
     void await_local_persistence() {
-        local_persistence_done.get();
+        completions->local_persistence.get();
     }
 
     /**
      * Blocks until the update caused by this RPC function call has finished
-     * persisting locally (i.e. the version number assigned to it has reached
-     * the "locally persisted" state). Note that this is meaningless if the
-     * Replicated Object has no Persistent<T> fields, and it will only work on
-     * QueryResults that are generated by ordered_send calls. It will block
-     * forever if called on the result of a p2p_send call, since only the
+     * persisting on all replicas (i.e. the version number assigned to it has
+     * reached the "globally persisted" state). Note that this is meaningless
+     * if the Replicated Object has no Persistent<T> fields, and it will only
+     * work on QueryResults that are generated by ordered_send calls. It will
+     * block forever if called on the result of a p2p_send call, since only the
      * members of the subgroup that receives an RPC message will be notified of
      * persistence events related to it.
      */
     void await_global_persistence() {
-        global_persistence_done.get();
+        completions->global_persistence.get();
     }
 
     /**
@@ -555,123 +843,109 @@ public:
      * signature events related to it.
      */
     void await_signature_verification() {
-        signature_done.get();
+        completions->signature_verified.get();
     }
-};
 
-/**
- * Abstract base type for PendingResults. This allows us to store a pointer to
- * any template specialization of PendingResults without knowing the template
- * parameter.
- */
-class PendingBase {
-public:
-    virtual void fulfill_map(const node_list_t&) = 0;
-    virtual void set_persistent_version(persistent::version_t, uint64_t) = 0;
-    virtual void set_local_persistence() = 0;
-    virtual void set_global_persistence() = 0;
-    virtual void set_signature_verified() = 0;
-    virtual void set_exception_for_removed_node(const node_id_t&) = 0;
-    virtual void set_exception_for_caller_removed() = 0;
-    virtual bool all_responded() const = 0;
-    virtual void reset() = 0;
-    virtual ~PendingBase() {}
+    /**
+     * Registers a function to be called once the update caused by this RPC
+     * function call has finished persisting locally. See
+     * QueryResults<Ret>::on_local_persistence().
+     */
+    void on_local_persistence(std::function<void()> callback) {
+        completions->local_persistence.then(std::move(callback));
+    }
+
+    /**
+     * Registers a function to be called once the update caused by this RPC
+     * function call has finished persisting on all replicas. See
+     * QueryResults<Ret>::on_global_persistence().
+     */
+    void on_global_persistence(std::function<void()> callback) {
+        completions->global_persistence.then(std::move(callback));
+    }
+
+    /**
+     * Registers a function to be called once the signature on the update
+     * caused by this RPC function call has been verified on all replicas. See
+     * QueryResults<Ret>::on_signature_verification().
+     */
+    void on_signature_verification(std::function<void()> callback) {
+        completions->signature_verified.then(std::move(callback));
+    }
 };
 
 /**
- * Data structure that holds a set of promises for a single RPC function call;
- * the promises transmit one response (either a value or an exception) for
- * each node that was called. The future ends of these promises are stored in
- * a corresponding QueryResults object.
+ * Data structure that holds the completions for a single RPC function call;
+ * there is one completion for the response (either a value or an exception)
+ * of each node that was called, plus one for each persistence event. The
+ * consumer ends of these completions are a corresponding QueryResults object.
  * @tparam Ret The return type of the RPC function, which is the type of a
  * response's value.
  */
 template <typename Ret>
 class PendingResults : public PendingBase {
 private:
-    /** A promise for a map containing one future for each reply to the RPC function
-     * call. The future end of this promise lives in QueryResults, and is fulfilled
-     * when the RPC function call is actually sent and the set of repliers is known. */
-    std::promise<std::unique_ptr<futures_map<Ret>>> promise_for_pending_map;
-
-    std::promise<std::map<node_id_t, std::promise<Ret>>> promise_for_reply_promises;
-    /** A future for a map containing one promise for each reply to the RPC function
-     * call. It will be fulfilled when fulfill_map is called, which means the RPC
-     * function call was actually sent and the set of destination nodes is known. */
-    std::future<std::map<node_id_t, std::promise<Ret>>> reply_promises_are_ready;
-    std::mutex reply_promises_are_ready_mutex;
-    std::map<node_id_t, std::promise<Ret>> reply_promises;
+    CallCompletions<Ret> completions;
     /**
      * True if the reply map has been fulfilled, i.e. fulfill_map() has been
-     * called and promise_for_pending_map has had a value set. This is necessary
-     * because it's impossible to ask a std::promise if set_value() has been
-     * called on it.
+     * called and completions.reply_map has been set. This is necessary
+     * because fulfill_map() may also set reply_map to an exception.
     */
-    bool map_fulfilled = false;
-    std::set<node_id_t> dest_nodes, responded_nodes;
-
+    std::atomic<bool> map_fulfilled{false};
     /**
-     * A promise for a persistent version (which is actually a pair of a version
-     * number and a timestamp) assigned to the update represented by this RPC
-     * function call. The future end of this promise lives in the corresponding
-     * QueryResults. It is fulfilled when the RPC function call is actually sent,
-     * which means it has been ordered and a version is assigned to it.
+     * The number of nodes whose reply completion has been set, either to
+     * their reply or to an exception, which all_responded() can read while
+     * replies are being received.
      */
-    std::promise<std::pair<persistent::version_t, uint64_t>> version_promise;
-    /**
-     * A promise representing the "local persistence" event for the update
-     * caused by this RPC call; the future end lives in QueryResults. This is
-     * fulfilled to signal that the update has finished persisting locally.
-     */
-    std::promise<void> local_persistence_promise;
-    /**
-     * A promise representing the "global persistence" event for the update
-     * caused by this RPC call; the future end lives in QueryResults. This is
-     * fulfilled to signal that the update has finished persisting on all
-     * replicas.
-     */
-    std::promise<void> global_persistence_promise;
+    std::atomic<std::size_t> num_responded{0};
+
     /**
-     * A promise representing the "signature verified" event for the update
-     * caused by this RPC call; the future end lives in QueryResults.
+     * Returns the completion for a node's reply, first waiting for the reply
+     * map to be fulfilled if fulfill_map() has not been called yet.
+     * @return nullptr if the node is not one of the nodes that were called,
+     * or the call was never sent
      */
-    std::promise<void> signature_verified_promise;
+    Completion<Ret>* reply_for(const node_id_t& nid) {
+        if(!map_fulfilled) {
+            dbg_default_trace("PendingResults<{}> about to wait for the reply map", typeid(Ret).name());
+            completions.reply_map.wait();
+            if(!map_fulfilled) {
+                return nullptr;
+            }
+        }
+        for(std::size_t i = 0; i < completions.reply_nodes.size(); ++i) {
+            if(completions.reply_nodes[i] == nid) {
+                return completions.replies[i].get();
+            }
+        }
+        return nullptr;
+    }
 
 public:
-    PendingResults()
-            : reply_promises_are_ready(promise_for_reply_promises.get_future()) {}
     virtual ~PendingResults() {}
 
     /**
      * Constructs and returns a QueryResults representing the "future" end of
-     * the response promises in this PendingResults.
+     * the response completions in this PendingResults.
      * @return A new QueryResults holding a set of futures for this RPC function call
      */
     QueryResults<Ret> get_future() {
-        return QueryResults<Ret>{promise_for_pending_map.get_future(),
-                                 version_promise.get_future(),
-                                 local_persistence_promise.get_future(),
-                                 global_persistence_promise.get_future(),
-                                 signature_verified_promise.get_future()};
+        return QueryResults<Ret>{completions, this};
     }
 
     /**
-     * Fill pending_map and reply_promises with one promise/future pair for
-     * each node that was contacted in this RPC call
+     * Sets up one completion for each node that was contacted in this RPC
+     * call, then marks the reply map as fulfilled.
      * @param who A list of nodes from which to expect responses.
      */
     void fulfill_map(const node_list_t& who) {
         dbg_default_trace("Got a call to fulfill_map for PendingResults<{}>", typeid(Ret).name());
-        std::unique_ptr<futures_map<Ret>> futures = std::make_unique<futures_map<Ret>>();
-        std::map<node_id_t, std::promise<Ret>> promises;
-        for(const auto& e : who) {
-            futures->emplace(e, promises[e].get_future());
+        completions.reply_nodes.assign(who.begin(), who.end());
+        while(completions.replies.size() < who.size()) {
+            completions.replies.emplace_back(std::make_unique<Completion<Ret>>());
         }
-        dest_nodes.insert(who.begin(), who.end());
-        dbg_default_trace("Setting a value for reply_promises_are_ready");
-        promise_for_reply_promises.set_value(std::move(promises));
-        promise_for_pending_map.set_value(std::move(futures));
         map_fulfilled = true;
+        completions.reply_map.set_value();
     }
 
     /**
@@ -680,132 +954,116 @@ public:
      */
     void set_exception_for_caller_removed() {
         if(!map_fulfilled) {
-            promise_for_pending_map.set_exception(
+            completions.reply_map.set_exception(
                     std::make_exception_ptr(sender_removed_from_group_exception{}));
         } else {
-            if(reply_promises.size() == 0) {
-                reply_promises = std::move(reply_promises_are_ready.get());
-            }
             //Set exceptions for any nodes that have not yet responded
-            for(auto& node_and_promise : reply_promises) {
-                if(responded_nodes.find(node_and_promise.first)
-                   == responded_nodes.end()) {
-                    node_and_promise.second.set_exception(
-                            std::make_exception_ptr(sender_removed_from_group_exception{}));
+            for(std::size_t i = 0; i < completions.reply_nodes.size(); ++i) {
+                if(completions.replies[i]->set_exception(
+                           std::make_exception_ptr(sender_removed_from_group_exception{}))) {
+                    num_responded++;
                 }
             }
         }
     }
 
     /**
-     * Fulfills a promise for a single node's reply to indicate that the node
-     * will never reply, by putting a node_removed_from_group_exception in the
-     * promise. This happens if the node is removed in a View change while the
-     * RPC is still awaiting its reply.
+     * Fulfills the completion for a single node's reply to indicate that the
+     * node will never reply, by putting a node_removed_from_group_exception in
+     * it. This happens if the node is removed in a View change while the RPC
+     * is still awaiting its reply.
      */
     void set_exception_for_removed_node(const node_id_t& removed_nid) {
         assert(map_fulfilled);
-        if(dest_nodes.find(removed_nid) != dest_nodes.end()
-           && responded_nodes.find(removed_nid) == responded_nodes.end()) {
-            //Mark the node as "responded" for the purposes of the other methods
-            responded_nodes.insert(removed_nid);
-            set_exception(removed_nid,
-                          std::make_exception_ptr(
-                                  node_removed_from_group_exception{removed_nid}));
+        Completion<Ret>* reply = reply_for(removed_nid);
+        if(reply && reply->set_exception(std::make_exception_ptr(
+                            node_removed_from_group_exception{removed_nid}))) {
+            num_responded++;
         }
     }
 
     /**
-     * Fulfills a promise for a single node's reply by setting the value that
-     * the node returned for the RPC call
+     * Fulfills the completion for a single node's reply by setting the value
+     * that the node returned for the RPC call
      * @param nid The node that responded to the RPC call
      * @param v The value that it returned as the result of the RPC function
      */
-    void set_value(const node_id_t& nid, const Ret& v) {
-        std::lock_guard<std::mutex> lock(reply_promises_are_ready_mutex);
-        responded_nodes.insert(nid);
-        if(reply_promises.size() == 0) {
-            dbg_default_trace("PendingResults<{}>::set_value about to wait on reply_promises_are_ready", typeid(Ret).name());
-            dbg_default_flush();
-            reply_promises = std::move(reply_promises_are_ready.get());
+    void set_value(const node_id_t& nid, Ret&& v) {
+        Completion<Ret>* reply = reply_for(nid);
+        if(reply && reply->set_value(std::move(v))) {
+            num_responded++;
+        } else {
+            dbg_default_warn("Ignoring a reply from node {} to an RPC call it has already been marked as responding to", nid);
         }
-        reply_promises.at(nid).set_value(v);
     }
 
     /**
-     * Fulfills a promise for a single node's reply by setting an exception that
-     * was thrown by the RPC function call.
+     * Fulfills the completion for a single node's reply by setting an
+     * exception that was thrown by the RPC function call.
      * @param nid The node that responded to the RPC call with an exception
      * @param e The exception_ptr that the RPC function call returned
      */
     void set_exception(const node_id_t& nid, const std::exception_ptr e) {
-        responded_nodes.insert(nid);
-        if(reply_promises.size() == 0) {
-            reply_promises = std::move(reply_promises_are_ready.get());
+        Completion<Ret>* reply = reply_for(nid);
+        if(reply && reply->set_exception(e)) {
+            num_responded++;
+        } else {
+            dbg_default_warn("Ignoring an exception from node {} for an RPC call it has already been marked as responding to", nid);
         }
-        reply_promises.at(nid).set_exception(e);
     }
 
     /**
      * @return True if all destination nodes for this RPC function call have
-     * responded, either by sending a reply or by being removed from the group
+     * responded, either by sending a reply or by being removed from the group.
+     * This is safe to call while replies are being received.
      */
     bool all_responded() const {
-        return map_fulfilled && (responded_nodes == dest_nodes);
+        return map_fulfilled && (num_responded == completions.reply_nodes.size());
     }
 
     /**
-     * Fulfills the promise for the persistent version number.
+     * Fulfills the completion for the persistent version number.
      * @param assigned_version The persistent version number that was assigned
      * to the update generated by this RPC function call
      */
     void set_persistent_version(persistent::version_t assigned_version, uint64_t assigned_timestamp) {
-        version_promise.set_value({assigned_version, assigned_timestamp});
+        completions.version.set_value(std::make_pair(assigned_version, assigned_timestamp));
     }
 
     /**
-     * Fulfills the local persistence promise, unblocking the future end. This
-     * should be called to signal client code that the update has finished
+     * Fulfills the local persistence completion, unblocking the QueryResults.
+     * This should be called to signal client code that the update has finished
      * persisting locally on this node.
      */
     void set_local_persistence() {
-        local_persistence_promise.set_value();
+        completions.local_persistence.set_value();
     }
 
     /**
-     * Fulfills the global persistence promise, unblocking the future end. This
-     * should be called to signal client code that the update has finished
+     * Fulfills the global persistence completion, unblocking the QueryResults.
+     * This should be called to signal client code that the update has finished
      * persisting on all replicas of this subgroup.
      */
     void set_global_persistence() {
-        global_persistence_promise.set_value();
+        completions.global_persistence.set_value();
     }
 
     /**
-     * Fulfills the signature verification promise, unblocking the future end.
-     * This should be called to signal client code that the update has been
-     * correctly signed on all replicas of this subgroup.
+     * Fulfills the signature verification completion, unblocking the
+     * QueryResults. This should be called to signal client code that the
+     * update has been correctly signed on all replicas of this subgroup.
      */
     void set_signature_verified() {
-        signature_verified_promise.set_value();
+        completions.signature_verified.set_value();
     }
 
     /**
      * reset this object.
      */
     void reset() {
-        promise_for_pending_map = std::promise<std::unique_ptr<futures_map<Ret>>>();
-        promise_for_reply_promises = std::promise<std::map<node_id_t, std::promise<Ret>>>();
-        reply_promises_are_ready = promise_for_reply_promises.get_future();
-        // reply_promises_are_ready_mutex
-        reply_promises.clear();
+        completions.reset();
         map_fulfilled = false;
-        dest_nodes.clear();
-        responded_nodes.clear();
-        version_promise = std::promise<std::pair<persistent::version_t, uint64_t>>();
-        local_persistence_promise = std::promise<void>();
-        global_persistence_promise = std::promise<void>();
-        signature_verified_promise = std::promise<void>();
+        num_responded = 0;
     }
 };
 
@@ -813,42 +1071,31 @@ public:
  * Specialization of PendingResults for void functions, which do not generate
  * replies. It still fulfills the "reply map" in its corresponding QueryResults<void>,
  * which is just a set of nodes to which the RPC message was delivered. It also
- * fulfills the local and global persistence promises, since void functions can still
- * cause new persistent versions to be generated.
+ * fulfills the local and global persistence completions, since void functions can
+ * still cause new persistent versions to be generated.
  */
 template <>
 class PendingResults<void> : public PendingBase {
 private:
-    std::promise<std::unique_ptr<std::set<node_id_t>>> promise_for_pending_map;
-    bool map_fulfilled = false;
-    std::promise<std::pair<persistent::version_t, uint64_t>> version_promise;
-    std::promise<void> local_persistence_promise;
-    std::promise<void> global_persistence_promise;
-    std::promise<void> signature_verified_promise;
+    CallCompletions<void> completions;
+    std::atomic<bool> map_fulfilled{false};
 
 public:
     QueryResults<void> get_future() {
-        return QueryResults<void>(promise_for_pending_map.get_future(),
-                                  version_promise.get_future(),
-                                  local_persistence_promise.get_future(),
-                                  global_persistence_promise.get_future(),
-                                  signature_verified_promise.get_future());
+        return QueryResults<void>(completions, this);
     }
 
     void fulfill_map(const node_list_t& sent_nodes) {
-        auto nodes_sent_set = std::make_unique<std::set<node_id_t>>();
-        for(const node_id_t& node : sent_nodes) {
-            nodes_sent_set->emplace(node);
-        }
-        promise_for_pending_map.set_value(std::move(nodes_sent_set));
+        completions.reply_nodes.assign(sent_nodes.begin(), sent_nodes.end());
         map_fulfilled = true;
+        completions.reply_map.set_value();
     }
 
     void set_exception_for_removed_node(const node_id_t&) {}
 
     void set_exception_for_caller_removed() {
         if(!map_fulfilled) {
-            promise_for_pending_map.set_exception(
+            completions.reply_map.set_exception(
                     std::make_exception_ptr(sender_removed_from_group_exception()));
         }
     }
@@ -858,48 +1105,152 @@ public:
     }
 
     /**
-     * Fulfills the promise for the persistent version number.
+     * Fulfills the completion for the persistent version number.
      * @param assigned_version The persistent version number that was assigned
      * to the update generated by this RPC function call
      */
     void set_persistent_version(persistent::version_t assigned_version, uint64_t assigned_timestamp) {
-        version_promise.set_value({assigned_version, assigned_timestamp});
+        completions.version.set_value(std::make_pair(assigned_version, assigned_timestamp));
     }
 
     /**
-     * Fulfills the local persistence promise, unblocking the future end. This
-     * should be called to signal client code that the update has finished
+     * Fulfills the local persistence completion, unblocking the QueryResults.
+     * This should be called to signal client code that the update has finished
      * persisting locally on this node.
      */
     void set_local_persistence() {
-        local_persistence_promise.set_value();
+        completions.local_persistence.set_value();
     }
 
     /**
-     * Fulfills the global persistence promise, unblocking the future end. This
-     * should be called to signal client code that the update has finished
+     * Fulfills the global persistence completion, unblocking the QueryResults.
+     * This should be called to signal client code that the update has finished
      * persisting on all replicas of this subgroup.
      */
     void set_global_persistence() {
-        global_persistence_promise.set_value();
+        completions.global_persistence.set_value();
     }
 
     /**
-     * Fulfills the signature verification promise, unblocking the future end.
-     * This should be called to signal client code that the update has been
-     * correctly signed on all replicas of this subgroup.
+     * Fulfills the signature verification completion, unblocking the
+     * QueryResults. This should be called to signal client code that the
+     * update has been correctly signed on all replicas of this subgroup.
      */
     void set_signature_verified() {
-        signature_verified_promise.set_value();
+        completions.signature_verified.set_value();
     }
 
     void reset() {
-        promise_for_pending_map = std::promise<std::unique_ptr<std::set<node_id_t>>>();
+        completions.reset();
         map_fulfilled = false;
-        version_promise = std::promise<std::pair<persistent::version_t, uint64_t>>();
-        local_persistence_promise = std::promise<void>();
-        global_persistence_promise = std::promise<void>();
-        signature_verified_promise = std::promise<void>();
+    }
+};
+
+/**
+ * A growable pool of the PendingResults for the RPC calls made through one
+ * RemoteInvoker. Slots are allocated a slab at a time, so they never move once
+ * allocated, and a slot is recycled once both the QueryResults returned to the
+ * caller and the RPCManager have released it. Each call is identified by an
+ * invocation ID that combines the index of its slot with the slot's
+ * generation, which is incremented every time the slot is recycled, so a reply
+ * that arrives after its slot was recycled is detected as stale.
+ *
+ * A pool must be created with new and disposed of with close() rather than
+ * deleted, since slots that are still held when the RemoteInvoker is destroyed
+ * keep the pool alive until they are released.
+ * @tparam Ret The return type of the RPC function
+ */
+template <typename Ret>
+class ReplySlotPool : public PendingSlotPool {
+private:
+    static constexpr uint32_t SLAB_SIZE = 64;
+    struct Slot {
+        PendingResults<Ret> pending;
+        uint32_t generation = 0;
+    };
+    /** Guards everything below; never held while a PendingResults is in use */
+    std::mutex pool_mutex;
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    std::vector<uint32_t> free_slots;
+    uint32_t num_held_slots = 0;
+    bool closed = false;
+
+    ~ReplySlotPool() = default;
+
+    Slot& slot_at(uint32_t index) {
+        return slabs[index / SLAB_SIZE][index % SLAB_SIZE];
+    }
+
+public:
+    /**
+     * Hands out a free slot, growing the pool by a slab if there is none. The
+     * slot is reset and starts out with two holders: the QueryResults created
+     * from it by get_future(), and the RPCManager that the caller passes it to.
+     * @return The invocation ID of the new RPC call and its PendingResults
+     */
+    std::pair<uint64_t, PendingResults<Ret>&> allocate() {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        if(free_slots.empty()) {
+            const uint32_t first_index = slabs.size() * SLAB_SIZE;
+            slabs.emplace_back(std::make_unique<Slot[]>(SLAB_SIZE));
+            for(uint32_t index = first_index + SLAB_SIZE; index > first_index; --index) {
+                slot_at(index - 1).pending.set_pool(this, index - 1);
+                free_slots.push_back(index - 1);
+            }
+        }
+        const uint32_t index = free_slots.back();
+        free_slots.pop_back();
+        num_held_slots++;
+        Slot& slot = slot_at(index);
+        const uint64_t invocation_id = (static_cast<uint64_t>(slot.generation) << 32) | index;
+        lock.unlock();
+        slot.pending.reset();
+        slot.pending.set_holders(2);
+        return {invocation_id, slot.pending};
+    }
+
+    /**
+     * Finds the PendingResults for an invocation ID and adds a holder to it,
+     * which the caller must release when it is done.
+     * @return The PendingResults, or nullptr if the invocation ID is stale
+     * (i.e. its slot has been released or recycled since the call was made)
+     */
+    PendingResults<Ret>* hold(uint64_t invocation_id) {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        const uint32_t index = static_cast<uint32_t>(invocation_id);
+        const uint32_t generation = static_cast<uint32_t>(invocation_id >> 32);
+        if(index >= slabs.size() * SLAB_SIZE) {
+            return nullptr;
+        }
+        Slot& slot = slot_at(index);
+        if(slot.generation != generation || !slot.pending.try_hold()) {
+            return nullptr;
+        }
+        return &slot.pending;
+    }
+
+    void recycle(uint32_t slot_index) {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        slot_at(slot_index).generation++;
+        free_slots.push_back(slot_index);
+        num_held_slots--;
+        if(closed && num_held_slots == 0) {
+            lock.unlock();
+            delete this;
+        }
+    }
+
+    /**
+     * Disposes of the pool: it is deleted immediately if none of its slots
+     * are held, or else when the last one is released.
+     */
+    void close() {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        closed = true;
+        if(num_held_slots == 0) {
+            lock.unlock();
+            delete this;
+        }
     }
 };
 
@@ -916,7 +1267,9 @@ namespace remote_invocation_utilities {
 
 // add new rpc header flags here.
 #define _RPC_HEADER_FLAG_CASCADE (0)
-#define _RPC_HEADER_FLAG_RESERVED (1)
+// set on each RPC message packed into a batched ordered_send multicast
+#define _RPC_HEADER_FLAG_BATCHED (1)
+#define _RPC_HEADER_FLAG_RESERVED (2)
 
 inline std::size_t header_space() {
     return sizeof(std::size_t) + sizeof(Opcode) + sizeof(node_id_t) + sizeof(uint32_t);
@@ -957,8 +1310,77 @@ inline void retrieve_header(mutils::RemoteDeserialization_v* rdv,
     offset += sizeof(from);
     flags = reinterpret_cast<const uint32_t*>(reply_buf + offset)[0];
 }
+
+/**
+ * @return The offset at which the next call of an ordered_send batch starts,
+ * given the end of the previous one, so that every header in the batch is
+ * aligned
+ */
+inline std::size_t align_batched_call(std::size_t offset) {
+    constexpr std::size_t alignment = std::max(alignof(std::size_t), alignof(Opcode));
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Marks an RPC message as one of the calls packed into a batched
+ * ordered_send multicast, so the receivers look for the calls after it.
+ */
+inline void mark_batched_call(char* call_buf) {
+    std::size_t payload_size;
+    Opcode indx;
+    node_id_t received_from;
+    uint32_t flags;
+    retrieve_header(nullptr, call_buf, payload_size, indx, received_from, flags);
+    RPC_HEADER_FLAG_SET(flags, BATCHED);
+    populate_header(call_buf, payload_size, indx, received_from, flags);
+}
+
+/**
+ * Calls a function on each RPC call in a multicast message: the whole
+ * message, or, if it is a batch, each of the calls packed into it in order,
+ * at the offsets given by align_batched_call.
+ * @param msg_buf The multicast message, which starts with an RPC header
+ * @param msg_size The size of the multicast message
+ * @param call_function A function taking a pointer to the header of a call
+ * and the size of the call, including its header
+ */
+template <typename CallFunction>
+void for_each_ordered_call(char* msg_buf, std::size_t msg_size, const CallFunction& call_function) {
+    std::size_t payload_size;
+    Opcode indx;
+    node_id_t received_from;
+    uint32_t flags;
+    retrieve_header(nullptr, msg_buf, payload_size, indx, received_from, flags);
+    if(!RPC_HEADER_FLAG_TST(flags, BATCHED)) {
+        call_function(msg_buf, msg_size);
+        return;
+    }
+    //A batch holds several calls back to back, which are delivered in order with the same version
+    std::size_t offset = 0;
+    while(offset + header_space() <= msg_size) {
+        retrieve_header(nullptr, msg_buf + offset, payload_size, indx, received_from, flags);
+        const std::size_t call_size = header_space() + payload_size;
+        call_function(msg_buf + offset, call_size);
+        offset = align_batched_call(offset + call_size);
+    }
+}
 }  // namespace remote_invocation_utilities
 
+/**
+ * Removes the entries for every version up to the given one from a map of
+ * results awaiting a persistence event, and passes each one to a function,
+ * in version order. The calls of a batch share a version, and are passed in
+ * the order they were added.
+ */
+template <typename Results, typename EntryFunction>
+void take_results_up_to_version(std::multimap<persistent::version_t, Results>& results,
+                                persistent::version_t version, const EntryFunction& entry_function) {
+    for(auto results_iter = results.begin(); results_iter != results.end() && results_iter->first <= version;) {
+        entry_function(*results_iter);
+        results_iter = results.erase(results_iter);
+    }
+}
+
 }  // namespace rpc
 }  // namespace derecho
 
@@ -0,0 +1,112 @@
+/**
+ * @file state_transfer.hpp
+ *
+ * Transfers the state of Replicated Objects to the members that need it
+ * during a view change or a total restart.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "../derecho_type_definitions.hpp"
+#include "connection_manager.hpp"
+#include "derecho_internal.hpp"
+#include "locked_reference.hpp"
+#include "replicated_interface.hpp"
+
+namespace derecho {
+
+/**
+ * Runs the object transfers of one view change (or one attempt at a total
+ * restart) in parallel. All transfers between two nodes share the TCP socket
+ * between them. Each node has one thread reading and one thread writing each
+ * socket, so different nodes are served at the same time.
+ *
+ * A receiver first sends a request that carries its persistent log tail. The
+ * sender then streams the object in chunks. Nothing is serialized ahead of
+ * time, and no complete copy is buffered on the sending side. Each socket is
+ * always being read, so a node can send objects to another node and receive
+ * objects from it without either node waiting on the other.
+ *
+ * A node adds its sends as soon as it knows them. It adds its receives once
+ * the objects that will receive the state have been constructed. finish()
+ * then waits for all the transfers. A StateTransfer holds all the sockets of
+ * its tcp_connections, so no other thread can use them until it is destroyed.
+ */
+class StateTransfer {
+    struct Shared;
+    struct Session;
+
+    LockedReference<std::unique_lock<std::mutex>, std::map<node_id_t, tcp::socket>> sockets;
+    const std::size_t chunk_size;
+    const uint32_t progress_interval_ms;
+    std::shared_ptr<Shared> shared;
+    /** The transfer session with each node, by node ID. Protected by shared->mutex. */
+    std::map<node_id_t, std::shared_ptr<Session>> sessions;
+
+    /** Starts the session with a node if there isn't one yet. Call with shared->mutex held. */
+    Session& session_with(node_id_t node_id);
+    /** Throws if a node has failed. Call with shared->mutex held. */
+    void check_failure() const;
+    void log_progress() const;
+
+    static void run_reader(std::shared_ptr<Session> session);
+    static void run_writer(std::shared_ptr<Session> session);
+
+public:
+    /**
+     * @param tcp_sockets The TCP connections to the other members, which are
+     * locked until this StateTransfer is destroyed
+     * @param chunk_size The number of bytes of object state to send or
+     * receive with each socket operation
+     * @param progress_interval_ms How often finish() logs the progress of
+     * the transfers, in milliseconds
+     */
+    StateTransfer(tcp::tcp_connections& tcp_sockets, std::size_t chunk_size, uint32_t progress_interval_ms);
+    /**
+     * Stops and joins any transfer threads that finish() did not join, which
+     * only happens if a node failed or finish() was never called. The
+     * sockets of the unfinished sessions are shut down to unblock them, so
+     * they can't be used for anything else afterwards.
+     */
+    ~StateTransfer();
+    StateTransfer(const StateTransfer&) = delete;
+    StateTransfer& operator=(const StateTransfer&) = delete;
+
+    /**
+     * Adds an object to send to a node. The object is sent after the node
+     * requests it. It must stay alive and unchanged until finish() returns,
+     * even if this node is leaving the object's shard.
+     * @param subgroup_id The subgroup of the object
+     * @param receiver_id The ID of the node that receives the object
+     * @param object The object whose state should be sent
+     */
+    void add_send(subgroup_id_t subgroup_id, node_id_t receiver_id, ReplicatedObject* object);
+
+    /**
+     * Requests the state of an object from a node, sending the object's
+     * persistent log tail if it has one. The object is replaced with the
+     * received state.
+     * @param subgroup_id The subgroup of the object
+     * @param sender_id The ID of the node that will send the state
+     * @param object The object that receives the state
+     */
+    void add_receive(subgroup_id_t subgroup_id, node_id_t sender_id, ReplicatedObject* object);
+
+    /**
+     * Tells every node that this node has no more requests, then blocks
+     * until all transfers have finished. Progress is logged periodically
+     * while it waits.
+     * @throw derecho_exception if a node fails during state transfer
+     */
+    void finish();
+};
+
+}  // namespace derecho
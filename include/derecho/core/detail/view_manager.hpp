@@ -5,10 +5,12 @@
  */
 #pragma once
 
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <shared_mutex>
 #include <string>
 #include <thread>
@@ -23,6 +25,7 @@
 #include "replicated_interface.hpp"
 #include "restart_state.hpp"
 #include "rpc_manager.hpp"
+#include "state_transfer.hpp"
 #include <derecho/conf/conf.hpp>
 
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
@@ -129,6 +132,15 @@ private:
     /** Notified when curr_view changes (i.e. we are finished with a pending view change).*/
     std::condition_variable_any view_change_cv;
 
+    /** Protects send_ready_callbacks and send_blocked_subgroups. */
+    std::mutex send_ready_mutex;
+    /** Functions registered with set_send_ready_callback, indexed by subgroup ID. */
+    std::map<subgroup_id_t, std::function<void()>> send_ready_callbacks;
+    /** The subgroups in which a try_send has failed since their last send-ready notification. */
+    std::set<subgroup_id_t> send_blocked_subgroups;
+    /** True if send_blocked_subgroups may be non-empty; lets the SST predicate thread skip the mutex. */
+    std::atomic<bool> send_blocked{false};
+
     /** The current View, containing the state of the managed group.
      *  Must be a pointer so we can re-assign it, but will never be null.*/
     std::unique_ptr<View> curr_view;
@@ -192,6 +204,9 @@ private:
      * to the transfer port of the corresponding member.
      */
     tcp::tcp_connections tcp_sockets;
+    /** The object transfers of the current view change or restart attempt,
+     * from the first send until transfer_objects() finishes them. */
+    std::unique_ptr<StateTransfer> state_transfer;
 
     /**
      * The socket that made the initial connection to the restart leader, if this
@@ -373,10 +388,11 @@ private:
 
     /** Helper method for completing view changes; determines whether this node
      * needs to send Replicated Object state to each node that just joined, and then
-     * sends the state if necessary. */
+     * starts sending the state if necessary. */
     void send_objects_to_new_members(const vector_int64_2d& old_shard_leaders);
 
-    /** Sends a single subgroup's replicated object to a new member after a view change. */
+    /** Starts sending a single subgroup's replicated object to a new member after a
+     * view change or during total restart. The send completes in transfer_objects(). */
     void send_subgroup_object(subgroup_id_t subgroup_id, node_id_t new_node_id);
 
     /** Sends a joining node the new view that has been constructed to include it.*/
@@ -549,6 +565,12 @@ private:
                                    const uint32_t slot_size,
                                    const uint32_t index_field_size);
 
+    /**
+     * Calls the send-ready callback of a subgroup if a try_send to it has
+     * failed since the last time the callback was called.
+     */
+    void notify_send_ready(subgroup_id_t subgroup_num);
+
     /**
      * Sets up the SST and MulticastGroup for a new view, based on the settings in the current view,
      * and copies over the SST data from the current view.
@@ -619,6 +641,23 @@ private:
      */
     static vector_int64_2d old_shard_leaders_by_new_ids(const View& curr_view, const View& next_view);
 
+    /**
+     * Chooses the node that sends a shard's Replicated Object state to a
+     * member that just joined the shard. New members are spread across the
+     * shard members that were already in the shard in the previous view, so
+     * the shard leader does not send every copy. If there are no such members,
+     * the shard leader of the previous view is the sender.
+     * @param view The view that the new member joined the shard in
+     * @param subgroup_id The subgroup ID of the shard in that view
+     * @param shard_num The shard number
+     * @param new_member The ID of the member that joined the shard
+     * @param old_shard_leader The leader of the shard in the previous view
+     * @return The ID of the node that should send the state to new_member
+     */
+    static node_id_t choose_state_transfer_sender(const View& view, subgroup_id_t subgroup_id,
+                                                  uint32_t shard_num, node_id_t new_member,
+                                                  node_id_t old_shard_leader);
+
     /**
      * A little convenience method that receives a 2-dimensional vector using
      * our standard network protocol, which first sends the buffer size and then
@@ -786,12 +825,15 @@ public:
     const vector_int64_2d& get_old_shard_leaders() const { return prior_view_shard_leaders; }
 
     /**
-     * Gets a locked reference to the TCP socket connected to a particular node
-     * for the purposes of doing state transfer. This is needed by Group to
-     * complete state transfer during Replicated Object construction, and just
-     * forwards the same call through to ViewManager's tcp_connections.
+     * Receives Replicated Object state for each of the given subgroups from
+     * the given node, and finishes any sends this node started, all in
+     * parallel. This is needed by Group to complete state transfer after
+     * Replicated Object construction.
+     * @param subgroups_and_senders Pairs of (subgroup ID, node ID of the node
+     * that sends that subgroup's state)
+     * @throw derecho_exception if a node fails during state transfer
      */
-    LockedReference<std::unique_lock<std::mutex>, tcp::socket> get_transfer_socket(node_id_t member_id);
+    void transfer_objects(const std::set<std::pair<subgroup_id_t, node_id_t>>& subgroups_and_senders);
 
     /** Causes this node to cleanly leave the group by setting itself to "failed." */
     void leave();
@@ -833,11 +875,45 @@ public:
      * Instructs the managed MulticastGroup to send a message. This returns
      * immediately if sending through RDMC; the send is scheduled to happen
      * some time in the future. If sending through SST, the RDMA write is
-     * issued in this call.
+     * issued in this call. Waits for room in the send window, and through
+     * view changes, as long as this node is a member of the subgroup.
+     * @return true if the message was sent, false if this node is not a
+     * member of the subgroup in the current view
      */
-    void send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+    bool send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
               const std::function<void(char* buf)>& msg_generator, bool cooked_send = false);
 
+    /**
+     * Instructs the managed MulticastGroup to send a message, unless that
+     * would block: if the subgroup's send window is full, or a view change is
+     * in progress, this returns false without sending, and the subgroup's
+     * send-ready callback (if any) will be called once a send may succeed.
+     * It also returns false if this node is not a member of the subgroup.
+     * @return true if the message was sent, false if it would have blocked
+     */
+    bool try_send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                  const std::function<void(char* buf)>& msg_generator, bool cooked_send = false);
+
+    /**
+     * @return true if this node is a member of the given subgroup in the
+     * current view. Used by RPCManager to tell a failed try_send to a
+     * subgroup this node has left from one to a full send window.
+     */
+    bool is_subgroup_member(subgroup_id_t subgroup_num);
+
+    /**
+     * Registers a function that will be called when a try_send to the given
+     * subgroup has failed and the subgroup's send window may have reopened,
+     * either because some of this node's messages were delivered or because
+     * a new view was installed. It is called at most once per failed
+     * try_send, from the SST predicate thread or the view change thread, so
+     * it must not block or send; it should just wake up the sending thread.
+     * Notifications may be spurious, so the next try_send can still fail.
+     * @param subgroup_num The subgroup to watch
+     * @param callback The function to call, or an empty function to remove it
+     */
+    void set_send_ready_callback(subgroup_id_t subgroup_num, std::function<void()> callback);
+
     const uint64_t compute_global_stability_frontier(subgroup_id_t subgroup_num);
 
     /**
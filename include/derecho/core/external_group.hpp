@@ -45,6 +45,8 @@ private:
     std::unique_ptr<sst::P2PConnectionManager> p2p_connections;
     std::unique_ptr<std::map<rpc::Opcode, rpc::receive_fun_t>> receivers;
     std::map<subgroup_id_t, std::list<rpc::PendingBase_ref>> fulfilled_pending_results;
+    /** The size each list in fulfilled_pending_results must reach before finish_p2p_send sweeps it again */
+    std::map<subgroup_id_t, std::size_t> fulfilled_results_sweep_size;
     std::map<subgroup_id_t, uint64_t> max_payload_sizes;
 
     template <typename T>
@@ -58,7 +60,7 @@ private:
      */
     bool get_view(const node_id_t nid);
     void clean_up();
-    volatile char* get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type);
+    volatile char* get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type, std::size_t size);
     void finish_p2p_send(node_id_t dest_id, subgroup_id_t dest_subgroup_id, rpc::PendingBase& pending_results_handle);
     uint32_t get_index_of_type(const std::type_info& ti) const;
 
@@ -72,6 +74,8 @@ private:
         node_id_t sender_id;
         char* msg_buf;
         uint32_t buffer_size;
+        /** The buffer msg_buf points to, if the request was reassembled from chunks */
+        std::unique_ptr<char[]> msg_copy;
         p2p_req() : sender_id(0),
                     msg_buf(nullptr) {}
         p2p_req(node_id_t _sender_id,
@@ -84,7 +88,7 @@ private:
     mutils::RemoteDeserialization_v rdv;
     void p2p_receive_loop();
     void p2p_request_worker();
-    void p2p_message_handler(node_id_t sender_id, char* msg_buf);
+    void p2p_message_handler(node_id_t sender_id, char* msg_buf, std::unique_ptr<char[]> owned_buf);
     std::exception_ptr receive_message(const rpc::Opcode& indx, const node_id_t& received_from,
                                        char const* const buf, std::size_t payload_size,
                                        const std::function<char*(int)>& out_alloc);
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
@@ -191,13 +192,29 @@ private:
      * removed from the subgroup.
      */
     std::map<subgroup_id_t, ReplicatedObject*> objects_by_subgroup_id;
+    /**
+     * The Replicated<T>s this node stopped replicating in the current view
+     * change, each owned through the map node extracted from
+     * replicated_objects so that it stays at the same address. They are kept
+     * until the view change's state transfer has finished, since this node
+     * may still be sending their state to the new members of their shards.
+     */
+    std::vector<std::shared_ptr<void>> retired_objects;
+
+    /**
+     * Removes a Replicated<T> that this node no longer replicates from
+     * replicated_objects and objects_by_subgroup_id. Its RPC functions are
+     * unregistered right away, but its state is moved to retired_objects.
+     */
+    template <typename T>
+    void retire_object(typename replicated_index_map<T>::iterator object);
 
     /**
      * Updates the state of the replicated objects that correspond to subgroups
      * identified in the provided map, by receiving serialized state from the
-     * shard leader whose ID is paired with that subgroup ID.
-     * @param subgroups_and_leaders Pairs of (subgroup ID, leader's node ID) for
-     * subgroups that need to have their state initialized from the leader.
+     * shard member whose ID is paired with that subgroup ID.
+     * @param subgroups_and_leaders Pairs of (subgroup ID, sender's node ID) for
+     * subgroups that need to have their state initialized from another member.
      */
     void receive_objects(const std::set<std::pair<subgroup_id_t, node_id_t>>& subgroups_and_leaders);
 
@@ -4,12 +4,16 @@
 
 #define make_p2p_tagger_expr(x) derecho::rpc::tag_p2p<derecho::rpc::hash_cstr(#x)>(&classname::x)
 #define make_ordered_tagger_expr(x) derecho::rpc::tag_ordered<derecho::rpc::hash_cstr(#x)>(&classname::x)
+#define make_concurrent_p2p_tagger_expr(x) derecho::rpc::tag_p2p_concurrent<derecho::rpc::hash_cstr(#x)>(&classname::x)
 #define applyp2p_(x) make_p2p_tagger_expr(x),
 #define applyp2p(...) EVAL(MAP(applyp2p_, __VA_ARGS__))
 
 #define applyordered_(x) make_ordered_tagger_expr(x),
 #define applyordered(...) EVAL(MAP(applyordered_, __VA_ARGS__))
 
+#define applyconcurrentp2p_(x) make_concurrent_p2p_tagger_expr(x),
+#define applyconcurrentp2p(...) EVAL(MAP(applyconcurrentp2p_, __VA_ARGS__))
+
 /**
  * This macro automatically generates a register_functions() method for a Derecho
  * Replicated Object. Example usage for a class Thing with methods foo() and bar():
@@ -23,7 +27,9 @@
  * names of each class method that should be callable by an ordered send, or an
  * invocation of the P2P_TARGETS macro containing the names of each class method
  * that should be callable by a P2P send.
- * @param arg2 Either ORDERED_TARGETS or P2P_TARGETS, just like arg1
+ * @param arg2 Either ORDERED_TARGETS or P2P_TARGETS, just like arg1. A third
+ * argument, CONCURRENT_P2P_TARGETS, can list additional P2P-callable methods
+ * that are safe to run concurrently.
  */
 #define REGISTER_RPC_FUNCTIONS(name, arg1, arg2...)                                                                                                  \
     static auto register_functions() {                                                                                                               \
@@ -51,6 +57,21 @@
             applyp2p(args))(/* Do nothing */) \
             make_p2p_tagger_expr(arg1)
 
+/**
+ * This macro is one of the possible arguments to REGISTER_RPC_FUNCTIONS; its
+ * parameters should be a list of method names that should be tagged as
+ * P2P-callable RPC functions that are safe to run concurrently with other P2P
+ * requests, so that RPCManager does not need to run the requests for them in
+ * the order they were sent. It is used in addition to P2P_TARGETS, e.g.:
+ *
+ * REGISTER_RPC_FUNCTIONS(Thing, ORDERED_TARGETS(foo), P2P_TARGETS(bar), CONCURRENT_P2P_TARGETS(baz))
+ */
+#define CONCURRENT_P2P_TARGETS(arg1, args...)           \
+    IF_ELSE(HAS_ARGS(args))                            \
+    (                                                  \
+            applyconcurrentp2p(args))(/* Do nothing */) \
+            make_concurrent_p2p_tagger_expr(arg1)
+
 /**
  * This macro is one of the possible arugments to REGISTER_RPC_FUNCTIONS; its
  * parameters should be a list of method names that should be tagged as RPC
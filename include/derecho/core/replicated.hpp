@@ -8,6 +8,7 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <tuple>
 #include <type_traits>
 
@@ -129,6 +130,15 @@ private:
     /** The timestamp associated with the current version number */
     uint64_t current_timestamp_us = 0;
 
+    /**
+     * The implementation of ordered_send and try_ordered_send.
+     * @param blocking Whether to wait for room in the subgroup's send window
+     * @return An std::optional<rpc::QueryResults<Ret>> that is empty only if
+     * blocking was false and the call was not sent
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    auto ordered_send_impl(bool blocking, Args&&... args);
+
 public:
     /**
      * Constructs a Replicated<T> that enables sending and receiving RPC
@@ -176,6 +186,14 @@ public:
     Replicated(const Replicated&) = delete;
     virtual ~Replicated();
 
+    /**
+     * Unregisters this object's RPC functions and fails its outstanding RPC
+     * calls, as destroying it would, but keeps its state, which can still be
+     * sent to new members of its shard. Used when this node leaves the shard;
+     * the object can no longer send or receive RPC calls afterwards.
+     */
+    void retire();
+
     /**
      * @return The value of has_persistent_fields<T> for this Replicated<T>'s
      * template parameter. This is true if any field of the user object T is
@@ -235,7 +253,10 @@ public:
      * Sends a multicast to the entire subgroup that replicates this Replicated<T>,
      * invoking the RPC function identified by the FunctionTag template parameter.
      * The caller must keep the returned QueryResults object in scope in order to
-     * receive replies.
+     * receive replies. If DERECHO/ordered_send_batch_size is more than 1, the
+     * call may be packed into one multicast message with other ordered_send
+     * calls to this subgroup, which is sent once it is full or its delay has
+     * expired, and shares its version number with them.
      * @param args The arguments to the RPC function
      * @return An instance of rpc::QueryResults<Ret>, where Ret is the return type
      * of the RPC function being invoked.
@@ -243,10 +264,37 @@ public:
     template <rpc::FunctionTag tag, typename... Args>
     auto ordered_send(Args&&... args);
 
+    /**
+     * Like ordered_send, but never waits for room in the subgroup's send
+     * window: if the multicast can't be sent right away (or, with batching,
+     * the call can't be added to the current batch), the call is not sent and
+     * this returns an empty optional. Once the window may have reopened, the
+     * function registered with set_send_ready_callback is called, after which
+     * the caller can try again.
+     * @param args The arguments to the RPC function
+     * @return An std::optional containing an instance of rpc::QueryResults<Ret>
+     * if the call was sent, or empty if sending it would have blocked
+     */
+    template <rpc::FunctionTag tag, typename... Args>
+    auto try_ordered_send(Args&&... args);
+
+    /**
+     * Registers a function to call when a try_ordered_send to this subgroup
+     * has failed and its send window may have reopened. The function runs on
+     * one of Derecho's internal threads, so it must return quickly and must
+     * not send; writing to an eventfd or notifying a condition variable that
+     * the sending thread waits on is the intended use. Notifications may be
+     * spurious, so the next try_ordered_send can still fail.
+     * @param callback The function to call, or an empty function to remove it
+     */
+    void set_send_ready_callback(std::function<void()> callback);
+
     /**
      * Submits a call to send a "raw" (byte array) message in a multicast to
      * this object's subgroup; the message will be generated by invoking msg_generator
      * inside this function.
+     * @throws sender_removed_from_group_exception if a view change removed
+     * this node from the subgroup before the message could be sent
      */
     void send(unsigned long long int payload_size, const std::function<void(char* buf)>& msg_generator);
 
@@ -275,6 +323,14 @@ public:
      */
     void send_object_raw(tcp::socket& receiver_socket) const;
 
+    /**
+     * Serializes the state of the "wrapped" object (of type T) for this
+     * Replicated<T>, passing the serialized bytes to a write function as they
+     * are produced instead of copying them into one buffer.
+     * @param write_func A function that writes a range of bytes somewhere
+     */
+    void post_object(const std::function<void(char const* const, std::size_t)>& write_func) const;
+
     /**
      * Updates the state of the "wrapped" object by replacing it with the object
      * serialized in a buffer. Returns the number of bytes read from the buffer,
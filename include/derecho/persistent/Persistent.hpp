@@ -6,9 +6,11 @@
 #include "PersistException.hpp"
 #include "PersistNoLog.hpp"
 #include "PersistentInterface.hpp"
+#include "detail/DeltaStateCache.hpp"
 #include "detail/FilePersistLog.hpp"
 #include "detail/PersistLog.hpp"
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
+#include <atomic>
 #include <functional>
 #include <inttypes.h>
 #include <iostream>
@@ -275,6 +277,12 @@ protected:
      */
     std::map<std::size_t, PersistentObject*> m_registry;
 
+    /**
+     * If true, persist() flushes all the Persistent fields as one group,
+     * see CONF_PERS_GROUP_COMMIT.
+     */
+    const bool m_bGroupCommit;
+
     /**
      * The last (most recent) signature to be added to a persistent log entry.
      * This is cached in memory since it is needed for the next call to sign()
@@ -303,7 +311,10 @@ protected:
 // of a byte array - the DELTA, as long as the update should be persisted. Each
 // time Persistent<T> trying to make a version, it collects the DELTA and write
 // it to the log. On reloading data from persistent storage, the DELTAs in the
-// log entries are applied in order. TODO: use checkpointing to accelerate it!
+// log entries are applied in order. To avoid replaying the whole log for a
+// historical state, Persistent<T> periodically saves checkpoints of T (see
+// CONF_PERS_DELTA_CHECKPOINT_INTERVAL and CONF_PERS_DELTA_CHECKPOINT_BYTES) and
+// can cache recently reconstructed states (see CONF_PERS_DELTA_CACHE_SIZE).
 //
 // There are three method included in this interface:
 // - 'finalizeCurrentDelta'     This method is called when Persistent<T> trying to
@@ -386,6 +397,34 @@ protected:
     inline void initialize_object_from_log(const std::function<std::unique_ptr<ObjectType>(void)>& object_factory,
                                            mutils::DeserializationManager* dm);
 
+    /** initialize the checkpoint settings and the state cache for IDeltaSupport objects, and resume the checkpoint
+     *  schedule from the entries already in the log. Call after the log is loaded.
+     */
+    inline void initialize_delta_checkpoint();
+
+    /** schedule a checkpoint at version ver if the configured interval is reached. The checkpoint is saved later by
+     *  save_pending_checkpoint(), off the delivery path.
+     *  @param ver          The version whose delta has just been logged
+     *  @param delta_size   The size of the delta at ver
+     */
+    inline void checkpoint_delta_object(version_t ver, std::size_t delta_size);
+
+    /** save the scheduled checkpoint, if its version has been persisted. Called on the persistence thread. The state
+     *  is reconstructed from the log, replaying only the deltas since the previous checkpoint.
+     */
+    inline void save_pending_checkpoint();
+
+    /** reconstruct the state at a log index of an IDeltaSupport object, replaying the deltas from the nearest cached
+     *  state or checkpoint.
+     *  @param idx          The log index
+     *  @param dm           The deserialization manager
+     *  @param cache_state  If true, the reconstructed state is put in the state cache. Checkpointing passes false, so
+     *                      that it does not evict the states cached for readers.
+     *  @return The reconstructed state
+     */
+    inline std::unique_ptr<ObjectType> reconstruct_delta_state(int64_t idx, mutils::DeserializationManager* dm,
+                                                               bool cache_state) const;
+
 public:
     /**
      * Persistent(std::unqieu_ptr<ObjectType>&,const char*,PersistentRegistry*,mutils::DeserializationManager)
@@ -502,8 +541,8 @@ public:
      * (const ObjectType&). Please note that due to zero copy design, this object may not be accessible anymore after
      * it returns.
      *
-     * A note for ObjectType implementing IDeltaSupport<> interface: a history state will be reconstructed from the very
-     * first log entry, making it extremely inefficient. @TODO: use cached checkpoint to accelerate it.
+     * A note for ObjectType implementing IDeltaSupport<> interface: a history state will be reconstructed by replaying
+     * the deltas from the nearest cached state or checkpoint, or from the very first log entry if there is none.
      *
      * @param idx   index
      * @param fun   the user function to process a const ObjectType& object
@@ -524,7 +563,7 @@ public:
      *
      * Get a version of value T by log index. Returns a copy of the object.
      *
-     * @TODO: see getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
+     * See getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
      *
      * @param idx   index
      * @param dm    the deserialization manager
@@ -544,7 +583,7 @@ public:
      * (const ObjectType&). Please note that due to zero copy design, this object may not be accessible anymore after
      * it returns.
      *
-     * @TODO: see getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
+     * See getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
      *
      * @param ver   if 'ver', the specified version, matches a log entry, the state corresponding to that entry will be
      *              send to 'fun'; if 'ver' does not match a log entry, the latest state before 'ver' will be applied to
@@ -567,7 +606,7 @@ public:
      *
      * Get a version of value T. specified version.
      *
-     * @TODO: see getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
+     * See getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
      *
      * @param ver   if 'ver', the specified version, matches a log entry, the state corresponding to that entry will be
      *              send to 'fun'; if 'ver' does not match a log entry, the latest state before 'ver' will be applied to
@@ -705,7 +744,7 @@ public:
      * Get a version of ObjectType, specified by HLC clock. the user function will be fed with an object of type 'const
      * ObjectType&'. Due to the zero-copy design, this object might not be accessible after get() returns.
      *
-     * @TODO: see getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
+     * See getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
      *
      * @tparam Func         User-specified function type, which is usually deduced.
      *
@@ -728,7 +767,7 @@ public:
      *
      * Get a version of ObjectType, specified by HLC clock. A copy of ObjectType object will be returned.
      *
-     * @TODO: see getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
+     * See getByIndex(int64_t,const Func&,mutils::DeserializationManager*) for more on the performance.
      *
      * @param hlc   the HLC timestamp
      * @param dm    the deserialization manager
@@ -882,6 +921,15 @@ public:
      */
     virtual void persist(version_t latest_version);
 
+    /**
+     * Group commit support, see PersistentObject. These forward to the
+     * two-phase persist API of the log.
+     */
+    virtual bool beginPersist(version_t latest_version);
+    virtual void syncPersist();
+    virtual void commitPersist(GroupMetaCommit& meta_commit);
+    virtual void abortPersist();
+
     /**
      * Update the provided Signer with the state of T at the specified version.
      * This should not finalize the Signer, since other Persistent fields in
@@ -946,6 +994,18 @@ protected:
     std::unique_ptr<PersistLog> m_pLog;
     // Persistence Registry
     PersistentRegistry* m_pRegistry;
+    // Checkpoint every this many versions, 0 for never (IDeltaSupport only)
+    uint64_t m_iDeltaCheckpointInterval = 0;
+    // Checkpoint every this many bytes of deltas, 0 for never (IDeltaSupport only)
+    uint64_t m_iDeltaCheckpointBytes = 0;
+    // Versions logged since the last checkpoint
+    uint64_t m_iVersionsSinceCheckpoint = 0;
+    // Bytes of deltas logged since the last checkpoint
+    uint64_t m_iBytesSinceCheckpoint = 0;
+    // The version of the checkpoint to be saved by the persistence thread, INVALID_VERSION for none
+    std::atomic<version_t> m_iPendingCheckpointVersion{INVALID_VERSION};
+    // Recently reconstructed states (IDeltaSupport only)
+    std::unique_ptr<DeltaStateCache> m_pDeltaStateCache;
     // get the static name maker.
     static _NameMaker<ObjectType, storageType>& getNameMaker(const std::string& prefix = std::string(""));
 
@@ -9,6 +9,8 @@ namespace persistent {
 
 using version_t = int64_t;
 
+class GroupMetaCommit;
+
 /**
  * This interface represents the API of a Persistent Object, and is inherited
  * by all versions of the Persistent<T> template. It can be used to call
@@ -68,6 +70,33 @@ public:
      * @param version The highest version number to persist
      */
     virtual void persist(version_t version) = 0;
+    /**
+     * Group commit, step 1: starts writing back the versions up to the
+     * provided version without waiting for them to become durable. Objects
+     * that do not support group commit simply persist here.
+     * @param version The highest version number to persist
+     * @return True if the object must be finished with syncPersist() and
+     * commitPersist(), or released with abortPersist()
+     */
+    virtual bool beginPersist(version_t version) {
+        persist(version);
+        return false;
+    }
+    /**
+     * Group commit, step 2: waits until the versions written back by
+     * beginPersist() are durable.
+     */
+    virtual void syncPersist() {}
+    /**
+     * Group commit, step 3: adds the versions synced by syncPersist() to the
+     * meta data commit of the group, which makes them visible as persisted.
+     * @param meta_commit The meta data commit of the group
+     */
+    virtual void commitPersist(GroupMetaCommit& meta_commit) {}
+    /**
+     * Abandons a group commit started by beginPersist().
+     */
+    virtual void abortPersist() {}
     /**
      * Trims the beginning (oldest part) of the log, discarding versions older
      * than the specified version
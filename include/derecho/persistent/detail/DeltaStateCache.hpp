@@ -0,0 +1,62 @@
+#ifndef DELTA_STATE_CACHE_HPP
+#define DELTA_STATE_CACHE_HPP
+
+#include <cstddef>
+#include <inttypes.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace persistent {
+
+/**
+ * DeltaStateCache is an LRU cache of the serialized states of an object
+ * implementing IDeltaSupport, reconstructed by replaying its log. It is keyed
+ * by the log index of the last delta applied to the state. A cached state is
+ * also a starting point for reconstructing any later state, so that only the
+ * deltas after it need to be replayed.
+ */
+class DeltaStateCache {
+public:
+    using state_t = std::shared_ptr<const std::vector<char>>;
+
+    /**
+     * Constructor
+     * @param capacity The maximum number of states in the cache
+     */
+    DeltaStateCache(std::size_t capacity);
+
+    /**
+     * Find the cached state with the greatest log index in [min_idx, idx].
+     * @param idx The log index of the state to be reconstructed
+     * @param min_idx The minimum log index of a usable state
+     * @param found_idx Set to the log index of the state found
+     * @return The serialized state found, or nullptr if there is none.
+     */
+    state_t find(int64_t idx, int64_t min_idx, int64_t& found_idx);
+
+    /**
+     * Put a state in the cache, evicting the least recently used one if the
+     * cache is full.
+     * @param idx The log index of the state
+     * @param state The serialized state
+     */
+    void put(int64_t idx, state_t state);
+
+    /** Drop all cached states */
+    void clear();
+
+private:
+    const std::size_t m_capacity;
+    std::mutex m_mutex;
+    /** log indexes, the most recently used first */
+    std::list<int64_t> m_lru;
+    /** log index -> (state, position in m_lru) */
+    std::map<int64_t, std::pair<state_t, std::list<int64_t>::iterator>> m_states;
+};
+
+}  // namespace persistent
+
+#endif  //DELTA_STATE_CACHE_HPP
@@ -6,6 +6,8 @@
 #include <derecho/utils/logger.hpp>
 #include <pthread.h>
 #include <string>
+#include <sys/types.h>
+#include <vector>
 
 namespace persistent {
 
@@ -13,6 +15,9 @@ namespace persistent {
 #define LOG_FILE_SUFFIX "log"
 #define DATA_FILE_SUFFIX "data"
 #define SWAP_FILE_SUFFIX "swp"
+#define CKPT_FILE_SUFFIX "ckpt"
+// the meta headers committed by group commits, one file per data path
+#define GROUP_META_FILE "group.gmeta"
 //Every log entry will be padded out to this size, which must be page-aligned
 #define MAX_LOG_ENTRY_SIZE (64)
 //Similarly, the size of a meta header must be page-aligned
@@ -24,6 +29,8 @@ union MetaHeader {
         int64_t head;  // the head index
         int64_t tail;  // the tail index
         int64_t ver;   // the latest version number.
+        uint64_t seq;  // incremented on every write, to find the latest of the
+                       // meta file and the group meta file.
     } fields;
     uint8_t bytes[META_HEADER_SIZE];
     bool operator==(const MetaHeader& other) {
@@ -96,6 +103,8 @@ int64_t binarySearch(const KeyGetter&, const TKey&, const int64_t&, const int64_
 
 // FilePersistLog is the default persist Log
 class FilePersistLog : public PersistLog {
+    friend class GroupMetaCommit;
+
 protected:
     // the current meta header
     MetaHeader m_currMetaHeader;
@@ -127,6 +136,22 @@ protected:
     pthread_rwlock_t m_rwlock;
     // persistent lock
     pthread_mutex_t m_perslock;
+    // versions of the checkpoints on disk
+    std::set<version_t> m_checkpoints;
+    // checkpoint lock, protecting m_checkpoints and the checkpoint files
+    pthread_mutex_t m_ckptlock;
+    // size of the data reserved by reserveAppend(), valid only while the
+    // write lock is held between reserveAppend() and commitAppend().
+    uint64_t m_iReservedSize;
+    // the meta header snapshotted by beginPersist(), valid only while the
+    // persist lock is held until commitPersist() or abortPersist().
+    MetaHeader m_groupMetaHeader;
+    // if the data and log files need to be synced by syncPersist()
+    bool m_bGroupNeedSync;
+    // the file system of the data and log files
+    dev_t m_iFileSystemDev;
+    // the syncfs() calls started on that file system before beginPersist()
+    uint64_t m_iGroupSyncTicket;
 
 // lock macro
 #define FPL_WRLOCK                                        \
@@ -164,6 +189,20 @@ protected:
         }                                                  \
     } while(0)
 
+#define FPL_CKPT_LOCK                                    \
+    do {                                                 \
+        if(pthread_mutex_lock(&this->m_ckptlock) != 0) { \
+            throw PERSIST_EXP_MUTEX_LOCK(errno);         \
+        }                                                \
+    } while(0)
+
+#define FPL_CKPT_UNLOCK                                    \
+    do {                                                   \
+        if(pthread_mutex_unlock(&this->m_ckptlock) != 0) { \
+            throw PERSIST_EXP_MUTEX_UNLOCK(errno);         \
+        }                                                  \
+    } while(0)
+
     // load the log from files. This method may through exceptions if read from
     // file failed.
     virtual void load();
@@ -175,6 +214,16 @@ protected:
     // FPL_PERS_LOCK is acquired.
     virtual void persistMetaHeaderAtomically(MetaHeader*);
 
+    // Snapshot the current meta header and compute the data and log ranges
+    // that are not persisted yet, we assume FPL_RDLOCK is acquired.
+    void shadowUnpersisted(MetaHeader& shadow_header,
+                           void*& flush_dstart, size_t& flush_dlen,
+                           void*& flush_lstart, size_t& flush_llen);
+
+    // Release the persist lock taken by beginPersist(). If committed, the meta
+    // header snapshotted by beginPersist() becomes the persisted one.
+    void releasePersist(bool committed);
+
 public:
     //Constructor
     FilePersistLog(const std::string& name, const std::string& dataPath, bool enableSignatures);
@@ -186,6 +235,9 @@ public:
     virtual void append(const void* pdata,
                         uint64_t size, version_t ver,
                         const HLC& mhlc) override;
+    virtual void* reserveAppend(uint64_t size, version_t ver) override;
+    virtual void commitAppend(version_t ver, const HLC& mhlc) override;
+    virtual void abortAppend() override;
     virtual void advanceVersion(int64_t ver) override;
     virtual int64_t getLength() override;
     virtual int64_t getEarliestIndex() override;
@@ -200,6 +252,10 @@ public:
     virtual const void* getEntry(const HLC& hlc) override;
     virtual version_t persist(version_t ver,
                               bool preLocked = false) override;
+    virtual bool beginPersist(version_t ver) override;
+    virtual void syncPersist() override;
+    virtual void commitPersist(GroupMetaCommit& meta_commit) override;
+    virtual void abortPersist() override;
     virtual void processEntryAtVersion(version_t ver, const std::function<void(const void*, std::size_t)>& func);
     virtual void addSignature(version_t ver, const unsigned char* signature, version_t previous_signed_version);
     virtual bool getSignature(version_t ver, unsigned char* signature, version_t& previous_signed_version);
@@ -212,6 +268,11 @@ public:
     virtual void post_object(const std::function<void(char const* const, std::size_t)>& f,
                              version_t ver) override;
     virtual void applyLogTail(char const* v) override;
+    virtual void saveCheckpoint(version_t ver, uint64_t size,
+                                const std::function<void(char*)>& writer) override;
+    virtual int64_t loadCheckpoint(int64_t idx, int64_t min_idx,
+                                   const std::function<void(const char*, std::size_t)>& reader) override;
+    virtual void getEntriesSinceCheckpoint(uint64_t& num_entries, uint64_t& num_bytes) override;
 
     template <typename TKey, typename KeyGetter>
     void trim(const TKey& key, const KeyGetter& keyGetter) {
@@ -274,6 +335,18 @@ private:
     /** verify the existence of the data file */
     bool checkOrCreateDataFile();
 
+    /** get the checkpoint file name for a version */
+    std::string getCheckpointFile(version_t ver) const;
+
+    /** load the versions of the existing checkpoint files */
+    void loadCheckpointVersions();
+
+    /**
+     * remove the checkpoint files of the versions in [from,to)
+     * Note: no lock protected, use FPL_CKPT_LOCK
+     */
+    void removeCheckpoints(version_t from, version_t to);
+
     /**
      * Get the minimum index greater than a given version
      * Note: no lock protected, use FPL_RDLOCK
@@ -376,6 +449,27 @@ private:
     }
 #endif  // NDEBUG
 };
+
+/**
+ * The meta headers of the logs flushed by a group commit. Instead of renaming
+ * a meta file for each log, commit() records all of them in the group meta file
+ * of their data path with one atomic write; loading a log takes whichever of its
+ * meta file and its group meta file record was written last.
+ */
+class GroupMetaCommit {
+    std::vector<FilePersistLog*> m_logs;
+
+public:
+    /**
+     * Adds a log whose data has been synced, see FilePersistLog::commitPersist().
+     */
+    void add(FilePersistLog* log);
+    /**
+     * Commits the meta headers of all the logs and releases their persist
+     * locks. If the write fails, the logs are released without committing.
+     */
+    void commit();
+};
 }  // namespace persistent
 
 #endif  //FILE_PERSIST_LOG_HPP
@@ -17,6 +17,8 @@
 
 namespace persistent {
 
+class GroupMetaCommit;
+
 // Storage type:
 enum StorageType {
     ST_FILE = 0,
@@ -97,6 +99,29 @@ public:
                         const HLC& mhlc)
             = 0;
 
+    /**
+     * Reserve space for the next log entry so that the caller can serialize
+     * directly into the log instead of into a temporary buffer. A successful
+     * call MUST be followed by exactly one call to commitAppend() or
+     * abortAppend(); the log is write-locked in between.
+     * @param size - length of the data to be written
+     * @param ver - version of the data, must grow monotonically as in append()
+     * @return pointer to a writable region of at least size bytes.
+     */
+    virtual void* reserveAppend(uint64_t size, version_t ver) = 0;
+
+    /**
+     * Turn the space reserved by reserveAppend() into a log entry.
+     * @param ver - version of the data, must be the same as passed to reserveAppend()
+     * @param mhlc - the hlc clock of the data
+     */
+    virtual void commitAppend(version_t ver, const HLC& mhlc) = 0;
+
+    /**
+     * Give up the space reserved by reserveAppend(), leaving the log unchanged.
+     */
+    virtual void abortAppend() = 0;
+
     /**
      * Advance the version number without appendding a log. This is useful
      * to create gap between versions.
@@ -163,6 +188,34 @@ public:
     virtual version_t persist(version_t version,
                               bool preLocked = false) = 0;
 
+    /**
+     * Group commit, step 1: snapshot the unpersisted part of the log and
+     * start writing it back, without waiting for it. If this returns true, the
+     * log is locked against other persist operations until commitPersist() or
+     * abortPersist() is called.
+     * @param version - the version to persist up to
+     * @return - false if there is nothing to persist.
+     */
+    virtual bool beginPersist(version_t version) = 0;
+
+    /**
+     * Group commit, step 2: wait until the part of the log snapshotted by
+     * beginPersist() is durable.
+     */
+    virtual void syncPersist() = 0;
+
+    /**
+     * Group commit, step 3: add the meta data of the snapshotted log to the
+     * meta data committed for the whole group, which releases the persist lock.
+     * @param meta_commit - the meta data commit of the group
+     */
+    virtual void commitPersist(GroupMetaCommit& meta_commit) = 0;
+
+    /**
+     * Release the persist lock taken by beginPersist() without committing.
+     */
+    virtual void abortPersist() = 0;
+
     /**
      * Add a signature to a specific version; does nothing if signatures are disabled
      * @param ver - version
@@ -245,6 +298,39 @@ public:
      * @param ver - all log entry strictly after ver will be truncated.
      */
     virtual void truncate(version_t ver) = 0;
+
+    /**
+     * Save a checkpoint, the materialized state of the object at version 'ver',
+     * alongside the log. This is used to accelerate the reconstruction of
+     * historical states for objects logging deltas.
+     * @param ver - the version of the state, which must be in the log
+     * @param size - the size of the serialized state
+     * @param writer - function to serialize the state into a buffer of 'size' bytes
+     */
+    virtual void saveCheckpoint(version_t ver, uint64_t size,
+                                const std::function<void(char*)>& writer)
+            = 0;
+
+    /**
+     * Load the latest checkpoint whose log index is in (min_idx, idx].
+     * @param idx - the log index of the state to be reconstructed
+     * @param min_idx - checkpoints at or before this index are ignored
+     * @param reader - function to process the serialized state
+     * @return the log index of the checkpoint loaded, or INVALID_INDEX if
+     *         there is no such checkpoint, in which case reader is not called.
+     */
+    virtual int64_t loadCheckpoint(int64_t idx, int64_t min_idx,
+                                   const std::function<void(const char*, std::size_t)>& reader)
+            = 0;
+
+    /**
+     * Count the log entries newer than the latest checkpoint, and the total
+     * size of their data, so that checkpointing can resume its schedule
+     * after the log is reloaded.
+     * @param num_entries - set to the number of entries after the latest checkpoint
+     * @param num_bytes - set to the total data size of those entries
+     */
+    virtual void getEntriesSinceCheckpoint(uint64_t& num_entries, uint64_t& num_bytes) = 0;
 };
 }  // namespace persistent
 
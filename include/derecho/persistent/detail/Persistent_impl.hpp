@@ -112,6 +112,114 @@ inline void Persistent<ObjectType, storageType>::initialize_object_from_log(cons
     }
 }
 
+template <typename ObjectType,
+          StorageType storageType>
+inline void Persistent<ObjectType, storageType>::initialize_delta_checkpoint() {
+    if constexpr(std::is_base_of<IDeltaSupport<ObjectType>, ObjectType>::value) {
+        this->m_iDeltaCheckpointInterval = derecho::getConfUInt64(CONF_PERS_DELTA_CHECKPOINT_INTERVAL);
+        this->m_iDeltaCheckpointBytes = derecho::getConfUInt64(CONF_PERS_DELTA_CHECKPOINT_BYTES);
+        const uint64_t cache_size = derecho::getConfUInt64(CONF_PERS_DELTA_CACHE_SIZE);
+        if(cache_size > 0) {
+            this->m_pDeltaStateCache = std::make_unique<DeltaStateCache>(cache_size);
+        }
+        // resume counting from the latest checkpoint in the reloaded log
+        this->m_pLog->getEntriesSinceCheckpoint(this->m_iVersionsSinceCheckpoint, this->m_iBytesSinceCheckpoint);
+    }
+}
+
+template <typename ObjectType,
+          StorageType storageType>
+inline void Persistent<ObjectType, storageType>::checkpoint_delta_object(version_t ver, std::size_t delta_size) {
+    this->m_iVersionsSinceCheckpoint++;
+    this->m_iBytesSinceCheckpoint += delta_size;
+    if((this->m_iDeltaCheckpointInterval > 0 && this->m_iVersionsSinceCheckpoint >= this->m_iDeltaCheckpointInterval)
+       || (this->m_iDeltaCheckpointBytes > 0 && this->m_iBytesSinceCheckpoint >= this->m_iDeltaCheckpointBytes)) {
+        dbg_default_trace("{0} schedule checkpoint at ver({1}) after {2} versions and {3} bytes of deltas.",
+                          this->m_pLog->m_sName, ver, this->m_iVersionsSinceCheckpoint, this->m_iBytesSinceCheckpoint);
+        this->m_iPendingCheckpointVersion.store(ver);
+        this->m_iVersionsSinceCheckpoint = 0;
+        this->m_iBytesSinceCheckpoint = 0;
+    }
+}
+
+template <typename ObjectType,
+          StorageType storageType>
+inline void Persistent<ObjectType, storageType>::save_pending_checkpoint() {
+    if constexpr(std::is_base_of<IDeltaSupport<ObjectType>, ObjectType>::value) {
+        const version_t ver = this->m_iPendingCheckpointVersion.exchange(INVALID_VERSION);
+        if(ver == INVALID_VERSION) {
+            return;
+        }
+        if(ver > this->m_pLog->getLastPersistedVersion()) {
+            // not durable yet; retry on the next persist unless a later checkpoint was scheduled meanwhile
+            version_t expected = INVALID_VERSION;
+            this->m_iPendingCheckpointVersion.compare_exchange_strong(expected, ver);
+            return;
+        }
+        const int64_t idx = this->m_pLog->getVersionIndex(ver, true);
+        if(idx == INVALID_INDEX) {
+            // truncated or trimmed in the meantime
+            return;
+        }
+        std::unique_ptr<ObjectType> state = this->reconstruct_delta_state(idx, nullptr, false);
+        dbg_default_trace("{0} save checkpoint at ver({1}).", this->m_pLog->m_sName, ver);
+        this->m_pLog->saveCheckpoint(ver, mutils::bytes_size(*state), [&state](char* buf) {
+            mutils::to_bytes(*state, buf);
+        });
+    }
+}
+
+template <typename ObjectType,
+          StorageType storageType>
+inline std::unique_ptr<ObjectType> Persistent<ObjectType, storageType>::reconstruct_delta_state(
+        int64_t idx,
+        mutils::DeserializationManager* dm,
+        bool cache_state) const {
+    const int64_t earliest_idx = this->m_pLog->getEarliestIndex();
+    if(earliest_idx == INVALID_INDEX) {
+        return ObjectType::create(dm);
+    }
+    // The state at base_idx is where the replay starts from.
+    int64_t base_idx = earliest_idx - 1;
+    // STEP 1: find the nearest reconstructed state in the cache
+    DeltaStateCache::state_t cached_state;
+    if(this->m_pDeltaStateCache) {
+        int64_t cached_idx;
+        cached_state = this->m_pDeltaStateCache->find(idx, earliest_idx - 1, cached_idx);
+        if(cached_state) {
+            base_idx = cached_idx;
+        }
+    }
+    const bool exact_hit = (cached_state && base_idx == idx);
+    // STEP 2: find a checkpoint newer than the cached state
+    std::unique_ptr<ObjectType> p;
+    int64_t ckpt_idx = INVALID_INDEX;
+    if(!exact_hit) {
+        ckpt_idx = this->m_pLog->loadCheckpoint(idx, base_idx, [&p, dm](const char* buf, std::size_t) {
+            p = mutils::from_bytes<ObjectType>(dm, buf);
+        });
+    }
+    if(ckpt_idx != INVALID_INDEX) {
+        base_idx = ckpt_idx;
+    } else if(cached_state) {
+        p = mutils::from_bytes<ObjectType>(dm, cached_state->data());
+    } else {
+        p = ObjectType::create(dm);
+    }
+    // STEP 3: replay the deltas after it
+    for(int64_t i = base_idx + 1; i <= idx; i++) {
+        const char* entry_data = (const char*)this->m_pLog->getEntryByIndex(i);
+        p->applyDelta(entry_data);
+    }
+    if(cache_state && this->m_pDeltaStateCache && !exact_hit) {
+        auto state = std::make_shared<std::vector<char>>(mutils::bytes_size(*p));
+        mutils::to_bytes(*p, state->data());
+        this->m_pDeltaStateCache->put(idx, std::move(state));
+    }
+
+    return p;
+}
+
 template <typename ObjectType,
           StorageType storageType>
 Persistent<ObjectType, storageType>::Persistent(
@@ -126,6 +234,7 @@ Persistent<ObjectType, storageType>::Persistent(
                            ? (*Persistent::getNameMaker().make(persistent_registry ? persistent_registry->getSubgroupPrefix() : nullptr)).c_str()
                            : object_name,
                    enable_signatures);
+    initialize_delta_checkpoint();
     // Initialize object
     initialize_object_from_log(object_factory, &dm);
     if(persistent_registry) {
@@ -149,6 +258,12 @@ Persistent<ObjectType, storageType>::Persistent(Persistent&& other) {
     this->m_pWrappedObject = std::move(other.m_pWrappedObject);
     this->m_pLog = std::move(other.m_pLog);
     this->m_pRegistry = other.m_pRegistry;
+    this->m_iDeltaCheckpointInterval = other.m_iDeltaCheckpointInterval;
+    this->m_iDeltaCheckpointBytes = other.m_iDeltaCheckpointBytes;
+    this->m_iVersionsSinceCheckpoint = other.m_iVersionsSinceCheckpoint;
+    this->m_iBytesSinceCheckpoint = other.m_iBytesSinceCheckpoint;
+    this->m_iPendingCheckpointVersion.store(other.m_iPendingCheckpointVersion.load());
+    this->m_pDeltaStateCache = std::move(other.m_pDeltaStateCache);
     if(this->m_pRegistry != nullptr) {
         // this will override the previous registry entry
         this->m_pRegistry->registerPersistent(this->m_pLog->m_sName, this);
@@ -171,6 +286,7 @@ Persistent<ObjectType, storageType>::Persistent(
     if(log_tail != nullptr) {
         this->m_pLog->applyLogTail(log_tail);
     }
+    initialize_delta_checkpoint();
     // Initialize Wrapped Object
     assert(wrapped_obj_ptr != nullptr);
     this->m_pWrappedObject = std::move(wrapped_obj_ptr);
@@ -255,15 +371,7 @@ std::unique_ptr<ObjectType> Persistent<ObjectType, storageType>::getByIndex(
         int64_t idx,
         mutils::DeserializationManager* dm) const {
     if constexpr(std::is_base_of<IDeltaSupport<ObjectType>, ObjectType>::value) {
-        // ObjectType* ot = new ObjectType{};
-        std::unique_ptr<ObjectType> p = ObjectType::create(dm);
-        // TODO: accelerate this by checkpointing
-        for(int64_t i = this->m_pLog->getEarliestIndex(); i <= idx; i++) {
-            const char* entry_data = (const char*)this->m_pLog->getEntryByIndex(i);
-            p->applyDelta(entry_data);
-        }
-
-        return p;
+        return reconstruct_delta_state(idx, dm, true);
     } else {
         return mutils::from_bytes<ObjectType>(dm, (const char*)this->m_pLog->getEntryByIndex(idx));
     }
@@ -291,7 +399,7 @@ auto Persistent<ObjectType, storageType>::get(
     }
     if constexpr(std::is_base_of<IDeltaSupport<ObjectType>, ObjectType>::value) {
         // "So far, the IDeltaSupport does not work with zero-copy 'Persistent::get()'. Emulate with the copy version."
-        return f(*this->get(ver, dm));
+        return fun(*this->get(ver, dm));
     } else {
         return mutils::deserialize_and_run(dm, pdat, fun);
     }
@@ -361,6 +469,10 @@ template <typename ObjectType,
 void Persistent<ObjectType, storageType>::truncate(const version_t ver) {
     dbg_default_trace("truncate.");
     this->m_pLog->truncate(ver);
+    if(this->m_pDeltaStateCache) {
+        // the log indexes of the truncated entries will be reused.
+        this->m_pDeltaStateCache->clear();
+    }
     dbg_default_trace("truncate...done");
 }
 
@@ -462,17 +574,28 @@ template <typename ObjectType,
 void Persistent<ObjectType, storageType>::set(ObjectType& v, version_t ver, const HLC& mhlc) {
     dbg_default_trace("append to log with ver({}),hlc({},{})", ver, mhlc.m_rtc_us, mhlc.m_logic);
     if constexpr(std::is_base_of<IDeltaSupport<ObjectType>, ObjectType>::value) {
+        bool appended = false;
+        std::size_t delta_size = 0;
         v.finalizeCurrentDelta([&](char const* const buf, size_t len) {
             this->m_pLog->append((const void* const)buf, len, ver, mhlc);
+            appended = true;
+            delta_size = len;
         });
+        if(appended) {
+            this->checkpoint_delta_object(ver, delta_size);
+        }
     } else {
         // ObjectType does not support Delta, logging the whole current state.
+        // Serialize it in place in the log to avoid a temporary buffer.
         auto size = mutils::bytes_size(v);
-        char* buf = new char[size];
-        bzero(buf, size);
-        mutils::to_bytes(v, buf);
-        this->m_pLog->append((void*)buf, size, ver, mhlc);
-        delete[] buf;
+        char* buf = static_cast<char*>(this->m_pLog->reserveAppend(size, ver));
+        try {
+            mutils::to_bytes(v, buf);
+        } catch(...) {
+            this->m_pLog->abortAppend();
+            throw;
+        }
+        this->m_pLog->commitAppend(ver, mhlc);
     }
 }
 
@@ -561,6 +684,32 @@ void Persistent<ObjectType, storageType>::persist(version_t ver) {
 #else
     this->m_pLog->persist(ver);
 #endif  //_PERFORMANCE_DEBUG
+    this->save_pending_checkpoint();
+}
+
+template <typename ObjectType,
+          StorageType storageType>
+bool Persistent<ObjectType, storageType>::beginPersist(version_t ver) {
+    return this->m_pLog->beginPersist(ver);
+}
+
+template <typename ObjectType,
+          StorageType storageType>
+void Persistent<ObjectType, storageType>::syncPersist() {
+    this->m_pLog->syncPersist();
+}
+
+template <typename ObjectType,
+          StorageType storageType>
+void Persistent<ObjectType, storageType>::commitPersist(GroupMetaCommit& meta_commit) {
+    this->m_pLog->commitPersist(meta_commit);
+    this->save_pending_checkpoint();
+}
+
+template <typename ObjectType,
+          StorageType storageType>
+void Persistent<ObjectType, storageType>::abortPersist() {
+    this->m_pLog->abortPersist();
 }
 
 template <typename ObjectType,
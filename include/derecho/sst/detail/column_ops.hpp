@@ -0,0 +1,134 @@
+/**
+ * @file column_ops.hpp
+ *
+ * Aggregate kernels over one column of an SSTFieldVector, restricted to a set
+ * of rows, such as the rows of the members of a shard.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SST_COLUMN_OPS_X86
+#endif
+
+#include "../sst.hpp"
+
+namespace sst {
+namespace column {
+
+namespace detail {
+
+/** Reads each row's entry once, through the volatile pointer. */
+template <typename T>
+T min_scalar(const volatile char* column_base, std::size_t row_len,
+             const uint32_t* rows, std::size_t num_rows) {
+    T result = std::numeric_limits<T>::max();
+    for(std::size_t i = 0; i < num_rows; ++i) {
+        T value = *reinterpret_cast<const volatile T*>(column_base + rows[i] * row_len);
+        result = std::min(result, value);
+    }
+    return result;
+}
+
+#ifdef SST_COLUMN_OPS_X86
+/**
+ * AVX2 kernels: the entries of a column are row_len bytes apart, so they are
+ * gathered 8 (int32) or 4 (int64) rows at a time. The byte offsets must fit in
+ * an int32, which the caller checks.
+ */
+__attribute__((target("avx2"))) inline int32_t min_avx2(const volatile char* column_base, std::size_t row_len,
+                                                        const uint32_t* rows, std::size_t num_rows) {
+    const int* base = const_cast<const int*>(reinterpret_cast<const volatile int*>(column_base));
+    const __m256i stride = _mm256_set1_epi32(static_cast<int>(row_len));
+    __m256i acc = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+    std::size_t i = 0;
+    for(; i + 8 <= num_rows; i += 8) {
+        __m256i offsets = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + i)), stride);
+        acc = _mm256_min_epi32(acc, _mm256_i32gather_epi32(base, offsets, 1));
+    }
+    __m128i acc128 = _mm_min_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    acc128 = _mm_min_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc128 = _mm_min_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(2, 3, 0, 1)));
+    const int32_t result = _mm_cvtsi128_si32(acc128);
+    return std::min(result, min_scalar<int32_t>(column_base, row_len, rows + i, num_rows - i));
+}
+
+__attribute__((target("avx2"))) inline int64_t min_avx2(const volatile char* column_base, std::size_t row_len,
+                                                        const uint32_t* rows, std::size_t num_rows, int64_t) {
+    const long long* base = const_cast<const long long*>(reinterpret_cast<const volatile long long*>(column_base));
+    const __m128i stride = _mm_set1_epi32(static_cast<int>(row_len));
+    __m256i acc = _mm256_set1_epi64x(std::numeric_limits<int64_t>::max());
+    std::size_t i = 0;
+    for(; i + 4 <= num_rows; i += 4) {
+        __m128i offsets = _mm_mullo_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + i)), stride);
+        __m256i values = _mm256_i32gather_epi64(base, offsets, 1);
+        acc = _mm256_blendv_epi8(acc, values, _mm256_cmpgt_epi64(acc, values));
+    }
+    alignas(32) int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    const int64_t result = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    return std::min(result, min_scalar<int64_t>(column_base, row_len, rows + i, num_rows - i));
+}
+
+inline bool has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif  // SST_COLUMN_OPS_X86
+
+}  // namespace detail
+
+/**
+ * Computes the minimum of one column of an SST field over a set of rows,
+ * reading each entry exactly once. Uses AVX2 gathers for 32- and 64-bit
+ * integer columns when the CPU supports them.
+ * @param field The SST field
+ * @param column The index of the column in the field
+ * @param rows The SST row indexes to aggregate over; must not be empty
+ * @return The minimum of field[row][column] over the rows
+ */
+template <typename T>
+T min(const SSTFieldVector<T>& field, std::size_t column, const std::vector<uint32_t>& rows) {
+    const volatile char* column_base = reinterpret_cast<const volatile char*>(field[0] + column);
+    const std::size_t row_len = field.rowLen;
+    // make sure the entries are read again on every call
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#ifdef SST_COLUMN_OPS_X86
+    if constexpr(std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) == 4 || sizeof(T) == 8)) {
+        const uint64_t max_offset = static_cast<uint64_t>(*std::max_element(rows.begin(), rows.end())) * row_len;
+        if(detail::has_avx2() && max_offset <= static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
+            if constexpr(sizeof(T) == 4) {
+                return detail::min_avx2(column_base, row_len, rows.data(), rows.size());
+            } else {
+                return detail::min_avx2(column_base, row_len, rows.data(), rows.size(), int64_t{});
+            }
+        }
+    }
+#endif
+    return detail::min_scalar<T>(column_base, row_len, rows.data(), rows.size());
+}
+
+/**
+ * Checks whether one column of an SST field is at least a threshold in all of
+ * a set of rows.
+ * @param field The SST field
+ * @param column The index of the column in the field
+ * @param rows The SST row indexes to check; must not be empty
+ * @param threshold The value to compare against
+ * @return True if field[row][column] >= threshold for every row
+ */
+template <typename T>
+bool all_at_least(const SSTFieldVector<T>& field, std::size_t column, const std::vector<uint32_t>& rows, T threshold) {
+    return column::min(field, column, rows) >= threshold;
+}
+
+}  // namespace column
+}  // namespace sst
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <optional>
 #include <list>
 #include <map>
@@ -40,5 +44,102 @@ public:
 
 //There is one global instance of PollingData
 extern PollingData polling_data;
+
+/**
+ * How many idle periods of a polling loop reached each tier of its
+ * IdleStrategy. Only tier changes are counted, so that the loop does not pay
+ * for the counters on every idle round.
+ */
+struct IdleCounters {
+    uint64_t spins = 0;
+    uint64_t backoffs = 0;
+    uint64_t waits = 0;
+};
+
+/**
+ * The idle strategy of a polling loop. When the loop finds no work, it first
+ * keeps spinning, then backs off with a growing number of pause instructions,
+ * and finally blocks on a wait function until there may be new work or a
+ * timeout expires. The wait can only end early on a local signal, such as a
+ * completion channel event or a local write; a remote one-sided RDMA write is
+ * only seen once the timeout expires. The thresholds between the tiers are
+ * configured with CONF_DERECHO_IDLE_SPIN_US, CONF_DERECHO_IDLE_BACKOFF_US and
+ * CONF_DERECHO_IDLE_WAIT_US. An IdleStrategy belongs to a single thread.
+ */
+class IdleStrategy {
+    /** How long to spin after the last work was found */
+    const std::chrono::microseconds spin_time;
+    /** How long to back off after spinning, before waiting */
+    const std::chrono::microseconds backoff_time;
+    /** The maximum time of one wait */
+    const std::chrono::microseconds wait_timeout;
+    enum class Tier { working,
+                      spin,
+                      backoff,
+                      wait };
+    Tier tier;
+    IdleCounters counters;
+    std::chrono::steady_clock::time_point last_work_time;
+    uint32_t num_pauses;
+
+public:
+    IdleStrategy();
+
+    /** Called by the polling loop whenever it finds work. */
+    void work_done() {
+        last_work_time = std::chrono::steady_clock::now();
+        num_pauses = 1;
+        tier = Tier::working;
+    }
+
+    /** How many idle periods reached each tier so far. */
+    const IdleCounters& get_counters() const {
+        return counters;
+    }
+
+    /**
+     * Called by the polling loop after a round that found no work.
+     * @param wait A function blocking until there may be new work, or for at
+     * most the std::chrono::microseconds timeout it is given.
+     */
+    template <typename WaitFunc>
+    void idle(WaitFunc&& wait) {
+        const auto idle_time = std::chrono::steady_clock::now() - last_work_time;
+        if(idle_time < spin_time) {
+            if(tier != Tier::spin) {
+                tier = Tier::spin;
+                counters.spins++;
+            }
+        } else if(idle_time < spin_time + backoff_time) {
+            if(tier != Tier::backoff) {
+                tier = Tier::backoff;
+                counters.backoffs++;
+            }
+            for(uint32_t i = 0; i < num_pauses; ++i) {
+                cpu_relax();
+            }
+            num_pauses = std::min(num_pauses * 2, max_pauses);
+        } else {
+            if(tier != Tier::wait) {
+                tier = Tier::wait;
+                counters.waits++;
+            }
+            wait(wait_timeout);
+        }
+    }
+
+private:
+    static constexpr uint32_t max_pauses = 1024;
+
+    static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+};
 }  // namespace util
 }  // namespace sst
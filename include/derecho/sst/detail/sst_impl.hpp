@@ -11,11 +11,15 @@
 #include <memory>
 #include <mutex>
 #include <pthread.h>
+#include <sched.h>
+#include <string>
 #include <sys/time.h>
 #include <thread>
 #include <time.h>
 #include <vector>
 
+#include <derecho/utils/logger.hpp>
+
 #include "poll_utils.hpp"
 #include "../predicates.hpp"
 #include "../sst.hpp"
@@ -29,6 +33,10 @@ namespace sst {
 template <typename DerivedSST>
 SST<DerivedSST>::~SST() {
     thread_shutdown = true;
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        idle_cv.notify_all();
+    }
     for(auto& thread : background_threads) {
         if(thread.joinable()) thread.join();
     }
@@ -39,9 +47,9 @@ SST<DerivedSST>::~SST() {
 }
 
 /**
- * This simply unblocks the background thread that runs the predicate evaluation
- * loop. It must be called at some point after the the constructor in order for
- * any registered predicates to trigger.
+ * This simply unblocks the background threads that run the predicate
+ * evaluation loop. It must be called at some point after the the constructor
+ * in order for any registered predicates to trigger.
  */
 template <typename DerivedSST>
 void SST<DerivedSST>::start_predicate_evaluation() {
@@ -51,58 +59,103 @@ void SST<DerivedSST>::start_predicate_evaluation() {
 }
 
 /**
- * This function is run in a detached background thread to detect predicate
- * events. It continuously evaluates predicates one by one, and runs the
- * trigger functions for each predicate that fires. In addition, it
- * continuously evaluates named functions one by one, and updates the local
- * row's observed values of those functions.
+ * Pins the calling predicate evaluation thread to the core configured for it,
+ * if any.
  */
 template <typename DerivedSST>
-void SST<DerivedSST>::detect() {
-    pthread_setname_np(pthread_self(), "sst_detect");
+void SST<DerivedSST>::pin_predicate_thread(uint32_t partition_index) {
+    const std::string cores = derecho::getConfString(CONF_DERECHO_SST_PREDICATE_THREAD_CORES);
+    if(cores.empty()) {
+        return;
+    }
+    const std::vector<std::string> core_list = derecho::split_string(cores);
+    const int core = std::stoi(core_list[partition_index % core_list.size()]);
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+        dbg_default_warn("Failed to pin predicate thread {} to core {}", partition_index, core);
+    }
+}
+
+/**
+ * This function is run in a background thread for each predicate partition to
+ * detect predicate events. It continuously evaluates the predicates of its
+ * partition one by one, and runs the trigger functions for each predicate that
+ * fires. In addition, it continuously evaluates named functions one by one,
+ * and updates the local row's observed values of those functions.
+ */
+template <typename DerivedSST>
+void SST<DerivedSST>::detect(uint32_t partition_index) {
+    if(partition_index == 0) {
+        pthread_setname_np(pthread_self(), "sst_detect");
+    } else {
+        pthread_setname_np(pthread_self(), ("sst_detect_" + std::to_string(partition_index)).c_str());
+    }
+    pin_predicate_thread(partition_index);
+    auto& partition = *predicates.partitions[partition_index];
+    partition.evaluator = std::this_thread::get_id();
     if(!thread_start) {
         std::unique_lock<std::mutex> lock(thread_start_mutex);
         thread_start_cv.wait(lock, [this]() { return thread_start; });
     }
-    struct timespec last_time, cur_time;
-    clock_gettime(CLOCK_REALTIME, &last_time);
+    util::IdleStrategy idle_strategy;
+    // Waits for a local write newer than the ones seen by the last pass
+    uint64_t seen_local_writes = 0;
+    auto wait_for_local_write = [&](std::chrono::microseconds timeout) {
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        num_idle_waiters++;
+        idle_cv.wait_for(lock, timeout, [&]() {
+            return local_write_count != seen_local_writes || thread_shutdown;
+        });
+        num_idle_waiters--;
+    };
+
+    // Take the predicate lock before reading the predicate lists
+    std::unique_lock<std::mutex> predicates_lock(partition.predicate_mutex, std::defer_lock);
+    // Runs a trigger without the predicate lock. The trigger lock is taken
+    // before the predicate lock is released, so that Predicates::remove()
+    // can't miss a trigger that is about to run.
+    auto run_trigger = [&](const std::shared_ptr<typename Predicates<DerivedSST>::trig>& trigger) {
+        std::unique_lock<std::mutex> trigger_lock(partition.trigger_mutex);
+        predicates_lock.unlock();
+        (*trigger)(*derived_this);
+        trigger_lock.unlock();
+        predicates_lock.lock();
+    };
 
     while(!thread_shutdown) {
         bool predicate_fired = false;
-        // Take the predicate lock before reading the predicate lists
-        std::unique_lock<std::mutex> predicates_lock(predicates.predicate_mutex);
+        seen_local_writes = local_write_count;
+        predicates_lock.lock();
 
         // one time predicates need to be evaluated only until they become true
-        for(auto& pred : predicates.one_time_predicates) {
+        for(auto& pred : partition.one_time_predicates) {
             if(pred != nullptr && (pred->first(*derived_this) == true)) {
                 predicate_fired = true;
                 // Copy the trigger pointer locally, so it can continue running without
                 // segfaulting even if this predicate gets deleted when we unlock predicates_lock
                 std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
-                predicates_lock.unlock();
-                (*trigger)(*derived_this);
-                predicates_lock.lock();
+                run_trigger(trigger);
                 // erase the predicate as it was just found to be true
                 pred.reset();
             }
         }
 
         // recurrent predicates are evaluated each time they are found to be true
-        for(auto& pred : predicates.recurrent_predicates) {
+        for(auto& pred : partition.recurrent_predicates) {
             if(pred != nullptr && (pred->first(*derived_this) == true)) {
                 predicate_fired = true;
                 std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
-                predicates_lock.unlock();
-                (*trigger)(*derived_this);
-                predicates_lock.lock();
+                run_trigger(trigger);
             }
         }
 
         // transition predicates are only evaluated when they change from false to true
         // We need to use iterators here because we need to iterate over two lists in parallel
-        auto pred_it = predicates.transition_predicates.begin();
-        auto pred_state_it = predicates.transition_predicate_states.begin();
-        while(pred_it != predicates.transition_predicates.end()) {
+        auto pred_it = partition.transition_predicates.begin();
+        auto pred_state_it = partition.transition_predicate_states.begin();
+        while(pred_it != partition.transition_predicates.end()) {
             if(*pred_it != nullptr) {
                 //*pred_state_it is the previous state of the predicate at *pred_it
                 bool curr_pred_state = (*pred_it)->first(*derived_this);
@@ -110,48 +163,54 @@ void SST<DerivedSST>::detect() {
                     predicate_fired = true;
                     std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(
                             (*pred_it)->second);
-                    predicates_lock.unlock();
-                    (*trigger)(*derived_this);
-                    predicates_lock.lock();
+                    run_trigger(trigger);
                 }
                 *pred_state_it = curr_pred_state;
-
-                ++pred_it;
-                ++pred_state_it;
             }
+            ++pred_it;
+            ++pred_state_it;
         }
+        predicates_lock.unlock();
 
         if(predicate_fired) {
-            // update last time
-            clock_gettime(CLOCK_REALTIME, &last_time);
+            idle_strategy.work_done();
         } else {
-            clock_gettime(CLOCK_REALTIME, &cur_time);
-            // check if the system has been inactive for enough time to induce sleep
-            double time_elapsed_in_ms = (cur_time.tv_sec - last_time.tv_sec) * 1e3
-                                        + (cur_time.tv_nsec - last_time.tv_nsec) / 1e6;
-            if(time_elapsed_in_ms > 1) {
-                predicates_lock.unlock();
-                using namespace std::chrono_literals;
-                std::this_thread::sleep_for(1ms);
-                predicates_lock.lock();
-            }
+            // Remote writes to the SST raise no event here, so the wait is
+            // bounded by a timeout; local writes wake it up right away.
+            idle_strategy.idle(wait_for_local_write);
         }
         //Still to do: Clean up deleted predicates
     }
+    dbg_default_debug("Predicate thread {} ending. Idle periods: spin={}, backoff={}, wait={}", partition_index,
+                      idle_strategy.get_counters().spins, idle_strategy.get_counters().backoffs,
+                      idle_strategy.get_counters().waits);
 }
 
 template <typename DerivedSST>
 void SST<DerivedSST>::put(const std::vector<uint32_t> receiver_ranks, size_t offset, size_t size) {
     assert(offset + size <= rowLen);
-    for(auto index : receiver_ranks) {
-        // don't write to yourself or a frozen row
-        if(index == my_index || row_is_frozen[index]) {
-            continue;
+    {
+        // keeps a row from being frozen and its connection handed over while writing to it
+        std::shared_lock<std::shared_mutex> lock(freeze_mutex);
+        for(auto index : receiver_ranks) {
+            // don't write to yourself or a frozen row
+            if(index == my_index || row_is_frozen[index]) {
+                continue;
+            }
+            // perform a remote RDMA write on the owner of the row
+            res_vec[index]->post_remote_write(offset, size);
         }
-        // perform a remote RDMA write on the owner of the row
-        res_vec[index]->post_remote_write(offset, size);
     }
-    return;
+    notify_local_write();
+}
+
+template <typename DerivedSST>
+void SST<DerivedSST>::notify_local_write() {
+    local_write_count++;
+    if(num_idle_waiters > 0) {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        idle_cv.notify_all();
+    }
 }
 
 template <typename DerivedSST>
@@ -170,17 +229,20 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
 #else
     lf_sender_ctxt sctxt[receiver_ranks.size()];
 #endif
-    for(auto index : receiver_ranks) {
-        // don't write to yourself or a frozen row
-        if(index == my_index || row_is_frozen[index]) {
-            continue;
+    {
+        std::shared_lock<std::shared_mutex> lock(freeze_mutex);
+        for(auto index : receiver_ranks) {
+            // don't write to yourself or a frozen row
+            if(index == my_index || row_is_frozen[index]) {
+                continue;
+            }
+            // perform a remote RDMA write on the owner of the row
+            sctxt[index].set_remote_id(index);
+            sctxt[index].set_ce_idx(ce_idx);
+            res_vec[index]->post_remote_write_with_completion(&sctxt[index], offset, size);
+            posted_write_to[index] = true;
+            num_writes_posted++;
         }
-        // perform a remote RDMA write on the owner of the row
-        sctxt[index].set_remote_id(index);
-        sctxt[index].set_ce_idx(ce_idx);
-        res_vec[index]->post_remote_write_with_completion(&sctxt[index], offset, size);
-        posted_write_to[index] = true;
-        num_writes_posted++;
     }
 
     // track which nodes respond successfully
@@ -237,6 +299,7 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
     }
 
     util::polling_data.reset_waiting(tid);
+    notify_local_write();
 
     for(auto index : failed_node_indexes) {
         freeze(index);
@@ -246,7 +309,7 @@ void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_r
 template <typename DerivedSST>
 void SST<DerivedSST>::freeze(int row_index) {
     {
-        std::lock_guard<std::mutex> lock(freeze_mutex);
+        std::lock_guard<std::shared_mutex> lock(freeze_mutex);
         if(row_is_frozen[row_index]) {
             return;
         }
@@ -262,6 +325,25 @@ void SST<DerivedSST>::freeze(int row_index) {
     }
 }
 
+template <typename DerivedSST>
+std::shared_ptr<resources> SST<DerivedSST>::detach_connection(uint32_t node_id) {
+    auto member = members_by_id.find(node_id);
+    if(member == members_by_id.end() || static_cast<unsigned int>(member->second) == my_index) {
+        return nullptr;
+    }
+    const int row_index = member->second;
+    {
+        std::lock_guard<std::shared_mutex> lock(freeze_mutex);
+        if(row_is_frozen[row_index]) {
+            return nullptr;
+        }
+        row_is_frozen[row_index] = true;
+    }
+    num_frozen++;
+    //Taking freeze_mutex waited for the writes in progress, and later ones skip the row
+    return res_vec[row_index];
+}
+
 /**
  * Exchanges a single byte of data with each member of the SST group over the
  * TCP (not RDMA) connection, in descending order of the members' node ranks.
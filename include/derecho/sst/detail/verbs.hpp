@@ -96,6 +96,14 @@ public:
     uint32_t without_completion_send_signal_interval;
     /** context for the polling thread */
     verbs_sender_ctxt without_completion_sender_ctxt;
+    /** Memory Regions and buffers registered by register_next_buffers(), or null. */
+    struct ibv_mr *next_write_mr = nullptr;
+    struct ibv_mr *next_read_mr = nullptr;
+    char *next_write_buf = nullptr;
+    char *next_read_buf = nullptr;
+    /** Memory Regions replaced by the last switch_buffers(), or null once released. */
+    struct ibv_mr *previous_write_mr = nullptr;
+    struct ibv_mr *previous_read_mr = nullptr;
 
     /** Constructor; initializes Queue Pair, Memory Regions, and `remote_props`.
      */
@@ -103,6 +111,27 @@ public:
                int size_r);
     /** Destroys the resources. */
     virtual ~_resources();
+
+    /**
+     * Registers a new pair of write and read buffers, which replace the
+     * current ones when switch_buffers() is called. The queue pair is not
+     * affected, so the remote node only needs to learn the key and address of
+     * the new write buffer to start using it.
+     * @return The key that the remote node must use to access write_addr
+     */
+    uint64_t register_next_buffers(char *write_addr, char *read_addr, int size_w, int size_r);
+    /** Deregisters the buffers from register_next_buffers() without using them. */
+    void discard_next_buffers();
+    /**
+     * Makes the buffers from register_next_buffers() the current write and
+     * read buffers, and directs all further remote operations to the remote
+     * node's buffer with the given key and address. The previous buffers stay
+     * registered until release_previous_buffers() is called, since operations
+     * that were already posted on them may not have completed.
+     */
+    void switch_buffers(uint64_t remote_key, uint64_t remote_addr);
+    /** Deregisters the buffers that were replaced by the last switch_buffers(). */
+    void release_previous_buffers();
 };
 
 class resources : public _resources {
@@ -162,6 +191,22 @@ bool remove_node(uint32_t node_id);
  * @param r_index The node rank of the node to exchange data with.
  */
 bool sync(uint32_t r_index);
+/**
+ * Moves an existing connection to a remote node onto a new pair of buffers,
+ * exchanging the new buffer's key and address with the remote node over TCP
+ * instead of connecting again. The remote node must call this function for
+ * the same connection at the same time.
+ * @param res The connection, or null if this node can no longer use it; the
+ * exchange is still done, so that the remote node learns that it must
+ * connect again
+ * @param r_index The node rank of the remote node
+ * @param write_addr, read_addr, size_w, size_r The new buffers, as in the
+ * resources constructor
+ * @return True if both nodes switched their connection to the new buffers;
+ * false if either of them could not, in which case res is left unchanged
+ */
+bool switch_connection_buffers(resources* res, uint32_t r_index, char* write_addr, char* read_addr,
+                               int size_w, int size_r);
 /**
  * Compares the set of external client connections to a list of known live nodes and
  * removes any connections to nodes not in that list. This is used to filter out
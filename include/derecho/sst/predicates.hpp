@@ -1,10 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <utility>
+#include <vector>
 
 
 namespace sst {
@@ -24,44 +29,94 @@ enum class PredicateType {
     TRANSITION
 };
 
+/**
+ * The affinity of predicates that do not belong to any subgroup, such as the
+ * ones managing views; they are always evaluated by the first predicate
+ * evaluation thread.
+ */
+constexpr int32_t NO_AFFINITY = -1;
+
 template <class DerivedSST>
 class Predicates {
     using pred = std::function<bool(const DerivedSST&)>;
     using trig = std::function<void(DerivedSST&)>;
     using pred_list = std::list<std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>>;
-    /** Predicate list for one-time predicates. */
-    pred_list one_time_predicates;
-    /** Predicate list for recurrent predicates */
-    pred_list recurrent_predicates;
-    /** Predicate list for transition predicates */
-    pred_list transition_predicates;
-    /** Contains one entry for every predicate in `transition_predicates`, in parallel. */
-    std::list<bool> transition_predicate_states;
+
+    /**
+     * The predicates evaluated by one predicate evaluation thread. Predicates
+     * with the same affinity always land in the same partition, so they are
+     * evaluated, and their triggers run, in the order they were inserted.
+     */
+    struct Partition {
+        /** Predicate list for one-time predicates. */
+        pred_list one_time_predicates;
+        /** Predicate list for recurrent predicates */
+        pred_list recurrent_predicates;
+        /** Predicate list for transition predicates */
+        pred_list transition_predicates;
+        /** Contains one entry for every predicate in `transition_predicates`, in parallel. */
+        std::list<bool> transition_predicate_states;
+        /** Guards the predicate lists. */
+        std::mutex predicate_mutex;
+        /** Held by the evaluation thread while it runs a trigger. */
+        std::mutex trigger_mutex;
+        /** The thread evaluating this partition. */
+        std::atomic<std::thread::id> evaluator;
+    };
+    std::vector<std::unique_ptr<Partition>> partitions;
     // SST needs to read these predicate lists directly
     friend class SST<DerivedSST>;
 
-    std::mutex predicate_mutex;
+    /** Maps an affinity to the index of the partition evaluating it. */
+    uint32_t partition_of(int32_t affinity) const {
+        if(affinity < 0 || partitions.size() == 1) {
+            return 0;
+        }
+        // The first partition is kept for predicates without affinity, so that
+        // a slow subgroup never delays failure detection or view changes.
+        return 1 + static_cast<uint32_t>(affinity) % (partitions.size() - 1);
+    }
+
+    /**
+     * Waits for the trigger currently running in a subgroup partition, if
+     * any, to finish. This keeps the guarantee of a single evaluation thread
+     * that a trigger removing other predicates (e.g. wedging a view) never
+     * runs concurrently with their triggers afterwards. The first partition
+     * is never waited for, since its triggers may take locks held by callers
+     * of remove().
+     */
+    void wait_for_trigger(Partition& partition) {
+        if(&partition == partitions.front().get()) {
+            return;
+        }
+        // A trigger removing predicates of its own partition must not wait for itself.
+        if(partition.evaluator.load() != std::this_thread::get_id()) {
+            std::lock_guard<std::mutex> lock(partition.trigger_mutex);
+        }
+    }
 
 public:
     class pred_handle {
         bool valid;
         typename pred_list::iterator iter;
         PredicateType type;
+        uint32_t partition;
         friend class Predicates;
 
     public:
-        pred_handle() : valid(false), type(PredicateType::ONE_TIME) {}
-        pred_handle(typename pred_list::iterator iter, PredicateType type)
-                : valid{true}, iter{iter}, type{type} {}
+        pred_handle() : valid(false), type(PredicateType::ONE_TIME), partition(0) {}
+        pred_handle(typename pred_list::iterator iter, PredicateType type, uint32_t partition)
+                : valid{true}, iter{iter}, type{type}, partition{partition} {}
         pred_handle(pred_handle&) = delete;
         pred_handle(pred_handle&& other)
-                : pred_handle(std::move(other.iter), other.type) {
+                : pred_handle(std::move(other.iter), other.type, other.partition) {
             other.valid = false;
         }
         pred_handle& operator=(pred_handle&) = delete;
         pred_handle& operator=(pred_handle&& other) {
             iter = std::move(other.iter);
             type = other.type;
+            partition = other.partition;
             valid = true;
             other.valid = false;
             return *this;
@@ -71,22 +126,46 @@ public:
         }
     };
 
-    /** Inserts a single (predicate, trigger) pair to the appropriate predicate list. */
+    /**
+     * @param num_partitions The number of predicate evaluation threads that
+     * will share the predicates.
+     */
+    Predicates(uint32_t num_partitions = 1) {
+        for(uint32_t i = 0; i < std::max(num_partitions, 1u); ++i) {
+            partitions.emplace_back(std::make_unique<Partition>());
+        }
+    }
+
+    /** @return the number of predicate evaluation threads */
+    uint32_t num_partitions() const { return partitions.size(); }
+
+    /**
+     * Inserts a single (predicate, trigger) pair to the appropriate predicate
+     * list. Predicates with the same affinity are evaluated in order by the
+     * same thread; predicates with different affinities (e.g. different
+     * subgroups) may be evaluated in parallel.
+     */
     pred_handle insert(pred predicate, trig trigger,
-                       PredicateType type = PredicateType::ONE_TIME);
+                       PredicateType type = PredicateType::ONE_TIME,
+                       int32_t affinity = NO_AFFINITY);
 
     /** Inserts a predicate with a list of triggers (which will be run in
      * sequence) to the appropriate predicate list. */
     pred_handle insert(pred predicate, const std::list<trig>& triggers,
-                       PredicateType type = PredicateType::ONE_TIME) {
+                       PredicateType type = PredicateType::ONE_TIME,
+                       int32_t affinity = NO_AFFINITY) {
         return insert(predicate, [triggers](DerivedSST& t) {
             for(const auto& trigger : triggers)
                 trigger(t);
         },
-                      type);
+                      type, affinity);
     }
 
-    /** Removes a (predicate, trigger) pair previously registered with insert(). */
+    /**
+     * Removes a (predicate, trigger) pair previously registered with insert().
+     * If a trigger of its partition is running on another evaluation thread,
+     * this waits for that trigger to finish (see wait_for_trigger()).
+     */
     void remove(pred_handle& pred);
 
     /** Deletes all predicates, including evolvers and their triggers. */
@@ -102,46 +181,59 @@ public:
  * @param trigger The trigger to execute when the predicate is true.
  * @param type The type of predicate being inserted; default is
  * PredicateType::ONE_TIME
+ * @param affinity The key, usually a subgroup ID, choosing the evaluation
+ * thread of the predicate; default is NO_AFFINITY
  */
 template <class DerivedSST>
-auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type) -> pred_handle {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
+auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type, int32_t affinity) -> pred_handle {
+    const uint32_t partition_index = partition_of(affinity);
+    Partition& partition = *partitions[partition_index];
+    std::lock_guard<std::mutex> lock(partition.predicate_mutex);
     if(type == PredicateType::ONE_TIME) {
-        one_time_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
+        partition.one_time_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
                 predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--one_time_predicates.end(), type);
+        return pred_handle(--partition.one_time_predicates.end(), type, partition_index);
     } else if(type == PredicateType::RECURRENT) {
-        recurrent_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
+        partition.recurrent_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
                 predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--recurrent_predicates.end(), type);
+        return pred_handle(--partition.recurrent_predicates.end(), type, partition_index);
     } else {
-        transition_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
+        partition.transition_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
                 predicate, std::make_shared<trig>(trigger)));
-        transition_predicate_states.push_back(false);
-        return pred_handle(--transition_predicates.end(), type);
+        partition.transition_predicate_states.push_back(false);
+        return pred_handle(--partition.transition_predicates.end(), type, partition_index);
     }
 }
 
 template <class DerivedSST>
 void Predicates<DerivedSST>::remove(pred_handle& handle) {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
-    if(!handle.is_valid()) {
-        return;
+    Partition& partition = *partitions[handle.partition];
+    {
+        std::lock_guard<std::mutex> lock(partition.predicate_mutex);
+        if(!handle.is_valid()) {
+            return;
+        }
+        handle.iter->reset();
+        handle.valid = false;
     }
-    handle.iter->reset();
-    handle.valid = false;
+    wait_for_trigger(partition);
 }
 
 template <class DerivedSST>
 void Predicates<DerivedSST>::clear() {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
     using ptr_to_pred = std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>;
-    std::for_each(one_time_predicates.begin(), one_time_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(recurrent_predicates.begin(), recurrent_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(transition_predicates.begin(), transition_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
+    for(auto& partition : partitions) {
+        {
+            std::lock_guard<std::mutex> lock(partition->predicate_mutex);
+            std::for_each(partition->one_time_predicates.begin(), partition->one_time_predicates.end(),
+                          [](ptr_to_pred& ptr) { ptr.reset(); });
+            std::for_each(partition->recurrent_predicates.begin(), partition->recurrent_predicates.end(),
+                          [](ptr_to_pred& ptr) { ptr.reset(); });
+            std::for_each(partition->transition_predicates.begin(), partition->transition_predicates.end(),
+                          [](ptr_to_pred& ptr) { ptr.reset(); });
+        }
+        wait_for_trigger(*partition);
+    }
 }
 
 } /* namespace sst */
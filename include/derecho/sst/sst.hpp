@@ -7,9 +7,11 @@
 #include <functional>
 #include <iostream>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <numeric>
+#include <shared_mutex>
 #include <stdexcept>
 #include <string.h>
 #include <string>
@@ -131,6 +133,7 @@ struct SSTParams {
     const failure_upcall_t failure_upcall;
     const std::vector<char> already_failed;
     const bool start_predicate_thread;
+    const std::map<uint32_t, std::shared_ptr<resources>> reused_connections;
 
     /**
      *
@@ -147,17 +150,24 @@ struct SSTParams {
      * should be started immediately on construction of the SST. If false,
      * predicate evaluation will not start until start_predicate_evalution()
      * is called.
+     * @param reused_connections Connections to members of this SST that were
+     * detached from a previous SST (see SST::detach_connection()), by member
+     * ID. Each of these members must supply a connection for this node in
+     * return; the entry may be null if the previous connection is no longer
+     * usable, in which case a new one is made.
      */
     SSTParams(const std::vector<uint32_t>& _members,
               const uint32_t my_node_id,
               const failure_upcall_t failure_upcall = nullptr,
               const std::vector<char> already_failed = {},
-              const bool start_predicate_thread = true)
+              const bool start_predicate_thread = true,
+              const std::map<uint32_t, std::shared_ptr<resources>> reused_connections = {})
             : members(_members),
               my_node_id(my_node_id),
               failure_upcall(failure_upcall),
               already_failed(already_failed),
-              start_predicate_thread(start_predicate_thread) {}
+              start_predicate_thread(start_predicate_thread),
+              reused_connections(reused_connections) {}
 };
 
 template <class DerivedSST>
@@ -178,7 +188,8 @@ private:
     std::vector<std::thread> background_threads;
     std::atomic<bool> thread_shutdown;
 
-    void detect();
+    void detect(uint32_t partition_index);
+    void pin_predicate_thread(uint32_t partition_index);
 
 public:
     Predicates<DerivedSST> predicates;
@@ -213,11 +224,18 @@ private:
     int num_frozen{0};
     /** The function to call when a remote node appears to have failed. */
     failure_upcall_t failure_upcall;
-    /** Mutex for failure detection and row freezing. */
-    std::mutex freeze_mutex;
+    /**
+     * Mutex for failure detection and row freezing. Writes to remote rows
+     * hold it shared while they check row_is_frozen and post, so a row
+     * frozen under the exclusive lock gets no more writes once it is taken.
+     */
+    std::shared_mutex freeze_mutex;
 
-    /** RDMA resources vector, one for each member. */
-    std::vector<std::unique_ptr<resources>> res_vec;
+    /** RDMA resources vector, one for each member. These are shared so that
+     * a later SST can take over a connection with detach_connection(). */
+    std::vector<std::shared_ptr<resources>> res_vec;
+    /** Connections handed over by a previous SST, consumed by SSTInit(). */
+    std::map<uint32_t, std::shared_ptr<resources>> reused_connections;
 
     /** Indicates whether the predicate evaluation thread should start after being
      * forked in the constructor. */
@@ -227,10 +245,23 @@ private:
     /** Notified when the predicate evaluation thread should start. */
     std::condition_variable thread_start_cv;
 
+    /** Number of put() calls, used to wake up idle predicate evaluation threads. */
+    std::atomic<uint64_t> local_write_count;
+    /** Number of predicate evaluation threads waiting on idle_cv. */
+    std::atomic<uint32_t> num_idle_waiters;
+    /** Mutex for idle_cv. */
+    std::mutex idle_mutex;
+    /** Notified after a local write, or on shutdown. */
+    std::condition_variable idle_cv;
+
+    /** Wakes up the predicate evaluation threads waiting for a local write. */
+    void notify_local_write();
+
 public:
     SST(DerivedSST* derived_class_pointer, const SSTParams& params)
             : derived_this(derived_class_pointer),
               thread_shutdown(false),
+              predicates(derecho::getConfUInt32(CONF_DERECHO_SST_PREDICATE_THREADS)),
               poll_cq_timeout_ms(derecho::getConfUInt32(CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS)),
               members(params.members),
               num_members(members.size()),
@@ -239,7 +270,10 @@ public:
               row_is_frozen(num_members),
               failure_upcall(params.failure_upcall),
               res_vec(num_members),
-              thread_start(params.start_predicate_thread) {
+              reused_connections(params.reused_connections),
+              thread_start(params.start_predicate_thread),
+              local_write_count(0),
+              num_idle_waiters(0) {
         //Figure out my SST index
         my_index = (uint)-1;
         for(uint32_t i = 0; i < num_members; ++i) {
@@ -284,20 +318,31 @@ public:
                 if(row_is_frozen[sst_index]) {
                     continue;
                 }
+                auto reused = reused_connections.find(node_rank);
+                // The remote node expects to reuse its connection too, so the
+                // buffer exchange happens even if this side's connection is gone
+                if(reused != reused_connections.end()
+                   && switch_connection_buffers(reused->second.get(), node_rank,
+                                                write_addr, read_addr, rowLen, rowLen)) {
+                    res_vec[sst_index] = reused->second;
+                    continue;
+                }
 #ifdef USE_VERBS_API
-                res_vec[sst_index] = std::make_unique<resources>(
+                res_vec[sst_index] = std::make_shared<resources>(
                         node_rank, write_addr, read_addr, rowLen, rowLen);
 #else  // use libfabric api by default
-                res_vec[sst_index] = std::make_unique<resources>(
+                res_vec[sst_index] = std::make_shared<resources>(
                         node_rank, write_addr, read_addr, rowLen, rowLen, (my_node_id < node_rank));
 #endif
                 // update qp_num_to_index
                 // qp_num_to_index[res_vec[sst_index].get()->qp->qp_num] = sst_index;
             }
         }
+        reused_connections.clear();
 
-        std::thread detector(&SST::detect, this);
-        background_threads.push_back(std::move(detector));
+        for(uint32_t partition_index = 0; partition_index < predicates.num_partitions(); ++partition_index) {
+            background_threads.emplace_back(&SST::detect, this, partition_index);
+        }
     }
 
     ~SST();
@@ -315,6 +360,29 @@ public:
      * node will not receive writes. */
     void freeze(int row_index);
 
+    /**
+     * Hands this SST's connection to a member over to a new SST, which
+     * reuses it instead of connecting again. The member's row is frozen
+     * without a failure upcall, and this returns once no write of this SST
+     * to it is in progress, so the new SST can switch its buffers.
+     * @param node_id The ID of the member
+     * @return The connection, or null if the member's row was already frozen
+     */
+    std::shared_ptr<resources> detach_connection(uint32_t node_id);
+
+    /**
+     * Deregisters the previous SST's buffers from the connections that were
+     * reused by this SST. Call this once every member has finished SSTInit(),
+     * e.g. after sync_with_members(), so no remote writes to them remain.
+     */
+    void release_previous_buffers() {
+        for(const auto& res : res_vec) {
+            if(res) {
+                res->release_previous_buffers();
+            }
+        }
+    }
+
     /** Returns the total number of rows in the table. */
     unsigned int get_num_rows() const { return num_members; }
 
@@ -149,6 +149,13 @@ public:
     /** Returns true if there is any data available to be read from the socket. */
     bool probe();
 
+    /**
+     * Shuts down both directions of the connection, so that a read or write
+     * blocked on it in another thread fails with a socket_error. The socket
+     * stays open, but can't be used again, until it is destroyed.
+     */
+    void shutdown();
+
     /**
      * Writes size bytes from the given buffer to the socket.
      * @param buffer A pointer to a byte buffer whose data should be sent over
@@ -0,0 +1,74 @@
+/**
+ * @file mpsc_queue.hpp
+ *
+ * A lock-free, unbounded, multi-producer single-consumer queue.
+ */
+
+#pragma once
+#include <atomic>
+#include <utility>
+
+namespace derecho {
+
+/**
+ * An intrusive-node MPSC queue (D. Vyukov's algorithm). Any number of threads
+ * may call push() concurrently, but only one thread at a time may call pop().
+ * push() is wait-free; pop() is lock-free, but may transiently report the queue
+ * as empty while a producer is between its two steps, so a consumer that knows
+ * an element is coming should retry.
+ */
+template <typename T>
+class MPSCQueue {
+    struct Node {
+        std::atomic<Node*> next;
+        T value;
+        Node() : next(nullptr), value() {}
+        Node(T&& v) : next(nullptr), value(std::move(v)) {}
+    };
+    /** Producers swap themselves in here */
+    std::atomic<Node*> head;
+    /** Owned by the consumer; always points to a "stub" node whose value was consumed */
+    Node* tail;
+
+public:
+    MPSCQueue() : head(new Node()), tail(head.load(std::memory_order_relaxed)) {}
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    ~MPSCQueue() {
+        T discard;
+        while(pop(discard))
+            ;
+        delete tail;
+    }
+
+    /** Enqueues a value; safe to call from any thread. */
+    void push(T value) {
+        Node* node = new Node(std::move(value));
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * Dequeues a value; must only be called by one thread at a time.
+     * @param value Set to the dequeued value on success
+     * @return false if the queue was (or appeared to be) empty
+     */
+    bool pop(T& value) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if(next == nullptr) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+    /** @return true if the queue appears empty to the consumer. */
+    bool empty() const {
+        return tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+};
+
+}  // namespace derecho
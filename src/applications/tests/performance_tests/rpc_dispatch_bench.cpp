@@ -0,0 +1,91 @@
+/*
+ * This microbenchmark measures the cost of finding and calling the receive
+ * function for an incoming RPC message as a function of 1. the number of
+ * subgroups 2. the number of RPC functions per subgroup, comparing the lookup
+ * in RPCManager's std::map<Opcode, receive_fun_t> with the lookup in an
+ * OpcodeDispatchTable built from the same map. Every subgroup has a "call"
+ * and a "reply" receive function for each RPC function, like a Replicated<T>
+ * that is also a member of its subgroup. It runs on a single node and the
+ * receive functions do nothing, so only the dispatch is measured.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <derecho/core/detail/opcode_dispatch_table.hpp>
+
+using std::cout;
+using std::endl;
+
+using namespace derecho;
+using namespace derecho::rpc;
+
+int main(int argc, char* argv[]) {
+    if(argc < 3) {
+        cout << "Usage: " << argv[0] << " <num_subgroups> <functions_per_subgroup> [num_lookups]" << endl;
+        return -1;
+    }
+    const uint32_t num_subgroups = std::stoi(argv[1]);
+    const uint32_t functions_per_subgroup = std::stoi(argv[2]);
+    const uint32_t num_lookups = argc > 3 ? std::stoi(argv[3]) : 10000000;
+
+    std::map<Opcode, receive_fun_t> receivers;
+    std::vector<Opcode> opcodes;
+    uint64_t num_calls = 0;
+    for(subgroup_id_t subgroup_id = 0; subgroup_id < num_subgroups; ++subgroup_id) {
+        // a few different subgroup types, as in a typical Group
+        const subgroup_type_id_t class_id = subgroup_id % 3;
+        for(uint32_t function = 0; function < functions_per_subgroup; ++function) {
+            const FunctionTag tag = to_internal_tag<true>(hash_cstr("function_" + std::to_string(function)));
+            for(const bool is_reply : {false, true}) {
+                const Opcode opcode{class_id, subgroup_id, tag, is_reply};
+                receivers.emplace(opcode, [&num_calls](mutils::RemoteDeserialization_v*, const node_id_t&,
+                                                       const char*, const std::function<char*(int)>&) {
+                    num_calls++;
+                    return recv_ret{Opcode(), 0, nullptr, nullptr};
+                });
+                opcodes.push_back(opcode);
+            }
+        }
+    }
+    const OpcodeDispatchTable dispatch_table(receivers);
+
+    // A random stream of incoming opcodes, the same for both lookups
+    std::mt19937 generator(0);
+    std::uniform_int_distribution<std::size_t> distribution(0, opcodes.size() - 1);
+    std::vector<Opcode> incoming(1 << 16);
+    for(Opcode& opcode : incoming) {
+        opcode = opcodes[distribution(generator)];
+    }
+
+    mutils::RemoteDeserialization_v rdv;
+    const std::function<char*(int)> out_alloc = [](int) -> char* { return nullptr; };
+    auto measure = [&](auto&& lookup) {
+        num_calls = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t i = 0; i < num_lookups; ++i) {
+            const receive_fun_t* function = lookup(incoming[i & (incoming.size() - 1)]);
+            (*function)(&rdv, 0, nullptr, out_alloc);
+        }
+        auto end = std::chrono::steady_clock::now();
+        if(num_calls != num_lookups) {
+            cout << "Unexpected number of calls" << endl;
+        }
+        return std::chrono::duration<double, std::nano>(end - start).count() / num_lookups;
+    };
+
+    const double map_ns = measure([&](const Opcode& opcode) {
+        return &receivers.find(opcode)->second;
+    });
+    const double table_ns = measure([&](const Opcode& opcode) {
+        return dispatch_table.find(opcode);
+    });
+    cout << "subgroups: " << num_subgroups << ", functions per subgroup: " << functions_per_subgroup
+         << ", receive functions: " << receivers.size() << endl;
+    cout << "std::map dispatch:      " << map_ns << " ns per message" << endl;
+    cout << "dispatch table:         " << table_ns << " ns per message" << endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * This microbenchmark measures the cost of the sender's "can I send in this
+ * subgroup" check as a function of 1. the number of subgroups 2. the number of
+ * members per shard. It times MulticastGroup::window_has_room, the check the
+ * sender thread and get_sendbuffer_ptr run, over the precomputed
+ * SubgroupHotSettings. For reference, it also times a reconstruction of how
+ * the check used to be written (looking up SubgroupSettings in a map, copying
+ * the senders and members vectors, counting senders and mapping node IDs to
+ * SST rows on every evaluation). It runs on a single node: the delivered_num
+ * and num_received fields are laid out in a local buffer with the same row
+ * layout as the SST, so only the bookkeeping around the SST reads is measured.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <vector>
+
+#include <derecho/core/detail/multicast_group.hpp>
+
+using std::cout;
+using std::endl;
+
+using namespace derecho;
+
+int main(int argc, char* argv[]) {
+    if(argc < 3) {
+        cout << "Usage: " << argv[0] << " <num_subgroups> <shard_size> [num_rounds]" << endl;
+        return -1;
+    }
+    const uint32_t num_subgroups = std::stoi(argv[1]);
+    const uint32_t shard_size = std::stoi(argv[2]);
+    const uint32_t num_rounds = argc > 3 ? std::stoi(argv[3]) : 10000;
+    const uint32_t num_nodes = shard_size;
+    const int32_t window_size = 16;
+
+    // Every node is a member and a sender of every subgroup
+    std::vector<node_id_t> members(num_nodes);
+    std::iota(members.begin(), members.end(), 100);
+    std::map<node_id_t, uint32_t> node_id_to_sst_index;
+    for(uint32_t i = 0; i < num_nodes; ++i) {
+        node_id_to_sst_index[members[i]] = i;
+    }
+    std::map<subgroup_id_t, SubgroupSettings> settings_map;
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < num_subgroups; ++subgroup_num) {
+        SubgroupSettings settings{};
+        settings.members = members;
+        settings.senders = std::vector<int>(shard_size, 1);
+        settings.sender_rank = 0;
+        settings.num_received_offset = subgroup_num * shard_size;
+        settings.mode = Mode::ORDERED;
+        settings.profile.window_size = window_size;
+        settings_map.emplace(subgroup_num, settings);
+    }
+    const std::vector<SubgroupHotSettings> hot_settings
+            = MulticastGroup::compute_hot_settings(members, num_subgroups, settings_map);
+
+    // The SST rows hold delivered_num followed by num_received, as in DerechoSST
+    sst::SSTFieldVector<message_id_t> delivered_num(num_subgroups);
+    sst::SSTFieldVector<int32_t> num_received(num_subgroups * shard_size);
+    const std::size_t row_len = sst::padded_len(delivered_num.field_len) + sst::padded_len(num_received.field_len);
+    std::vector<long long> sst_rows((row_len * num_nodes) / sizeof(long long) + 1);
+    volatile char* base = reinterpret_cast<volatile char*>(sst_rows.data());
+    num_received.set_base(base + delivered_num.set_base(base));
+    delivered_num.set_rowLen(row_len);
+    num_received.set_rowLen(row_len);
+    // Low enough that every check fails, so that the sender thread would
+    // re-evaluate every subgroup on every wake
+    for(uint32_t row = 0; row < num_nodes; ++row) {
+        for(subgroup_id_t subgroup_num = 0; subgroup_num < num_subgroups; ++subgroup_num) {
+            delivered_num[row][subgroup_num] = -1;
+        }
+    }
+    const message_id_t msg_index = window_size + 1;
+
+    auto old_check = [&](subgroup_id_t subgroup_num) {
+        const SubgroupSettings& subgroup_settings = settings_map.at(subgroup_num);
+        std::vector<int> shard_senders = subgroup_settings.senders;
+        std::vector<node_id_t> shard_members = subgroup_settings.members;
+        uint32_t num_shard_senders = 0;
+        for(const auto i : shard_senders) {
+            if(i) {
+                num_shard_senders++;
+            }
+        }
+        const int32_t threshold = (msg_index - subgroup_settings.profile.window_size) * num_shard_senders
+                                  + subgroup_settings.sender_rank;
+        for(node_id_t node : shard_members) {
+            if(delivered_num[node_id_to_sst_index.at(node)][subgroup_num] < threshold) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto new_check = [&](subgroup_id_t subgroup_num) {
+        return MulticastGroup::window_has_room(hot_settings[subgroup_num], subgroup_num,
+                                               delivered_num, num_received, msg_index);
+    };
+
+    auto measure = [&](auto&& check) {
+        uint64_t num_true = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t round = 0; round < num_rounds; ++round) {
+            for(subgroup_id_t subgroup_num = 0; subgroup_num < num_subgroups; ++subgroup_num) {
+                num_true += check(subgroup_num);
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        // keep the checks from being optimized away
+        if(num_true != 0) {
+            cout << "Unexpected result" << endl;
+        }
+        return std::chrono::duration<double, std::nano>(end - start).count() / (double(num_rounds) * num_subgroups);
+    };
+
+    const double old_ns = measure(old_check);
+    const double new_ns = measure(new_check);
+    cout << "subgroups: " << num_subgroups << ", shard size: " << shard_size << endl;
+    cout << "copying check (reference): " << old_ns << " ns per subgroup, " << old_ns * num_subgroups / 1000.0 << " us per wake" << endl;
+    cout << "window_has_room:           " << new_ns << " ns per subgroup, " << new_ns * num_subgroups / 1000.0 << " us per wake" << endl;
+    return 0;
+}
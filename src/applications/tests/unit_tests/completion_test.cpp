@@ -0,0 +1,154 @@
+/**
+ * @file completion_test.cpp
+ *
+ * Tests Completion: it is set exactly once, waiters sleeping on its futex are
+ * woken up, and a continuation registered with then() runs exactly once
+ * whether it races with the thread setting the completion or not.
+ */
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <derecho/core/detail/completion.hpp>
+
+#include "test_checks.hpp"
+
+using derecho::rpc::Completion;
+using derecho::test::check;
+
+void test_set_once() {
+    Completion<int> completion;
+    check(!completion.is_ready(), "a new completion is not ready");
+    check(completion.set_value(1), "the first set_value sets the completion");
+    check(!completion.set_value(2), "a second set_value is ignored");
+    check(!completion.set_exception(std::make_exception_ptr(std::runtime_error("late"))),
+          "set_exception after set_value is ignored");
+    check(completion.is_ready() && completion.get() == 1, "get returns the first value");
+
+    Completion<int> failed;
+    failed.set_exception(std::make_exception_ptr(std::runtime_error("failed")));
+    bool thrown = false;
+    try {
+        failed.get();
+    } catch(const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "get rethrows the exception");
+
+    completion.reset();
+    check(!completion.is_ready(), "reset makes the completion reusable");
+    completion.set_value(3);
+    check(completion.get() == 3, "a reset completion takes a new value");
+
+    Completion<void> event;
+    check(event.set_value() && !event.set_value(), "Completion<void> is set once");
+    event.get();
+}
+
+void test_concurrent_setters(int num_threads) {
+    Completion<int> completion;
+    std::atomic<int> num_set{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> setters;
+    for(int i = 0; i < num_threads; ++i) {
+        setters.emplace_back([&, i]() {
+            while(!start) {
+            }
+            if(completion.set_value(i)) {
+                num_set++;
+            }
+        });
+    }
+    start = true;
+    for(auto& setter : setters) {
+        setter.join();
+    }
+    check(num_set == 1, "exactly one of several racing setters sets the completion");
+}
+
+void test_waiters_woken(int num_waiters) {
+    Completion<int> completion;
+    std::atomic<int> num_woken{0};
+    std::vector<std::thread> waiters;
+    for(int i = 0; i < num_waiters; ++i) {
+        waiters.emplace_back([&]() {
+            if(completion.get() == 42) {
+                num_woken++;
+            }
+        });
+    }
+    // Give the waiters time to go to sleep on the futex
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    completion.set_value(42);
+    for(auto& waiter : waiters) {
+        waiter.join();
+    }
+    check(num_woken == num_waiters, "set_value wakes up every sleeping waiter");
+
+    Completion<void> never_set;
+    const auto start = std::chrono::steady_clock::now();
+    check(!never_set.wait_for(std::chrono::milliseconds(20)), "wait_for times out if the completion is not set");
+    check(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20), "wait_for waits for the whole timeout");
+
+    Completion<void> set_later;
+    std::thread setter([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        set_later.set_value();
+    });
+    check(set_later.wait_for(std::chrono::seconds(10)), "wait_for returns once the completion is set");
+    setter.join();
+}
+
+void test_then() {
+    Completion<int> before;
+    std::thread::id ran_on;
+    int seen = 0;
+    before.then([&]() {
+        ran_on = std::this_thread::get_id();
+        seen = before.get();
+    });
+    std::thread setter([&]() { before.set_value(5); });
+    const std::thread::id setter_id = setter.get_id();
+    setter.join();
+    check(seen == 5 && ran_on == setter_id, "a continuation registered first runs on the setting thread");
+
+    Completion<int> after;
+    after.set_value(6);
+    seen = 0;
+    after.then([&]() { seen = after.get(); });
+    check(seen == 6, "a continuation registered after the value runs right away");
+}
+
+void test_then_races_publish(int iterations) {
+    Completion<int> completion;
+    std::atomic<int> runs{0};
+    bool exactly_once = true;
+    for(int i = 0; i < iterations; ++i) {
+        completion.reset();
+        runs = 0;
+        std::atomic<bool> start{false};
+        std::thread setter([&]() {
+            while(!start) {
+            }
+            completion.set_value(i);
+        });
+        start = true;
+        completion.then([&]() { runs++; });
+        setter.join();
+        exactly_once = exactly_once && runs == 1 && completion.get() == i;
+    }
+    check(exactly_once, "a continuation racing with set_value runs exactly once");
+}
+
+int main(int argc, char** argv) {
+    test_set_once();
+    test_concurrent_setters(8);
+    test_waiters_woken(8);
+    test_then();
+    test_then_races_publish(10000);
+    return derecho::test::report_checks();
+}
@@ -0,0 +1,136 @@
+/**
+ * @file delta_checkpoint_test.cpp
+ *
+ * Tests DeltaStateCache and the checkpoints of Persistent<T> for objects
+ * implementing IDeltaSupport, including reloading a log that has checkpoints.
+ */
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/persistent/Persistent.hpp>
+
+#include "test_checks.hpp"
+
+using namespace persistent;
+using derecho::test::check;
+
+class IntegerWithDelta : public mutils::ByteRepresentable, public IDeltaSupport<IntegerWithDelta> {
+public:
+    int value;
+    int delta;
+    IntegerWithDelta(int v) : value(v), delta(0) {}
+    IntegerWithDelta() : value(0), delta(0) {}
+    void add(int op) {
+        value += op;
+        delta += op;
+    }
+    virtual void finalizeCurrentDelta(const DeltaFinalizer& df) {
+        df((char const* const) & delta, sizeof(delta));
+        delta = 0;
+    }
+    virtual void applyDelta(char const* const pdat) {
+        value += *((const int* const)pdat);
+    }
+    static std::unique_ptr<IntegerWithDelta> create(mutils::DeserializationManager*) {
+        return std::make_unique<IntegerWithDelta>();
+    }
+
+    DEFAULT_SERIALIZATION_SUPPORT(IntegerWithDelta, value);
+};
+
+static DeltaStateCache::state_t make_state(char c) {
+    return std::make_shared<const std::vector<char>>(1, c);
+}
+
+void test_delta_state_cache() {
+    DeltaStateCache cache(2);
+    int64_t found_idx = INVALID_INDEX;
+    cache.put(1, make_state('a'));
+    cache.put(5, make_state('b'));
+    auto state = cache.find(4, 0, found_idx);
+    check(state && found_idx == 1 && (*state)[0] == 'a', "find returns the closest earlier state");
+    state = cache.find(9, 2, found_idx);
+    check(state && found_idx == 5 && (*state)[0] == 'b', "find returns the latest state at or before idx");
+    check(cache.find(0, 0, found_idx) == nullptr, "find returns nothing before the earliest state");
+    check(cache.find(4, 2, found_idx) == nullptr, "find ignores states before min_idx");
+    // 1 is now the least recently used
+    cache.put(7, make_state('c'));
+    check(cache.find(4, 0, found_idx) == nullptr, "put evicts the least recently used state");
+    state = cache.find(7, 0, found_idx);
+    check(state && found_idx == 7 && (*state)[0] == 'c', "put adds the new state");
+    cache.put(7, make_state('d'));
+    state = cache.find(8, 0, found_idx);
+    check(state && found_idx == 7 && (*state)[0] == 'd', "put replaces an existing state");
+    cache.clear();
+    check(cache.find(9, 0, found_idx) == nullptr, "clear drops all states");
+}
+
+static bool has_checkpoint(const std::string& path, version_t ver) {
+    const std::string suffix = "." + std::to_string(ver) + ".ckpt";
+    for(const auto& dent : std::filesystem::directory_iterator(path)) {
+        const std::string fname = dent.path().filename().string();
+        if(fname.size() > suffix.size()
+           && fname.compare(fname.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void test_checkpoint_reload(const std::string& path) {
+    auto factory = []() { return std::make_unique<IntegerWithDelta>(); };
+    // versions 0..9, adding ver + 1 each time; checkpoints every 4 versions
+    {
+        Persistent<IntegerWithDelta> dx(factory, "DeltaCheckpointTest", nullptr, false);
+        for(version_t ver = 0; ver < 10; ver++) {
+            dx->add(ver + 1);
+            dx.version(ver);
+            dx.persist(ver);
+        }
+        check(has_checkpoint(path, 3) && has_checkpoint(path, 7), "checkpoints are saved by persist()");
+        check(!has_checkpoint(path, 9), "no checkpoint before the interval is reached");
+    }
+    // reload: the state and every historical state come from the checkpoints and the deltas
+    {
+        Persistent<IntegerWithDelta> dx(factory, "DeltaCheckpointTest", nullptr, false);
+        check(dx->value == 55, "the reloaded state is the latest state");
+        for(int64_t idx = 0; idx < 10; idx++) {
+            check(dx.getByIndex(idx)->value == (idx + 1) * (idx + 2) / 2,
+                  "historical state at index " + std::to_string(idx));
+        }
+        // versions 8 and 9 count towards the next checkpoint after reloading
+        for(version_t ver = 10; ver < 12; ver++) {
+            dx->add(ver + 1);
+            dx.version(ver);
+            dx.persist(ver);
+        }
+        check(has_checkpoint(path, 11), "the checkpoint interval resumes after reloading");
+        check(dx.getByIndex(11)->value == 78, "historical state after the resumed checkpoint");
+    }
+}
+
+int main(int argc, char** argv) {
+    char path_template[] = "/tmp/delta_checkpoint_test.XXXXXX";
+    if(mkdtemp(path_template) == nullptr) {
+        std::cout << "Failed to create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string path(path_template);
+    std::string file_path_arg = std::string("--" CONF_PERS_FILE_PATH "=") + path;
+    std::string interval_arg = "--" CONF_PERS_DELTA_CHECKPOINT_INTERVAL "=4";
+    // The cache is off by default; the historical reads below go through it
+    std::string cache_size_arg = "--" CONF_PERS_DELTA_CACHE_SIZE "=2";
+    std::vector<char*> conf_argv = {argv[0], file_path_arg.data(), interval_arg.data(), cache_size_arg.data()};
+    derecho::Conf::initialize(conf_argv.size(), conf_argv.data());
+
+    test_delta_state_cache();
+    test_checkpoint_reload(path);
+
+    std::filesystem::remove_all(path);
+    return derecho::test::report_checks();
+}
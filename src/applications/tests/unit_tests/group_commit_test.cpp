@@ -0,0 +1,104 @@
+/**
+ * @file group_commit_test.cpp
+ *
+ * Tests the group commit of PersistentRegistry::persist(): the persisted
+ * versions of all the fields survive a reload through the group meta file, and
+ * a later truncation recorded in a field's own meta file takes precedence.
+ */
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <vector>
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/persistent/Persistent.hpp>
+
+#include "test_checks.hpp"
+
+using namespace persistent;
+using derecho::test::check;
+
+class Counter : public mutils::ByteRepresentable {
+public:
+    int value;
+    Counter(int v) : value(v) {}
+    Counter() : value(0) {}
+
+    DEFAULT_SERIALIZATION_SUPPORT(Counter, value);
+};
+
+struct GroupCommitTestObject {
+    PersistentRegistry registry;
+    Persistent<Counter> first;
+    Persistent<Counter> second;
+
+    GroupCommitTestObject()
+            : registry(nullptr, std::type_index(typeid(GroupCommitTestObject)), 0, 0),
+              first([]() { return std::make_unique<Counter>(); }, "GroupCommitTestFirst", &registry),
+              second([]() { return std::make_unique<Counter>(); }, "GroupCommitTestSecond", &registry) {}
+
+    void update(version_t ver) {
+        first->value = ver;
+        second->value = 2 * ver;
+        registry.makeVersion(ver, HLC());
+    }
+};
+
+void test_group_commit_reload(const std::string& path) {
+    {
+        GroupCommitTestObject object;
+        for(version_t ver = 0; ver < 4; ver++) {
+            object.update(ver);
+        }
+        object.registry.persist(3);
+        check(object.first.getLastPersistedVersion() == 3 && object.second.getLastPersistedVersion() == 3,
+              "persist() commits every field");
+        check(std::filesystem::exists(path + "/" GROUP_META_FILE), "persist() writes the group meta file");
+        // versions after the last persist are lost on reload
+        object.update(4);
+    }
+    {
+        GroupCommitTestObject object;
+        check(object.first.getLastPersistedVersion() == 3 && object.second.getLastPersistedVersion() == 3,
+              "reloading takes the persisted versions from the group meta file");
+        check(object.first.getLatestVersion() == 3 && object.second.getLatestVersion() == 3,
+              "reloading drops the versions that were not persisted");
+        check(object.first->value == 3 && object.second->value == 6, "reloading restores the latest state");
+        // the truncation is written to the meta files of the fields only
+        object.registry.truncate(1);
+    }
+    {
+        GroupCommitTestObject object;
+        check(object.first.getLatestVersion() == 1 && object.second.getLatestVersion() == 1,
+              "a truncation after the group commit takes precedence on reload");
+        check(object.first->value == 1 && object.second->value == 2, "reloading after a truncation");
+        object.update(5);
+        object.registry.persist(5);
+    }
+    {
+        GroupCommitTestObject object;
+        check(object.first.getLatestVersion() == 5 && object.second.getLatestVersion() == 5,
+              "a group commit after a truncation takes precedence on reload");
+    }
+}
+
+int main(int argc, char** argv) {
+    char path_template[] = "/tmp/group_commit_test.XXXXXX";
+    if(mkdtemp(path_template) == nullptr) {
+        std::cout << "Failed to create a temporary directory" << std::endl;
+        return 1;
+    }
+    const std::string path(path_template);
+    std::string file_path_arg = std::string("--" CONF_PERS_FILE_PATH "=") + path;
+    std::string group_commit_arg = "--" CONF_PERS_GROUP_COMMIT "=true";
+    std::vector<char*> conf_argv = {argv[0], file_path_arg.data(), group_commit_arg.data()};
+    derecho::Conf::initialize(conf_argv.size(), conf_argv.data());
+
+    test_group_commit_reload(path);
+
+    std::filesystem::remove_all(path);
+    return derecho::test::report_checks();
+}
@@ -0,0 +1,96 @@
+/**
+ * @file mpsc_queue_test.cpp
+ *
+ * Tests MPSCQueue with several producer threads and one consumer thread:
+ * every value is popped exactly once, and the values of each producer are
+ * popped in the order they were pushed.
+ */
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <derecho/utils/mpsc_queue.hpp>
+
+#include "test_checks.hpp"
+
+using derecho::MPSCQueue;
+using derecho::test::check;
+
+void test_single_thread() {
+    MPSCQueue<int> queue;
+    int value = -1;
+    check(queue.empty() && !queue.pop(value), "a new queue is empty");
+    for(int i = 0; i < 10; ++i) {
+        queue.push(i);
+    }
+    check(!queue.empty(), "a queue with values is not empty");
+    bool in_order = true;
+    for(int i = 0; i < 10; ++i) {
+        in_order = in_order && queue.pop(value) && value == i;
+    }
+    check(in_order, "values are popped in the order they were pushed");
+    check(queue.empty() && !queue.pop(value), "the queue is empty after popping every value");
+}
+
+void test_concurrent_producers(uint32_t num_producers, uint32_t values_per_producer) {
+    MPSCQueue<std::pair<uint32_t, uint32_t>> queue;
+    std::atomic<bool> start{false};
+    std::vector<std::thread> producers;
+    for(uint32_t producer = 0; producer < num_producers; ++producer) {
+        producers.emplace_back([&, producer]() {
+            while(!start.load()) {
+            }
+            for(uint32_t seq = 0; seq < values_per_producer; ++seq) {
+                queue.push({producer, seq});
+            }
+        });
+    }
+    std::vector<uint32_t> next_seq(num_producers, 0);
+    bool fifo_per_producer = true;
+    uint64_t popped = 0;
+    const uint64_t total = uint64_t{num_producers} * values_per_producer;
+    start = true;
+    while(popped < total) {
+        std::pair<uint32_t, uint32_t> value;
+        if(!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        fifo_per_producer = fifo_per_producer && value.first < num_producers
+                            && value.second == next_seq[value.first];
+        next_seq[value.first]++;
+        popped++;
+    }
+    for(auto& producer : producers) {
+        producer.join();
+    }
+    std::pair<uint32_t, uint32_t> extra;
+    check(fifo_per_producer, "each producer's values are popped in order");
+    check(!queue.pop(extra), "no value is popped twice");
+}
+
+void test_destroy_nonempty() {
+    // Values left in the queue are destroyed with it
+    std::shared_ptr<int> tracker = std::make_shared<int>(0);
+    {
+        MPSCQueue<std::shared_ptr<int>> queue;
+        for(int i = 0; i < 5; ++i) {
+            queue.push(tracker);
+        }
+        std::shared_ptr<int> value;
+        queue.pop(value);
+    }
+    check(tracker.use_count() == 1, "destroying the queue releases the remaining values");
+}
+
+int main(int argc, char** argv) {
+    test_single_thread();
+    test_concurrent_producers(8, 100000);
+    test_destroy_nonempty();
+    return derecho::test::report_checks();
+}
@@ -0,0 +1,92 @@
+/**
+ * @file opcode_dispatch_table_test.cpp
+ *
+ * Tests OpcodeDispatchTable against the receivers map it is built from: every
+ * opcode in the map finds its own receive function, and every other opcode,
+ * including ones in subgroups with no functions or past the last subgroup,
+ * finds nothing. The functions it finds still work after their entries are
+ * erased from the map.
+ */
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <derecho/core/detail/opcode_dispatch_table.hpp>
+
+#include "test_checks.hpp"
+
+using namespace derecho::rpc;
+using derecho::test::check;
+
+/** Makes a receive function that returns its tag as the reply size, to tell receivers apart */
+static receive_fun_t make_receiver(std::size_t tag) {
+    return [tag](mutils::RemoteDeserialization_v*, const node_id_t&, const char*,
+                 const std::function<char*(int)>&) { return recv_ret{Opcode{}, tag, nullptr, nullptr}; };
+}
+
+static std::size_t call_receiver(const receive_fun_t* receiver) {
+    return (*receiver)(nullptr, 0, nullptr, [](int) { return nullptr; }).size;
+}
+
+void test_empty_table() {
+    OpcodeDispatchTable empty;
+    check(empty.find(Opcode{0, 0, 0, false}) == nullptr, "an empty table finds nothing");
+    std::map<Opcode, receive_fun_t> receivers;
+    OpcodeDispatchTable from_empty_map(receivers);
+    check(from_empty_map.find(Opcode{0, 0, 0, false}) == nullptr, "a table built from an empty map finds nothing");
+}
+
+void test_lookup(uint32_t num_subgroups) {
+    // Every third subgroup has functions, with up to 16 per subgroup to force collisions
+    std::map<Opcode, receive_fun_t> receivers;
+    for(uint32_t subgroup = 0; subgroup < num_subgroups; subgroup += 3) {
+        for(uint32_t function = 0; function < subgroup % 17; ++function) {
+            for(bool is_reply : {false, true}) {
+                receivers.emplace(Opcode{subgroup % 4, subgroup, function * 7919ULL, is_reply}, make_receiver(receivers.size()));
+            }
+        }
+    }
+    OpcodeDispatchTable table(receivers);
+    bool all_found = true;
+    for(const auto& receiver : receivers) {
+        const receive_fun_t* found = table.find(receiver.first);
+        all_found = all_found && found && call_receiver(found) == call_receiver(&receiver.second);
+    }
+    check(all_found, "every opcode in the map finds its own receive function");
+
+    bool none_found = true;
+    for(uint32_t subgroup = 0; subgroup < num_subgroups + 10; ++subgroup) {
+        for(uint32_t function = 0; function < 20; ++function) {
+            for(bool is_reply : {false, true}) {
+                const Opcode opcode{subgroup % 4, subgroup, function * 7919ULL, is_reply};
+                if(receivers.find(opcode) == receivers.end()) {
+                    none_found = none_found && table.find(opcode) == nullptr;
+                }
+                // Same subgroup and function, but a different class
+                none_found = none_found && table.find(Opcode{subgroup % 4 + 1, subgroup, function * 7919ULL, is_reply}) == nullptr;
+            }
+        }
+    }
+    check(none_found, "opcodes that are not in the map find nothing");
+}
+
+void test_erased_receivers() {
+    std::map<Opcode, receive_fun_t> receivers;
+    const Opcode opcode{1, 2, 3, false};
+    receivers.emplace(opcode, make_receiver(42));
+    receivers.emplace(Opcode{1, 5, 3, false}, make_receiver(43));
+    OpcodeDispatchTable table(receivers);
+    const receive_fun_t* found = table.find(opcode);
+    // Like RPCManager::destroy_remote_invocable_class, while a message is being dispatched
+    receivers.clear();
+    check(found && call_receiver(found) == 42, "a receive function found in a table outlives its entry in the map");
+}
+
+int main(int argc, char** argv) {
+    test_empty_table();
+    test_lookup(60);
+    test_erased_receivers();
+    return derecho::test::report_checks();
+}
@@ -0,0 +1,369 @@
+/**
+ * @file p2p_chunking_test.cpp
+ *
+ * Tests the streaming of P2P messages larger than a slot through a loopback
+ * P2PConnection, which needs no RDMA: a large message is sent in chunks
+ * through a window smaller than the message, which only makes progress as
+ * the receiver acknowledges the slots it consumed, and is reassembled intact
+ * and in order with the messages around it. A pair of connected loopback
+ * P2PConnections also switches to a larger size class with messages in
+ * flight, after crossing proposals, or not at all when the proposal is
+ * rejected, and frees the buffers it no longer uses.
+ */
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <derecho/core/detail/p2p_connection.hpp>
+
+#include "test_checks.hpp"
+
+using namespace sst;
+using derecho::test::check;
+
+/** Lays out a P2P buffer the way P2PConnectionManager does, with the same window and slot size for every type */
+static RequestParams make_layout(uint32_t window_size, uint32_t slot_payload_size) {
+    RequestParams layout;
+    uint64_t buffer_size = 0;
+    for(uint8_t i = 0; i < num_request_types; ++i) {
+        layout.window_sizes[i] = window_size;
+        // The payload is followed by the chunk word and the sequence number
+        layout.max_msg_sizes[i] = slot_payload_size + 2 * sizeof(uint64_t);
+        layout.offsets[i] = buffer_size;
+        buffer_size += layout.window_sizes[i] * layout.max_msg_sizes[i];
+    }
+    layout.ack_offset = buffer_size;
+    buffer_size += num_request_types * sizeof(uint64_t);
+    layout.control_offset = buffer_size;
+    buffer_size += P2PConnection::num_control_words * sizeof(uint64_t);
+    buffer_size += sizeof(bool);
+    layout.buffer_size = buffer_size;
+    return layout;
+}
+
+static std::vector<RequestParams> make_layouts(uint32_t window_size, uint32_t slot_payload_size) {
+    return {make_layout(window_size, slot_payload_size)};
+}
+
+static void fill_pattern(char* buf, std::size_t size, uint32_t seed) {
+    for(std::size_t i = 0; i < size; ++i) {
+        buf[i] = static_cast<char>((i * 31 + seed) & 0xff);
+    }
+}
+
+static bool matches_pattern(const char* buf, std::size_t size, uint32_t seed) {
+    for(std::size_t i = 0; i < size; ++i) {
+        if(buf[i] != static_cast<char>((i * 31 + seed) & 0xff)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Consumes every ready slot of the connection, appending the complete messages to received */
+static void receive(P2PConnection& connection, std::vector<IncomingMessage>& received) {
+    std::vector<IncomingMessage> messages;
+    uint32_t slot_counts[num_request_types];
+    connection.probe(messages, slot_counts);
+    for(auto& message : messages) {
+        received.push_back(std::move(message));
+    }
+    connection.update_incoming_seq_nums(slot_counts);
+}
+
+void test_single_slot_messages() {
+    P2PConnection connection(0, 0, make_layouts(4, 64), 0);
+    check(connection.get_max_slot_payload_size(P2P_REPLY) == 64, "a slot holds its payload size");
+    bool in_place = true;
+    for(uint32_t i = 0; i < 10; ++i) {
+        char* buf = connection.get_sendbuffer_ptr(P2P_REPLY);
+        check(buf != nullptr, "a slot is free after the previous ones were consumed");
+        if(!buf) {
+            return;
+        }
+        fill_pattern(buf, 64, i);
+        connection.send(P2P_REPLY);
+        // A message read in place is only valid until its slot is reused
+        std::vector<IncomingMessage> received;
+        receive(connection, received);
+        in_place = in_place && received.size() == 1 && !received[0].owned_buf
+                   && matches_pattern(received[0].buf, 64, i);
+    }
+    check(in_place, "single-slot messages are read in place, in order");
+}
+
+void test_large_message(REQUEST_TYPE type, std::size_t size) {
+    const uint32_t window_size = 4;
+    const uint32_t slot_payload_size = 64;
+    P2PConnection connection(0, 0, make_layouts(window_size, slot_payload_size), 0);
+    const std::string description = " around a large message of " + std::to_string(size) + " bytes";
+
+    // A small message before the large one
+    char* buf = connection.get_sendbuffer_ptr(type);
+    fill_pattern(buf, slot_payload_size, 1);
+    connection.send(type);
+    std::vector<IncomingMessage> before;
+    receive(connection, before);
+    check(before.size() == 1 && !before[0].owned_buf && matches_pattern(before[0].buf, slot_payload_size, 1),
+          "the message before the large one is intact" + description);
+    if(type == P2P_REQUEST) {
+        // The slot of a single-slot request is only reused once the request has been replied to
+        std::vector<IncomingMessage> replies;
+        connection.get_sendbuffer_ptr(P2P_REPLY)[0] = 0;
+        connection.send(P2P_REPLY);
+        receive(connection, replies);
+    }
+
+    buf = connection.get_large_sendbuffer_ptr(type, size);
+    fill_pattern(buf, size, 2);
+    std::vector<IncomingMessage> large;
+    uint32_t stalls = 0;
+    while(connection.has_large_send_pending(type)) {
+        if(!connection.send_next_chunk(type)) {
+            stalls++;
+            receive(connection, large);
+        }
+    }
+    check(stalls > 0 || size <= (window_size - 1) * slot_payload_size,
+          "a message larger than the window waits for slots to be acknowledged");
+
+    // A small message after the large one, which may have to wait for a slot
+    while(!(buf = connection.get_sendbuffer_ptr(type))) {
+        receive(connection, large);
+    }
+    fill_pattern(buf, slot_payload_size, 3);
+    connection.send(type);
+    std::vector<IncomingMessage> after;
+    receive(connection, after);
+    // The last chunk may arrive in the same batch as the message after it
+    if(large.empty() && !after.empty()) {
+        large.push_back(std::move(after.front()));
+        after.erase(after.begin());
+    }
+
+    check(large.size() == 1, "the chunks of a large message are delivered as one message" + description);
+    check(large.size() == 1 && large[0].owned_buf && large[0].buf == large[0].owned_buf.get()
+                  && matches_pattern(large[0].buf, size, 2),
+          "a large message of " + std::to_string(size) + " bytes is reassembled intact into its own buffer");
+    check(after.size() == 1 && !after[0].owned_buf && matches_pattern(after[0].buf, slot_payload_size, 3),
+          "the message after the large one is intact" + description);
+}
+
+void test_interleaved_types() {
+    // Large messages of two types are reassembled separately, even when their chunks alternate
+    P2PConnection connection(0, 0, make_layouts(2, 32), 0);
+    const std::size_t request_size = 32 * 9 + 5;
+    const std::size_t reply_size = 32 * 6;
+    fill_pattern(connection.get_large_sendbuffer_ptr(P2P_REQUEST, request_size), request_size, 4);
+    fill_pattern(connection.get_large_sendbuffer_ptr(RPC_REPLY, reply_size), reply_size, 5);
+    std::vector<IncomingMessage> received;
+    while(connection.has_large_send_pending(P2P_REQUEST) || connection.has_large_send_pending(RPC_REPLY)) {
+        bool progress = false;
+        for(auto type : {P2P_REQUEST, RPC_REPLY}) {
+            if(connection.has_large_send_pending(type) && connection.send_next_chunk(type)) {
+                progress = true;
+            }
+        }
+        if(!progress) {
+            receive(connection, received);
+        }
+    }
+    receive(connection, received);
+    check(received.size() == 2, "two interleaved large messages are delivered once each");
+    bool request_intact = false;
+    bool reply_intact = false;
+    for(const auto& message : received) {
+        // The first byte of each pattern is its seed
+        if(message.buf[0] == 4) {
+            request_intact = matches_pattern(message.buf, request_size, 4);
+        } else if(message.buf[0] == 5) {
+            reply_intact = matches_pattern(message.buf, reply_size, 5);
+        }
+    }
+    check(request_intact && reply_intact, "interleaved large messages are reassembled intact");
+}
+
+/** Size classes that double the window and slot sizes, like P2PConnectionManager's */
+static const std::vector<RequestParams> size_classes = {make_layout(2, 32), make_layout(4, 64), make_layout(8, 128)};
+
+/**
+ * Answers the resize message that arrived on a connection the way
+ * P2PConnectionManager::handle_resize_message does, with the outcome of its
+ * memory budget check given by within_budget.
+ */
+static void handle_resize_message(P2PConnection& connection, bool is_lower_node_id, bool within_budget) {
+    const ResizeMessage message = connection.receive_resize_message();
+    switch(message.type) {
+        case ResizeMessageType::PROPOSE:
+            if(connection.is_resize_pending()) {
+                if(is_lower_node_id) {
+                    connection.reject_resize();
+                    return;
+                }
+                connection.abandon_resize();
+            }
+            if(!connection.can_accept_resize(message.size_class) || !within_budget) {
+                connection.reject_resize();
+                return;
+            }
+            connection.accept_resize(message.size_class);
+            break;
+        case ResizeMessageType::ACCEPT:
+            connection.complete_resize();
+            break;
+        case ResizeMessageType::REJECT:
+            connection.abandon_resize();
+            break;
+        case ResizeMessageType::NONE:
+            break;
+    }
+}
+
+/** Sends one single-slot message whose pattern starts with seed, or returns false if there is no free slot */
+static bool send_message(P2PConnection& connection, REQUEST_TYPE type, uint32_t seed) {
+    char* buf = connection.get_sendbuffer_ptr(type);
+    if(!buf) {
+        return false;
+    }
+    fill_pattern(buf, connection.get_max_slot_payload_size(type), seed);
+    connection.send(type);
+    return true;
+}
+
+/** @return The seeds of the intact messages received, in the order they were received */
+static std::vector<uint32_t> receive_seeds(P2PConnection& connection, std::size_t size) {
+    std::vector<IncomingMessage> received;
+    receive(connection, received);
+    std::vector<uint32_t> seeds;
+    for(const auto& message : received) {
+        const uint32_t seed = static_cast<unsigned char>(message.buf[0]);
+        seeds.push_back(matches_pattern(message.buf, size, seed) ? seed : 0);
+    }
+    return seeds;
+}
+
+/** Releases the retired buffers of both sides once they are drained, and checks that only the current ones remain */
+static void check_released(P2PConnection& first, P2PConnection& second, const std::string& description) {
+    // Each side finishes draining when it probes its connection
+    receive_seeds(first, 0);
+    receive_seeds(second, 0);
+    first.release_retired_buffers(std::chrono::steady_clock::duration::zero());
+    second.release_retired_buffers(std::chrono::steady_clock::duration::zero());
+    check(first.get_buffer_memory() == 2 * size_classes[first.get_size_class()].buffer_size
+                  && second.get_buffer_memory() == 2 * size_classes[second.get_size_class()].buffer_size,
+          "only the buffers of the current size class remain allocated " + description);
+}
+
+void test_resize_with_messages_in_flight() {
+    auto [first, second] = P2PConnection::make_loopback_pair(0, 1, size_classes, 0);
+    const uint64_t baseline = first->get_buffer_memory();
+    check(baseline == 2 * size_classes[0].buffer_size, "a new connection allocates one pair of buffers");
+
+    // Messages in both directions that have not been received when the resize starts
+    send_message(*first, P2P_REQUEST, 1);
+    send_message(*second, RPC_REPLY, 2);
+    check(first->propose_resize(1), "an idle connection can propose a larger size class");
+    check(!first->propose_resize(2), "only one proposal can be pending");
+    check(first->get_buffer_memory() == baseline + 2 * size_classes[1].buffer_size,
+          "a proposal allocates the buffers of the new size class");
+    check(first->get_sendbuffer_ptr(P2P_REQUEST) == nullptr, "no request can be sent while a proposal is pending");
+    check(send_message(*first, RPC_REPLY, 3), "RPC replies can be sent while a proposal is pending");
+
+    check(second->has_resize_message(), "the remote side sees the proposal");
+    handle_resize_message(*second, false, true);
+    check(second->get_size_class() == 1, "the remote side switches when it accepts");
+    // Sent to the new buffers while the old ones are still being drained
+    send_message(*second, RPC_REPLY, 4);
+    check(first->has_resize_message(), "the proposer sees the answer");
+    handle_resize_message(*first, true, true);
+    check(first->get_size_class() == 1 && !first->is_resize_pending(), "the proposer switches when its proposal is accepted");
+    check(send_message(*first, P2P_REQUEST, 5), "requests can be sent again after the switch");
+
+    // The slots of the new size class are twice as large, and messages sent before the switch come first
+    std::vector<uint32_t> second_seeds;
+    std::vector<uint32_t> first_seeds;
+    for(int round = 0; round < 3; ++round) {
+        for(uint32_t seed : receive_seeds(*second, size_classes[0].max_msg_sizes[0] - 2 * sizeof(uint64_t))) {
+            second_seeds.push_back(seed);
+        }
+        for(uint32_t seed : receive_seeds(*first, size_classes[0].max_msg_sizes[0] - 2 * sizeof(uint64_t))) {
+            first_seeds.push_back(seed);
+        }
+    }
+    check(second_seeds == std::vector<uint32_t>({1, 3, 5}), "the accepting side receives every message intact, in order");
+    check(first_seeds == std::vector<uint32_t>({2, 4}), "the proposer receives every message intact, in order");
+    check(first->get_max_slot_payload_size(P2P_REQUEST) == 64, "the connection uses the slots of the new size class");
+
+    // The request read in place from the retired buffer keeps it allocated until it is replied to
+    receive_seeds(*first, 0);
+    receive_seeds(*second, 0);
+    check(second->release_retired_buffers(std::chrono::steady_clock::duration::zero()) == 0,
+          "the retired buffers are kept until the requests received in them are replied to");
+    send_message(*second, P2P_REPLY, 6);
+    send_message(*second, P2P_REPLY, 7);
+    check(receive_seeds(*first, 64) == std::vector<uint32_t>({6, 7}), "replies arrive in the new buffers");
+    check_released(*first, *second, "after a resize with messages in flight");
+}
+
+void test_crossing_proposals() {
+    auto [first, second] = P2PConnection::make_loopback_pair(0, 1, size_classes, 0);
+    check(first->propose_resize(1) && second->propose_resize(1), "both sides can propose at once");
+    // The lower node ID handles the crossing proposal first, and rejects it
+    check(first->has_resize_message(), "the lower node ID sees the crossing proposal");
+    handle_resize_message(*first, true, true);
+    check(first->is_resize_pending(), "the lower node ID keeps its own proposal");
+    check(second->has_resize_message(), "the higher node ID sees the rejection");
+    handle_resize_message(*second, false, true);
+    check(!second->is_resize_pending() && second->get_size_class() == 0,
+          "the higher node ID abandons its proposal when it is rejected");
+    check(second->has_resize_message(), "the higher node ID sees the winning proposal");
+    handle_resize_message(*second, false, true);
+    check(first->has_resize_message(), "the lower node ID sees the acceptance");
+    handle_resize_message(*first, true, true);
+    check(first->get_size_class() == 1 && second->get_size_class() == 1, "both sides switch to the winning proposal");
+    check(!first->has_resize_message() && !second->has_resize_message(), "no resize message is left unanswered");
+
+    check(send_message(*first, P2P_REQUEST, 8) && send_message(*second, P2P_REQUEST, 9),
+          "both sides send after the switch");
+    check(receive_seeds(*second, 64) == std::vector<uint32_t>({8}) && receive_seeds(*first, 64) == std::vector<uint32_t>({9}),
+          "messages arrive in the new buffers after crossing proposals");
+    send_message(*first, P2P_REPLY, 10);
+    send_message(*second, P2P_REPLY, 11);
+    receive_seeds(*first, 0);
+    receive_seeds(*second, 0);
+    check_released(*first, *second, "after crossing proposals");
+}
+
+void test_rejected_proposal() {
+    auto [first, second] = P2PConnection::make_loopback_pair(0, 1, size_classes, 0);
+    const uint64_t baseline = first->get_buffer_memory();
+    check(first->propose_resize(1), "a proposal is sent before the remote side checks its budget");
+    check(second->has_resize_message(), "the remote side sees the proposal");
+    handle_resize_message(*second, false, false);
+    check(second->get_size_class() == 0 && second->get_buffer_memory() == baseline,
+          "the remote side allocates nothing for a proposal over its budget");
+    check(first->has_resize_message(), "the proposer sees the rejection");
+    handle_resize_message(*first, true, true);
+    check(first->get_size_class() == 0 && !first->is_resize_pending(), "the proposer stays in its size class");
+    check(first->get_buffer_memory() == baseline, "the proposer frees the buffers of a rejected proposal");
+    check(send_message(*first, P2P_REQUEST, 12), "requests can be sent again after a rejection");
+    check(receive_seeds(*second, 32) == std::vector<uint32_t>({12}), "messages still arrive after a rejection");
+    check(first->propose_resize(1), "a connection can propose again after a rejection");
+}
+
+int main(int argc, char** argv) {
+    test_single_slot_messages();
+    // A message that fills its last chunk, and one that does not
+    test_large_message(P2P_REPLY, 64 * 3);
+    test_large_message(P2P_REPLY, 64 * 10 + 13);
+    test_large_message(P2P_REQUEST, 64 * 10 + 13);
+    test_large_message(RPC_REPLY, 64 * 25 + 1);
+    test_interleaved_types();
+    test_resize_with_messages_in_flight();
+    test_crossing_proposals();
+    test_rejected_proposal();
+    return derecho::test::report_checks();
+}
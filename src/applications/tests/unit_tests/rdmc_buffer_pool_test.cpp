@@ -0,0 +1,136 @@
+/**
+ * @file rdmc_buffer_pool_test.cpp
+ *
+ * Tests RDMCBufferPool without RDMA, by replacing the registration of its
+ * regions: blocks are sized by power-of-two size classes, carved from shared
+ * regions that are each registered once, reused after they are released, and
+ * blocks larger than a region get a region of their own.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <derecho/core/detail/rdmc_buffer_pool.hpp>
+
+#include "test_checks.hpp"
+
+using derecho::MessageBuffer;
+using derecho::RDMCBufferPool;
+using derecho::test::check;
+
+/** The regions registered by a pool, in order */
+struct RegisteredRegion {
+    char* memory;
+    std::size_t size;
+};
+
+static RDMCBufferPool::RegisterFunction record_registrations(std::vector<RegisteredRegion>& registered) {
+    return [&registered](char* memory, std::size_t size) {
+        registered.push_back(RegisteredRegion{memory, size});
+        return std::shared_ptr<rdma::memory_region>();
+    };
+}
+
+/** @return True if the block lies entirely within the given region, at its recorded offset */
+static bool in_region(const MessageBuffer& message_buffer, std::size_t size, const RegisteredRegion& region) {
+    return message_buffer.buffer.get() == region.memory + message_buffer.offset
+           && message_buffer.offset + size <= region.size;
+}
+
+void test_size_classes() {
+    const std::size_t region_size = 1 << 20;
+    std::vector<RegisteredRegion> registered;
+    RDMCBufferPool pool(region_size, false, record_registrations(registered));
+    check(pool.get_usage().num_regions == 0 && registered.empty(), "a new pool has no regions");
+
+    std::vector<MessageBuffer> buffers;
+    const std::size_t sizes[] = {1, 4096, 4097, 10000, 65536, 100000};
+    for(std::size_t size : sizes) {
+        buffers.push_back(pool.allocate(size));
+        std::memset(buffers.back().buffer.get(), 0xab, size);
+    }
+    RDMCBufferPool::Usage usage = pool.get_usage();
+    check(usage.num_regions == 1 && registered.size() == 1 && usage.registered_bytes == region_size,
+          "small blocks are carved from one region, registered once");
+    check(usage.hugepage_bytes == 0, "no huge pages are used when they are not requested");
+    check(usage.allocated_bytes == 4096 + 4096 + 8192 + 16384 + 65536 + 131072,
+          "each block is the smallest power of two that fits its message");
+    check(usage.allocated_blocks[0] == 2 && usage.allocated_blocks[1] == 1 && usage.allocated_blocks[5] == 1,
+          "blocks are counted by size class");
+    bool inside = true;
+    for(uint32_t i = 0; i < buffers.size(); ++i) {
+        inside = inside && in_region(buffers[i], sizes[i], registered[0]);
+        for(uint32_t j = 0; j < i; ++j) {
+            // Each block is at least as big as its message, so blocks overlap only if their messages do
+            inside = inside
+                     && (buffers[i].offset >= buffers[j].offset + sizes[j] || buffers[j].offset >= buffers[i].offset + sizes[i]);
+        }
+    }
+    check(inside, "blocks lie within their region at their offsets, without overlapping");
+
+    buffers.clear();
+    usage = pool.get_usage();
+    check(usage.allocated_bytes == 0, "destroying a MessageBuffer returns its block to the pool");
+    check(usage.free_blocks[0] == 2 && usage.free_blocks[5] == 1, "released blocks go on the free list of their class");
+}
+
+void test_reuse() {
+    const std::size_t region_size = 1 << 16;
+    std::vector<RegisteredRegion> registered;
+    RDMCBufferPool pool(region_size, false, record_registrations(registered));
+
+    char* first_block;
+    {
+        MessageBuffer message_buffer = pool.allocate(5000);
+        first_block = message_buffer.buffer.get();
+    }
+    MessageBuffer reused = pool.allocate(8000);
+    check(reused.buffer.get() == first_block, "a released block is reused for a message of the same class");
+
+    // Fill the rest of the first region so that the next 32 KiB block does not fit
+    std::vector<MessageBuffer> buffers;
+    buffers.push_back(pool.allocate(16384));
+    buffers.push_back(pool.allocate(16384));
+    buffers.push_back(pool.allocate(32768));
+    check(registered.size() == 2, "a new region is added when a block does not fit in the current one");
+    check(in_region(buffers.back(), 32768, registered[1]), "the block that did not fit comes from the new region");
+    // 8 KiB of the first region was left over
+    buffers.push_back(pool.allocate(8192));
+    check(registered.size() == 2 && in_region(buffers.back(), 8192, registered[0]),
+          "the rest of a full region is kept on the free lists");
+
+    // Blocks larger than a region
+    char* large_block;
+    {
+        MessageBuffer large = pool.allocate(3 * region_size);
+        large_block = large.buffer.get();
+        check(registered.size() == 3 && registered[2].size == 4 * region_size && large.offset == 0,
+              "a block larger than a region gets a region of its own");
+    }
+    MessageBuffer large = pool.allocate(3 * region_size + 1);
+    check(registered.size() == 3 && large.buffer.get() == large_block,
+          "a released large block is kept for reuse");
+    check(pool.get_usage().registered_bytes == 6 * region_size, "registered_bytes counts every region");
+}
+
+void test_hugepages() {
+    // Whether or not the system has huge pages, the pool must work
+    std::vector<RegisteredRegion> registered;
+    RDMCBufferPool pool(1 << 20, true, record_registrations(registered));
+    MessageBuffer message_buffer = pool.allocate(100000);
+    std::memset(message_buffer.buffer.get(), 0xcd, 100000);
+    const RDMCBufferPool::Usage usage = pool.get_usage();
+    check(usage.num_regions == 1 && usage.hugepage_bytes <= usage.registered_bytes,
+          "a pool that asks for huge pages falls back to regular pages if needed");
+}
+
+int main(int argc, char** argv) {
+    test_size_classes();
+    test_reuse();
+    test_hugepages();
+    return derecho::test::report_checks();
+}
@@ -0,0 +1,123 @@
+/**
+ * @file reply_slot_pool_test.cpp
+ *
+ * Tests ReplySlotPool: an invocation ID is tagged with the generation of its
+ * slot, so it goes stale once the slot is recycled, and a closed pool is
+ * deleted once the last of its slots is released.
+ */
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <derecho/core/detail/rpc_utils.hpp>
+
+#include "test_checks.hpp"
+
+using namespace derecho::rpc;
+using derecho::test::check;
+
+/** A reply value that counts its live instances, which shows when the pool storing it is deleted */
+struct Tracked {
+    static int live;
+    int value;
+    Tracked(int value) : value(value) { live++; }
+    Tracked(const Tracked& other) : value(other.value) { live++; }
+    Tracked(Tracked&& other) : value(other.value) { live++; }
+    ~Tracked() { live--; }
+};
+int Tracked::live = 0;
+
+/** Releases both holders of a slot: the QueryResults and the RPCManager's hold */
+template <typename Ret>
+static void release_slot(PendingResults<Ret>& pending) {
+    { QueryResults<Ret> results = pending.get_future(); }
+    pending.release();
+}
+
+void test_generation_tags() {
+    auto* pool = new ReplySlotPool<int>();
+    auto first = pool->allocate();
+    const uint64_t first_id = first.first;
+    PendingResults<int>* held = pool->hold(first_id);
+    check(held == &first.second, "hold finds the slot of a live invocation ID");
+    if(held) {
+        held->release();
+    }
+    first.second.fulfill_map({1});
+    first.second.set_value(1, 5);
+    release_slot(first.second);
+    check(pool->hold(first_id) == nullptr, "an invocation ID is stale once its slot is recycled");
+
+    auto second = pool->allocate();
+    check(&second.second == &first.second, "a recycled slot is handed out again");
+    check(static_cast<uint32_t>(second.first) == static_cast<uint32_t>(first_id),
+          "a reused slot keeps its index");
+    check(second.first != first_id, "a reused slot gets a new generation");
+    check(!second.second.all_responded(), "a reused slot is reset");
+    check(pool->hold(first_id) == nullptr, "the old invocation ID stays stale after the slot is reused");
+    held = pool->hold(second.first);
+    check(held == &second.second, "the new invocation ID finds the reused slot");
+    if(held) {
+        held->release();
+    }
+    check(pool->hold(uint64_t{1} << 20) == nullptr, "an index past the end of the pool is stale");
+    release_slot(second.second);
+
+    // Grow the pool past one slab while every slot is held
+    std::vector<std::pair<uint64_t, PendingResults<int>&>> slots;
+    std::set<uint64_t> ids;
+    for(int i = 0; i < 200; ++i) {
+        slots.push_back(pool->allocate());
+        ids.insert(slots.back().first);
+    }
+    check(ids.size() == slots.size(), "held slots have distinct invocation IDs");
+    bool all_found = true;
+    for(auto& slot : slots) {
+        held = pool->hold(slot.first);
+        all_found = all_found && held == &slot.second;
+        if(held) {
+            held->release();
+        }
+    }
+    check(all_found, "slots do not move when the pool grows");
+    for(auto& slot : slots) {
+        release_slot(slot.second);
+    }
+    pool->close();
+}
+
+void test_delete_on_last_release() {
+    // A slot still held when the pool is closed keeps the pool alive
+    auto* pool = new ReplySlotPool<Tracked>();
+    auto slot = pool->allocate();
+    {
+        QueryResults<Tracked> results = slot.second.get_future();
+        slot.second.fulfill_map({1});
+        slot.second.set_value(1, Tracked(7));
+        check(results.get().get(1).value == 7, "the reply is read through the QueryResults");
+        pool->close();
+        check(Tracked::live == 1, "a closed pool is not deleted while a slot is held");
+    }
+    check(Tracked::live == 1, "a closed pool is not deleted while the RPCManager holds a slot");
+    slot.second.release();
+    check(Tracked::live == 0, "a closed pool is deleted when its last slot is released");
+
+    // A pool whose slots are all released is deleted by close()
+    pool = new ReplySlotPool<Tracked>();
+    auto unheld_slot = pool->allocate();
+    unheld_slot.second.fulfill_map({1});
+    unheld_slot.second.set_value(1, Tracked(8));
+    release_slot(unheld_slot.second);
+    check(Tracked::live == 1, "a recycled slot keeps its reply until the slot is reused or deleted");
+    pool->close();
+    check(Tracked::live == 0, "close deletes a pool with no held slots");
+}
+
+int main(int argc, char** argv) {
+    test_generation_tags();
+    test_delete_on_last_release();
+    return derecho::test::report_checks();
+}
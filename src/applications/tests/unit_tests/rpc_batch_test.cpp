@@ -0,0 +1,172 @@
+/**
+ * @file rpc_batch_test.cpp
+ *
+ * Tests the delivery of batched ordered_send calls without a Derecho group:
+ * the calls packed into a multicast message are unpacked intact and in order,
+ * a message that is not a batch is delivered whole, and the results of the
+ * calls of a batch, which share its version, are matched to their callers in
+ * order and move through the maps of results awaiting persistence together.
+ */
+#include <cstdint>
+#include <map>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <derecho/core/detail/rpc_utils.hpp>
+
+#include "test_checks.hpp"
+
+using namespace derecho::rpc;
+using namespace derecho::rpc::remote_invocation_utilities;
+using derecho::test::check;
+using persistent::version_t;
+
+/** A call unpacked from a multicast message */
+struct Call {
+    Opcode opcode;
+    std::size_t payload_size;
+    /** The first byte of the payload, which the tests set to the index of the call */
+    uint32_t call_id;
+    bool batched;
+    bool intact;
+};
+
+/**
+ * Appends a call to a multicast message the way RPCManager adds it to an
+ * ordered_send batch, with a payload whose bytes are all call_id.
+ */
+static void append_call(std::vector<char>& msg, bool batched, const Opcode& opcode, std::size_t payload_size,
+                        uint32_t call_id) {
+    const std::size_t offset = align_batched_call(msg.size());
+    msg.resize(offset, 0);
+    msg.resize(offset + header_space() + payload_size, static_cast<char>(call_id));
+    populate_header(msg.data() + offset, payload_size, opcode, 0, 0);
+    if(batched) {
+        mark_batched_call(msg.data() + offset);
+    }
+}
+
+static std::vector<Call> unpack(std::vector<char>& msg, std::size_t msg_size) {
+    std::vector<Call> calls;
+    for_each_ordered_call(msg.data(), msg_size, [&calls](char* call_buf, std::size_t call_size) {
+        Call call;
+        node_id_t from;
+        uint32_t flags;
+        retrieve_header(nullptr, call_buf, call.payload_size, call.opcode, from, flags);
+        call.batched = RPC_HEADER_FLAG_TST(flags, BATCHED);
+        const char* payload = call_buf + header_space();
+        call.call_id = static_cast<unsigned char>(payload[0]);
+        call.intact = call_size == header_space() + call.payload_size;
+        for(std::size_t i = 0; i < call.payload_size; ++i) {
+            call.intact = call.intact && payload[i] == static_cast<char>(call.call_id);
+        }
+        calls.push_back(call);
+    });
+    return calls;
+}
+
+void test_unpack_batch() {
+    std::vector<char> msg;
+    const std::vector<std::pair<Opcode, std::size_t>> sent = {{Opcode{1, 2, 10, false}, 8},
+                                                              {Opcode{1, 2, 11, false}, 1},
+                                                              {Opcode{1, 2, 10, false}, 100}};
+    for(uint32_t i = 0; i < sent.size(); ++i) {
+        append_call(msg, true, sent[i].first, sent[i].second, i + 1);
+    }
+    std::vector<Call> calls = unpack(msg, msg.size());
+    check(calls.size() == sent.size(), "every call in a batch is delivered once");
+    bool in_order = calls.size() == sent.size();
+    for(uint32_t i = 0; in_order && i < calls.size(); ++i) {
+        in_order = calls[i].call_id == i + 1 && calls[i].opcode == sent[i].first
+                   && calls[i].payload_size == sent[i].second && calls[i].batched && calls[i].intact;
+    }
+    check(in_order, "the calls of a batch are delivered intact, in the order they were added");
+
+    // The multicast message can be longer than the batch, as long as the rest is smaller than a header
+    std::vector<char> padded = msg;
+    padded.resize(msg.size() + header_space() - 1, 0);
+    check(unpack(padded, padded.size()).size() == sent.size(), "the space after the last call of a batch is ignored");
+
+    std::vector<char> single;
+    append_call(single, true, Opcode{1, 2, 12, false}, 16, 7);
+    calls = unpack(single, single.size());
+    check(calls.size() == 1 && calls[0].call_id == 7 && calls[0].intact, "a batch of one call is delivered");
+}
+
+void test_unbatched_message() {
+    std::vector<char> msg;
+    append_call(msg, false, Opcode{1, 2, 10, false}, 24, 9);
+    // The multicast message may be larger than the call, and is delivered whole
+    msg.resize(msg.size() + 3 * header_space(), 0);
+    std::size_t delivered_size = 0;
+    uint32_t deliveries = 0;
+    for_each_ordered_call(msg.data(), msg.size(), [&](char* call_buf, std::size_t call_size) {
+        check(call_buf == msg.data(), "a message that is not a batch is delivered from its start");
+        delivered_size = call_size;
+        deliveries++;
+    });
+    check(deliveries == 1 && delivered_size == msg.size(), "a message that is not a batch is delivered once, whole");
+}
+
+void test_version_matching() {
+    // The callers of an ordered_send are queued in the order their calls were added to batches,
+    // like RPCManager::pending_results_to_fulfill
+    std::queue<uint32_t> results_to_fulfill;
+    for(uint32_t call_id = 1; call_id <= 6; ++call_id) {
+        results_to_fulfill.push(call_id);
+    }
+    // Two batches and a single call, delivered with versions 5, 6 and 7
+    std::vector<std::pair<std::vector<char>, version_t>> deliveries(3);
+    for(uint32_t call_id : {1, 2, 3}) {
+        append_call(deliveries[0].first, true, Opcode{1, 2, 10, false}, 4 * call_id, call_id);
+    }
+    deliveries[0].second = 5;
+    for(uint32_t call_id : {4, 5}) {
+        append_call(deliveries[1].first, true, Opcode{1, 2, 10, false}, 4 * call_id, call_id);
+    }
+    deliveries[1].second = 6;
+    append_call(deliveries[2].first, false, Opcode{1, 2, 10, false}, 4, 6);
+    deliveries[2].second = 7;
+
+    std::multimap<version_t, uint32_t> awaiting_local_persistence;
+    bool matched = true;
+    for(auto& delivery : deliveries) {
+        for(const Call& call : unpack(delivery.first, delivery.first.size())) {
+            // Each delivered call fulfills the next caller, with the version of its multicast
+            matched = matched && !results_to_fulfill.empty() && results_to_fulfill.front() == call.call_id;
+            awaiting_local_persistence.emplace(delivery.second, results_to_fulfill.front());
+            results_to_fulfill.pop();
+        }
+    }
+    check(matched && results_to_fulfill.empty(), "each call of a batch is matched to its own caller");
+
+    std::multimap<version_t, uint32_t> awaiting_global_persistence;
+    std::vector<uint32_t> persisted;
+    auto move_to_global = [&](const std::pair<const version_t, uint32_t>& entry) {
+        persisted.push_back(entry.second);
+        awaiting_global_persistence.emplace(entry);
+    };
+    take_results_up_to_version(awaiting_local_persistence, 4, move_to_global);
+    check(persisted.empty(), "no call is persisted before the version of its batch");
+    take_results_up_to_version(awaiting_local_persistence, 5, move_to_global);
+    check(persisted == std::vector<uint32_t>({1, 2, 3}), "all the calls of a batch are persisted with its version");
+    take_results_up_to_version(awaiting_local_persistence, 7, move_to_global);
+    check(persisted == std::vector<uint32_t>({1, 2, 3, 4, 5, 6}) && awaiting_local_persistence.empty(),
+          "a later version persists the calls of every batch before it, in order");
+
+    std::vector<uint32_t> completed;
+    take_results_up_to_version(awaiting_global_persistence, 6,
+                               [&](const std::pair<const version_t, uint32_t>& entry) { completed.push_back(entry.second); });
+    check(completed == std::vector<uint32_t>({1, 2, 3, 4, 5}) && awaiting_global_persistence.size() == 1
+                  && awaiting_global_persistence.begin()->first == 7,
+          "calls keep the version of their batch in the next map");
+}
+
+int main(int argc, char** argv) {
+    test_unpack_batch();
+    test_unbatched_message();
+    test_version_matching();
+    return derecho::test::report_checks();
+}
@@ -0,0 +1,49 @@
+/**
+ * @file test_checks.hpp
+ *
+ * A minimal check-and-report harness for the unit tests that run standalone,
+ * without a Derecho group: each check prints what failed, and main() returns
+ * the result of report_checks() as the exit status of the test.
+ */
+
+#pragma once
+
+#include <iostream>
+#include <string>
+
+namespace derecho {
+namespace test {
+
+/** The number of checks that have failed so far in this test program */
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+/**
+ * Records a failed check, printing a description of what was expected.
+ * @param condition The condition that should hold
+ * @param what A description of the condition
+ */
+inline void check(bool condition, const std::string& what) {
+    if(!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        check_failures()++;
+    }
+}
+
+/**
+ * Prints a summary of the checks, for the end of main().
+ * @return The exit status of the test program: 0 if every check passed
+ */
+inline int report_checks() {
+    if(check_failures() > 0) {
+        std::cout << check_failures() << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
+
+}  // namespace test
+}  // namespace derecho
@@ -46,13 +46,30 @@ struct option Conf::long_options[] = {
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_EXTERNAL_PORT),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_HEARTBEAT_MS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PREDICATE_THREADS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PREDICATE_THREAD_CORES),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_IDLE_SPIN_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_IDLE_BACKOFF_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_IDLE_WAIT_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SENDER_THREADS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RESTART_TIMEOUT_MS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_ENABLE_BACKUP_RESTART_LEADERS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_DISABLE_PARTITIONING_SAFETY),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_WINDOW_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_REQUEST_THREADS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_INITIAL_WINDOW_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_INITIAL_PAYLOAD_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_MEMORY_BUDGET_MB),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_ORDERED_SEND_BATCH_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_ORDERED_SEND_BATCH_DELAY_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RDMC_BUFFER_REGION_SIZE_MB),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RDMC_BUFFER_HUGEPAGES),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_STATE_TRANSFER_PROGRESS_INTERVAL_MS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_NODE_ID),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_PERSISTENCE_THREADS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_JSON_LAYOUT),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_JSON_LAYOUT_PATH),
         // [SUBGROUP/<subgroup name>]
@@ -74,6 +91,10 @@ struct option Conf::long_options[] = {
         MAKE_LONG_OPT_ENTRY(CONF_PERS_MAX_LOG_ENTRY),
         MAKE_LONG_OPT_ENTRY(CONF_PERS_MAX_DATA_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_PERS_PRIVATE_KEY_FILE),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_DELTA_CHECKPOINT_INTERVAL),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_DELTA_CHECKPOINT_BYTES),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_DELTA_CACHE_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_PERS_GROUP_COMMIT),
         {0, 0, 0, 0}};
 
 void Conf::initialize(int argc, char* argv[], const char* conf_file) {
@@ -144,6 +165,10 @@ void Conf::initialize(int argc, char* argv[], const char* conf_file) {
             throw std::logic_error(std::string("Configuration error: P2P reply payload size must be at least ")
                                    + std::to_string(DERECHO_MIN_RPC_RESPONSE_SIZE));
         }
+        if(getConfUInt64(CONF_DERECHO_P2P_INITIAL_PAYLOAD_SIZE) <= DERECHO_MIN_RPC_RESPONSE_SIZE) {
+            throw std::logic_error(std::string("Configuration error: P2P initial payload size must be at least ")
+                                   + std::to_string(DERECHO_MIN_RPC_RESPONSE_SIZE));
+        }
     }
 }
 
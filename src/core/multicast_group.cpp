@@ -8,11 +8,35 @@
 #include <derecho/core/detail/multicast_group.hpp>
 #include <derecho/persistent/Persistent.hpp>
 #include <derecho/rdmc/detail/util.hpp>
+#include <derecho/sst/detail/column_ops.hpp>
 #include <derecho/utils/logger.hpp>
 #include <derecho/utils/time.h>
 
 namespace derecho {
 
+namespace {
+/**
+ * The subgroup whose upcall this thread is running, with that subgroup's
+ * state lock held, or -1 if it is not running one. A send from the upcall to
+ * another subgroup must not wait for the other subgroup's lock, since an
+ * upcall in that subgroup could be waiting for this one.
+ */
+thread_local int64_t upcall_subgroup = -1;
+
+/** Marks the current thread as running an upcall in a subgroup while it is in scope. */
+class UpcallScope {
+    const int64_t previous;
+
+public:
+    UpcallScope(subgroup_id_t subgroup_num) : previous(upcall_subgroup) {
+        upcall_subgroup = subgroup_num;
+    }
+    ~UpcallScope() {
+        upcall_subgroup = previous;
+    }
+};
+}  // namespace
+
 /**
  * Helper function to find the index of an element in a container.
  */
@@ -43,8 +67,13 @@ MulticastGroup::MulticastGroup(
           internal_callbacks(internal_callbacks),
           total_num_subgroups(total_num_subgroups),
           subgroup_settings_map(subgroup_settings_by_id),
+          hot_settings(compute_hot_settings(members, total_num_subgroups, subgroup_settings_by_id)),
           received_intervals(sst->num_received.size(), {-1, -1}),
           rdmc_group_num_offset(0),
+          first_rdmc_group_num(0),
+          buffer_pool(std::make_shared<RDMCBufferPool>(getConfUInt64(CONF_DERECHO_RDMC_BUFFER_REGION_SIZE_MB) << 20,
+                                                       getConfBoolean(CONF_DERECHO_RDMC_BUFFER_HUGEPAGES))),
+          subgroup_states(total_num_subgroups),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
           committed_sst_index(total_num_subgroups, -1),
@@ -64,15 +93,7 @@ MulticastGroup::MulticastGroup(
         node_id_to_sst_index[members[i]] = i;
     }
 
-    for(const auto p : subgroup_settings_by_id) {
-        subgroup_id_t id = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
-    }
-
+    create_sender_threads();
     initialize_sst_row();
     bool no_member_failed = true;
     if(already_failed.size()) {
@@ -88,7 +109,7 @@ MulticastGroup::MulticastGroup(
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
     register_predicates();
-    sender_thread = std::thread(&MulticastGroup::send_loop, this);
+    start_sender_threads();
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
 }
 
@@ -106,8 +127,12 @@ MulticastGroup::MulticastGroup(
           internal_callbacks(old_group.internal_callbacks),
           total_num_subgroups(total_num_subgroups),
           subgroup_settings_map(subgroup_settings_by_id),
+          hot_settings(compute_hot_settings(members, total_num_subgroups, subgroup_settings_by_id)),
           received_intervals(sst->num_received.size(), {-1, -1}),
           rdmc_group_num_offset(old_group.rdmc_group_num_offset + old_group.num_members),
+          first_rdmc_group_num(rdmc_group_num_offset),
+          buffer_pool(old_group.buffer_pool),
+          subgroup_states(total_num_subgroups),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
           committed_sst_index(total_num_subgroups, -1),
@@ -149,93 +174,68 @@ MulticastGroup::MulticastGroup(
         return std::move(msg);
     };
 
-    for(const auto p : subgroup_settings_by_id) {
-        subgroup_id_t id = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
-    }
-
-    // Reclaim RDMCMessageBuffers from the old group, and supplement them with
-    // additional if the group has grown.
-    std::lock_guard<std::recursive_mutex> lock(old_group.msg_state_mtx);
-    for(const auto p : subgroup_settings_by_id) {
-        const subgroup_id_t subgroup_num = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        // for later: don't move extra message buffers
-        free_message_buffers[subgroup_num].swap(old_group.free_message_buffers[subgroup_num]);
-        while(free_message_buffers[subgroup_num].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[subgroup_num].emplace_back(settings.profile.max_msg_size);
-        }
-    }
-
-    for(auto& msg : old_group.current_receives) {
-        free_message_buffers[msg.first.first].push_back(std::move(msg.second.message_buffer));
-    }
-    old_group.current_receives.clear();
-
-    // Assume that any locally stable messages failed. If we were the sender
-    // than re-attempt, otherwise discard. TODO: Presumably the ragged edge
-    // cleanup will want the chance to deliver some of these.
-    for(auto& p : old_group.locally_stable_rdmc_messages) {
-        if(p.second.size() == 0) {
-            continue;
-        }
-
-        for(auto& q : p.second) {
-            if(q.second.sender_id == members[member_index]) {
-                pending_sends[p.first].push(convert_msg(q.second, p.first));
-            } else {
-                free_message_buffers[p.first].push_back(std::move(q.second.message_buffer));
+    // Take over the old group's messages; the buffers of those that are
+    // discarded go back to the shared buffer pool.
+    std::lock_guard<std::mutex> lock(old_group.msg_state_mtx);
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < old_group.subgroup_states.size(); ++subgroup_num) {
+        SubgroupState& old_state = old_group.subgroup_states[subgroup_num];
+        std::lock_guard<std::recursive_mutex> old_subgroup_lock(old_state.mtx);
+        const bool still_member = subgroup_num < total_num_subgroups && hot_settings[subgroup_num].is_member;
+        old_state.current_receives.clear();
+
+        // Assume that any locally stable messages failed. If we were the sender
+        // than re-attempt, otherwise discard. TODO: Presumably the ragged edge
+        // cleanup will want the chance to deliver some of these.
+        if(still_member) {
+            for(auto& q : old_state.locally_stable_rdmc_messages) {
+                if(q.second.sender_id == members[member_index]) {
+                    pending_sends[subgroup_num].push(convert_msg(q.second, subgroup_num));
+                }
             }
         }
-    }
-    old_group.locally_stable_rdmc_messages.clear();
-
-    for(const auto p : subgroup_settings_by_id) {
-        subgroup_id_t id = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
+        old_state.locally_stable_rdmc_messages.clear();
+        old_state.locally_stable_sst_messages.clear();
     }
 
-    old_group.locally_stable_sst_messages.clear();
-
     // Any messages that were being sent should be re-attempted.
     for(const auto& p : subgroup_settings_by_id) {
         auto subgroup_num = p.first;
-        if(old_group.current_sends.size() > subgroup_num && old_group.current_sends[subgroup_num]) {
+        if(old_group.subgroup_states.size() <= subgroup_num) {
+            continue;
+        }
+        SubgroupState& old_state = old_group.subgroup_states[subgroup_num];
+        std::lock_guard<std::recursive_mutex> old_subgroup_lock(old_state.mtx);
+        if(old_group.current_sends[subgroup_num]) {
             pending_sends[subgroup_num].push(convert_msg(*old_group.current_sends[subgroup_num], subgroup_num));
         }
 
-        if(old_group.pending_sends.size() > subgroup_num) {
-            while(!old_group.pending_sends[subgroup_num].empty()) {
-                pending_sends[subgroup_num].push(convert_msg(old_group.pending_sends[subgroup_num].front(), subgroup_num));
-                old_group.pending_sends[subgroup_num].pop();
-            }
+        while(!old_group.pending_sends[subgroup_num].empty()) {
+            pending_sends[subgroup_num].push(convert_msg(old_group.pending_sends[subgroup_num].front(), subgroup_num));
+            old_group.pending_sends[subgroup_num].pop();
         }
 
-        if(old_group.next_sends.size() > subgroup_num && old_group.next_sends[subgroup_num]) {
+        if(old_group.next_sends[subgroup_num]) {
             next_sends[subgroup_num] = convert_msg(*old_group.next_sends[subgroup_num], subgroup_num);
         }
 
-        for(auto& entry : old_group.non_persistent_messages[subgroup_num]) {
-            non_persistent_messages[subgroup_num].emplace(entry.first,
-                                                          convert_msg(entry.second, subgroup_num));
+        {
+            std::lock_guard<std::mutex> deferred_lock(old_state.deferred_sends_mutex);
+            subgroup_states[subgroup_num].deferred_sends = std::move(old_state.deferred_sends);
+        }
+
+        for(auto& entry : old_state.non_persistent_messages) {
+            subgroup_states[subgroup_num].non_persistent_messages.emplace(entry.first,
+                                                                          convert_msg(entry.second, subgroup_num));
         }
-        old_group.non_persistent_messages.clear();
-        for(auto& entry : old_group.non_persistent_sst_messages[subgroup_num]) {
-            non_persistent_sst_messages[subgroup_num].emplace(entry.first,
-                                                              convert_sst_msg(entry.second, subgroup_num));
+        old_state.non_persistent_messages.clear();
+        for(auto& entry : old_state.non_persistent_sst_messages) {
+            subgroup_states[subgroup_num].non_persistent_sst_messages.emplace(entry.first,
+                                                                              convert_sst_msg(entry.second, subgroup_num));
         }
-        old_group.non_persistent_sst_messages.clear();
+        old_state.non_persistent_sst_messages.clear();
     }
 
+    create_sender_threads();
     initialize_sst_row();
     bool no_member_failed = true;
     if(already_failed.size()) {
@@ -251,7 +251,7 @@ MulticastGroup::MulticastGroup(
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
     register_predicates();
-    sender_thread = std::thread(&MulticastGroup::send_loop, this);
+    start_sender_threads();
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
 }
 
@@ -285,7 +285,8 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                         num_shard_senders,
                                         shard_sst_indices](char* data, size_t size) {
                     assert(this->sst);
-                    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+                    std::lock_guard<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
+                    SubgroupState& state = subgroup_states[subgroup_num];
                     header* h = (header*)data;
                     const int32_t index = h->index;
                     message_id_t sequence_number = index * num_shard_senders + sender_rank;
@@ -295,17 +296,17 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                     // Move message from current_receives to locally_stable_rdmc_messages.
                     if(node_id == members[member_index]) {
                         assert(current_sends[subgroup_num]);
-                        locally_stable_rdmc_messages[subgroup_num][sequence_number] = std::move(*current_sends[subgroup_num]);
+                        state.locally_stable_rdmc_messages[sequence_number] = std::move(*current_sends[subgroup_num]);
                         current_sends[subgroup_num] = std::nullopt;
                     } else {
-                        auto it = current_receives.find({subgroup_num, node_id});
-                        assert(it != current_receives.end());
+                        auto it = state.current_receives.find(node_id);
+                        assert(it != state.current_receives.end());
                         auto& msg = it->second;
                         msg.index = index;
                         // We set the size in this receive handler instead of in the incoming_message_handler
                         msg.size = size;
-                        locally_stable_rdmc_messages[subgroup_num].emplace(sequence_number, std::move(msg));
-                        current_receives.erase(it);
+                        state.locally_stable_rdmc_messages.emplace(sequence_number, std::move(msg));
+                        state.current_receives.erase(it);
                     }
 
                     auto new_num_received = resolve_num_received(index, subgroup_settings.num_received_offset + sender_rank);
@@ -329,41 +330,42 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                         for(int i = sst->num_received[member_index][subgroup_settings.num_received_offset + sender_rank] + 1;
                             i <= new_num_received; ++i) {
                             message_id_t seq_num = i * num_shard_senders + sender_rank;
-                            if(!locally_stable_sst_messages[subgroup_num].empty()
-                               && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                                auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                            if(!state.locally_stable_sst_messages.empty()
+                               && state.locally_stable_sst_messages.begin()->first == seq_num) {
+                                auto& msg = state.locally_stable_sst_messages.begin()->second;
                                 char* buf = const_cast<char*>(msg.buf);
                                 header* h = (header*)(buf);
                                 // no delivery callback for a NULL message
                                 if(msg.size > h->header_size && callbacks.global_stability_callback) {
+                                    UpcallScope upcall(subgroup_num);
                                     callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                                         msg.index,
                                                                         {{buf + h->header_size, msg.size - h->header_size}},
                                                                         persistent::INVALID_VERSION);
                                 }
                                 if(node_id == members[member_index]) {
-                                    pending_message_timestamps[subgroup_num].erase(h->timestamp);
+                                    state.pending_message_timestamps.erase(h->timestamp);
                                 }
-                                locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                                state.locally_stable_sst_messages.erase(state.locally_stable_sst_messages.begin());
                             } else {
-                                assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                                auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
+                                assert(!state.locally_stable_rdmc_messages.empty());
+                                auto it2 = state.locally_stable_rdmc_messages.begin();
                                 assert(it2->first == seq_num);
                                 auto& msg = it2->second;
                                 char* buf = msg.message_buffer.buffer.get();
                                 header* h = (header*)(buf);
                                 // no delivery for a NULL message
                                 if(msg.size > h->header_size && callbacks.global_stability_callback) {
+                                    UpcallScope upcall(subgroup_num);
                                     callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                                         msg.index,
                                                                         {{buf + h->header_size, msg.size - h->header_size}},
                                                                         persistent::INVALID_VERSION);
                                 }
-                                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
                                 if(node_id == members[member_index]) {
-                                    pending_message_timestamps[subgroup_num].erase(h->timestamp);
+                                    state.pending_message_timestamps.erase(h->timestamp);
                                 }
-                                locally_stable_rdmc_messages[subgroup_num].erase(it2);
+                                state.locally_stable_rdmc_messages.erase(it2);
                             }
                         }
                     }
@@ -387,10 +389,10 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                 };
                 // Capture rdmc_receive_handler by copy! The reference to it won't be valid after this constructor ends!
                 auto receive_handler_plus_notify =
-                        [this, rdmc_receive_handler](char* data, size_t size) {
+                        [this, subgroup_num, rdmc_receive_handler](char* data, size_t size) {
                             rdmc_receive_handler(data, size);
                             // signal background writer thread
-                            sender_cv.notify_all();
+                            notify_sender(subgroup_num);
                         };
 
                 // Create a "rotated" vector of members in which the currently selected shard member (shard_rank) is first
@@ -423,19 +425,17 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                     if(!rdmc::create_group(
                                rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, subgroup_settings.profile.rdmc_send_algorithm,
                                [this, subgroup_num, node_id](size_t length) {
-                                   std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
-                                   assert(!free_message_buffers[subgroup_num].empty());
+                                   std::lock_guard<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
                                    //Create a Message struct to receive the data into.
                                    RDMCMessage msg;
                                    msg.sender_id = node_id;
                                    // The length variable is not the exact size of the msg,
                                    // but it is the nearest multiple of the block size greater then the size
                                    // so we will set the size in the receive handler
-                                   msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-                                   free_message_buffers[subgroup_num].pop_back();
+                                   msg.message_buffer = buffer_pool->allocate(length);
 
-                                   rdmc::receive_destination ret{msg.message_buffer.mr, 0};
-                                   current_receives[{subgroup_num, node_id}] = std::move(msg);
+                                   rdmc::receive_destination ret{msg.message_buffer.mr, msg.message_buffer.offset};
+                                   subgroup_states[subgroup_num].current_receives[node_id] = std::move(msg);
 
                                    assert(ret.mr->buffer != nullptr);
                                    return ret;
@@ -477,6 +477,7 @@ void MulticastGroup::deliver_message(RDMCMessage& msg, const subgroup_id_t& subg
     if(msg.size <= sizeof(header)) {
         return;
     }
+    UpcallScope upcall(subgroup_num);
 
     char* buf = msg.message_buffer.buffer.get();
     header* h = (header*)(buf);
@@ -503,6 +504,7 @@ void MulticastGroup::deliver_message(SSTMessage& msg, const subgroup_id_t& subgr
     if(msg.size <= sizeof(header)) {
         return;
     }
+    UpcallScope upcall(subgroup_num);
 
     char* buf = const_cast<char*>(msg.buf);
     header* h = (header*)(buf);
@@ -533,7 +535,7 @@ bool MulticastGroup::version_message(RDMCMessage& msg, const subgroup_id_t& subg
         return false;
     }
     if(msg.sender_id == members[member_index]) {
-        pending_persistence[subgroup_num][locally_stable_rdmc_messages[subgroup_num].begin()->first] = msg_timestamp;
+        subgroup_states[subgroup_num].pending_persistence[subgroup_states[subgroup_num].locally_stable_rdmc_messages.begin()->first] = msg_timestamp;
     }
     // make a version for persistent<t>/volatile<t>
     uint64_t msg_ts_us = msg_timestamp / 1e3;
@@ -555,7 +557,7 @@ bool MulticastGroup::version_message(SSTMessage& msg, const subgroup_id_t& subgr
         return false;
     }
     if(msg.sender_id == members[member_index]) {
-        pending_persistence[subgroup_num][locally_stable_sst_messages[subgroup_num].begin()->first] = msg_timestamp;
+        subgroup_states[subgroup_num].pending_persistence[subgroup_states[subgroup_num].locally_stable_sst_messages.begin()->first] = msg_timestamp;
     }
     // make a version for persistent<t>/volatile<t>
     uint64_t msg_ts_us = msg_timestamp / 1e3;
@@ -574,7 +576,8 @@ void MulticastGroup::deliver_messages_upto(
     bool non_null_msgs_delivered = false;
     assert(max_indices_for_senders.size() == (size_t)num_shard_senders);
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+        std::lock_guard<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
+        SubgroupState& state = subgroup_states[subgroup_num];
         int32_t curr_seq_num = sst->delivered_num[member_index][subgroup_num];
         int32_t max_seq_num = curr_seq_num;
         for(uint sender = 0; sender < num_shard_senders; sender++) {
@@ -589,27 +592,26 @@ void MulticastGroup::deliver_messages_upto(
             if(index > max_indices_for_senders[sender_rank]) {
                 continue;
             }
-            auto rdmc_msg_ptr = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+            auto rdmc_msg_ptr = state.locally_stable_rdmc_messages.find(seq_num);
             assigned_version = persistent::combine_int32s(sst->vid[member_index], seq_num);
-            if(rdmc_msg_ptr != locally_stable_rdmc_messages[subgroup_num].end()) {
+            if(rdmc_msg_ptr != state.locally_stable_rdmc_messages.end()) {
                 auto& msg = rdmc_msg_ptr->second;
                 char* buf = msg.message_buffer.buffer.get();
                 uint64_t msg_ts = ((header*)buf)->timestamp;
                 //Note: deliver_message frees the RDMC buffer in msg, which is why the timestamp must be saved before calling this
                 deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
                 non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                // free the message buffer only after it version_message has been called
-                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
-                locally_stable_rdmc_messages[subgroup_num].erase(rdmc_msg_ptr);
+                // the message buffer is freed by erasing the message, which must happen only after version_message has been called
+                state.locally_stable_rdmc_messages.erase(rdmc_msg_ptr);
             } else {
                 dbg_default_trace("Subgroup {}, deliver_messages_upto delivering an SST message with seq_num = {}",
                                   subgroup_num, seq_num);
-                auto& msg = locally_stable_sst_messages[subgroup_num].at(seq_num);
+                auto& msg = state.locally_stable_sst_messages.at(seq_num);
                 char* buf = (char*)msg.buf;
                 uint64_t msg_ts = ((header*)buf)->timestamp;
                 deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
                 non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                locally_stable_sst_messages[subgroup_num].erase(seq_num);
+                state.locally_stable_sst_messages.erase(seq_num);
             }
         }
         gmssst::set(sst->delivered_num[member_index][subgroup_num], max_seq_num);
@@ -673,6 +675,8 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
                                          const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                                          uint32_t num_shard_senders, uint32_t sender_rank,
                                          volatile char* data, uint64_t size) {
+    // the caller holds the lock on the subgroup's state
+    SubgroupState& state = subgroup_states[subgroup_num];
     header* h = (header*)data;
     int32_t index = h->index;
     int32_t num_nulls = h->num_nulls;
@@ -684,7 +688,7 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
         message_id_t sequence_number = index * num_shard_senders + sender_rank;
         node_id_t node_id = subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_rank)];
 
-        locally_stable_sst_messages[subgroup_num][sequence_number] = {node_id, index, size, data};
+        state.locally_stable_sst_messages[sequence_number] = {node_id, index, size, data};
 
         auto new_num_received = resolve_num_received(index, subgroup_settings.num_received_offset + sender_rank);
 
@@ -706,39 +710,40 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
             // issue stability upcalls for the recently sequenced messages
             for(int i = sst->num_received[member_index][subgroup_settings.num_received_offset + sender_rank] + 1; i <= new_num_received; ++i) {
                 message_id_t seq_num = i * num_shard_senders + sender_rank;
-                if(!locally_stable_sst_messages[subgroup_num].empty()
-                   && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                    auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                if(!state.locally_stable_sst_messages.empty()
+                   && state.locally_stable_sst_messages.begin()->first == seq_num) {
+                    auto& msg = state.locally_stable_sst_messages.begin()->second;
                     char* buf = const_cast<char*>(msg.buf);
                     header* h = (header*)(buf);
                     if(msg.size > h->header_size && callbacks.global_stability_callback) {
+                        UpcallScope upcall(subgroup_num);
                         callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                             msg.index,
                                                             {{buf + h->header_size, msg.size - h->header_size}},
                                                             persistent::INVALID_VERSION);
                     }
                     if(node_id == members[member_index]) {
-                        pending_message_timestamps[subgroup_num].erase(h->timestamp);
+                        state.pending_message_timestamps.erase(h->timestamp);
                     }
-                    locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                    state.locally_stable_sst_messages.erase(state.locally_stable_sst_messages.begin());
                 } else {
-                    assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                    auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
+                    assert(!state.locally_stable_rdmc_messages.empty());
+                    auto it2 = state.locally_stable_rdmc_messages.begin();
                     assert(it2->first == seq_num);
                     auto& msg = it2->second;
                     char* buf = msg.message_buffer.buffer.get();
                     header* h = (header*)(buf);
                     if(msg.size > h->header_size && callbacks.global_stability_callback) {
+                        UpcallScope upcall(subgroup_num);
                         callbacks.global_stability_callback(subgroup_num, msg.sender_id,
                                                             msg.index,
                                                             {{buf + h->header_size, msg.size - h->header_size}},
                                                             persistent::INVALID_VERSION);
                     }
-                    free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
                     if(node_id == members[member_index]) {
-                        pending_message_timestamps[subgroup_num].erase(h->timestamp);
+                        state.pending_message_timestamps.erase(h->timestamp);
                     }
-                    locally_stable_rdmc_messages[subgroup_num].erase(it2);
+                    state.locally_stable_rdmc_messages.erase(it2);
                 }
             }
         }
@@ -756,7 +761,7 @@ void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const Subgrou
 
     bool put_new_seq_num = false;
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+        std::lock_guard<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
         for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
             const uint32_t sender_sst_index = node_id_to_sst_index.at(subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)]);
             uint32_t slot;
@@ -806,56 +811,51 @@ void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const Subgroup
                                       const uint32_t num_shard_members, DerechoSST& sst) {
     bool update_sst = false;
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
-        // compute the min of the seq_num
-        message_id_t min_stable_num
-                = sst.seq_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
-        for(uint i = 0; i < num_shard_members; ++i) {
-            // to avoid a race condition, do not read the same SST entry twice
-            message_id_t stable_num_copy = sst.seq_num[node_id_to_sst_index.at(subgroup_settings.members[i])][subgroup_num];
-            min_stable_num = std::min(min_stable_num, stable_num_copy);
-        }
+        std::lock_guard<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
+        SubgroupState& state = subgroup_states[subgroup_num];
+        // compute the min of the seq_num (this reads each SST entry only once,
+        // to avoid a race condition)
+        message_id_t min_stable_num = sst::column::min(sst.seq_num, subgroup_num, hot_settings[subgroup_num].member_sst_indices);
         bool non_null_msgs_delivered = false;
         persistent::version_t assigned_version = persistent::INVALID_VERSION;
         while(true) {
-            if(locally_stable_rdmc_messages[subgroup_num].empty() && locally_stable_sst_messages[subgroup_num].empty()) {
+            if(state.locally_stable_rdmc_messages.empty() && state.locally_stable_sst_messages.empty()) {
                 break;
             }
             int32_t least_undelivered_rdmc_seq_num, least_undelivered_sst_seq_num;
             least_undelivered_rdmc_seq_num = least_undelivered_sst_seq_num = std::numeric_limits<int32_t>::max();
-            if(!locally_stable_rdmc_messages[subgroup_num].empty()) {
-                least_undelivered_rdmc_seq_num = locally_stable_rdmc_messages[subgroup_num].begin()->first;
+            if(!state.locally_stable_rdmc_messages.empty()) {
+                least_undelivered_rdmc_seq_num = state.locally_stable_rdmc_messages.begin()->first;
             }
-            if(!locally_stable_sst_messages[subgroup_num].empty()) {
-                least_undelivered_sst_seq_num = locally_stable_sst_messages[subgroup_num].begin()->first;
+            if(!state.locally_stable_sst_messages.empty()) {
+                least_undelivered_sst_seq_num = state.locally_stable_sst_messages.begin()->first;
             }
             if(least_undelivered_rdmc_seq_num < least_undelivered_sst_seq_num && least_undelivered_rdmc_seq_num <= min_stable_num) {
                 update_sst = true;
                 dbg_default_trace("Subgroup {}, can deliver a locally stable RDMC message: min_stable_num={} and least_undelivered_seq_num={}",
                                   subgroup_num, min_stable_num, least_undelivered_rdmc_seq_num);
-                RDMCMessage& msg = locally_stable_rdmc_messages[subgroup_num].begin()->second;
+                RDMCMessage& msg = state.locally_stable_rdmc_messages.begin()->second;
                 char* buf = msg.message_buffer.buffer.get();
                 uint64_t msg_ts = ((header*)buf)->timestamp;
                 //Note: deliver_message frees the RDMC buffer in msg, which is why the timestamp must be saved before calling this
                 assigned_version = persistent::combine_int32s(sst.vid[member_index], least_undelivered_rdmc_seq_num);
                 deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
                 non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                // free the message buffer only after version_message has been called
-                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
+                // the message buffer is freed by erasing the message, which must happen only after version_message has been called
                 sst.delivered_num[member_index][subgroup_num] = least_undelivered_rdmc_seq_num;
-                locally_stable_rdmc_messages[subgroup_num].erase(locally_stable_rdmc_messages[subgroup_num].begin());
+                state.locally_stable_rdmc_messages.erase(state.locally_stable_rdmc_messages.begin());
             } else if(least_undelivered_sst_seq_num < least_undelivered_rdmc_seq_num && least_undelivered_sst_seq_num <= min_stable_num) {
                 update_sst = true;
                 dbg_default_trace("Subgroup {}, can deliver a locally stable SST message: min_stable_num={} and least_undelivered_seq_num={}",
                                   subgroup_num, min_stable_num, least_undelivered_sst_seq_num);
-                SSTMessage& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                SSTMessage& msg = state.locally_stable_sst_messages.begin()->second;
                 char* buf = (char*)msg.buf;
                 uint64_t msg_ts = ((header*)buf)->timestamp;
                 assigned_version = persistent::combine_int32s(sst.vid[member_index], least_undelivered_sst_seq_num);
                 deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
                 non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
                 sst.delivered_num[member_index][subgroup_num] = least_undelivered_sst_seq_num;
-                locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                state.locally_stable_sst_messages.erase(state.locally_stable_sst_messages.begin());
             } else {
                 break;
             }
@@ -880,7 +880,7 @@ void MulticastGroup::sst_send_trigger(subgroup_id_t subgroup_num, const Subgroup
     int32_t current_first_null_index;
     uint32_t current_num_nulls_queued;
     {
-        std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
+        std::unique_lock<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
         to_be_sent = committed_sst_index[subgroup_num] - sst.index[member_index][subgroup_settings.index_offset];
         if(to_be_sent > 0) {
             current_committed_index = sst_multicast_group_ptrs[subgroup_num]->commit_send(to_be_sent);
@@ -908,17 +908,12 @@ void MulticastGroup::sst_send_trigger(subgroup_id_t subgroup_num, const Subgroup
 
 void MulticastGroup::update_min_persisted_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
                                               uint32_t num_shard_members, DerechoSST& sst) {
-    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+    std::lock_guard<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
     // compute the min of the persisted_num
-    persistent::version_t min_persisted_num
-            = sst.persisted_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
-    for(uint32_t i = 1; i < num_shard_members; ++i) {
-        persistent::version_t persisted_num_copy = sst.persisted_num[node_id_to_sst_index.at(subgroup_settings.members[i])]
-                                                                    [subgroup_num];
-        min_persisted_num = std::min(min_persisted_num, persisted_num_copy);
-    }
+    persistent::version_t min_persisted_num = sst::column::min(sst.persisted_num, subgroup_num, hot_settings[subgroup_num].member_sst_indices);
     // callbacks
     if(min_persisted_num > minimum_persisted_version[subgroup_num]) {
+        UpcallScope upcall(subgroup_num);
         if(callbacks.global_persistence_callback) {
             callbacks.global_persistence_callback(subgroup_num, min_persisted_num);
         }
@@ -932,14 +927,8 @@ void MulticastGroup::update_min_persisted_num(subgroup_id_t subgroup_num, const
 
 void MulticastGroup::update_min_verified_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
                                              uint32_t num_shard_members, DerechoSST& sst) {
-    //Do I need msg_state_mtx here? What does it guard?
-    persistent::version_t min_verified_num
-            = sst.verified_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
-    for(uint32_t i = 1; i < num_shard_members; ++i) {
-        persistent::version_t member_verified_num = sst.verified_num[node_id_to_sst_index.at(subgroup_settings.members[i])]
-                                                                    [subgroup_num];
-        min_verified_num = std::min(min_verified_num, member_verified_num);
-    }
+    // No lock needed: minimum_verified_version[subgroup_num] is only used by this trigger
+    persistent::version_t min_verified_num = sst::column::min(sst.verified_num, subgroup_num, hot_settings[subgroup_num].member_sst_indices);
     if(min_verified_num > minimum_verified_version[subgroup_num]) {
         if(callbacks.global_verified_callback) {
             callbacks.global_verified_callback(subgroup_num, min_verified_num);
@@ -981,7 +970,7 @@ void MulticastGroup::register_predicates() {
                               sst_receive_handler_lambda);
         };
         receiver_pred_handles.emplace_back(sst->predicates.insert(receiver_pred, receiver_trig,
-                                                                  sst::PredicateType::RECURRENT));
+                                                                  sst::PredicateType::RECURRENT, subgroup_num));
 
         auto sst_send_pred = [](const DerechoSST& sst) {
             return true;
@@ -990,7 +979,7 @@ void MulticastGroup::register_predicates() {
             sst_send_trigger(subgroup_num, subgroup_settings, num_shard_members, sst);
         };
         receiver_pred_handles.emplace_back(sst->predicates.insert(sst_send_pred, sst_send_trig,
-                                                                  sst::PredicateType::RECURRENT));
+                                                                  sst::PredicateType::RECURRENT, subgroup_num));
 
         if(subgroup_settings.mode != Mode::UNORDERED) {
             auto delivery_pred = [](const DerechoSST& sst) {
@@ -1001,7 +990,7 @@ void MulticastGroup::register_predicates() {
             };
 
             delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, delivery_trig,
-                                                                      sst::PredicateType::RECURRENT));
+                                                                      sst::PredicateType::RECURRENT, subgroup_num));
 
             //This predicate should be "current min over persisted_num is greater than the last
             //observed minimum persisted_num," but computing the current min in the predicate is
@@ -1014,7 +1003,7 @@ void MulticastGroup::register_predicates() {
                 update_min_persisted_num(subgroup_num, subgroup_settings, num_shard_members, sst);
             };
 
-            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, persistence_trig, sst::PredicateType::RECURRENT));
+            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, persistence_trig, sst::PredicateType::RECURRENT, subgroup_num));
 
             //In case there are persistent objects with signatures, add a similar predicate to check/update the minimum verified_num
             auto verified_pred = [](const DerechoSST& sst) {
@@ -1024,43 +1013,40 @@ void MulticastGroup::register_predicates() {
                 update_min_verified_num(subgroup_num, subgroup_settings, num_shard_members, sst);
             };
 
-            persistence_pred_handles.emplace_back(sst->predicates.insert(verified_pred, verified_trig, sst::PredicateType::RECURRENT));
+            persistence_pred_handles.emplace_back(sst->predicates.insert(verified_pred, verified_trig, sst::PredicateType::RECURRENT, subgroup_num));
 
             if(subgroup_settings.sender_rank >= 0) {
-                auto sender_pred = [=](const DerechoSST& sst) {
-                    message_id_t seq_num = next_message_to_deliver[subgroup_num] * num_shard_senders + subgroup_settings.sender_rank;
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        if(sst.delivered_num[node_id_to_sst_index.at(subgroup_settings.members[i])][subgroup_num] < seq_num) {
-                            return false;
-                        }
-                    }
-                    return true;
+                const SubgroupHotSettings& hot = hot_settings[subgroup_num];
+                auto sender_pred = [this, subgroup_num, &hot](const DerechoSST& sst) {
+                    message_id_t seq_num = next_message_to_deliver[subgroup_num] * hot.num_shard_senders + hot.sender_rank;
+                    return sst::column::all_at_least(sst.delivered_num, subgroup_num, hot.member_sst_indices, seq_num);
                 };
                 auto sender_trig = [=](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    notify_sender(subgroup_num);
                     next_message_to_deliver[subgroup_num]++;
+                    if(internal_callbacks.send_window_callback) {
+                        internal_callbacks.send_window_callback(subgroup_num);
+                    }
                 };
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT, subgroup_num));
             }
         } else {
             //This subgroup is in UNORDERED mode
             if(subgroup_settings.sender_rank >= 0) {
-                auto sender_pred = [=](const DerechoSST& sst) {
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        uint32_t num_received_offset = subgroup_settings.num_received_offset;
-                        if(sst.num_received[node_id_to_sst_index.at(subgroup_settings.members[i])][num_received_offset + subgroup_settings.sender_rank]
-                           < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - subgroup_settings.profile.window_size)) {
-                            return false;
-                        }
-                    }
-                    return true;
+                const SubgroupHotSettings& hot = hot_settings[subgroup_num];
+                auto sender_pred = [this, subgroup_num, &hot](const DerechoSST& sst) {
+                    return sst::column::all_at_least(sst.num_received, hot.own_num_received_column, hot.member_sst_indices,
+                                                     static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - hot.window_size));
                 };
-                auto sender_trig = [this](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                auto sender_trig = [this, subgroup_num](DerechoSST& sst) {
+                    notify_sender(subgroup_num);
+                    if(internal_callbacks.send_window_callback) {
+                        internal_callbacks.send_window_callback(subgroup_num);
+                    }
                 };
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT, subgroup_num));
             }
         }
     }
@@ -1079,7 +1065,14 @@ void MulticastGroup::wedge() {
         return;
     }
 
-    //Consume and remove all the predicate handles
+    // Wake up the upcalls waiting for room in a deferred send queue
+    for(auto& state : subgroup_states) {
+        std::lock_guard<std::mutex> deferred_lock(state.deferred_sends_mutex);
+        state.deferred_sends_cv.notify_all();
+    }
+
+    //Consume and remove all the predicate handles. No lock may be held here
+    //that a subgroup trigger takes, since remove() waits for a running one.
     for(auto handle_iter = sender_pred_handles.begin(); handle_iter != sender_pred_handles.end();) {
         sst->predicates.remove(*handle_iter);
         handle_iter = sender_pred_handles.erase(handle_iter);
@@ -1097,19 +1090,36 @@ void MulticastGroup::wedge() {
         handle_iter = persistence_pred_handles.erase(handle_iter);
     }
 
-    for(uint i = 0; i < num_members; ++i) {
-        rdmc::destroy_group(i + rdmc_group_num_offset);
+    std::lock_guard<std::mutex> lock(msg_state_mtx);
+    // rdmc_group_num_offset was advanced past every group this view created
+    for(uint16_t group_num = first_rdmc_group_num; group_num < rdmc_group_num_offset; ++group_num) {
+        rdmc::destroy_group(group_num);
     }
 
-    sender_cv.notify_all();
-    if(sender_thread.joinable()) {
-        sender_thread.join();
+    for(auto& sender : sender_threads) {
+        {
+            std::lock_guard<std::mutex> lock(sender->wakeup_mutex);
+            sender->wakeup_count++;
+        }
+        sender->wakeup_cv.notify_all();
+    }
+    for(auto& sender : sender_threads) {
+        if(sender->thread.joinable()) {
+            sender->thread.join();
+        }
     }
 }
 
-void MulticastGroup::send_loop() {
-    pthread_setname_np(pthread_self(), "sender_thread");
-    subgroup_id_t subgroup_to_send = 0;
+void MulticastGroup::send_loop(uint32_t thread_index) {
+    if(sender_threads.size() == 1) {
+        pthread_setname_np(pthread_self(), "sender_thread");
+    } else {
+        std::string thread_name = "sender_" + std::to_string(thread_index);
+        pthread_setname_np(pthread_self(), thread_name.c_str());
+    }
+    SenderThread& self = *sender_threads[thread_index];
+    const std::size_t num_subgroups = self.subgroups.size();
+    std::size_t next_subgroup = 0;
     auto should_send_to_subgroup = [&](subgroup_id_t subgroup_num) {
         if(!rdmc_sst_groups_created) {
             return false;
@@ -1117,61 +1127,49 @@ void MulticastGroup::send_loop() {
         if(pending_sends[subgroup_num].empty()) {
             return false;
         }
-        RDMCMessage& msg = pending_sends[subgroup_num].front();
-        const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
-
-        int shard_sender_index = subgroup_settings.sender_rank;
-        std::vector<int> shard_senders = subgroup_settings.senders;
-        uint32_t num_shard_senders = get_num_senders(shard_senders);
-        assert(shard_sender_index >= 0);
+        const RDMCMessage& msg = pending_sends[subgroup_num].front();
+        const SubgroupHotSettings& hot = hot_settings[subgroup_num];
+        assert(hot.sender_rank >= 0);
 
-        if(sst->num_received[member_index][subgroup_settings.num_received_offset + shard_sender_index] < msg.index - 1) {
+        if(sst->num_received[member_index][hot.own_num_received_column] < msg.index - 1) {
             return false;
         }
 
-        std::vector<node_id_t> shard_members = subgroup_settings.members;
-        auto num_shard_members = shard_members.size();
-        assert(num_shard_members >= 1);
-        if(subgroup_settings.mode != Mode::UNORDERED) {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < static_cast<message_id_t>((msg.index - subgroup_settings.profile.window_size) * num_shard_senders + shard_sender_index)) {
-                    return false;
-                }
-            }
-        } else {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                auto num_received_offset = subgroup_settings.num_received_offset;
-                if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-                   < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - subgroup_settings.profile.window_size)) {
-                    return false;
-                }
-            }
-        }
-
-        return true;
-    };
-    auto should_send = [&]() {
-        for(uint i = 1; i <= total_num_subgroups; ++i) {
-            auto subgroup_num = (subgroup_to_send + i) % total_num_subgroups;
-            if(should_send_to_subgroup(subgroup_num)) {
-                subgroup_to_send = subgroup_num;
-                return true;
-            }
-        }
-        return false;
+        assert(hot.member_sst_indices.size() >= 1);
+        return window_has_room(hot, subgroup_num, sst->delivered_num, sst->num_received,
+                               hot.mode != Mode::UNORDERED ? msg.index : future_message_indices[subgroup_num] - 1);
     };
-    auto should_wake = [&]() { return thread_shutdown || should_send(); };
-    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
     while(!thread_shutdown) {
-        sender_cv.wait(lock, should_wake);
-        if(!thread_shutdown) {
+        // Read the wakeup count before looking at the subgroups, so that a
+        // notification arriving while they are checked is not lost
+        uint64_t wakeup_count;
+        {
+            std::lock_guard<std::mutex> lock(self.wakeup_mutex);
+            wakeup_count = self.wakeup_count;
+        }
+        bool sent = false;
+        for(std::size_t i = 0; i < num_subgroups && !thread_shutdown; ++i) {
+            const subgroup_id_t subgroup_to_send = self.subgroups[(next_subgroup + i) % num_subgroups];
+            std::unique_lock<std::recursive_mutex> lock(subgroup_states[subgroup_to_send].mtx);
+            flush_deferred_sends(subgroup_to_send);
+            if(subgroup_states[subgroup_to_send].send_ready_wanted.exchange(false)
+               && internal_callbacks.send_window_callback) {
+                // without the lock, since the callback may send
+                lock.unlock();
+                internal_callbacks.send_window_callback(subgroup_to_send);
+                lock.lock();
+            }
+            if(!should_send_to_subgroup(subgroup_to_send)) {
+                continue;
+            }
             current_sends[subgroup_to_send] = std::move(pending_sends[subgroup_to_send].front());
             dbg_default_trace("Calling send in subgroup {} on message {} from sender {}",
                               subgroup_to_send, current_sends[subgroup_to_send]->index, current_sends[subgroup_to_send]->sender_id);
             // make sure there are > 1 members before issuing RDMC send
-            if(subgroup_settings_map.at(subgroup_to_send).members.size() > 1) {
+            if(hot_settings[subgroup_to_send].num_shard_members > 1) {
                 if(!rdmc::send(subgroup_to_rdmc_group.at(subgroup_to_send),
-                               current_sends[subgroup_to_send]->message_buffer.mr, 0,
+                               current_sends[subgroup_to_send]->message_buffer.mr,
+                               current_sends[subgroup_to_send]->message_buffer.offset,
                                current_sends[subgroup_to_send]->size)) {
                     throw std::runtime_error("rdmc::send returned false");
                 }
@@ -1181,10 +1179,58 @@ void MulticastGroup::send_loop() {
                         current_sends[subgroup_to_send]->message_buffer.buffer.get(), current_sends[subgroup_to_send]->size);
             }
             pending_sends[subgroup_to_send].pop();
+            next_subgroup = (next_subgroup + i + 1) % num_subgroups;
+            sent = true;
+            break;
+        }
+        if(!sent) {
+            std::unique_lock<std::mutex> lock(self.wakeup_mutex);
+            self.wakeup_cv.wait(lock, [&]() { return thread_shutdown || self.wakeup_count != wakeup_count; });
         }
     }
 }
 
+void MulticastGroup::create_sender_threads() {
+    std::vector<subgroup_id_t> sending_subgroups;
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
+        if(hot_settings[subgroup_num].is_member && hot_settings[subgroup_num].sender_rank >= 0) {
+            sending_subgroups.push_back(subgroup_num);
+        }
+    }
+    uint32_t num_threads = getConfUInt32(CONF_DERECHO_SENDER_THREADS);
+    if(num_threads == 0 || num_threads > sending_subgroups.size()) {
+        num_threads = sending_subgroups.size();
+    }
+    sender_thread_of.assign(total_num_subgroups, -1);
+    for(uint32_t i = 0; i < num_threads; ++i) {
+        sender_threads.emplace_back(std::make_unique<SenderThread>());
+    }
+    for(std::size_t i = 0; i < sending_subgroups.size(); ++i) {
+        sender_threads[i % num_threads]->subgroups.push_back(sending_subgroups[i]);
+        sender_thread_of[sending_subgroups[i]] = i % num_threads;
+    }
+    dbg_default_debug("Sending in {} subgroups with {} sender threads", sending_subgroups.size(), num_threads);
+}
+
+void MulticastGroup::start_sender_threads() {
+    for(uint32_t i = 0; i < sender_threads.size(); ++i) {
+        sender_threads[i]->thread = std::thread(&MulticastGroup::send_loop, this, i);
+    }
+}
+
+void MulticastGroup::notify_sender(subgroup_id_t subgroup_num) {
+    const int32_t thread_index = sender_thread_of[subgroup_num];
+    if(thread_index < 0) {
+        return;
+    }
+    SenderThread& sender = *sender_threads[thread_index];
+    {
+        std::lock_guard<std::mutex> lock(sender.wakeup_mutex);
+        sender.wakeup_count++;
+    }
+    sender.wakeup_cv.notify_one();
+}
+
 const uint64_t MulticastGroup::compute_global_stability_frontier(uint32_t subgroup_num) {
     uint64_t global_stability_frontier = sst->local_stability_frontier[member_index][subgroup_num];
     auto shard_sst_indices = get_shard_sst_indices(subgroup_num);
@@ -1200,30 +1246,28 @@ void MulticastGroup::check_failures_loop() {
     while(!thread_shutdown) {
         std::this_thread::sleep_for(std::chrono::milliseconds(sender_timeout));
         if(sst) {
-            {
-                std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
-                auto current_time = get_walltime();
-                for(auto p : subgroup_settings_map) {
-                    auto subgroup_num = p.first;
-                    auto members = p.second.members;
-                    auto sst_indices = get_shard_sst_indices(subgroup_num);
-                    // clean up timestamps of persisted messages
-                    auto min_persisted_num = sst->persisted_num[member_index][subgroup_num];
-                    for(auto i : sst_indices) {
-                        persistent::version_t persisted_num_copy = sst->persisted_num[i][subgroup_num];
-                        min_persisted_num = std::min(min_persisted_num, persisted_num_copy);
-                    }
-                    while(!pending_persistence[subgroup_num].empty() && pending_persistence[subgroup_num].begin()->first <= min_persisted_num) {
-                        auto timestamp = pending_persistence[subgroup_num].begin()->second;
-                        pending_persistence[subgroup_num].erase(pending_persistence[subgroup_num].begin());
-                        pending_message_timestamps[subgroup_num].erase(timestamp);
-                    }
-                    if(pending_message_timestamps[subgroup_num].empty()) {
-                        sst->local_stability_frontier[member_index][subgroup_num] = current_time;
-                    } else {
-                        sst->local_stability_frontier[member_index][subgroup_num] = std::min(current_time,
-                                                                                             *pending_message_timestamps[subgroup_num].begin());
-                    }
+            auto current_time = get_walltime();
+            for(const auto& p : subgroup_settings_map) {
+                auto subgroup_num = p.first;
+                SubgroupState& state = subgroup_states[subgroup_num];
+                std::lock_guard<std::recursive_mutex> lock(state.mtx);
+                const auto& sst_indices = get_shard_sst_indices(subgroup_num);
+                // clean up timestamps of persisted messages
+                auto min_persisted_num = sst->persisted_num[member_index][subgroup_num];
+                for(auto i : sst_indices) {
+                    persistent::version_t persisted_num_copy = sst->persisted_num[i][subgroup_num];
+                    min_persisted_num = std::min(min_persisted_num, persisted_num_copy);
+                }
+                while(!state.pending_persistence.empty() && state.pending_persistence.begin()->first <= min_persisted_num) {
+                    auto timestamp = state.pending_persistence.begin()->second;
+                    state.pending_persistence.erase(state.pending_persistence.begin());
+                    state.pending_message_timestamps.erase(timestamp);
+                }
+                if(state.pending_message_timestamps.empty()) {
+                    sst->local_stability_frontier[member_index][subgroup_num] = current_time;
+                } else {
+                    sst->local_stability_frontier[member_index][subgroup_num] = std::min(current_time,
+                                                                                         *state.pending_message_timestamps.begin());
                 }
             }
             sst->put_with_completion((char*)std::addressof(sst->local_stability_frontier[0][0]) - sst->getBaseAddress(),
@@ -1232,7 +1276,7 @@ void MulticastGroup::check_failures_loop() {
     }
 }
 
-// we already hold the lock on msg_state_mtx when we call this
+// we already hold the lock on the subgroup's state when we call this
 void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
     // short-circuits most of the normal checks because
     // we know that we received a message and are sending a null
@@ -1246,11 +1290,10 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num];
         msg.size = msg_size;
-        msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-        free_message_buffers[subgroup_num].pop_back();
+        msg.message_buffer = buffer_pool->allocate(msg_size);
 
         auto current_time = get_walltime();
-        pending_message_timestamps[subgroup_num].insert(current_time);
+        subgroup_states[subgroup_num].pending_message_timestamps.insert(current_time);
 
         // Fill header
         char* buf = msg.message_buffer.buffer.get();
@@ -1261,14 +1304,14 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
 
         future_message_indices[subgroup_num]++;
         pending_sends[subgroup_num].push(std::move(msg));
-        sender_cv.notify_all();
+        notify_sender(subgroup_num);
     } else {
         char* buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
 
         assert(buf);
 
         auto current_time = get_walltime();
-        pending_message_timestamps[subgroup_num].insert(current_time);
+        subgroup_states[subgroup_num].pending_message_timestamps.insert(current_time);
 
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->index = future_message_indices[subgroup_num];
@@ -1297,30 +1340,12 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         throw derecho_exception(exp_msg);
     }
 
-    std::vector<node_id_t> shard_members = subgroup_settings.members;
-    auto num_shard_members = shard_members.size();
-    // if the current node is not a sender, shard_sender_index will be -1
-    uint32_t num_shard_senders;
-    std::vector<int> shard_senders = subgroup_settings.senders;
-    int shard_sender_index = subgroup_settings.sender_rank;
-    num_shard_senders = get_num_senders(shard_senders);
-    assert(shard_sender_index >= 0);
-
-    if(subgroup_settings.mode != Mode::UNORDERED) {
-        for(uint i = 0; i < num_shard_members; ++i) {
-            if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num]
-               < static_cast<int32_t>((future_message_indices[subgroup_num] - subgroup_settings.profile.window_size) * num_shard_senders + shard_sender_index)) {
-                return nullptr;
-            }
-        }
-    } else {
-        for(uint i = 0; i < num_shard_members; ++i) {
-            auto num_received_offset = subgroup_settings.num_received_offset;
-            if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-               < static_cast<int32_t>(future_message_indices[subgroup_num] - subgroup_settings.profile.window_size)) {
-                return nullptr;
-            }
-        }
+    // if the current node is not a sender, sender_rank will be -1
+    const SubgroupHotSettings& hot = hot_settings[subgroup_num];
+    assert(hot.sender_rank >= 0);
+
+    if(!window_has_room(hot, subgroup_num, sst->delivered_num, sst->num_received, future_message_indices[subgroup_num])) {
+        return nullptr;
     }
 
     if(msg_size > subgroup_settings.profile.sst_max_msg_size) {
@@ -1328,11 +1353,7 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
             return nullptr;
         }
 
-        if(free_message_buffers[subgroup_num].empty()) {
-            return nullptr;
-        }
-
-        if(pending_sst_sends[subgroup_num] || next_sends[subgroup_num]) {
+        if(subgroup_states[subgroup_num].pending_sst_send || next_sends[subgroup_num]) {
             return nullptr;
         }
 
@@ -1341,11 +1362,10 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num];
         msg.size = msg_size;
-        msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-        free_message_buffers[subgroup_num].pop_back();
+        msg.message_buffer = buffer_pool->allocate(msg_size);
 
         auto current_time = get_walltime();
-        pending_message_timestamps[subgroup_num].insert(current_time);
+        subgroup_states[subgroup_num].pending_message_timestamps.insert(current_time);
 
         // Fill header
         char* buf = msg.message_buffer.buffer.get();
@@ -1360,22 +1380,22 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         last_transfer_medium[subgroup_num] = true;
         return buf + sizeof(header);
     } else {
-        if(pending_sst_sends[subgroup_num] || next_sends[subgroup_num]) {
+        if(subgroup_states[subgroup_num].pending_sst_send || next_sends[subgroup_num]) {
             return nullptr;
         }
 
-        pending_sst_sends[subgroup_num] = true;
+        subgroup_states[subgroup_num].pending_sst_send = true;
         if(thread_shutdown) {
-            pending_sst_sends[subgroup_num] = false;
+            subgroup_states[subgroup_num].pending_sst_send = false;
             return nullptr;
         }
         char* buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
         if(!buf) {
-            pending_sst_sends[subgroup_num] = false;
+            subgroup_states[subgroup_num].pending_sst_send = false;
             return nullptr;
         }
         auto current_time = get_walltime();
-        pending_message_timestamps[subgroup_num].insert(current_time);
+        subgroup_states[subgroup_num].pending_message_timestamps.insert(current_time);
 
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->index = future_message_indices[subgroup_num];
@@ -1396,8 +1416,11 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num, long long unsigned int pay
     if(!rdmc_sst_groups_created) {
         return false;
     }
-    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
-    char* buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send);
+    if(upcall_subgroup >= 0 && upcall_subgroup != subgroup_num) {
+        return defer_send(subgroup_num, payload_size, msg_generator, cooked_send);
+    }
+    std::unique_lock<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
+    char* buf = flush_deferred_sends(subgroup_num) ? get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send) : nullptr;
     while(!buf) {
         // Don't want any deadlocks. For example, this thread cannot get a buffer because delivery is lagging
         // but the SST detect thread cannot proceed (and deliver) because it requires the same lock
@@ -1408,37 +1431,154 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num, long long unsigned int pay
             return false;
         }
         lock.lock();
-        buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send);
+        buf = flush_deferred_sends(subgroup_num) ? get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send) : nullptr;
     }
     // call to the user supplied message generator
     msg_generator(buf);
+    commit_send(subgroup_num);
+    return true;
+}
 
+bool MulticastGroup::try_send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                              const std::function<void(char* buf)>& msg_generator, bool cooked_send) {
+    if(!rdmc_sst_groups_created || thread_shutdown) {
+        return false;
+    }
+    SubgroupState& state = subgroup_states[subgroup_num];
+    std::unique_lock<std::recursive_mutex> lock(state.mtx, std::defer_lock);
+    if(upcall_subgroup >= 0 && upcall_subgroup != subgroup_num) {
+        // Waiting for the lock from an upcall in another subgroup could
+        // deadlock, see defer_send(). If it is taken, the sender thread
+        // raises the send window callback once it is free.
+        if(!lock.try_lock()) {
+            state.send_ready_wanted = true;
+            notify_sender(subgroup_num);
+            return false;
+        }
+    } else {
+        lock.lock();
+    }
+    if(!flush_deferred_sends(subgroup_num)) {
+        return false;
+    }
+    char* buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send);
+    if(!buf) {
+        return false;
+    }
+    msg_generator(buf);
+    commit_send(subgroup_num);
+    return true;
+}
+
+bool MulticastGroup::defer_send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                                const std::function<void(char* buf)>& msg_generator, bool cooked_send) {
+    const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
+    if(payload_size + sizeof(header) > subgroup_settings.profile.max_msg_size) {
+        std::string exp_msg("Can't send messages of size larger than the maximum message size which is equal to ");
+        exp_msg += std::to_string(subgroup_settings.profile.max_msg_size);
+        throw derecho_exception(exp_msg);
+    }
+    dbg_default_trace("Deferring a send in subgroup {} from an upcall in subgroup {}", subgroup_num, upcall_subgroup);
+    {
+        SubgroupState& state = subgroup_states[subgroup_num];
+        std::unique_lock<std::mutex> deferred_lock(state.deferred_sends_mutex);
+        state.deferred_sends_cv.wait(deferred_lock, [&]() {
+            return state.deferred_sends.size() < subgroup_settings.profile.window_size || thread_shutdown;
+        });
+        if(thread_shutdown) {
+            return false;
+        }
+        // generate the message only once it has room, since a failed send is retried in the next view
+        DeferredSend deferred{std::vector<char>(payload_size), cooked_send};
+        msg_generator(deferred.payload.data());
+        state.deferred_sends.push(std::move(deferred));
+    }
+    notify_sender(subgroup_num);
+    return true;
+}
+
+bool MulticastGroup::flush_deferred_sends(subgroup_id_t subgroup_num) {
+    // the caller holds the lock on the subgroup's state
+    SubgroupState& state = subgroup_states[subgroup_num];
+    std::lock_guard<std::mutex> deferred_lock(state.deferred_sends_mutex);
+    if(!rdmc_sst_groups_created) {
+        return state.deferred_sends.empty();
+    }
+    while(!state.deferred_sends.empty()) {
+        DeferredSend& deferred = state.deferred_sends.front();
+        char* buf = get_sendbuffer_ptr(subgroup_num, deferred.payload.size(), deferred.cooked_send);
+        if(!buf) {
+            return false;
+        }
+        std::copy(deferred.payload.begin(), deferred.payload.end(), buf);
+        commit_send(subgroup_num);
+        state.deferred_sends.pop();
+        state.deferred_sends_cv.notify_all();
+    }
+    return true;
+}
+
+void MulticastGroup::commit_send(subgroup_id_t subgroup_num) {
     if(last_transfer_medium[subgroup_num]) {
         assert(next_sends[subgroup_num]);
         pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
         next_sends[subgroup_num] = std::nullopt;
-        sender_cv.notify_all();
-        return true;
+        notify_sender(subgroup_num);
     } else {
         committed_sst_index[subgroup_num]++;
-        pending_sst_sends[subgroup_num] = false;
-        return true;
+        subgroup_states[subgroup_num].pending_sst_send = false;
     }
 }
 
 bool MulticastGroup::check_pending_sst_sends(subgroup_id_t subgroup_num) {
-    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
-    return pending_sst_sends[subgroup_num];
+    std::lock_guard<std::recursive_mutex> lock(subgroup_states[subgroup_num].mtx);
+    return subgroup_states[subgroup_num].pending_sst_send;
 }
 
-std::vector<uint32_t> MulticastGroup::get_shard_sst_indices(subgroup_id_t subgroup_num) {
-    std::vector<node_id_t> shard_members = subgroup_settings_map.at(subgroup_num).members;
+const std::vector<uint32_t>& MulticastGroup::get_shard_sst_indices(subgroup_id_t subgroup_num) const {
+    return hot_settings[subgroup_num].member_sst_indices;
+}
 
-    std::vector<uint32_t> shard_sst_indices;
-    for(auto m : shard_members) {
-        shard_sst_indices.push_back(node_id_to_sst_index.at(m));
+bool MulticastGroup::window_has_room(const SubgroupHotSettings& hot,
+                                     subgroup_id_t subgroup_num,
+                                     const sst::SSTFieldVector<message_id_t>& delivered_num,
+                                     const sst::SSTFieldVector<int32_t>& num_received,
+                                     message_id_t msg_index) {
+    if(hot.mode != Mode::UNORDERED) {
+        return sst::column::all_at_least(delivered_num, subgroup_num, hot.member_sst_indices,
+                                         static_cast<message_id_t>((msg_index - hot.window_size) * hot.num_shard_senders + hot.sender_rank));
+    } else {
+        return sst::column::all_at_least(num_received, hot.own_num_received_column, hot.member_sst_indices,
+                                         static_cast<int32_t>(msg_index - hot.window_size));
     }
-    return shard_sst_indices;
+}
+
+std::vector<SubgroupHotSettings> MulticastGroup::compute_hot_settings(
+        const std::vector<node_id_t>& members,
+        uint32_t total_num_subgroups,
+        const std::map<subgroup_id_t, SubgroupSettings>& subgroup_settings_by_id) {
+    std::map<node_id_t, uint32_t> sst_index_of;
+    for(uint32_t i = 0; i < members.size(); ++i) {
+        sst_index_of[members[i]] = i;
+    }
+    std::vector<SubgroupHotSettings> result(total_num_subgroups);
+    for(const auto& p : subgroup_settings_by_id) {
+        const SubgroupSettings& settings = p.second;
+        SubgroupHotSettings& hot = result[p.first];
+        hot.is_member = true;
+        hot.mode = settings.mode;
+        hot.num_shard_members = settings.members.size();
+        hot.num_shard_senders = std::count_if(settings.senders.begin(), settings.senders.end(),
+                                              [](int is_sender) { return is_sender != 0; });
+        hot.sender_rank = settings.sender_rank;
+        hot.own_num_received_column = settings.num_received_offset + std::max(settings.sender_rank, 0);
+        hot.window_size = settings.profile.window_size;
+        hot.member_sst_indices.reserve(settings.members.size());
+        for(node_id_t shard_member : settings.members) {
+            hot.member_sst_indices.push_back(sst_index_of.at(shard_member));
+        }
+    }
+    return result;
 }
 
 void MulticastGroup::debug_print() {
@@ -1469,9 +1609,16 @@ void MulticastGroup::debug_print() {
         cout << endl;
     }
 
-    std::cout << "Printing memory usage of free_message_buffers" << std::endl;
-    for(const auto& p : free_message_buffers) {
-        std::cout << "Subgroup " << p.first << ", Number of free buffers " << p.second.size() << std::endl;
+    std::cout << "Printing memory usage of the RDMC buffer pool" << std::endl;
+    const RDMCBufferPool::Usage usage = buffer_pool->get_usage();
+    std::cout << "Registered " << usage.registered_bytes << " bytes in " << usage.num_regions << " regions ("
+              << usage.hugepage_bytes << " bytes of huge pages), " << usage.allocated_bytes << " bytes allocated" << std::endl;
+    for(uint32_t size_class = 0; size_class < usage.allocated_blocks.size(); ++size_class) {
+        if(usage.allocated_blocks[size_class] > 0 || usage.free_blocks[size_class] > 0) {
+            std::cout << "Blocks of " << (RDMCBufferPool::MIN_BLOCK_SIZE << size_class) << " bytes: "
+                      << usage.allocated_blocks[size_class] << " allocated, "
+                      << usage.free_blocks[size_class] << " free" << std::endl;
+        }
     }
 }
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <map>
 
 #include <cassert>
@@ -8,10 +9,63 @@
 #include <derecho/conf/conf.hpp>
 #include <derecho/core/detail/p2p_connection.hpp>
 #include <derecho/sst/detail/poll_utils.hpp>
+#include <derecho/utils/logger.hpp>
 
 namespace sst {
-P2PConnection::P2PConnection(uint32_t my_node_id, uint32_t remote_id, uint64_t p2p_buf_size, const RequestParams& request_params)
-        : my_node_id(my_node_id), remote_id(remote_id), request_params(request_params) {
+
+namespace {
+/**
+ * The control words of a P2P buffer, which are written by the remote side to
+ * negotiate a change of size class. Proposals and answers have separate
+ * words, so that a proposal crossing an answer cannot overwrite it.
+ */
+enum ControlWord : uint32_t {
+    /** The key and address of the proposer's new incoming buffer */
+    PROPOSAL_KEY = 0,
+    PROPOSAL_ADDRESS,
+    /** The number of messages of each type the proposer sent to the current buffer */
+    PROPOSAL_SEQ_NUMS,
+    /** The proposal itself, written last: see encode_resize_message */
+    PROPOSAL_MESSAGE = PROPOSAL_SEQ_NUMS + num_request_types,
+    /** The key and address of the accepting side's new incoming buffer */
+    ANSWER_KEY,
+    ANSWER_ADDRESS,
+    /** The number of messages of each type the accepting side sent to the current buffer */
+    ANSWER_SEQ_NUMS,
+    /** The answer to a proposal, written last, with the serial number of the proposal */
+    ANSWER_MESSAGE = ANSWER_SEQ_NUMS + num_request_types,
+    /**
+     * The number of RPC replies the proposer sent to the accepting side's
+     * previous buffer, which it may still send to while its proposal is pending
+     */
+    SWITCH_RPC_REPLY_SEQ_NUM,
+    /** The serial number of the last accepted proposal whose proposer has switched buffers, written last */
+    SWITCH_CONFIRMATION
+};
+static_assert(SWITCH_CONFIRMATION + 1 == P2PConnection::num_control_words,
+              "P2PConnection::num_control_words does not match the control word layout");
+
+uint64_t encode_resize_message(uint64_t serial_num, uint32_t size_class, ResizeMessageType type) {
+    return (serial_num << 16) | (static_cast<uint64_t>(size_class & 0xff) << 8) | static_cast<uint64_t>(type);
+}
+
+ResizeMessage decode_resize_message(uint64_t word) {
+    return ResizeMessage{static_cast<ResizeMessageType>(word & 0xff), static_cast<uint32_t>((word >> 8) & 0xff)};
+}
+}  // namespace
+
+P2PConnection::P2PConnection(uint32_t my_node_id, uint32_t remote_id, const std::vector<RequestParams>& buffer_layouts,
+                             uint32_t size_class)
+        : P2PConnection(my_node_id, remote_id, buffer_layouts, size_class, my_node_id != remote_id) {}
+
+P2PConnection::P2PConnection(uint32_t my_node_id, uint32_t remote_id, const std::vector<RequestParams>& buffer_layouts,
+                             uint32_t size_class, bool use_rdma)
+        : my_node_id(my_node_id),
+          remote_id(remote_id),
+          buffer_layouts(buffer_layouts),
+          size_class(size_class),
+          request_params(buffer_layouts[size_class]) {
+    const uint64_t p2p_buf_size = request_params.buffer_size;
     incoming_p2p_buffer = std::make_unique<volatile char[]>(p2p_buf_size);
     outgoing_p2p_buffer = std::make_unique<volatile char[]>(p2p_buf_size);
 
@@ -19,8 +73,11 @@ P2PConnection::P2PConnection(uint32_t my_node_id, uint32_t remote_id, uint64_t p
         incoming_seq_nums_map.try_emplace(type, 0);
         outgoing_seq_nums_map.try_emplace(type, 0);
     }
+    request_slot_owners.resize(request_params.window_sizes[P2P_REQUEST], 0);
 
-    if(my_node_id != remote_id) {
+    if(!use_rdma) {
+        loopback_remote_buffer = incoming_p2p_buffer.get();
+    } else {
 #ifdef USE_VERBS_API
         res = std::make_unique<resources>(remote_id, const_cast<char*>(incoming_p2p_buffer.get()),
                                           const_cast<char*>(outgoing_p2p_buffer.get()),
@@ -33,68 +90,485 @@ P2PConnection::P2PConnection(uint32_t my_node_id, uint32_t remote_id, uint64_t p
     }
 }
 
+std::pair<std::unique_ptr<P2PConnection>, std::unique_ptr<P2PConnection>> P2PConnection::make_loopback_pair(
+        uint32_t first_node_id, uint32_t second_node_id, const std::vector<RequestParams>& buffer_layouts,
+        uint32_t size_class) {
+    std::unique_ptr<P2PConnection> first(new P2PConnection(first_node_id, second_node_id, buffer_layouts, size_class, false));
+    std::unique_ptr<P2PConnection> second(new P2PConnection(second_node_id, first_node_id, buffer_layouts, size_class, false));
+    first->loopback_remote_buffer = second->incoming_p2p_buffer.get();
+    second->loopback_remote_buffer = first->incoming_p2p_buffer.get();
+    return {std::move(first), std::move(second)};
+}
+
 resources* P2PConnection::get_res() {
     return res.get();
 }
-uint64_t P2PConnection::getOffsetSeqNum(REQUEST_TYPE type, uint64_t seq_num) {
-    return request_params.offsets[type] + request_params.max_msg_sizes[type] * ((seq_num % request_params.window_sizes[type]) + 1) - sizeof(uint64_t);
+
+void P2PConnection::post_remote_write(uint64_t offset, uint64_t size) {
+    if(res) {
+        res->post_remote_write(offset, size);
+    } else {
+        std::memcpy(const_cast<char*>(loopback_remote_buffer) + offset,
+                    const_cast<char*>(outgoing_p2p_buffer.get()) + offset, size);
+    }
+}
+uint64_t P2PConnection::getOffsetSeqNum(const RequestParams& params, REQUEST_TYPE type, uint64_t seq_num) {
+    return params.offsets[type] + params.max_msg_sizes[type] * ((seq_num % params.window_sizes[type]) + 1) - sizeof(uint64_t);
     // return max_msg_size * (type * window_size + (seq_num % window_size) + 1) - sizeof(uint64_t);
 }
 
-uint64_t P2PConnection::getOffsetBuf(REQUEST_TYPE type, uint64_t seq_num) {
-    return request_params.offsets[type] + request_params.max_msg_sizes[type] * (seq_num % request_params.window_sizes[type]);
+uint64_t P2PConnection::getOffsetBuf(const RequestParams& params, REQUEST_TYPE type, uint64_t seq_num) {
+    return params.offsets[type] + params.max_msg_sizes[type] * (seq_num % params.window_sizes[type]);
     // return max_msg_size * (type * window_size + (seq_num % window_size));
 }
 
-// check if there's a new request from some node
-char* P2PConnection::probe() {
+uint64_t P2PConnection::getOffsetSeqNum(REQUEST_TYPE type, uint64_t seq_num) {
+    return getOffsetSeqNum(request_params, type, seq_num);
+}
+
+uint64_t P2PConnection::getOffsetChunkWord(REQUEST_TYPE type, uint64_t seq_num) {
+    return getOffsetSeqNum(type, seq_num) - sizeof(uint64_t);
+}
+
+uint64_t P2PConnection::getOffsetBuf(REQUEST_TYPE type, uint64_t seq_num) {
+    return getOffsetBuf(request_params, type, seq_num);
+}
+
+uint64_t P2PConnection::getOffsetAck(REQUEST_TYPE type) {
+    return request_params.ack_offset + type * sizeof(uint64_t);
+}
+
+std::size_t P2PConnection::get_max_slot_payload_size(REQUEST_TYPE type) const {
+    return request_params.max_msg_sizes[type] - 2 * sizeof(uint64_t);
+}
+
+// check if there are new requests from the remote node
+uint32_t P2PConnection::probe(std::vector<IncomingMessage>& messages, uint32_t (&slot_counts)[num_request_types]) {
+    if(draining_buffer) {
+        // The proposer's switch confirmation can end the drain without a new message
+        finish_draining();
+    }
+    // After a switch, the messages the remote node sent to the previous buffer come first
+    volatile char* const read_buffer = draining_buffer ? draining_buffer.get() : incoming_p2p_buffer.get();
+    const RequestParams& read_params = draining_buffer ? draining_params : request_params;
+    uint32_t total = 0;
     for(auto type : p2p_request_types) {
-        if((uint64_t&)incoming_p2p_buffer[getOffsetSeqNum(type, incoming_seq_nums_map[type])]
-           == incoming_seq_nums_map[type] + 1) {
-            last_type = type;
-            return const_cast<char*>(incoming_p2p_buffer.get())
-                   + getOffsetBuf(type, incoming_seq_nums_map[type]);
+        const uint64_t first_seq_num = incoming_seq_nums_map[type];
+        uint32_t count = 0;
+        while(count < read_params.window_sizes[type]
+              && (uint64_t&)read_buffer[getOffsetSeqNum(read_params, type, first_seq_num + count)]
+                         == first_seq_num + count + 1) {
+            const uint64_t seq_num = first_seq_num + count;
+            char* slot = const_cast<char*>(read_buffer) + getOffsetBuf(read_params, type, seq_num);
+            const uint64_t message_size
+                    = (uint64_t&)read_buffer[getOffsetSeqNum(read_params, type, seq_num) - sizeof(uint64_t)];
+            count++;
+            if(message_size == 0) {
+                messages.push_back(IncomingMessage{slot, nullptr});
+            } else {
+                // A chunk of a large message: copy it out, so the slot can be reused right away
+                Reassembly& reassembly = reassemblies[type];
+                if(!reassembly.buffer) {
+                    reassembly.buffer = std::make_unique<char[]>(message_size);
+                    reassembly.size = message_size;
+                    reassembly.received = 0;
+                }
+                const uint64_t chunk_size = std::min<uint64_t>(read_params.max_msg_sizes[type] - 2 * sizeof(uint64_t),
+                                                               reassembly.size - reassembly.received);
+                std::memcpy(reassembly.buffer.get() + reassembly.received, slot, chunk_size);
+                reassembly.received += chunk_size;
+                consumed_chunks[type] = true;
+                if(reassembly.received < reassembly.size) {
+                    continue;
+                }
+                char* message_buf = reassembly.buffer.get();
+                messages.push_back(IncomingMessage{message_buf, std::move(reassembly.buffer)});
+            }
+            if(type == P2P_REPLY) {
+                num_replies_received++;
+            } else if(type == P2P_REQUEST) {
+                num_requests_received++;
+            }
+        }
+        if(count == read_params.window_sizes[type]) {
+            pressure_events++;
         }
+        slot_counts[type] = count;
+        total += count;
     }
-    return nullptr;
+    return total;
 }
 
-void P2PConnection::update_incoming_seq_num() {
-    incoming_seq_nums_map[last_type]++;
+void P2PConnection::update_incoming_seq_nums(const uint32_t (&slot_counts)[num_request_types]) {
+    if(draining_buffer) {
+        // The remote node no longer sends to the draining buffer, so it needs no acknowledgments
+        for(auto type : p2p_request_types) {
+            incoming_seq_nums_map[type] += slot_counts[type];
+        }
+        finish_draining();
+        return;
+    }
+    for(auto type : p2p_request_types) {
+        incoming_seq_nums_map[type] += slot_counts[type];
+        // The sender only waits for an acknowledgment when it runs out of slots,
+        // so publishing once every half window is enough unless it is streaming
+        // a large message through the window
+        const uint64_t ack_interval = std::max<uint32_t>(request_params.window_sizes[type] / 2, 1);
+        if(incoming_seq_nums_map[type] == published_seq_nums[type]
+           || (!consumed_chunks[type] && incoming_seq_nums_map[type] - published_seq_nums[type] < ack_interval)) {
+            continue;
+        }
+        published_seq_nums[type] = incoming_seq_nums_map[type];
+        consumed_chunks[type] = false;
+        (uint64_t&)outgoing_p2p_buffer[getOffsetAck(type)] = published_seq_nums[type];
+        post_remote_write(getOffsetAck(type), sizeof(uint64_t));
+        if(res) {
+            num_rdma_writes++;
+        }
+    }
+}
+
+bool P2PConnection::is_slot_available(REQUEST_TYPE type) {
+    const uint64_t seq_num = outgoing_seq_nums_map[type];
+    const uint32_t window_size = request_params.window_sizes[type];
+    if(seq_num < window_size) {
+        return true;
+    }
+    // The slot was last used by the message with this sequence number
+    const uint64_t previous_seq_num = seq_num - window_size;
+    if(type == P2P_REQUEST) {
+        const uint64_t owner = request_slot_owners[previous_seq_num % window_size];
+        if(owner != 0) {
+            // a single-slot request is done with once it has been replied to
+            return num_replies_received >= owner;
+        }
+    }
+    return (uint64_t&)incoming_p2p_buffer[getOffsetAck(type)] > previous_seq_num;
 }
 
 char* P2PConnection::get_sendbuffer_ptr(REQUEST_TYPE type) {
-    prev_mode = type;
-    if(type != REQUEST_TYPE::P2P_REQUEST
-       || static_cast<int32_t>(incoming_seq_nums_map[REQUEST_TYPE::P2P_REPLY])
-                  > static_cast<int32_t>(outgoing_seq_nums_map[REQUEST_TYPE::P2P_REQUEST] - request_params.window_sizes[P2P_REQUEST])) {
+    large_sends[type].pending = false;
+    // Nothing new can be sent while the remote node decides whether to switch
+    // buffers, except RPC replies, which the delivery path cannot postpone
+    if(resize_proposed && type != RPC_REPLY) {
+        return nullptr;
+    }
+    if(is_slot_available(type)) {
+        send_stalled[type] = false;
+        send_buffer_claimed[type] = true;
+        (uint64_t&)outgoing_p2p_buffer[getOffsetChunkWord(type, outgoing_seq_nums_map[type])] = 0;
         (uint64_t&)outgoing_p2p_buffer[getOffsetSeqNum(type, outgoing_seq_nums_map[type])]
                 = outgoing_seq_nums_map[type] + 1;
         return const_cast<char*>(outgoing_p2p_buffer.get())
                + getOffsetBuf(type, outgoing_seq_nums_map[type]);
     }
+    // Count each time senders run out of slots once, however long they retry
+    if(!send_stalled[type]) {
+        send_stalled[type] = true;
+        pressure_events++;
+    }
     return nullptr;
 }
 
-void P2PConnection::send() {
-    auto type = prev_mode;
-    if(remote_id == my_node_id) {
-        // there's no reason why memcpy shouldn't also copy guard and data separately
-        std::memcpy(const_cast<char*>(incoming_p2p_buffer.get()) + getOffsetBuf(type, outgoing_seq_nums_map[type]),
-                    const_cast<char*>(outgoing_p2p_buffer.get()) + getOffsetBuf(type, outgoing_seq_nums_map[type]),
-                    request_params.max_msg_sizes[type] - sizeof(uint64_t));
-        std::memcpy(const_cast<char*>(incoming_p2p_buffer.get()) + getOffsetSeqNum(type, outgoing_seq_nums_map[type]),
-                    const_cast<char*>(outgoing_p2p_buffer.get()) + getOffsetSeqNum(type, outgoing_seq_nums_map[type]),
-                    sizeof(uint64_t));
+char* P2PConnection::get_large_sendbuffer_ptr(REQUEST_TYPE type, std::size_t size) {
+    if(resize_proposed && type != RPC_REPLY) {
+        return nullptr;
+    }
+    pressure_events++;
+    LargeSend& large_send = large_sends[type];
+    large_send.buffer.resize(size);
+    large_send.size = size;
+    large_send.offset = 0;
+    large_send.pending = true;
+    return large_send.buffer.data();
+}
+
+void P2PConnection::write_slot(REQUEST_TYPE type, uint64_t seq_num, std::size_t data_size) {
+    // The data and the chunk word must arrive before the sequence number, and
+    // are written together if the data fills the slot
+    if(data_size == get_max_slot_payload_size(type)) {
+        post_remote_write(getOffsetBuf(type, seq_num), data_size + sizeof(uint64_t));
     } else {
-        res->post_remote_write(getOffsetBuf(type, outgoing_seq_nums_map[type]),
-                               request_params.max_msg_sizes[type] - sizeof(uint64_t));
-        res->post_remote_write(getOffsetSeqNum(type, outgoing_seq_nums_map[type]),
-                               sizeof(uint64_t));
+        post_remote_write(getOffsetBuf(type, seq_num), data_size);
+        post_remote_write(getOffsetChunkWord(type, seq_num), sizeof(uint64_t));
+    }
+    post_remote_write(getOffsetSeqNum(type, seq_num), sizeof(uint64_t));
+}
+
+void P2PConnection::send(REQUEST_TYPE type) {
+    write_slot(type, outgoing_seq_nums_map[type], get_max_slot_payload_size(type));
+    if(type == P2P_REQUEST) {
+        request_slot_owners[outgoing_seq_nums_map[type] % request_params.window_sizes[type]] = ++num_requests_sent;
+    } else if(type == P2P_REPLY) {
+        num_replies_sent++;
     }
+    send_buffer_claimed[type] = false;
     outgoing_seq_nums_map[type]++;
 }
 
-P2PConnection::~P2PConnection() {}
+bool P2PConnection::has_large_send_pending(REQUEST_TYPE type) const {
+    return large_sends[type].pending;
+}
+
+bool P2PConnection::send_next_chunk(REQUEST_TYPE type) {
+    if(!is_slot_available(type)) {
+        if(!send_stalled[type]) {
+            send_stalled[type] = true;
+            pressure_events++;
+        }
+        return false;
+    }
+    send_stalled[type] = false;
+    LargeSend& large_send = large_sends[type];
+    const uint64_t seq_num = outgoing_seq_nums_map[type];
+    const std::size_t chunk_size = std::min(get_max_slot_payload_size(type), large_send.size - large_send.offset);
+    std::memcpy(const_cast<char*>(outgoing_p2p_buffer.get()) + getOffsetBuf(type, seq_num),
+                large_send.buffer.data() + large_send.offset, chunk_size);
+    (uint64_t&)outgoing_p2p_buffer[getOffsetChunkWord(type, seq_num)] = large_send.size;
+    (uint64_t&)outgoing_p2p_buffer[getOffsetSeqNum(type, seq_num)] = seq_num + 1;
+    write_slot(type, seq_num, chunk_size);
+    large_send.offset += chunk_size;
+    if(type == P2P_REQUEST) {
+        request_slot_owners[seq_num % request_params.window_sizes[type]] = 0;
+    }
+    outgoing_seq_nums_map[type]++;
+    if(large_send.offset == large_send.size) {
+        large_send.pending = false;
+        if(type == P2P_REQUEST) {
+            ++num_requests_sent;
+        } else if(type == P2P_REPLY) {
+            num_replies_sent++;
+        }
+    }
+    return true;
+}
+
+uint32_t P2PConnection::get_size_class() const {
+    return size_class;
+}
+
+uint64_t P2PConnection::get_buffer_memory() const {
+    uint64_t memory = 2 * (request_params.buffer_size + retired_buffer_size);
+    if(resize_proposed) {
+        memory += 2 * buffer_layouts[proposed_size_class].buffer_size;
+    }
+    return memory;
+}
+
+uint64_t P2PConnection::get_heartbeat_offset() const {
+    return request_params.buffer_size - sizeof(bool);
+}
+
+uint32_t P2PConnection::take_pressure_events() {
+    const uint32_t events = pressure_events;
+    pressure_events = 0;
+    return events;
+}
+
+bool P2PConnection::is_resize_pending() const {
+    return resize_proposed;
+}
+
+volatile uint64_t& P2PConnection::incoming_control_word(uint32_t index) const {
+    return reinterpret_cast<volatile uint64_t*>(incoming_p2p_buffer.get() + request_params.control_offset)[index];
+}
+
+volatile uint64_t& P2PConnection::outgoing_control_word(uint32_t index) const {
+    return reinterpret_cast<volatile uint64_t*>(outgoing_p2p_buffer.get() + request_params.control_offset)[index];
+}
+
+bool P2PConnection::is_send_idle() const {
+    for(auto type : p2p_request_types) {
+        if(send_buffer_claimed[type] || large_sends[type].pending) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t P2PConnection::prepare_next_buffers(uint32_t new_size_class) {
+    const uint64_t buffer_size = buffer_layouts[new_size_class].buffer_size;
+    next_incoming_buffer = std::make_unique<volatile char[]>(buffer_size);
+    next_outgoing_buffer = std::make_unique<volatile char[]>(buffer_size);
+    if(!res) {
+        return 0;
+    }
+    return res->register_next_buffers(const_cast<char*>(next_incoming_buffer.get()),
+                                      const_cast<char*>(next_outgoing_buffer.get()),
+                                      buffer_size, buffer_size);
+}
+
+void P2PConnection::switch_to_next_buffers(uint32_t new_size_class, uint64_t remote_key, uint64_t remote_addr,
+                                           uint32_t remote_seq_nums_word) {
+    for(auto type : p2p_request_types) {
+        drain_seq_nums[type] = incoming_control_word(remote_seq_nums_word + type);
+    }
+    if(res) {
+        res->switch_buffers(remote_key, remote_addr);
+    } else {
+        loopback_remote_buffer = reinterpret_cast<volatile char*>(remote_addr);
+    }
+    retired_outgoing_buffer = std::move(outgoing_p2p_buffer);
+    draining_buffer = std::move(incoming_p2p_buffer);
+    draining_params = request_params;
+    retired_buffer_size = request_params.buffer_size;
+    switch_time = std::chrono::steady_clock::now();
+    incoming_p2p_buffer = std::move(next_incoming_buffer);
+    outgoing_p2p_buffer = std::move(next_outgoing_buffer);
+    size_class = new_size_class;
+    request_params = buffer_layouts[new_size_class];
+    for(auto type : p2p_request_types) {
+        outgoing_seq_nums_map[type] = 0;
+        send_stalled[type] = false;
+    }
+    // Requests keep their numbers, since replies to requests sent before the switch can arrive after it
+    request_slot_owners.assign(request_params.window_sizes[P2P_REQUEST], 0);
+    dbg_default_debug("P2P connection to node {} switched to size class {} ({} bytes per buffer)",
+                      remote_id, size_class, request_params.buffer_size);
+    finish_draining();
+}
+
+void P2PConnection::finish_draining() {
+    if(awaited_switch_confirmation != 0) {
+        // The proposer could send RPC replies to the draining buffer until it switched
+        if(incoming_control_word(SWITCH_CONFIRMATION) < awaited_switch_confirmation) {
+            return;
+        }
+        drain_seq_nums[RPC_REPLY] = incoming_control_word(SWITCH_RPC_REPLY_SEQ_NUM);
+    }
+    for(auto type : p2p_request_types) {
+        if(incoming_seq_nums_map[type] < drain_seq_nums[type]) {
+            return;
+        }
+    }
+    retired_incoming_buffer = std::move(draining_buffer);
+    requests_received_before_switch = num_requests_received;
+    for(auto type : p2p_request_types) {
+        incoming_seq_nums_map[type] = 0;
+        published_seq_nums[type] = 0;
+        consumed_chunks[type] = false;
+    }
+}
+
+bool P2PConnection::propose_resize(uint32_t new_size_class) {
+    if(remote_id == my_node_id || resize_proposed || retired_outgoing_buffer
+       || new_size_class <= size_class || new_size_class >= buffer_layouts.size() || !is_send_idle()) {
+        return false;
+    }
+    const uint64_t key = prepare_next_buffers(new_size_class);
+    outgoing_control_word(PROPOSAL_KEY) = key;
+    outgoing_control_word(PROPOSAL_ADDRESS) = reinterpret_cast<uintptr_t>(next_incoming_buffer.get());
+    for(auto type : p2p_request_types) {
+        outgoing_control_word(PROPOSAL_SEQ_NUMS + type) = outgoing_seq_nums_map[type];
+    }
+    outgoing_control_word(PROPOSAL_MESSAGE) = encode_resize_message(++resize_proposals_sent, new_size_class,
+                                                                    ResizeMessageType::PROPOSE);
+    // The proposal must arrive after its contents
+    post_remote_write(request_params.control_offset, PROPOSAL_MESSAGE * sizeof(uint64_t));
+    post_remote_write(request_params.control_offset + PROPOSAL_MESSAGE * sizeof(uint64_t), sizeof(uint64_t));
+    proposed_size_class = new_size_class;
+    resize_proposed = true;
+    return true;
+}
+
+bool P2PConnection::has_resize_message() {
+    if(remote_id == my_node_id) {
+        return false;
+    }
+    if(resize_proposed && (incoming_control_word(ANSWER_MESSAGE) >> 16) == resize_proposals_sent) {
+        return true;
+    }
+    return (incoming_control_word(PROPOSAL_MESSAGE) >> 16) > last_proposal_received;
+}
+
+ResizeMessage P2PConnection::receive_resize_message() {
+    // Answers to a proposal that has since been abandoned carry an old serial number and are ignored
+    if(resize_proposed) {
+        const uint64_t answer = incoming_control_word(ANSWER_MESSAGE);
+        if((answer >> 16) == resize_proposals_sent) {
+            return decode_resize_message(answer);
+        }
+    }
+    const uint64_t proposal = incoming_control_word(PROPOSAL_MESSAGE);
+    if((proposal >> 16) > last_proposal_received) {
+        last_proposal_received = proposal >> 16;
+        return decode_resize_message(proposal);
+    }
+    return ResizeMessage{ResizeMessageType::NONE, 0};
+}
+
+bool P2PConnection::can_accept_resize(uint32_t new_size_class) const {
+    return !resize_proposed && !retired_outgoing_buffer && new_size_class > size_class
+           && new_size_class < buffer_layouts.size() && is_send_idle();
+}
+
+void P2PConnection::accept_resize(uint32_t new_size_class) {
+    const uint64_t remote_key = incoming_control_word(PROPOSAL_KEY);
+    const uint64_t remote_addr = incoming_control_word(PROPOSAL_ADDRESS);
+    const uint64_t key = prepare_next_buffers(new_size_class);
+    outgoing_control_word(ANSWER_KEY) = key;
+    outgoing_control_word(ANSWER_ADDRESS) = reinterpret_cast<uintptr_t>(next_incoming_buffer.get());
+    for(auto type : p2p_request_types) {
+        outgoing_control_word(ANSWER_SEQ_NUMS + type) = outgoing_seq_nums_map[type];
+    }
+    outgoing_control_word(ANSWER_MESSAGE) = encode_resize_message(last_proposal_received, new_size_class,
+                                                                  ResizeMessageType::ACCEPT);
+    post_remote_write(request_params.control_offset + ANSWER_KEY * sizeof(uint64_t),
+                           (ANSWER_MESSAGE - ANSWER_KEY) * sizeof(uint64_t));
+    post_remote_write(request_params.control_offset + ANSWER_MESSAGE * sizeof(uint64_t), sizeof(uint64_t));
+    awaited_switch_confirmation = last_proposal_received;
+    switch_to_next_buffers(new_size_class, remote_key, remote_addr, PROPOSAL_SEQ_NUMS);
+}
+
+void P2PConnection::reject_resize() {
+    outgoing_control_word(ANSWER_MESSAGE) = encode_resize_message(last_proposal_received, size_class,
+                                                                  ResizeMessageType::REJECT);
+    post_remote_write(request_params.control_offset + ANSWER_MESSAGE * sizeof(uint64_t), sizeof(uint64_t));
+}
+
+void P2PConnection::complete_resize() {
+    const uint64_t remote_key = incoming_control_word(ANSWER_KEY);
+    const uint64_t remote_addr = incoming_control_word(ANSWER_ADDRESS);
+    const uint64_t rpc_replies_sent = outgoing_seq_nums_map[RPC_REPLY];
+    resize_proposed = false;
+    awaited_switch_confirmation = 0;
+    switch_to_next_buffers(proposed_size_class, remote_key, remote_addr, ANSWER_SEQ_NUMS);
+    // Everything this side wrote to the remote node's old buffer was posted before this
+    outgoing_control_word(SWITCH_RPC_REPLY_SEQ_NUM) = rpc_replies_sent;
+    outgoing_control_word(SWITCH_CONFIRMATION) = resize_proposals_sent;
+    post_remote_write(request_params.control_offset + SWITCH_RPC_REPLY_SEQ_NUM * sizeof(uint64_t), sizeof(uint64_t));
+    post_remote_write(request_params.control_offset + SWITCH_CONFIRMATION * sizeof(uint64_t), sizeof(uint64_t));
+}
+
+void P2PConnection::abandon_resize() {
+    if(res) {
+        res->discard_next_buffers();
+    }
+    next_incoming_buffer.reset();
+    next_outgoing_buffer.reset();
+    resize_proposed = false;
+}
+
+uint64_t P2PConnection::release_retired_buffers(std::chrono::steady_clock::duration grace_period) {
+    // A request received in the retired buffer is read in place until it has been replied to
+    if(!retired_incoming_buffer || num_replies_sent < requests_received_before_switch
+       || incoming_control_word(SWITCH_CONFIRMATION) < awaited_switch_confirmation
+       || std::chrono::steady_clock::now() - switch_time < grace_period) {
+        return 0;
+    }
+    if(res) {
+        res->release_previous_buffers();
+    }
+    retired_incoming_buffer.reset();
+    retired_outgoing_buffer.reset();
+    const uint64_t freed = 2 * retired_buffer_size;
+    retired_buffer_size = 0;
+    return freed;
+}
+
+P2PConnection::~P2PConnection() {
+    // Deregister all the buffers before they are freed
+    res.reset();
+}
 
 }  // namespace sst
@@ -1,6 +1,10 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 #include <sys/time.h>
 #include <unordered_set>
 
@@ -15,27 +19,57 @@ P2PConnectionManager::P2PConnectionManager(const P2PParams params)
           active_p2p_connections(new char[derecho::getConfUInt32(CONF_DERECHO_MAX_NODE_ID)]),
           failure_upcall(params.failure_upcall) {
     // HARD-CODED. Adding another request type will break this
-
-    request_params.window_sizes[P2P_REPLY] = params.p2p_window_size;
-    request_params.window_sizes[P2P_REQUEST] = params.p2p_window_size;
-    request_params.window_sizes[RPC_REPLY] = params.rpc_window_size;
-    request_params.max_msg_sizes[P2P_REPLY] = params.max_p2p_reply_size;
-    request_params.max_msg_sizes[P2P_REQUEST] = params.max_p2p_request_size;
-    request_params.max_msg_sizes[RPC_REPLY] = params.max_rpc_reply_size;
+    const uint64_t max_window_sizes[num_request_types] = {params.p2p_window_size,
+                                                          params.p2p_window_size,
+                                                          params.rpc_window_size};
+    const uint64_t max_payload_sizes[num_request_types] = {params.max_p2p_reply_size,
+                                                           params.max_p2p_request_size,
+                                                           params.max_rpc_reply_size};
+    const uint64_t initial_window_size = std::max(derecho::getConfUInt32(CONF_DERECHO_P2P_INITIAL_WINDOW_SIZE), 1u);
+    const uint64_t initial_payload_size = derecho::getConfUInt64(CONF_DERECHO_P2P_INITIAL_PAYLOAD_SIZE);
+    for(uint32_t size_class = 0; size_class <= UINT8_MAX; ++size_class) {
+        RequestParams layout;
+        uint64_t buffer_size = 0;
+        bool is_largest = true;
+        for(uint8_t i = 0; i < num_request_types; ++i) {
+            // RPC replies are sent from the delivery path, which must not wait
+            // for the remote node, so their window is never reduced; only
+            // their slots start small
+            layout.window_sizes[i] = i == RPC_REPLY ? max_window_sizes[i]
+                                                    : std::min(max_window_sizes[i], initial_window_size << size_class);
+            // Each slot also holds a chunk word, besides the message and its sequence number
+            layout.max_msg_sizes[i] = std::min(max_payload_sizes[i], initial_payload_size << size_class)
+                                      + sizeof(uint64_t);
+            is_largest = is_largest && layout.window_sizes[i] == max_window_sizes[i]
+                         && layout.max_msg_sizes[i] == max_payload_sizes[i] + sizeof(uint64_t);
+            layout.offsets[i] = buffer_size;
+            buffer_size += layout.window_sizes[i] * layout.max_msg_sizes[i];
+        }
+        layout.ack_offset = buffer_size;
+        buffer_size += num_request_types * sizeof(uint64_t);
+        layout.control_offset = buffer_size;
+        buffer_size += P2PConnection::num_control_words * sizeof(uint64_t);
+        buffer_size += sizeof(bool);
+        layout.buffer_size = buffer_size;
+        buffer_layouts.push_back(layout);
+        if(is_largest) {
+            break;
+        }
+    }
+    buffer_memory_budget = derecho::getConfUInt64(CONF_DERECHO_P2P_MEMORY_BUDGET_MB) << 20;
+    next_resize_check_time = std::chrono::steady_clock::now() + resize_check_interval;
 
     for(uint32_t i = 0; i < derecho::getConfUInt32(CONF_DERECHO_MAX_NODE_ID); ++i) {
         active_p2p_connections[i] = false;
     }
 
-    p2p_buf_size = 0;
-    for(uint8_t i = 0; i < num_request_types; ++i) {
-        request_params.offsets[i] = p2p_buf_size;
-        p2p_buf_size += request_params.window_sizes[i] * request_params.max_msg_sizes[i];
-    }
-    p2p_buf_size += sizeof(bool);
-
-    p2p_connections[my_node_id].second = std::make_unique<P2PConnection>(my_node_id, my_node_id, p2p_buf_size, request_params);
+    // The local connection does not use RDMA, so it may as well be as large as possible
+    p2p_connections[my_node_id].second = std::make_unique<P2PConnection>(my_node_id, my_node_id, buffer_layouts,
+                                                                         buffer_layouts.size() - 1);
+    buffer_memory_used += p2p_connections[my_node_id].second->get_buffer_memory();
     active_p2p_connections[my_node_id] = true;
+    active_node_ids.push_back(my_node_id);
+    active_node_ids_version++;
 
     // external client doesn't need failure checking
     if(!params.is_external) {
@@ -50,23 +84,55 @@ P2PConnectionManager::~P2PConnectionManager() {
 }
 
 void P2PConnectionManager::add_connections(const std::vector<node_id_t>& node_ids) {
+    std::lock_guard<std::mutex> list_lock(connections_mutex);
+    bool list_changed = false;
     for(const node_id_t remote_id : node_ids) {
         std::lock_guard<std::mutex> connection_lock(p2p_connections[remote_id].first);
         if(!p2p_connections[remote_id].second) {
-            p2p_connections[remote_id].second = std::make_unique<P2PConnection>(my_node_id, remote_id, p2p_buf_size, request_params);
+            // A new connection always gets the smallest buffers, even if they exceed the budget
+            p2p_connections[remote_id].second = std::make_unique<P2PConnection>(my_node_id, remote_id, buffer_layouts, 0);
+            const uint64_t memory_used = buffer_memory_used += p2p_connections[remote_id].second->get_buffer_memory();
+            if(buffer_memory_budget != 0 && memory_used > buffer_memory_budget) {
+                dbg_default_warn("P2P connection buffers use {} bytes, more than the budget of {} bytes",
+                                 memory_used, buffer_memory_budget);
+            }
             active_p2p_connections[remote_id] = true;
+            active_node_ids.insert(std::lower_bound(active_node_ids.begin(), active_node_ids.end(), remote_id),
+                                   remote_id);
+            list_changed = true;
         }
     }
+    if(list_changed) {
+        active_node_ids_version++;
+    }
 }
 
 void P2PConnectionManager::remove_connections(const std::vector<node_id_t>& node_ids) {
+    std::lock_guard<std::mutex> list_lock(connections_mutex);
+    bool list_changed = false;
     for(const node_id_t remote_id : node_ids) {
         std::lock_guard<std::mutex> connection_lock(p2p_connections[remote_id].first);
+        if(p2p_connections[remote_id].second) {
+            release_buffer_memory(p2p_connections[remote_id].second->get_buffer_memory());
+        }
         p2p_connections[remote_id].second = nullptr;
         active_p2p_connections[remote_id] = false;
+        auto position = std::lower_bound(active_node_ids.begin(), active_node_ids.end(), remote_id);
+        if(position != active_node_ids.end() && *position == remote_id) {
+            active_node_ids.erase(position);
+            list_changed = true;
+        }
+    }
+    if(list_changed) {
+        active_node_ids_version++;
     }
 }
 
+std::vector<node_id_t> P2PConnectionManager::get_active_node_ids() {
+    std::lock_guard<std::mutex> list_lock(connections_mutex);
+    return active_node_ids;
+}
+
 bool P2PConnectionManager::contains_node(const node_id_t node_id) {
     std::lock_guard<std::mutex> lock(p2p_connections[node_id].first);
     return p2p_connections[node_id].second != nullptr;
@@ -80,63 +146,229 @@ void P2PConnectionManager::shutdown_failures_thread() {
 }
 
 std::size_t P2PConnectionManager::get_max_p2p_reply_size() {
-    return request_params.max_msg_sizes[P2P_REPLY] - sizeof(uint64_t);
+    return buffer_layouts.back().max_msg_sizes[P2P_REPLY] - 2 * sizeof(uint64_t);
 }
 
 std::size_t P2PConnectionManager::get_max_rpc_reply_size() {
-    return request_params.max_msg_sizes[RPC_REPLY] - sizeof(uint64_t);
+    return buffer_layouts.back().max_msg_sizes[RPC_REPLY] - 2 * sizeof(uint64_t);
 }
 
-void P2PConnectionManager::update_incoming_seq_num(node_id_t node_id) {
-    if(node_id != INVALID_NODE_ID) {
-        std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
-        if(p2p_connections[node_id].second) {
-            p2p_connections[node_id].second->update_incoming_seq_num();
+bool P2PConnectionManager::reserve_buffer_memory(uint64_t bytes) {
+    uint64_t memory_used = buffer_memory_used.load();
+    do {
+        if(buffer_memory_budget != 0 && memory_used + bytes > buffer_memory_budget) {
+            return false;
         }
-    }
+    } while(!buffer_memory_used.compare_exchange_weak(memory_used, memory_used + bytes));
+    return true;
 }
 
-// check if there's a new request from any node
-std::optional<std::pair<node_id_t, char*>> P2PConnectionManager::probe_all() {
-    for(node_id_t node_id = 0; node_id < p2p_connections.size(); ++node_id) {
-        //Check the hint before locking the mutex. If it's false, don't bother.
-        if(!active_p2p_connections[node_id]) continue;
+void P2PConnectionManager::release_buffer_memory(uint64_t bytes) {
+    buffer_memory_used -= bytes;
+}
 
+uint64_t P2PConnectionManager::get_buffer_memory_used() const {
+    return buffer_memory_used.load();
+}
+
+void P2PConnectionManager::handle_resize_message(node_id_t node_id, P2PConnection& connection) {
+    const ResizeMessage message = connection.receive_resize_message();
+    switch(message.type) {
+        case ResizeMessageType::PROPOSE: {
+            if(connection.is_resize_pending()) {
+                // Both sides proposed at once: the proposal of the lower node ID wins
+                if(my_node_id < node_id) {
+                    connection.reject_resize();
+                    return;
+                }
+                release_buffer_memory(2 * buffer_layouts[connection.get_size_class() + 1].buffer_size);
+                connection.abandon_resize();
+            }
+            if(!connection.can_accept_resize(message.size_class)) {
+                connection.reject_resize();
+                return;
+            }
+            if(!reserve_buffer_memory(2 * buffer_layouts[message.size_class].buffer_size)) {
+                dbg_default_debug("Rejecting larger P2P buffers for node {}: over the memory budget", node_id);
+                connection.reject_resize();
+                return;
+            }
+            connection.accept_resize(message.size_class);
+            break;
+        }
+        case ResizeMessageType::ACCEPT:
+            connection.complete_resize();
+            break;
+        case ResizeMessageType::REJECT:
+            release_buffer_memory(2 * buffer_layouts[connection.get_size_class() + 1].buffer_size);
+            connection.abandon_resize();
+            break;
+        case ResizeMessageType::NONE:
+            break;
+    }
+}
+
+void P2PConnectionManager::check_buffer_sizes() {
+    for(const node_id_t node_id : probe_order) {
+        if(node_id == my_node_id) {
+            continue;
+        }
         std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
-        //In case the hint was wrong, check for an empty connection
         if(!p2p_connections[node_id].second) continue;
+        P2PConnection& connection = *p2p_connections[node_id].second;
+        release_buffer_memory(connection.release_retired_buffers(retired_buffer_grace_period));
+        const uint32_t next_size_class = connection.get_size_class() + 1;
+        if(connection.take_pressure_events() < resize_pressure_threshold
+           || next_size_class >= buffer_layouts.size() || connection.is_resize_pending()) {
+            continue;
+        }
+        const uint64_t next_buffer_memory = 2 * buffer_layouts[next_size_class].buffer_size;
+        if(!reserve_buffer_memory(next_buffer_memory)) {
+            dbg_default_debug("Not growing the P2P connection to node {}: over the memory budget", node_id);
+            continue;
+        }
+        if(!connection.propose_resize(next_size_class)) {
+            release_buffer_memory(next_buffer_memory);
+        }
+    }
+}
+
+void P2PConnectionManager::update_incoming_seq_nums(const P2PMessageBatch& batch) {
+    if(batch.sender_id != INVALID_NODE_ID) {
+        std::lock_guard<std::mutex> connection_lock(p2p_connections[batch.sender_id].first);
+        if(p2p_connections[batch.sender_id].second) {
+            p2p_connections[batch.sender_id].second->update_incoming_seq_nums(batch.slot_counts);
+        }
+    }
+}
 
-        auto buf = p2p_connections[node_id].second->probe();
+// check if there are new requests from any node
+bool P2PConnectionManager::probe_all(P2PMessageBatch& batch) {
+    if(probe_order_version != active_node_ids_version.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> list_lock(connections_mutex);
+        // Keep the scan position on the same node if it is still connected
+        const node_id_t resume_node = next_probe_position < probe_order.size()
+                                              ? probe_order[next_probe_position]
+                                              : 0;
+        probe_order = active_node_ids;
+        probe_order_version = active_node_ids_version.load(std::memory_order_relaxed);
+        next_probe_position = std::lower_bound(probe_order.begin(), probe_order.end(), resume_node)
+                              - probe_order.begin();
+    }
+    if(++probes_since_resize_clock_check == probes_per_resize_clock_check) {
+        probes_since_resize_clock_check = 0;
+        const auto now = std::chrono::steady_clock::now();
+        if(now >= next_resize_check_time) {
+            next_resize_check_time = now + resize_check_interval;
+            check_buffer_sizes();
+        }
+    }
+    batch.sender_id = INVALID_NODE_ID;
+    batch.messages.clear();
+    const std::size_t num_connections = probe_order.size();
+    for(std::size_t i = 0; i < num_connections; ++i) {
+        const std::size_t position = (next_probe_position + i) % num_connections;
+        const node_id_t node_id = probe_order[position];
+
+        uint32_t batch_size;
+        {
+            std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
+            //The connection may have been removed since probe_order was refreshed
+            if(!p2p_connections[node_id].second) continue;
+            if(p2p_connections[node_id].second->has_resize_message()) {
+                handle_resize_message(node_id, *p2p_connections[node_id].second);
+            }
+            batch_size = p2p_connections[node_id].second->probe(batch.messages, batch.slot_counts);
+        }
+        if(batch_size == 0) continue;
+
+        // The next scan starts at the connection after this one
+        next_probe_position = (position + 1) % num_connections;
+        batch.sender_id = node_id;
         // In include/derecho/core/detail/rpc_utils.hpp:
         // Please note that populate_header() put payload_size(size_t) at the beginning of buffer.
         // If we only test buf[0], it will fall in the wrong path if the least significant byte of the payload size is
-        // zero.
-        if(buf && reinterpret_cast<size_t*>(buf)[0]) {
-            return std::pair<node_id_t, char*>(node_id, buf);
-        } else if(buf) {
-            // this means that we have a null reply
-            // we don't need to process it, but we still want to increment the seq num
-            p2p_connections[node_id].second->update_incoming_seq_num();
-            return std::pair<node_id_t, char*>(INVALID_NODE_ID, nullptr);
-        }
+        // zero. A zero payload size means a null reply, which we don't need to process, but we
+        // still want to increment the seq num for it.
+        batch.messages.erase(std::remove_if(batch.messages.begin(), batch.messages.end(),
+                                            [](const IncomingMessage& message) {
+                                                return reinterpret_cast<size_t*>(message.buf)[0] == 0;
+                                            }),
+                             batch.messages.end());
+        record_batch(batch_size);
+        return true;
     }
-    return {};
+    return false;
 }
 
-char* P2PConnectionManager::get_sendbuffer_ptr(node_id_t node_id, REQUEST_TYPE type) {
-    std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
-    if(p2p_connections[node_id].second) {
-        return p2p_connections[node_id].second->get_sendbuffer_ptr(type);
-    } else {
-        return nullptr;
+void P2PConnectionManager::record_batch(uint32_t batch_size) {
+    num_batches.fetch_add(1, std::memory_order_relaxed);
+    num_batched_messages.fetch_add(batch_size, std::memory_order_relaxed);
+    if(batch_size > max_batch_size.load(std::memory_order_relaxed)) {
+        max_batch_size.store(batch_size, std::memory_order_relaxed);
+    }
+    // floor(log2(batch_size)), capped at the last bucket
+    std::size_t bucket = 31 - __builtin_clz(batch_size);
+    if(bucket >= P2PBatchStats::NUM_HISTOGRAM_BUCKETS) {
+        bucket = P2PBatchStats::NUM_HISTOGRAM_BUCKETS - 1;
     }
+    batch_size_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
 }
 
-void P2PConnectionManager::send(node_id_t node_id) {
-    std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
-    p2p_connections[node_id].second->send();
-    if(node_id != my_node_id && p2p_connections[node_id].second) {
-        p2p_connections[node_id].second->num_rdma_writes++;
+P2PBatchStats P2PConnectionManager::get_batch_stats() const {
+    P2PBatchStats stats;
+    stats.num_batches = num_batches.load(std::memory_order_relaxed);
+    stats.num_messages = num_batched_messages.load(std::memory_order_relaxed);
+    stats.max_batch_size = max_batch_size.load(std::memory_order_relaxed);
+    for(std::size_t bucket = 0; bucket < P2PBatchStats::NUM_HISTOGRAM_BUCKETS; ++bucket) {
+        stats.batch_size_histogram[bucket] = batch_size_histogram[bucket].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+char* P2PConnectionManager::get_sendbuffer_ptr(node_id_t node_id, REQUEST_TYPE type, std::size_t size) {
+    while(true) {
+        {
+            std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
+            if(!p2p_connections[node_id].second) {
+                return nullptr;
+            }
+            char* buf = size > p2p_connections[node_id].second->get_max_slot_payload_size(type)
+                                ? p2p_connections[node_id].second->get_large_sendbuffer_ptr(type, size)
+                                : p2p_connections[node_id].second->get_sendbuffer_ptr(type);
+            if(buf || type == P2P_REQUEST) {
+                return buf;
+            }
+        }
+        // Wait for the remote node to consume some replies or answer a resize
+        // proposal, without holding the lock, which the polling thread needs
+        std::this_thread::yield();
+    }
+}
+
+void P2PConnectionManager::send(node_id_t node_id, REQUEST_TYPE type) {
+    std::unique_lock<std::mutex> connection_lock(p2p_connections[node_id].first);
+    if(!p2p_connections[node_id].second) {
+        throw std::out_of_range("No P2P connection to node " + std::to_string(node_id));
+    }
+    if(!p2p_connections[node_id].second->has_large_send_pending(type)) {
+        p2p_connections[node_id].second->send(type);
+        if(node_id != my_node_id) {
+            p2p_connections[node_id].second->num_rdma_writes++;
+        }
+        return;
+    }
+    while(p2p_connections[node_id].second && p2p_connections[node_id].second->has_large_send_pending(type)) {
+        if(p2p_connections[node_id].second->send_next_chunk(type)) {
+            if(node_id != my_node_id) {
+                p2p_connections[node_id].second->num_rdma_writes++;
+            }
+            continue;
+        }
+        // Let the polling thread use the connection while the remote node catches up
+        connection_lock.unlock();
+        std::this_thread::yield();
+        connection_lock.lock();
     }
 }
 
@@ -163,9 +395,7 @@ void P2PConnectionManager::check_failures_loop() {
         std::map<uint32_t, lf_sender_ctxt> sctxt;
 #endif
 
-        for(node_id_t node_id = 0; node_id < p2p_connections.size(); ++node_id) {
-            if(!active_p2p_connections[node_id]) continue;
-
+        for(const node_id_t node_id : get_active_node_ids()) {
             std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
 
             if(!p2p_connections[node_id].second) continue;
@@ -178,9 +408,8 @@ void P2PConnectionManager::check_failures_loop() {
             sctxt[node_id].set_remote_id(node_id);
             sctxt[node_id].set_ce_idx(ce_idx);
 
-            p2p_connections[node_id].second->get_res()->post_remote_write_with_completion(&sctxt[node_id],
-                                                                                          p2p_buf_size - sizeof(bool),
-                                                                                          sizeof(bool));
+            p2p_connections[node_id].second->get_res()->post_remote_write_with_completion(
+                    &sctxt[node_id], p2p_connections[node_id].second->get_heartbeat_offset(), sizeof(bool));
             posted_write_to.insert(node_id);
         }
         if(tick_count >= one_second_count) {
@@ -255,17 +484,8 @@ void P2PConnectionManager::check_failures_loop() {
 }
 
 void P2PConnectionManager::filter_to(const std::vector<node_id_t>& live_nodes_list) {
-    std::vector<node_id_t> prev_nodes_list;
-    for(node_id_t node_id = 0; node_id < p2p_connections.size(); ++node_id) {
-        //Check the hint before acquiring the lock
-        if(!active_p2p_connections[node_id]) continue;
-
-        std::lock_guard<std::mutex> connection_lock(p2p_connections[node_id].first);
-        //Check again to ensure the connection is non-null
-        if(p2p_connections[node_id].second) {
-            prev_nodes_list.push_back(node_id);
-        }
-    }
+    // get_active_node_ids() is sorted, as set_difference requires
+    const std::vector<node_id_t> prev_nodes_list = get_active_node_ids();
 
     std::vector<node_id_t> departed;
     std::set_difference(prev_nodes_list.begin(), prev_nodes_list.end(),
@@ -7,13 +7,16 @@
 #include <derecho/core/detail/view_manager.hpp>
 #include <derecho/openssl/signature.hpp>
 
+#include <algorithm>
+
 namespace derecho {
 
 PersistenceManager::PersistenceManager(
         std::map<subgroup_id_t, ReplicatedObject*>& objects_map,
         bool any_signed_objects,
         const persistence_callback_t& user_persistence_callback)
-        : thread_shutdown(false),
+        : num_persist_threads(std::max(getConfUInt32(CONF_DERECHO_PERSISTENCE_THREADS), 1u)),
+          thread_shutdown(false),
           signature_size(0),
           persistence_callbacks{user_persistence_callback},
           objects_by_subgroup_id(objects_map) {
@@ -25,7 +28,10 @@ PersistenceManager::PersistenceManager(
         openssl::EnvelopeKey signing_key = openssl::EnvelopeKey::from_pem_private(getConfString(CONF_PERS_PRIVATE_KEY_FILE));
         signature_size = signing_key.get_max_size();
         //The Verifier only needs the public key, but we loaded both public and private components from the private key file
-        signature_verifier = std::make_unique<openssl::Verifier>(signing_key, openssl::DigestAlgorithm::SHA256);
+        //A Verifier is not thread-safe, so each persistence thread gets its own
+        for(uint32_t i = 0; i < num_persist_threads; ++i) {
+            signature_verifiers.emplace_back(std::make_unique<openssl::Verifier>(signing_key, openssl::DigestAlgorithm::SHA256));
+        }
     }
 }
 
@@ -35,6 +41,12 @@ PersistenceManager::~PersistenceManager() {
 
 void PersistenceManager::set_view_manager(ViewManager& view_manager) {
     this->view_manager = &view_manager;
+    //Initialize the lanes now that ViewManager is set up and we know the number of subgroups
+    const std::size_t num_subgroups = view_manager.get_current_view().get().subgroup_shard_views.size();
+    persist_lanes.clear();
+    for(std::size_t i = 0; i < num_subgroups; ++i) {
+        persist_lanes.emplace_back(std::make_unique<PersistLane>());
+    }
 }
 
 std::size_t PersistenceManager::get_signature_size() const {
@@ -46,50 +58,66 @@ void PersistenceManager::add_persistence_callback(const persistence_callback_t&
 }
 
 void PersistenceManager::start() {
-    //Initialize this vector now that ViewManager is set up and we know the number of subgroups
-    last_persisted_version.resize(view_manager->get_current_view().get().subgroup_shard_views.size(), -1);
-    //Start the thread
-    this->persist_thread = std::thread{[this]() {
-        pthread_setname_np(pthread_self(), "persist");
-        dbg_default_debug("PersistenceManager thread started");
-        do {
-            // wait for semaphore
-            sem_wait(&persistence_request_sem);
-            while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-                ;                                                    // spin
-            if(this->persistence_request_queue.empty()) {
-                prq_lock.clear(std::memory_order_release);  // release lock
-                if(this->thread_shutdown) {
-                    break;
-                }
-                continue;
-            }
+    //Start the threads
+    for(uint32_t thread_index = 0; thread_index < num_persist_threads; ++thread_index) {
+        persist_threads.emplace_back([this, thread_index]() {
+            pthread_setname_np(pthread_self(), ("persist_" + std::to_string(thread_index)).c_str());
+            dbg_default_debug("PersistenceManager thread {} started", thread_index);
+            persist_loop(thread_index);
+        });
+    }
+}
 
-            ThreadRequest request = persistence_request_queue.front();
-            persistence_request_queue.pop();
-            prq_lock.clear(std::memory_order_release);  // release lock
+void PersistenceManager::persist_loop(uint32_t thread_index) {
+    do {
+        // wait for semaphore
+        sem_wait(&persistence_request_sem);
+        // Scan every lane, starting from this thread's own lane so that the
+        // threads spread out, and take over any other lane that has requests
+        // and is not being handled.
+        bool any_pending = false;
+        for(std::size_t i = 0; i < persist_lanes.size(); ++i) {
+            PersistLane& lane = *persist_lanes[(thread_index + i) % persist_lanes.size()];
+            drain_lane(lane, thread_index);
+            any_pending = any_pending || (lane.pending > 0);
+        }
+        if(this->thread_shutdown && !any_pending) {
+            // pass the wakeup on, in case another thread is still sleeping
+            sem_post(&persistence_request_sem);
+            break;  // finish
+        }
+    } while(true);
+}
 
+bool PersistenceManager::drain_lane(PersistLane& lane, uint32_t thread_index) {
+    bool handled = false;
+    // Check again after releasing the lane, in case a request was posted
+    // after the last pop but its wakeup was consumed by a thread that saw
+    // the lane busy.
+    while(lane.pending > 0 && !lane.busy.test_and_set(std::memory_order_acquire)) {
+        while(lane.pending > 0) {
+            ThreadRequest request;
+            if(!lane.requests.pop(request)) {
+                // a producer is in the middle of a push
+                std::this_thread::yield();
+                continue;
+            }
+            lane.pending--;
             if(request.operation == RequestType::PERSIST) {
-                handle_persist_request(request.subgroup_id, request.version);
+                handle_persist_request(lane, request.subgroup_id, request.version);
             } else if(request.operation == RequestType::VERIFY) {
-                handle_verify_request(request.subgroup_id, request.version);
+                handle_verify_request(request.subgroup_id, request.version, *signature_verifiers[thread_index]);
             }
-            if(this->thread_shutdown) {
-                while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-                    ;                                                    // spin
-                if(persistence_request_queue.empty()) {
-                    prq_lock.clear(std::memory_order_release);  // release lock
-                    break;                                      // finish
-                }
-                prq_lock.clear(std::memory_order_release);  // release lock
-            }
-        } while(true);
-    }};
+            handled = true;
+        }
+        lane.busy.clear(std::memory_order_release);
+    }
+    return handled;
 }
 
-void PersistenceManager::handle_persist_request(subgroup_id_t subgroup_id, persistent::version_t version) {
+void PersistenceManager::handle_persist_request(PersistLane& lane, subgroup_id_t subgroup_id, persistent::version_t version) {
     //If a previous request already persisted a later version (due to batching), don't do anything
-    if(last_persisted_version[subgroup_id] >= version) {
+    if(lane.last_persisted_version >= version) {
         return;
     }
     persistent::version_t persisted_version = version;
@@ -129,14 +157,15 @@ void PersistenceManager::handle_persist_request(subgroup_id_t subgroup_id, persi
         Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_id),
                        Vc.gmsSST->persisted_num,
                        subgroup_id);
-        last_persisted_version[subgroup_id] = persisted_version;
+        lane.last_persisted_version = persisted_version;
     } catch(uint64_t exp) {
         dbg_default_debug("exception on persist():subgroup={},ver={},exp={}.", subgroup_id, version, exp);
         std::cout << "exception on persistent:subgroup=" << subgroup_id << ",ver=" << version << "exception=0x" << std::hex << exp << std::endl;
     }
 }
 
-void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version) {
+void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persistent::version_t version,
+                                               openssl::Verifier& signature_verifier) {
     auto search = objects_by_subgroup_id.find(subgroup_id);
     if(search != objects_by_subgroup_id.end()) {
         ReplicatedObject* subgroup_object = search->second;
@@ -164,7 +193,7 @@ void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persis
             assert(other_signed_version >= version);
             assert(subgroup_object->get_minimum_latest_persisted_version() >= other_signed_version);
             bool verification_success = subgroup_object->verify_log(
-                    other_signed_version, *signature_verifier, other_signature.data());
+                    other_signed_version, signature_verifier, other_signature.data());
             if(verification_success) {
                 minimum_verified_version = std::min(minimum_verified_version, other_signed_version);
             } else {
@@ -179,27 +208,26 @@ void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persis
     }
 }
 
-/** post a persistence request */
-void PersistenceManager::post_persist_request(const subgroup_id_t& subgroup_id, const persistent::version_t& version) {
+void PersistenceManager::post_request(const ThreadRequest& request) {
+    PersistLane& lane = *persist_lanes[request.subgroup_id];
     // request enqueue
-    while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-        ;                                                    // spin
-    persistence_request_queue.push({RequestType::PERSIST, subgroup_id, version});
-    prq_lock.clear(std::memory_order_release);  // release lock
+    lane.requests.push(request);
+    lane.pending++;
     // post semaphore
     sem_post(&persistence_request_sem);
 }
 
+/** post a persistence request */
+void PersistenceManager::post_persist_request(const subgroup_id_t& subgroup_id, const persistent::version_t& version) {
+    post_request({RequestType::PERSIST, subgroup_id, version});
+}
+
 void PersistenceManager::post_verify_request(const subgroup_id_t& subgroup_id, const persistent::version_t& version) {
     //If signatures are disabled, ignore the request
     if(signature_size == 0) {
         return;
     }
-    while(prq_lock.test_and_set(std::memory_order_acquire))  // acquire lock
-        ;                                                    // spin
-    persistence_request_queue.push({RequestType::VERIFY, subgroup_id, version});
-    prq_lock.clear(std::memory_order_release);  // release lock
-    sem_post(&persistence_request_sem);
+    post_request({RequestType::VERIFY, subgroup_id, version});
 }
 
 /** make a version */
@@ -217,12 +245,14 @@ void PersistenceManager::make_version(const subgroup_id_t& subgroup_id,
 void PersistenceManager::shutdown(bool wait) {
     // if(replicated_objects == nullptr) return;  //skip for raw subgroups - NO DON'T
 
-    dbg_default_debug("PersistenceManager thread shutting down");
+    dbg_default_debug("PersistenceManager threads shutting down");
     thread_shutdown = true;
-    sem_post(&persistence_request_sem);  // kick the persistence thread in case it is sleeping
+    sem_post(&persistence_request_sem);  // kick the persistence threads in case they are sleeping
 
     if(wait) {
-        this->persist_thread.join();
+        for(auto& persist_thread : persist_threads) {
+            persist_thread.join();
+        }
     }
 }
 }  // namespace derecho
@@ -0,0 +1,164 @@
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include <derecho/core/derecho_exception.hpp>
+#include <derecho/core/detail/rdmc_buffer_pool.hpp>
+#include <derecho/utils/logger.hpp>
+
+namespace derecho {
+
+namespace {
+/** The size of a huge page; mappings backed by huge pages are rounded up to it */
+constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+std::size_t round_up_to_power_of_two(std::size_t size) {
+    std::size_t result = RDMCBufferPool::MIN_BLOCK_SIZE;
+    while(result < size) {
+        result *= 2;
+    }
+    return result;
+}
+}  // namespace
+
+void PooledBufferDeleter::operator()(char* block) const {
+    if(pool) {
+        pool->release(block, size_class, region_index);
+    }
+}
+
+RDMCBufferPool::RDMCBufferPool(std::size_t region_size, bool use_hugepages, RegisterFunction register_region)
+        : region_size(round_up_to_power_of_two(region_size)),
+          register_region(register_region ? std::move(register_region)
+                                          : [](char* memory, std::size_t size) {
+                                                return std::make_shared<rdma::memory_region>(memory, size);
+                                            }),
+          use_hugepages(use_hugepages),
+          free_lists(size_class_of(this->region_size) + 1),
+          allocated_blocks(free_lists.size(), 0) {}
+
+RDMCBufferPool::~RDMCBufferPool() {
+    for(Region& region : regions) {
+        // Deregister the memory before unmapping it
+        region.mr.reset();
+        munmap(region.memory, region.mapped_size);
+    }
+}
+
+uint32_t RDMCBufferPool::size_class_of(std::size_t size) {
+    uint32_t size_class = 0;
+    while(block_size_of(size_class) < size) {
+        size_class++;
+    }
+    return size_class;
+}
+
+uint32_t RDMCBufferPool::add_region(std::size_t size) {
+    void* memory = MAP_FAILED;
+    std::size_t mapped_size = size;
+    bool hugepages = false;
+    if(use_hugepages) {
+        mapped_size = ((size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+        memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        hugepages = (memory != MAP_FAILED);
+        if(!hugepages) {
+            dbg_default_warn("Could not map {} bytes of huge pages for RDMC buffers ({}), using regular pages from now on",
+                             mapped_size, std::strerror(errno));
+            use_hugepages = false;
+        }
+    }
+    if(!hugepages) {
+        mapped_size = size;
+        memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED) {
+            throw derecho_exception("Failed to map " + std::to_string(mapped_size)
+                                    + " bytes for RDMC buffers: " + std::strerror(errno));
+        }
+        // Transparent huge pages are the next best thing
+        madvise(memory, mapped_size, MADV_HUGEPAGE);
+    }
+    char* region_memory = static_cast<char*>(memory);
+    regions.push_back(Region{region_memory, size, mapped_size, hugepages, register_region(region_memory, size)});
+    registered_bytes += size;
+    dbg_default_info("Registered a {}-byte RDMC buffer region{}; {} bytes in {} regions are registered in total",
+                     size, hugepages ? " of huge pages" : "", registered_bytes, regions.size());
+    return regions.size() - 1;
+}
+
+void RDMCBufferPool::retire_carving_region() {
+    Region& region = regions[carving_region];
+    while(region.size - carving_offset >= MIN_BLOCK_SIZE) {
+        uint32_t size_class = size_class_of(region.size - carving_offset);
+        if(block_size_of(size_class) > region.size - carving_offset) {
+            size_class--;
+        }
+        free_lists[size_class].push_back(FreeBlock{region.memory + carving_offset, carving_region});
+        carving_offset += block_size_of(size_class);
+    }
+}
+
+MessageBuffer RDMCBufferPool::allocate(std::size_t size) {
+    const uint32_t size_class = size_class_of(size);
+    const std::size_t block_size = block_size_of(size_class);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if(free_lists.size() <= size_class) {
+        free_lists.resize(size_class + 1);
+        allocated_blocks.resize(size_class + 1, 0);
+    }
+    FreeBlock free_block;
+    if(!free_lists[size_class].empty()) {
+        free_block = free_lists[size_class].back();
+        free_lists[size_class].pop_back();
+    } else if(block_size > region_size) {
+        // Too big to carve out of a region, so it gets one of its own
+        const uint32_t region_index = add_region(block_size);
+        free_block = FreeBlock{regions[region_index].memory, region_index};
+    } else {
+        if(carving_region == NO_REGION || regions[carving_region].size - carving_offset < block_size) {
+            if(carving_region != NO_REGION) {
+                retire_carving_region();
+            }
+            carving_region = add_region(region_size);
+            carving_offset = 0;
+        }
+        free_block = FreeBlock{regions[carving_region].memory + carving_offset, carving_region};
+        carving_offset += block_size;
+    }
+    allocated_blocks[size_class]++;
+    const Region& region = regions[free_block.region_index];
+    MessageBuffer message_buffer;
+    message_buffer.buffer = std::unique_ptr<char[], PooledBufferDeleter>(
+            free_block.block, PooledBufferDeleter{this, size_class, free_block.region_index});
+    message_buffer.mr = region.mr;
+    message_buffer.offset = free_block.block - region.memory;
+    return message_buffer;
+}
+
+void RDMCBufferPool::release(char* block, uint32_t size_class, uint32_t region_index) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    assert(allocated_blocks[size_class] > 0);
+    allocated_blocks[size_class]--;
+    free_lists[size_class].push_back(FreeBlock{block, region_index});
+}
+
+RDMCBufferPool::Usage RDMCBufferPool::get_usage() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    Usage usage{regions.size(), registered_bytes, 0, 0, allocated_blocks, {}};
+    for(const Region& region : regions) {
+        if(region.hugepages) {
+            usage.hugepage_bytes += region.size;
+        }
+    }
+    for(uint32_t size_class = 0; size_class < free_lists.size(); ++size_class) {
+        usage.allocated_bytes += allocated_blocks[size_class] * block_size_of(size_class);
+        usage.free_blocks.push_back(free_lists[size_class].size());
+    }
+    return usage;
+}
+
+}  // namespace derecho
@@ -5,6 +5,7 @@
  */
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 #include <derecho/core/detail/rpc_manager.hpp>
@@ -21,6 +22,14 @@ RPCManager::~RPCManager() {
     if(rpc_listener_thread.joinable()) {
         rpc_listener_thread.join();
     }
+    {
+        std::lock_guard<std::mutex> lock(ordered_send_batches_mutex);
+        ordered_send_batches_cv.notify_all();
+    }
+    if(ordered_send_flush_thread.joinable()) {
+        ordered_send_flush_thread.join();
+    }
+    sem_destroy(&p2p_request_sem);
 }
 
 void RPCManager::report_failure(const node_id_t who) {
@@ -37,10 +46,12 @@ void RPCManager::report_failure(const node_id_t who) {
 }
 
 void RPCManager::create_connections() {
+    //Each multicast message can carry up to ordered_send_batch_size calls, and each of
+    //them is answered by its own RPC reply, so the reply window must scale with the batch
     connections = std::make_unique<sst::P2PConnectionManager>(sst::P2PParams{
             nid,
             getConfUInt32(CONF_DERECHO_P2P_WINDOW_SIZE),
-            view_manager.view_max_rpc_window_size,
+            view_manager.view_max_rpc_window_size * ordered_send_batch_size,
             getConfUInt64(CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE) + sizeof(header),
             getConfUInt64(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE) + sizeof(header),
             view_manager.view_max_rpc_reply_payload_size + sizeof(header),
@@ -58,19 +69,52 @@ void RPCManager::destroy_remote_invocable_class(uint32_t instance_id) {
             receivers_iterator++;
         }
     }
+    for(auto concurrent_iterator = concurrent_p2p_functions.begin();
+        concurrent_iterator != concurrent_p2p_functions.end();) {
+        if(concurrent_iterator->subgroup_id == instance_id) {
+            concurrent_iterator = concurrent_p2p_functions.erase(concurrent_iterator);
+        } else {
+            concurrent_iterator++;
+        }
+    }
+    rebuild_dispatch_table();
     //Deliver a node_removed_from_shard_exception to the QueryResults for this class
     //Important: This only works because the Replicated destructor runs before the
     //wrapped_this member is destroyed; otherwise the PendingResults we're referencing
     //would already have been deleted.
-    std::lock_guard<std::mutex> lock(pending_results_mutex);
-    while(!pending_results_to_fulfill[instance_id].empty()) {
-        pending_results_to_fulfill[instance_id].front().get().set_exception_for_caller_removed();
-        pending_results_to_fulfill[instance_id].pop();
+    //The exceptions can run callbacks registered on the QueryResults, so they are
+    //delivered after releasing pending_results_mutex, using RPCManager's hold on each one
+    std::vector<PendingBase_ref> removed_caller_results;
+    {
+        std::lock_guard<std::mutex> lock(pending_results_mutex);
+        while(!pending_results_to_fulfill[instance_id].empty()) {
+            removed_caller_results.emplace_back(pending_results_to_fulfill[instance_id].front());
+            pending_results_to_fulfill[instance_id].pop();
+        }
+        for(auto& pending_results_pair : results_awaiting_local_persistence[instance_id]) {
+            removed_caller_results.emplace_back(pending_results_pair.second);
+        }
+        results_awaiting_local_persistence[instance_id].clear();
+        //Release the rest of the PendingResults for this class, so that its reply slots can be freed
+        for(auto& pending_results_pair : results_awaiting_global_persistence[instance_id]) {
+            pending_results_pair.second.get().release();
+        }
+        results_awaiting_global_persistence[instance_id].clear();
+        for(auto& pending_results_pair : results_awaiting_signature[instance_id]) {
+            pending_results_pair.second.get().release();
+        }
+        results_awaiting_signature[instance_id].clear();
+        for(auto& pending_results : completed_pending_results[instance_id]) {
+            pending_results.get().release();
+        }
+        completed_pending_results[instance_id].clear();
     }
-    for(auto& pending_results_pair : results_awaiting_local_persistence[instance_id]) {
-        pending_results_pair.second.get().set_exception_for_caller_removed();
+    for(auto& pending_results : removed_caller_results) {
+        pending_results.get().set_exception_for_caller_removed();
+        pending_results.get().release();
     }
-    results_awaiting_local_persistence[instance_id].clear();
+    //Calls still waiting in an ordered_send batch for this class will never be sent
+    fail_ordered_send_batch(instance_id);
 }
 
 void RPCManager::start_listening() {
@@ -79,13 +123,20 @@ void RPCManager::start_listening() {
     thread_start_cv.notify_all();
 }
 
+void RPCManager::rebuild_dispatch_table() {
+    std::shared_ptr<const OpcodeDispatchTable> new_table = std::make_shared<OpcodeDispatchTable>(*receivers);
+    std::atomic_store_explicit(&dispatch_table, std::move(new_table), std::memory_order_release);
+}
+
 std::exception_ptr RPCManager::receive_message(
         const Opcode& indx, const node_id_t& received_from, char const* const buf,
         std::size_t payload_size, const std::function<char*(int)>& out_alloc) {
     using namespace remote_invocation_utilities;
     assert(payload_size);
-    auto receiver_function_entry = receivers->find(indx);
-    if(receiver_function_entry == receivers->end()) {
+    //Holding the table keeps receiver_function alive even if the table is replaced meanwhile
+    const std::shared_ptr<const OpcodeDispatchTable> table = std::atomic_load_explicit(&dispatch_table, std::memory_order_acquire);
+    const receive_fun_t* receiver_function = table->find(indx);
+    if(!receiver_function) {
         dbg_default_error("Received an RPC message with an invalid RPC opcode! Opcode was ({}, {}, {}, {}).",
                           indx.class_id, indx.subgroup_id, indx.function_id, indx.is_reply);
         //TODO: We should reply with some kind of "no such method" error in this case
@@ -93,7 +144,7 @@ std::exception_ptr RPCManager::receive_message(
     }
     std::size_t reply_header_size = header_space();
     //Pass through the provided out_alloc function, but add space for the reply header
-    recv_ret reply_return = receiver_function_entry->second(
+    recv_ret reply_return = (*receiver_function)(
             &rdv, received_from, buf,
             [&out_alloc, &reply_header_size](std::size_t size) {
                 return out_alloc(size + reply_header_size) + reply_header_size;
@@ -124,26 +175,37 @@ std::exception_ptr RPCManager::parse_and_receive(char* buf, std::size_t size,
 void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender_id,
                                      persistent::version_t version, uint64_t timestamp,
                                      char* msg_buf, uint32_t buffer_size) {
-    // WARNING: This assumes the current view doesn't change during execution!
-    // (It accesses curr_view without a lock).
-
+    using namespace remote_invocation_utilities;
     // set the thread local rpc_handler context
     _in_rpc_handler = true;
 
+    for_each_ordered_call(msg_buf, buffer_size, [&](char* call_buf, std::size_t call_size) {
+        receive_ordered_call(subgroup_id, sender_id, version, timestamp, call_buf, call_size);
+    });
+
+    // clear the thread local rpc_handler context
+    _in_rpc_handler = false;
+}
+
+void RPCManager::receive_ordered_call(subgroup_id_t subgroup_id, node_id_t sender_id,
+                                      persistent::version_t version, uint64_t timestamp,
+                                      char* call_buf, std::size_t call_size) {
+    // WARNING: This assumes the current view doesn't change during execution!
+    // (It accesses curr_view without a lock).
+
+    //Held from the time the reply buffer is allocated until the reply is sent (or, for a self-receive, parsed)
+    std::unique_lock<std::mutex> reply_lock(rpc_reply_mutexes[sender_id], std::defer_lock);
     //Use the reply-buffer allocation lambda to detect whether parse_and_receive generated a reply
     size_t reply_size = 0;
     char* reply_buf;
-    parse_and_receive(msg_buf, buffer_size,
-                      [this, &reply_buf, &reply_size, &sender_id](size_t size) -> char* {
+    parse_and_receive(call_buf, call_size,
+                      [this, &reply_buf, &reply_size, &sender_id, &reply_lock](size_t size) -> char* {
                           reply_size = size;
-                          if(reply_size <= connections->get_max_rpc_reply_size()) {
-                              reply_buf = (char*)connections->get_sendbuffer_ptr(
-                                      sender_id, sst::REQUEST_TYPE::RPC_REPLY);
-                              return reply_buf;
-                          } else {
-                              // the reply size is too large - not part of the design to handle it
-                              throw buffer_overflow_exception("Size of a P2P reply exceeds the maximum P2P reply message size");
-                          }
+                          reply_lock.lock();
+                          //Replies larger than an RPC reply slot are sent in chunks
+                          reply_buf = (char*)connections->get_sendbuffer_ptr(
+                                  sender_id, sst::REQUEST_TYPE::RPC_REPLY, reply_size);
+                          return reply_buf;
                       });
     if(sender_id == nid) {
         //This is a self-receive of an RPC message I sent, so I have a reply-map that needs fulfilling
@@ -176,14 +238,11 @@ void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender
         }
     } else if(reply_size > 0) {
         //Otherwise, the only thing to do is send the reply (if there was one)
-        connections->send(sender_id);
+        connections->send(sender_id, sst::REQUEST_TYPE::RPC_REPLY);
     }
-
-    // clear the thread local rpc_handler context
-    _in_rpc_handler = false;
 }
 
-void RPCManager::p2p_message_handler(node_id_t sender_id, char* msg_buf) {
+void RPCManager::p2p_message_handler(node_id_t sender_id, char* msg_buf, std::unique_ptr<char[]> owned_buf) {
     using namespace remote_invocation_utilities;
     const std::size_t header_size = header_space();
     std::size_t payload_size;
@@ -197,15 +256,11 @@ void RPCManager::p2p_message_handler(node_id_t sender_id, char* msg_buf) {
         receive_message(indx, received_from, msg_buf + header_size, payload_size,
                         [this, &reply_size, &sender_id](size_t _size) -> char* {
                             reply_size = _size;
-                            if(reply_size <= connections->get_max_p2p_reply_size()) {
-                                return (char*)connections->get_sendbuffer_ptr(
-                                        sender_id, sst::REQUEST_TYPE::P2P_REPLY);
-                            } else {
-                                throw buffer_overflow_exception("Size of a P2P reply exceeds the maximum P2P reply message size");
-                            }
+                            return (char*)connections->get_sendbuffer_ptr(
+                                    sender_id, sst::REQUEST_TYPE::P2P_REPLY, reply_size);
                         });
         if(reply_size > 0) {
-            connections->send(sender_id);
+            connections->send(sender_id, sst::REQUEST_TYPE::P2P_REPLY);
         }
     } else if(RPC_HEADER_FLAG_TST(flags, CASCADE)) {
         // TODO: what is the lifetime of msg_buf? discuss with Sagar to make
@@ -213,10 +268,31 @@ void RPCManager::p2p_message_handler(node_id_t sender_id, char* msg_buf) {
         // for cascading messages, we create a new thread.
         throw derecho::derecho_exception("Cascading P2P Send/Queries to be implemented!");
     } else {
-        // send to fifo queue.
-        std::unique_lock<std::mutex> lock(request_queue_mutex);
-        p2p_request_queue.emplace(sender_id, msg_buf);
-        request_queue_cv.notify_one();
+        //Requests from one node to one subgroup always go to the same lane, so they run in order,
+        //but requests to functions that are safe to run concurrently are spread across the lanes
+        std::size_t lane_index;
+        if(p2p_request_lanes.size() == 1) {
+            lane_index = 0;
+        } else if(concurrent_p2p_functions.count(indx)) {
+            lane_index = next_concurrent_lane++ % p2p_request_lanes.size();
+        } else {
+            lane_index = (static_cast<std::size_t>(sender_id) * 31 + indx.subgroup_id) % p2p_request_lanes.size();
+        }
+        p2p_req request(sender_id, msg_buf);
+        if(owned_buf) {
+            //A large request that was reassembled from chunks is already out of the P2P buffer
+            request.msg_copy = std::move(owned_buf);
+        } else if(p2p_request_lanes.size() > 1) {
+            //Replies can be sent out of order, and the sender reuses a request's buffer
+            //once it has enough replies, so the request must be copied out of the buffer
+            request.msg_copy = std::make_unique<char[]>(header_size + payload_size);
+            std::memcpy(request.msg_copy.get(), msg_buf, header_size + payload_size);
+            request.msg_buf = request.msg_copy.get();
+        }
+        P2PRequestLane& lane = *p2p_request_lanes[lane_index];
+        lane.requests.push(std::move(request));
+        lane.pending++;
+        sem_post(&p2p_request_sem);
     }
 }
 
@@ -225,119 +301,148 @@ void RPCManager::new_view_callback(const View& new_view) {
     connections->remove_connections(new_view.departed);
     connections->add_connections(new_view.members);
     dbg_default_debug("Created new connections among the new view members");
-    std::lock_guard<std::mutex> lock(pending_results_mutex);
-    for(auto& fulfilled_pending_results_pair : results_awaiting_local_persistence) {
-        const subgroup_id_t subgroup_id = fulfilled_pending_results_pair.first;
-        //For each PendingResults in this subgroup, check the departed list of each shard in
+    //The node_removed_from_group_exceptions can run callbacks registered on the QueryResults,
+    //so they are collected here (with a hold on each PendingResults, since it may move to
+    //completed_pending_results and be released meanwhile) and delivered after releasing the lock
+    std::vector<std::pair<PendingBase_ref, node_id_t>> removed_node_results;
+    auto collect_removed_nodes = [&](subgroup_id_t subgroup_id, PendingBase_ref pending_results) {
+        for(uint32_t shard_num = 0;
+            shard_num < new_view.subgroup_shard_views[subgroup_id].size();
+            ++shard_num) {
+            for(auto removed_id : new_view.subgroup_shard_views[subgroup_id][shard_num].departed) {
+                //This will do nothing if removed_id was never in the
+                //shard this PendingResult corresponds to
+                dbg_default_debug("Setting exception for removed node {} on PendingResults for subgroup {}, shard {}", removed_id, subgroup_id, shard_num);
+                pending_results.get().hold();
+                removed_node_results.emplace_back(pending_results, removed_id);
+            }
+        }
+    };
+    {
+        std::lock_guard<std::mutex> lock(pending_results_mutex);
+        //For each PendingResults in each subgroup, check the departed list of each shard in
         //the subgroup, and call set_exception_for_removed_node for the departed nodes
-        for(auto pending_results_iter = fulfilled_pending_results_pair.second.begin();
-            pending_results_iter != fulfilled_pending_results_pair.second.end();) {
-            if(!pending_results_iter->second.get().all_responded()) {
-                for(uint32_t shard_num = 0;
-                    shard_num < new_view.subgroup_shard_views[subgroup_id].size();
-                    ++shard_num) {
-                    for(auto removed_id : new_view.subgroup_shard_views[subgroup_id][shard_num].departed) {
-                        //This will do nothing if removed_id was never in the
-                        //shard this PendingResult corresponds to
-                        dbg_default_debug("Setting exception for removed node {} on PendingResults for subgroup {}, shard {}", removed_id, subgroup_id, shard_num);
-                        pending_results_iter->second.get().set_exception_for_removed_node(removed_id);
-                    }
+        for(auto& fulfilled_pending_results_pair : results_awaiting_local_persistence) {
+            for(auto& pending_results_pair : fulfilled_pending_results_pair.second) {
+                if(!pending_results_pair.second.get().all_responded()) {
+                    collect_removed_nodes(fulfilled_pending_results_pair.first, pending_results_pair.second);
                 }
-                pending_results_iter++;
             }
         }
-    }
-    //Do the same departed-node check on PendingResults in the awaiting_global_persistence map
-    for(auto& fulfilled_pending_results_pair : results_awaiting_global_persistence) {
-        const subgroup_id_t subgroup_id = fulfilled_pending_results_pair.first;
-        for(auto pending_results_iter = fulfilled_pending_results_pair.second.begin();
-            pending_results_iter != fulfilled_pending_results_pair.second.end();) {
-            if(!pending_results_iter->second.get().all_responded()) {
-                for(uint32_t shard_num = 0;
-                    shard_num < new_view.subgroup_shard_views[subgroup_id].size();
-                    ++shard_num) {
-                    for(auto removed_id : new_view.subgroup_shard_views[subgroup_id][shard_num].departed) {
-                        dbg_default_debug("Setting exception for removed node {} on PendingResults for subgroup {}, shard {}", removed_id, subgroup_id, shard_num);
-                        pending_results_iter->second.get().set_exception_for_removed_node(removed_id);
-                    }
+        //Do the same departed-node check on PendingResults in the awaiting_global_persistence map
+        for(auto& fulfilled_pending_results_pair : results_awaiting_global_persistence) {
+            for(auto& pending_results_pair : fulfilled_pending_results_pair.second) {
+                if(!pending_results_pair.second.get().all_responded()) {
+                    collect_removed_nodes(fulfilled_pending_results_pair.first, pending_results_pair.second);
                 }
-                pending_results_iter++;
             }
         }
-    }
 
-    //No need to check any entries in the awaiting_signature map - if an update has reached global
-    //persistence, then all of the replicas must have responded to the RPC message
-
-    //Do the same check on completed_pending_results, but remove them if they are now finished
-    for(auto& fulfilled_pending_results_pair : completed_pending_results) {
-        const subgroup_id_t subgroup_id = fulfilled_pending_results_pair.first;
-        for(auto pending_results_iter = fulfilled_pending_results_pair.second.begin();
-            pending_results_iter != fulfilled_pending_results_pair.second.end();) {
-            if(pending_results_iter->get().all_responded()) {
-                pending_results_iter = fulfilled_pending_results_pair.second.erase(pending_results_iter);
-            } else {
-                for(uint32_t shard_num = 0;
-                    shard_num < new_view.subgroup_shard_views[subgroup_id].size();
-                    ++shard_num) {
-                    for(auto removed_id : new_view.subgroup_shard_views[subgroup_id][shard_num].departed) {
-                        //This will do nothing if removed_id was never in the
-                        //shard this PendingResult corresponds to
-                        dbg_default_debug("Setting exception for removed node {} on PendingResults for subgroup {}, shard {}", removed_id, subgroup_id, shard_num);
-                        pending_results_iter->get().set_exception_for_removed_node(removed_id);
-                    }
+        //No need to check any entries in the awaiting_signature map - if an update has reached global
+        //persistence, then all of the replicas must have responded to the RPC message
+
+        //Do the same check on completed_pending_results, but remove them if they are now finished
+        for(auto& fulfilled_pending_results_pair : completed_pending_results) {
+            for(auto pending_results_iter = fulfilled_pending_results_pair.second.begin();
+                pending_results_iter != fulfilled_pending_results_pair.second.end();) {
+                if(pending_results_iter->get().all_responded()) {
+                    pending_results_iter->get().release();
+                    pending_results_iter = fulfilled_pending_results_pair.second.erase(pending_results_iter);
+                } else {
+                    collect_removed_nodes(fulfilled_pending_results_pair.first, *pending_results_iter);
+                    pending_results_iter++;
                 }
-                pending_results_iter++;
             }
         }
     }
+    for(auto& removed_node_pair : removed_node_results) {
+        removed_node_pair.first.get().set_exception_for_removed_node(removed_node_pair.second);
+        removed_node_pair.first.get().release();
+    }
+    //Calls batched for a subgroup this node has left can never be sent
+    std::vector<subgroup_id_t> departed_subgroups;
+    {
+        std::lock_guard<std::mutex> lock(ordered_send_batches_mutex);
+        for(const auto& batch_pair : ordered_send_batches) {
+            if(new_view.my_subgroups.find(batch_pair.first) == new_view.my_subgroups.end()) {
+                departed_subgroups.push_back(batch_pair.first);
+            }
+        }
+        //Wake up the flush thread, so that batches held back by the wedge are sent in the new view
+        ordered_send_batch_started = true;
+        ordered_send_batches_cv.notify_all();
+    }
+    for(subgroup_id_t subgroup_id : departed_subgroups) {
+        fail_ordered_send_batch(subgroup_id);
+    }
 }
 
 void RPCManager::notify_persistence_finished(subgroup_id_t subgroup_id, persistent::version_t version) {
     dbg_default_trace("RPCManager: Got a local persistence callback for version {}", version);
-    std::lock_guard<std::mutex> lock(pending_results_mutex);
-    //PendingResults in each per-subgroup map are ordered by version number, so all entries before
-    //the argument version number have been persisted and need to be notified
-    for(auto pending_results_iter = results_awaiting_local_persistence[subgroup_id].begin();
-        pending_results_iter != results_awaiting_local_persistence[subgroup_id].upper_bound(version);) {
-        dbg_default_trace("RPCManager: Setting local persistence on version {}", pending_results_iter->first);
-        pending_results_iter->second.get().set_local_persistence();
-        //Move the PendingResults reference to results_awaiting_global_persistence, with the same key
-        results_awaiting_global_persistence[subgroup_id].emplace(*pending_results_iter);
-        pending_results_iter = results_awaiting_local_persistence[subgroup_id].erase(pending_results_iter);
+    //Setting local persistence can run a callback registered on the QueryResults, so it is done
+    //after releasing pending_results_mutex, with a hold on each PendingResults meanwhile
+    std::vector<PendingBase_ref> persisted_results;
+    {
+        std::lock_guard<std::mutex> lock(pending_results_mutex);
+        //PendingResults in each per-subgroup map are ordered by version number, so all entries before
+        //the argument version number have been persisted and need to be notified
+        take_results_up_to_version(results_awaiting_local_persistence[subgroup_id], version,
+                                   [&](const auto& pending_results_pair) {
+                                       pending_results_pair.second.get().hold();
+                                       persisted_results.emplace_back(pending_results_pair.second);
+                                       //Move the PendingResults reference to results_awaiting_global_persistence, with the same key
+                                       results_awaiting_global_persistence[subgroup_id].emplace(pending_results_pair);
+                                   });
+    }
+    for(auto& pending_results : persisted_results) {
+        pending_results.get().set_local_persistence();
+        pending_results.get().release();
     }
 }
 
 void RPCManager::notify_global_persistence_finished(subgroup_id_t subgroup_id, persistent::version_t version) {
     dbg_default_trace("RPCManager: Got a global persistence callback for version {}", version);
-    std::lock_guard<std::mutex> lock(pending_results_mutex);
-    //PendingResults in each per-subgroup map are ordered by version number, so all entries before
-    //the argument version number have been persisted and need to be notified
-    for(auto pending_results_iter = results_awaiting_global_persistence[subgroup_id].begin();
-        pending_results_iter != results_awaiting_global_persistence[subgroup_id].upper_bound(version);) {
-        dbg_default_trace("RPCManager: Setting global persistence on version {}", pending_results_iter->first);
-        pending_results_iter->second.get().set_global_persistence();
-        //Move the PendingResults reference to results_awaiting_signature if the subgroup needs signatures,
-        //or completed_pending_results if it does not
-        if(view_manager.subgroup_is_signed(subgroup_id)) {
-            results_awaiting_signature[subgroup_id].emplace(*pending_results_iter);
-        } else {
-            completed_pending_results[subgroup_id].emplace_back(pending_results_iter->second);
-        }
-        pending_results_iter = results_awaiting_global_persistence[subgroup_id].erase(pending_results_iter);
+    std::vector<PendingBase_ref> persisted_results;
+    {
+        std::lock_guard<std::mutex> lock(pending_results_mutex);
+        //PendingResults in each per-subgroup map are ordered by version number, so all entries before
+        //the argument version number have been persisted and need to be notified
+        const bool is_signed = view_manager.subgroup_is_signed(subgroup_id);
+        take_results_up_to_version(results_awaiting_global_persistence[subgroup_id], version,
+                                   [&](const auto& pending_results_pair) {
+                                       pending_results_pair.second.get().hold();
+                                       persisted_results.emplace_back(pending_results_pair.second);
+                                       //Move the PendingResults reference to results_awaiting_signature if the subgroup needs signatures,
+                                       //or completed_pending_results if it does not
+                                       if(is_signed) {
+                                           results_awaiting_signature[subgroup_id].emplace(pending_results_pair);
+                                       } else {
+                                           completed_pending_results[subgroup_id].emplace_back(pending_results_pair.second);
+                                       }
+                                   });
+    }
+    for(auto& pending_results : persisted_results) {
+        pending_results.get().set_global_persistence();
+        pending_results.get().release();
     }
 }
 
 void RPCManager::notify_verification_finished(subgroup_id_t subgroup_id, persistent::version_t version) {
     dbg_default_trace("RPCManager: Got a global verification callback for version {}", version);
-    std::lock_guard<std::mutex> lock(pending_results_mutex);
-    for(auto pending_results_iter = results_awaiting_signature[subgroup_id].begin();
-        pending_results_iter != results_awaiting_signature[subgroup_id].upper_bound(version);) {
-        dbg_default_trace("RPCManager: Setting signature verification on version {}", pending_results_iter->first);
-        pending_results_iter->second.get().set_signature_verified();
-        //Move the PendingResults reference to completed_pending_results
-        completed_pending_results[subgroup_id].emplace_back(pending_results_iter->second);
-        pending_results_iter = results_awaiting_signature[subgroup_id].erase(pending_results_iter);
+    std::vector<PendingBase_ref> verified_results;
+    {
+        std::lock_guard<std::mutex> lock(pending_results_mutex);
+        take_results_up_to_version(results_awaiting_signature[subgroup_id], version,
+                                   [&](const auto& pending_results_pair) {
+                                       pending_results_pair.second.get().hold();
+                                       verified_results.emplace_back(pending_results_pair.second);
+                                       //Move the PendingResults reference to completed_pending_results
+                                       completed_pending_results[subgroup_id].emplace_back(pending_results_pair.second);
+                                   });
+    }
+    for(auto& pending_results : verified_results) {
+        pending_results.get().set_signature_verified();
+        pending_results.get().release();
     }
 }
 
@@ -349,10 +454,216 @@ bool RPCManager::finish_rpc_send(subgroup_id_t subgroup_id, PendingBase& pending
     std::lock_guard<std::mutex> lock(pending_results_mutex);
     pending_results_to_fulfill[subgroup_id].push(pending_results_handle);
     pending_results_cv.notify_all();
+    release_completed_results(subgroup_id);
+    return true;
+}
+
+bool RPCManager::add_to_ordered_send_batch(subgroup_id_t subgroup_id, std::size_t size,
+                                           const std::function<PendingBase&(char*)>& serializer,
+                                           bool blocking) {
+    const std::size_t max_payload_size = view_manager.get_max_payload_sizes().at(subgroup_id);
+    if(size > max_payload_size) {
+        throw buffer_overflow_exception("The size of an ordered_send message exceeds the maximum message size.");
+    }
+    OrderedSendBatch* batch;
+    {
+        std::lock_guard<std::mutex> lock(ordered_send_batches_mutex);
+        auto& batch_ptr = ordered_send_batches[subgroup_id];
+        if(!batch_ptr) {
+            batch_ptr = std::make_unique<OrderedSendBatch>();
+        }
+        batch = batch_ptr.get();
+    }
+    //The calls of a batch that can no longer be sent are failed after releasing its mutex
+    std::vector<PendingBase_ref> failed_calls;
+    bool added;
+    try {
+        added = add_call_to_ordered_send_batch(subgroup_id, *batch, size, max_payload_size,
+                                               serializer, blocking, failed_calls);
+    } catch(...) {
+        fail_ordered_send_calls(failed_calls);
+        throw;
+    }
+    fail_ordered_send_calls(failed_calls);
+    return added;
+}
+
+bool RPCManager::add_call_to_ordered_send_batch(subgroup_id_t subgroup_id, OrderedSendBatch& batch,
+                                                std::size_t size, std::size_t max_payload_size,
+                                                const std::function<PendingBase&(char*)>& serializer,
+                                                bool blocking, std::vector<PendingBase_ref>& failed_calls) {
+    using namespace remote_invocation_utilities;
+    std::lock_guard<std::mutex> batch_lock(batch.mutex);
+    if(batch.pending_results.size() >= ordered_send_batch_size
+       || align_batched_call(batch.buffer.size()) + size > max_payload_size) {
+        if(!send_ordered_send_batch(subgroup_id, batch, blocking, failed_calls)) {
+            return false;
+        }
+    }
+    const std::size_t previous_size = batch.buffer.size();
+    const std::size_t offset = align_batched_call(previous_size);
+    batch.buffer.resize(offset + size);
+    char* call_buf = batch.buffer.data() + offset;
+    try {
+        batch.pending_results.emplace_back(serializer(call_buf));
+    } catch(...) {
+        batch.buffer.resize(previous_size);
+        throw;
+    }
+    mark_batched_call(call_buf);
+    if(batch.pending_results.size() == 1) {
+        batch.first_call_time = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(ordered_send_batches_mutex);
+        ordered_send_batch_started = true;
+        ordered_send_batches_cv.notify_all();
+    }
+    if(batch.pending_results.size() >= ordered_send_batch_size) {
+        //If the window is full, the next call or the flush thread will send the batch
+        send_ordered_send_batch(subgroup_id, batch, blocking, failed_calls);
+    } else if(!failed_calls.empty()) {
+        //This node left the subgroup while sending the previous batch, so this call can't be sent either
+        take_ordered_send_calls(batch, failed_calls);
+    }
+    return true;
+}
+
+bool RPCManager::send_ordered_send_batch(subgroup_id_t subgroup_id, OrderedSendBatch& batch, bool blocking,
+                                         std::vector<PendingBase_ref>& failed_calls) {
+    if(batch.pending_results.empty()) {
+        return true;
+    }
+    auto copy_batch = [&batch](char* buf) {
+        std::memcpy(buf, batch.buffer.data(), batch.buffer.size());
+    };
+    const bool sent = blocking ? view_manager.send(subgroup_id, batch.buffer.size(), copy_batch, true)
+                               : view_manager.try_send(subgroup_id, batch.buffer.size(), copy_batch, true);
+    if(!sent) {
+        if(blocking || !view_manager.is_subgroup_member(subgroup_id)) {
+            dbg_default_debug("This node left subgroup {}; failing the {} calls batched for it", subgroup_id, batch.pending_results.size());
+            take_ordered_send_calls(batch, failed_calls);
+            return true;
+        }
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_results_mutex);
+        for(PendingBase_ref pending_results : batch.pending_results) {
+            pending_results_to_fulfill[subgroup_id].push(pending_results);
+        }
+        pending_results_cv.notify_all();
+        release_completed_results(subgroup_id);
+    }
+    batch.buffer.clear();
+    batch.pending_results.clear();
     return true;
 }
 
-volatile char* RPCManager::get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type) {
+void RPCManager::take_ordered_send_calls(OrderedSendBatch& batch, std::vector<PendingBase_ref>& failed_calls) {
+    failed_calls.insert(failed_calls.end(), batch.pending_results.begin(), batch.pending_results.end());
+    batch.buffer.clear();
+    batch.pending_results.clear();
+}
+
+void RPCManager::fail_ordered_send_calls(std::vector<PendingBase_ref>& failed_calls) {
+    for(PendingBase_ref pending_results : failed_calls) {
+        pending_results.get().set_exception_for_caller_removed();
+        pending_results.get().release();
+    }
+    failed_calls.clear();
+}
+
+void RPCManager::fail_ordered_send_batch(subgroup_id_t subgroup_id) {
+    std::vector<PendingBase_ref> failed_calls;
+    {
+        std::lock_guard<std::mutex> lock(ordered_send_batches_mutex);
+        auto batch_iter = ordered_send_batches.find(subgroup_id);
+        if(batch_iter == ordered_send_batches.end()) {
+            return;
+        }
+        //The batch's owner may be a sender waiting for the current view change to finish;
+        //it fails the calls itself once the send finds this node out of the subgroup
+        std::unique_lock<std::mutex> batch_lock(batch_iter->second->mutex, std::try_to_lock);
+        if(batch_lock.owns_lock()) {
+            take_ordered_send_calls(*batch_iter->second, failed_calls);
+        }
+    }
+    fail_ordered_send_calls(failed_calls);
+}
+
+void RPCManager::ordered_send_flush_loop() {
+    pthread_setname_np(pthread_self(), "rpc_batch_flush");
+    std::unique_lock<std::mutex> lock(ordered_send_batches_mutex);
+    while(!thread_shutdown) {
+        //Find the batches that have waited long enough, and when the next one will have
+        const auto now = std::chrono::steady_clock::now();
+        auto next_deadline = std::chrono::steady_clock::time_point::max();
+        std::vector<std::pair<subgroup_id_t, OrderedSendBatch*>> expired_batches;
+        for(auto& batch_pair : ordered_send_batches) {
+            OrderedSendBatch& batch = *batch_pair.second;
+            std::unique_lock<std::mutex> batch_lock(batch.mutex, std::try_to_lock);
+            if(!batch_lock.owns_lock()) {
+                //A sender is adding to or sending this batch right now; look again later
+                next_deadline = std::min(next_deadline, now + ordered_send_batch_delay);
+            } else if(!batch.pending_results.empty()) {
+                const auto deadline = batch.first_call_time + ordered_send_batch_delay;
+                if(deadline <= now) {
+                    expired_batches.emplace_back(batch_pair.first, &batch);
+                } else {
+                    next_deadline = std::min(next_deadline, deadline);
+                }
+            }
+        }
+        if(!expired_batches.empty()) {
+            //Don't block senders of other subgroups while sending
+            lock.unlock();
+            bool window_full = false;
+            std::vector<PendingBase_ref> failed_calls;
+            for(auto& expired_batch : expired_batches) {
+                std::lock_guard<std::mutex> batch_lock(expired_batch.second->mutex);
+                if(!expired_batch.second->pending_results.empty()
+                   && expired_batch.second->first_call_time + ordered_send_batch_delay <= now) {
+                    //Don't hold the batch's mutex while waiting for the send window, since
+                    //that would block try_ordered_send callers; try again after a delay instead
+                    window_full |= !send_ordered_send_batch(expired_batch.first, *expired_batch.second, false, failed_calls);
+                }
+            }
+            fail_ordered_send_calls(failed_calls);
+            lock.lock();
+            if(window_full) {
+                ordered_send_batches_cv.wait_for(lock, ordered_send_batch_delay,
+                                                 [this]() { return thread_shutdown.load(); });
+            }
+            continue;
+        }
+        ordered_send_batch_started = false;
+        const auto wake_up = [this]() { return thread_shutdown || ordered_send_batch_started; };
+        if(next_deadline == std::chrono::steady_clock::time_point::max()) {
+            ordered_send_batches_cv.wait(lock, wake_up);
+        } else {
+            ordered_send_batches_cv.wait_until(lock, next_deadline, wake_up);
+        }
+    }
+}
+
+void RPCManager::release_completed_results(subgroup_id_t subgroup_id) {
+    std::list<PendingBase_ref>& completed = completed_pending_results[subgroup_id];
+    std::size_t& sweep_size = completed_results_sweep_size[subgroup_id];
+    if(completed.size() < sweep_size) {
+        return;
+    }
+    for(auto pending_results_iter = completed.begin(); pending_results_iter != completed.end();) {
+        if(pending_results_iter->get().all_responded()) {
+            pending_results_iter->get().release();
+            pending_results_iter = completed.erase(pending_results_iter);
+        } else {
+            pending_results_iter++;
+        }
+    }
+    //Sweep again once the list has doubled, so each entry is visited O(1) times on average
+    sweep_size = std::max(2 * completed.size(), MIN_COMPLETED_RESULTS_SWEEP_SIZE);
+}
+
+volatile char* RPCManager::get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYPE type, std::size_t size) {
     volatile char* buf;
     int curr_vid = -1;
     do {
@@ -364,7 +675,7 @@ volatile char* RPCManager::get_sendbuffer_ptr(uint32_t dest_id, sst::REQUEST_TYP
             curr_vid = view_and_lock.get().vid;
         }
         try {
-            buf = connections->get_sendbuffer_ptr(dest_id, type);
+            buf = connections->get_sendbuffer_ptr(dest_id, type, size);
         } catch(std::out_of_range& map_error) {
             throw node_removed_from_group_exception(dest_id);
         }
@@ -378,8 +689,10 @@ void RPCManager::finish_p2p_send(node_id_t dest_id, subgroup_id_t dest_subgroup_
         //ViewManager's view_mutex also prevents connections from being removed (because
         //that happens in new_view_callback)
         SharedLockedReference<View> view_and_lock = view_manager.get_current_view();
-        connections->send(dest_id);
+        connections->send(dest_id, sst::REQUEST_TYPE::P2P_REQUEST);
     } catch(std::out_of_range& map_error) {
+        //The RPC was never sent, so RPCManager will not deliver anything to its PendingResults
+        pending_results_handle.release();
         throw node_removed_from_group_exception(dest_id);
     }
     pending_results_handle.fulfill_map({dest_id});
@@ -387,54 +700,80 @@ void RPCManager::finish_p2p_send(node_id_t dest_id, subgroup_id_t dest_subgroup_
     // These PendingResults don't need to have ReplyMaps fulfilled, and they
     // won't ever get version numbers or persistence notifications (since P2P sends are read-only)
     completed_pending_results[dest_subgroup_id].push_back(pending_results_handle);
+    release_completed_results(dest_subgroup_id);
+}
+
+void RPCManager::p2p_request_worker(uint32_t thread_index) {
+    pthread_setname_np(pthread_self(), ("p2p_request_" + std::to_string(thread_index)).c_str());
+    while(true) {
+        sem_wait(&p2p_request_sem);
+        if(thread_shutdown) {
+            //pass the wakeup on, in case another thread is still sleeping
+            sem_post(&p2p_request_sem);
+            break;
+        }
+        //Scan every lane, starting from a different one in each thread so that the threads spread out
+        for(std::size_t i = 0; i < p2p_request_lanes.size(); ++i) {
+            drain_p2p_request_lane(*p2p_request_lanes[(thread_index + i) % p2p_request_lanes.size()]);
+        }
+    }
+}
+
+void RPCManager::drain_p2p_request_lane(P2PRequestLane& lane) {
+    // Check again after releasing the lane, in case a request was posted
+    // after the last pop but its wakeup was consumed by a thread that saw
+    // the lane busy.
+    while(lane.pending > 0 && !lane.busy.test_and_set(std::memory_order_acquire)) {
+        while(lane.pending > 0 && !thread_shutdown) {
+            p2p_req request;
+            if(!lane.requests.pop(request)) {
+                // the listening thread is in the middle of a push
+                std::this_thread::yield();
+                continue;
+            }
+            lane.pending--;
+            handle_p2p_request(request);
+        }
+        lane.busy.clear(std::memory_order_release);
+        if(thread_shutdown) {
+            break;
+        }
+    }
 }
 
-void RPCManager::p2p_request_worker() {
-    pthread_setname_np(pthread_self(), "request_worker_thread");
+void RPCManager::handle_p2p_request(const p2p_req& request) {
     using namespace remote_invocation_utilities;
     const std::size_t header_size = header_space();
     std::size_t payload_size;
     Opcode indx;
     node_id_t received_from;
     uint32_t flags;
+    retrieve_header(nullptr, request.msg_buf, payload_size, indx, received_from, flags);
+    if(indx.is_reply || RPC_HEADER_FLAG_TST(flags, CASCADE)) {
+        dbg_default_error("Invalid rpc message in fifo queue: is_reply={}, is_cascading={}",
+                          indx.is_reply, RPC_HEADER_FLAG_TST(flags, CASCADE));
+        throw derecho::derecho_exception("invalid rpc message in fifo queue...crash.");
+    }
+    //Held from the time the reply buffer is allocated until the reply is sent
+    std::unique_lock<std::mutex> reply_lock(p2p_reply_mutexes[request.sender_id], std::defer_lock);
     size_t reply_size = 0;
-    p2p_req request;
-
-    while(!thread_shutdown) {
-        {
-            std::unique_lock<std::mutex> lock(request_queue_mutex);
-            request_queue_cv.wait(lock, [&]() { return !p2p_request_queue.empty() || thread_shutdown; });
-            if(thread_shutdown) {
-                break;
-            }
-            request = p2p_request_queue.front();
-            p2p_request_queue.pop();
-        }
-        retrieve_header(nullptr, request.msg_buf, payload_size, indx, received_from, flags);
-        if(indx.is_reply || RPC_HEADER_FLAG_TST(flags, CASCADE)) {
-            dbg_default_error("Invalid rpc message in fifo queue: is_reply={}, is_cascading={}",
-                              indx.is_reply, RPC_HEADER_FLAG_TST(flags, CASCADE));
-            throw derecho::derecho_exception("invalid rpc message in fifo queue...crash.");
-        }
-        reply_size = 0;
-        receive_message(indx, received_from, request.msg_buf + header_size, payload_size,
-                        [this, &reply_size, &request](size_t _size) -> char* {
-                            reply_size = _size;
-                            if(reply_size <= connections->get_max_p2p_reply_size()) {
-                                return (char*)connections->get_sendbuffer_ptr(
-                                        request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
-                            } else {
-                                throw buffer_overflow_exception("Size of a P2P reply exceeds the maximum P2P reply size.");
-                            }
-                        });
-        if(reply_size > 0) {
-            connections->send(request.sender_id);
-        } else {
-            // hack for now to "simulate" a reply for p2p_sends to functions that do not generate a reply
-            char* buf = connections->get_sendbuffer_ptr(request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
-            buf[0] = 0;
-            connections->send(request.sender_id);
+    receive_message(indx, received_from, request.msg_buf + header_size, payload_size,
+                    [this, &reply_size, &request, &reply_lock](size_t _size) -> char* {
+                        reply_size = _size;
+                        reply_lock.lock();
+                        return (char*)connections->get_sendbuffer_ptr(
+                                request.sender_id, sst::REQUEST_TYPE::P2P_REPLY, reply_size);
+                    });
+    if(reply_size > 0) {
+        connections->send(request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
+    } else {
+        // hack for now to "simulate" a reply for p2p_sends to functions that do not generate a reply
+        if(!reply_lock.owns_lock()) {
+            reply_lock.lock();
         }
+        char* buf = connections->get_sendbuffer_ptr(request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
+        buf[0] = 0;
+        connections->send(request.sender_id, sst::REQUEST_TYPE::P2P_REPLY);
     }
 }
 
@@ -449,12 +788,15 @@ void RPCManager::p2p_receive_loop() {
         thread_start_cv.wait(lock, [this]() { return thread_start; });
     }
     dbg_default_debug("P2P listening thread started");
-    // start the fifo worker thread
-    request_worker_thread = std::thread(&RPCManager::p2p_request_worker, this);
+    // start the P2P request threads
+    for(uint32_t thread_index = 0; thread_index < num_p2p_request_threads; ++thread_index) {
+        p2p_request_threads.emplace_back(&RPCManager::p2p_request_worker, this, thread_index);
+    }
 
     struct timespec last_time, cur_time;
     clock_gettime(CLOCK_REALTIME, &last_time);
 
+    sst::P2PMessageBatch batch;
     // loop event
     while(!thread_shutdown) {
         bool message_received = false;
@@ -463,14 +805,13 @@ void RPCManager::p2p_receive_loop() {
         // successful probe_all() and the call to p2p_message_handler)
         {
             SharedLockedReference<View> locked_view = view_manager.get_current_view();
-            auto optional_reply_pair = connections->probe_all();
-            if(optional_reply_pair) {
+            if(connections->probe_all(batch)) {
                 message_received = true;
-                auto reply_pair = optional_reply_pair.value();
-                if(reply_pair.first != INVALID_NODE_ID) {
-                    p2p_message_handler(reply_pair.first, (char*)reply_pair.second);
-                    connections->update_incoming_seq_num(reply_pair.first);
+                for(sst::IncomingMessage& message : batch.messages) {
+                    p2p_message_handler(batch.sender_id, message.buf, std::move(message.owned_buf));
                 }
+                // consume the whole batch at once
+                connections->update_incoming_seq_nums(batch);
                 // update last time
                 clock_gettime(CLOCK_REALTIME, &last_time);
             }
@@ -487,9 +828,14 @@ void RPCManager::p2p_receive_loop() {
             }
         }
     }
-    // stop fifo worker.
-    request_queue_cv.notify_one();
-    request_worker_thread.join();
+    const sst::P2PBatchStats batch_stats = connections->get_batch_stats();
+    dbg_default_debug("P2P listening thread received {} messages in {} batches, largest batch {}",
+                      batch_stats.num_messages, batch_stats.num_batches, batch_stats.max_batch_size);
+    // stop the P2P request threads
+    sem_post(&p2p_request_sem);
+    for(auto& request_thread : p2p_request_threads) {
+        request_thread.join();
+    }
 }
 
 bool in_rpc_handler() {
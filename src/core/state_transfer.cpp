@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <derecho/core/derecho_exception.hpp>
+#include <derecho/core/detail/state_transfer.hpp>
+#include <derecho/persistent/Persistent.hpp>
+#include <derecho/utils/logger.hpp>
+
+namespace derecho {
+
+namespace {
+/** The kinds of messages exchanged by the two ends of a transfer session */
+enum class FrameType : uint32_t {
+    /** Asks for the state of a subgroup's object */
+    REQUEST,
+    /** Precedes the serialized state of a subgroup's object */
+    OBJECT,
+    /** Follows the sender's last request and last object */
+    DONE
+};
+
+struct FrameHeader {
+    FrameType type;
+    subgroup_id_t subgroup_id;
+    /** In a REQUEST, the persistent log tail of the receiver's object */
+    persistent::version_t log_tail;
+    /** In an OBJECT, the size of the serialized object that follows */
+    uint64_t size;
+} __attribute__((packed));
+}  // namespace
+
+/** State shared by all the sessions of a StateTransfer and their threads */
+struct StateTransfer::Shared {
+    const std::size_t chunk_size;
+    const std::chrono::steady_clock::time_point start_time;
+    /** Protects everything below except the byte counters, and all Session state */
+    std::mutex mutex;
+    /** Notified whenever a session makes progress or fails */
+    std::condition_variable cv;
+    /** Received objects are deserialized one at a time, since objects of
+     * different subgroups can share deserialization state. */
+    std::mutex receive_object_mutex;
+    /** The first node whose session failed, if any */
+    std::optional<node_id_t> failed_node;
+    /** Set by ~StateTransfer to stop the threads that are still running */
+    bool stopping = false;
+    uint32_t objects_to_send = 0;
+    uint32_t objects_sent = 0;
+    uint32_t objects_to_receive = 0;
+    uint32_t objects_received = 0;
+    /** The totals only count objects whose transfer has started */
+    std::atomic<uint64_t> bytes_to_send{0};
+    std::atomic<uint64_t> bytes_sent{0};
+    std::atomic<uint64_t> bytes_to_receive{0};
+    std::atomic<uint64_t> bytes_received{0};
+
+    Shared(std::size_t chunk_size)
+            : chunk_size(chunk_size), start_time(std::chrono::steady_clock::now()) {}
+};
+
+/** The transfers between this node and one other node */
+struct StateTransfer::Session {
+    struct Send {
+        subgroup_id_t subgroup_id;
+        ReplicatedObject* object;
+        persistent::version_t log_tail;
+    };
+
+    const node_id_t node_id;
+    tcp::socket& socket;
+    const std::shared_ptr<Shared> shared;
+    // Everything below is protected by shared->mutex
+    /** Objects to send that the node has not requested yet, by subgroup */
+    std::map<subgroup_id_t, ReplicatedObject*> unrequested_sends;
+    /** Objects the node has requested, in the order of its requests */
+    std::deque<Send> requested_sends;
+    /** Requests to the node that have not been written yet, with their log tails */
+    std::deque<std::pair<subgroup_id_t, persistent::version_t>> unsent_requests;
+    /** Objects requested from the node that have not arrived yet, by subgroup */
+    std::map<subgroup_id_t, ReplicatedObject*> pending_receives;
+    /** Set by finish(); no more requests will be added */
+    bool requests_complete = false;
+    /** Set when the node's DONE arrives */
+    bool node_done = false;
+    /** Set when this node's DONE has been written */
+    bool done_sent = false;
+    std::thread reader;
+    std::thread writer;
+
+    Session(node_id_t node_id, tcp::socket& socket, std::shared_ptr<Shared> shared)
+            : node_id(node_id), socket(socket), shared(std::move(shared)) {}
+
+    bool is_complete() const {
+        return done_sent && node_done && pending_receives.empty();
+    }
+
+    /** Records that the session failed and wakes everyone up. Call with shared->mutex held. */
+    void fail() {
+        if(!shared->failed_node) {
+            shared->failed_node = node_id;
+        }
+        shared->cv.notify_all();
+    }
+
+    /** Streams an object's state to the node in chunks of shared->chunk_size bytes. */
+    void write_object(const Send& send) {
+        if(send.object->is_persistent()) {
+            persistent::PersistentRegistry::setEarliestVersionToSerialize(send.log_tail);
+        }
+        const std::size_t size = send.object->object_size();
+        shared->bytes_to_send += size;
+        dbg_default_debug("Sending {} bytes of Replicated Object state for subgroup {} to node {}",
+                          size, send.subgroup_id, node_id);
+        socket.write(FrameHeader{FrameType::OBJECT, send.subgroup_id, send.log_tail, size});
+        std::vector<char> chunk(shared->chunk_size);
+        std::size_t chunk_used = 0;
+        auto write_chunk = [&]() {
+            socket.write(chunk.data(), chunk_used);
+            shared->bytes_sent += chunk_used;
+            chunk_used = 0;
+        };
+        send.object->post_object([&](char const* const bytes, std::size_t length) {
+            std::size_t offset = 0;
+            while(offset < length) {
+                const std::size_t amount = std::min(length - offset, chunk.size() - chunk_used);
+                std::memcpy(chunk.data() + chunk_used, bytes + offset, amount);
+                chunk_used += amount;
+                offset += amount;
+                if(chunk_used == chunk.size()) {
+                    write_chunk();
+                }
+            }
+        });
+        if(chunk_used > 0) {
+            write_chunk();
+        }
+        persistent::PersistentRegistry::resetEarliestVersionToSerialize();
+    }
+
+    /**
+     * Reads an object's state from the node in chunks and installs it in object.
+     * The chunks are read straight into the buffer the object is deserialized
+     * from, which is the only copy of the state on this node and is freed as
+     * soon as the object is built. It is left uninitialized, so its memory is
+     * only committed as the chunks arrive.
+     */
+    void read_object(ReplicatedObject* object, std::size_t size) {
+        shared->bytes_to_receive += size;
+        std::unique_ptr<char[]> buffer(new char[size]);
+        for(std::size_t offset = 0; offset < size; offset += shared->chunk_size) {
+            const std::size_t amount = std::min(size - offset, shared->chunk_size);
+            socket.read(buffer.get() + offset, amount);
+            shared->bytes_received += amount;
+        }
+        std::lock_guard<std::mutex> receive_object_lock(shared->receive_object_mutex);
+        object->receive_object(buffer.get());
+    }
+};
+
+StateTransfer::StateTransfer(tcp::tcp_connections& tcp_sockets, std::size_t chunk_size, uint32_t progress_interval_ms)
+        : sockets(tcp_sockets.get_all_sockets()),
+          chunk_size(std::max<std::size_t>(chunk_size, 1)),
+          progress_interval_ms(std::max<uint32_t>(progress_interval_ms, 1)),
+          shared(std::make_shared<Shared>(this->chunk_size)) {}
+
+StateTransfer::~StateTransfer() {
+    // Threads are still running only if finish() was not reached or a node
+    // failed. The sockets are released when this is destroyed, so the threads
+    // must not outlive it: shut down the sockets of unfinished sessions to
+    // unblock their reads and writes, and wake up the idle writers.
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->stopping = true;
+        for(auto& id_session : sessions) {
+            if(!(id_session.second->node_done && id_session.second->done_sent)) {
+                id_session.second->socket.shutdown();
+            }
+        }
+        shared->cv.notify_all();
+    }
+    for(auto& id_session : sessions) {
+        if(id_session.second->reader.joinable()) {
+            id_session.second->reader.join();
+        }
+        if(id_session.second->writer.joinable()) {
+            id_session.second->writer.join();
+        }
+    }
+}
+
+StateTransfer::Session& StateTransfer::session_with(node_id_t node_id) {
+    auto session = sessions.find(node_id);
+    if(session == sessions.end()) {
+        auto socket = sockets.get().find(node_id);
+        if(socket == sockets.get().end()) {
+            throw derecho_exception("No TCP connection to node " + std::to_string(node_id) + " for state transfer");
+        }
+        session = sessions.emplace(node_id, std::make_shared<Session>(node_id, socket->second, shared)).first;
+        session->second->reader = std::thread(run_reader, session->second);
+        session->second->writer = std::thread(run_writer, session->second);
+    }
+    return *session->second;
+}
+
+void StateTransfer::check_failure() const {
+    if(shared->failed_node) {
+        throw derecho_exception("Fatal error: Node " + std::to_string(*shared->failed_node)
+                                + " failed during state transfer!");
+    }
+}
+
+void StateTransfer::log_progress() const {
+    dbg_default_info("State transfer in progress: sent {} of {} objects ({} of {} bytes), received {} of {} objects ({} of {} bytes)",
+                     shared->objects_sent, shared->objects_to_send, shared->bytes_sent, shared->bytes_to_send,
+                     shared->objects_received, shared->objects_to_receive, shared->bytes_received, shared->bytes_to_receive);
+}
+
+void StateTransfer::add_send(subgroup_id_t subgroup_id, node_id_t receiver_id, ReplicatedObject* object) {
+    std::lock_guard<std::mutex> lock(shared->mutex);
+    Session& session = session_with(receiver_id);
+    session.unrequested_sends[subgroup_id] = object;
+    shared->objects_to_send++;
+    shared->cv.notify_all();
+}
+
+void StateTransfer::add_receive(subgroup_id_t subgroup_id, node_id_t sender_id, ReplicatedObject* object) {
+    const persistent::version_t log_tail = object->is_persistent()
+                                                   ? object->get_minimum_latest_persisted_version()
+                                                   : persistent::INVALID_VERSION;
+    dbg_default_debug("Requesting Replicated Object state for subgroup {} from node {} with log tail length {}",
+                      subgroup_id, sender_id, log_tail);
+    std::lock_guard<std::mutex> lock(shared->mutex);
+    Session& session = session_with(sender_id);
+    session.pending_receives[subgroup_id] = object;
+    session.unsent_requests.emplace_back(subgroup_id, log_tail);
+    shared->objects_to_receive++;
+    shared->cv.notify_all();
+}
+
+void StateTransfer::finish() {
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    for(auto& id_session : sessions) {
+        id_session.second->requests_complete = true;
+    }
+    shared->cv.notify_all();
+    auto all_complete = [&]() {
+        return shared->failed_node
+               || std::all_of(sessions.begin(), sessions.end(),
+                              [](const auto& id_session) { return id_session.second->is_complete(); });
+    };
+    while(!shared->cv.wait_for(lock, std::chrono::milliseconds(progress_interval_ms), all_complete)) {
+        log_progress();
+    }
+    check_failure();
+    lock.unlock();
+    for(auto& id_session : sessions) {
+        id_session.second->reader.join();
+        id_session.second->writer.join();
+    }
+    if(!sessions.empty()) {
+        const auto elapsed = std::chrono::steady_clock::now() - shared->start_time;
+        dbg_default_debug("State transfer finished in {} ms: sent {} objects ({} bytes), received {} objects ({} bytes)",
+                          std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+                          shared->objects_sent, shared->bytes_sent, shared->objects_received, shared->bytes_received);
+    }
+}
+
+void StateTransfer::run_reader(std::shared_ptr<Session> session) {
+    Shared& shared = *session->shared;
+    try {
+        while(true) {
+            FrameHeader header;
+            session->socket.read(header);
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            if(header.type == FrameType::DONE) {
+                session->node_done = true;
+                if(!session->pending_receives.empty()) {
+                    dbg_default_error("Node {} finished state transfer without sending the state of subgroup {}",
+                                      session->node_id, session->pending_receives.begin()->first);
+                    session->fail();
+                }
+                shared.cv.notify_all();
+                return;
+            } else if(header.type == FrameType::REQUEST) {
+                auto send = session->unrequested_sends.find(header.subgroup_id);
+                if(send == session->unrequested_sends.end()) {
+                    dbg_default_error("Node {} requested the state of subgroup {}, which this node does not send to it",
+                                      session->node_id, header.subgroup_id);
+                    session->fail();
+                    return;
+                }
+                session->requested_sends.push_back({header.subgroup_id, send->second, header.log_tail});
+                session->unrequested_sends.erase(send);
+                shared.cv.notify_all();
+            } else {
+                auto receive = session->pending_receives.find(header.subgroup_id);
+                if(receive == session->pending_receives.end()) {
+                    dbg_default_error("Node {} sent the state of subgroup {}, which this node did not request",
+                                      session->node_id, header.subgroup_id);
+                    session->fail();
+                    return;
+                }
+                ReplicatedObject* object = receive->second;
+                lock.unlock();
+                session->read_object(object, header.size);
+                dbg_default_debug("Received {} bytes of Replicated Object state for subgroup {} from node {}",
+                                  header.size, header.subgroup_id, session->node_id);
+                lock.lock();
+                session->pending_receives.erase(header.subgroup_id);
+                shared.objects_received++;
+                shared.cv.notify_all();
+            }
+        }
+    } catch(tcp::socket_error&) {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        session->fail();
+    }
+}
+
+void StateTransfer::run_writer(std::shared_ptr<Session> session) {
+    Shared& shared = *session->shared;
+    try {
+        std::unique_lock<std::mutex> lock(shared.mutex);
+        while(true) {
+            shared.cv.wait(lock, [&]() {
+                return shared.stopping || shared.failed_node || !session->unsent_requests.empty()
+                       || !session->requested_sends.empty()
+                       || (session->requests_complete
+                           && (session->unrequested_sends.empty() || session->node_done));
+            });
+            if(shared.stopping || shared.failed_node) {
+                return;
+            }
+            // Requests go first, so the node can start sending as early as possible
+            if(!session->unsent_requests.empty()) {
+                const auto request = session->unsent_requests.front();
+                session->unsent_requests.pop_front();
+                lock.unlock();
+                session->socket.write(FrameHeader{FrameType::REQUEST, request.first, request.second, 0});
+                lock.lock();
+            } else if(!session->requested_sends.empty()) {
+                const Session::Send send = session->requested_sends.front();
+                session->requested_sends.pop_front();
+                lock.unlock();
+                session->write_object(send);
+                lock.lock();
+                shared.objects_sent++;
+                shared.cv.notify_all();
+            } else {
+                // The node is done, so it does not need the objects it did not request
+                for(const auto& unrequested : session->unrequested_sends) {
+                    dbg_default_warn("Node {} did not request the state of subgroup {}", session->node_id, unrequested.first);
+                }
+                session->unrequested_sends.clear();
+                lock.unlock();
+                session->socket.write(FrameHeader{FrameType::DONE, 0, persistent::INVALID_VERSION, 0});
+                lock.lock();
+                session->done_sent = true;
+                shared.cv.notify_all();
+                return;
+            }
+        }
+    } catch(tcp::socket_error&) {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        session->fail();
+    }
+}
+
+}  // namespace derecho
@@ -426,6 +426,9 @@ void ViewManager::initialize_multicast_groups(const UserMessageCallbacks& callba
                 assert(subgroup_objects.find(subgroup_id) != subgroup_objects.end());
                 subgroup_objects.at(subgroup_id)->post_next_version(ver, msg_ts);
             };
+    internal_callbacks.send_window_callback = [this](subgroup_id_t subgroup_id) {
+        notify_send_ready(subgroup_id);
+    };
     dbg_default_debug("Initializing SST and RDMC for the first time.");
     construct_multicast_group(callbacks, internal_callbacks, subgroup_settings_map, num_received_size, slot_size, index_field_size);
     curr_view->gmsSST->vid[curr_view->my_rank] = curr_view->vid;
@@ -1487,6 +1490,7 @@ void ViewManager::finish_view_change(DerechoSST& gmsSST) {
     // New members can now proceed to view_manager.finish_setup(), which will call put() and sync()
     next_view->gmsSST->push_row_except_slots();
     next_view->gmsSST->sync_with_members();
+    next_view->gmsSST->release_previous_buffers();
     {
         lock_guard_t old_views_lock(old_views_mutex);
         old_views.push(std::move(curr_view));
@@ -1520,6 +1524,19 @@ void ViewManager::finish_view_change(DerechoSST& gmsSST) {
     curr_view->gmsSST->start_predicate_evaluation();
     view_change_cv.notify_all();
     dbg_default_debug("Done with view change to view {}", curr_view->vid);
+    write_lock.unlock();
+
+    // Every send window is empty in the new view, so wake up any senders that gave up on the old one
+    if(send_blocked) {
+        std::vector<subgroup_id_t> blocked_subgroups;
+        {
+            std::lock_guard<std::mutex> lock(send_ready_mutex);
+            blocked_subgroups.assign(send_blocked_subgroups.begin(), send_blocked_subgroups.end());
+        }
+        for(subgroup_id_t subgroup_id : blocked_subgroups) {
+            notify_send_ready(subgroup_id);
+        }
+    }
 }
 
 /* ------------- 3. Helper Functions for Predicates and Triggers ------------- */
@@ -1553,11 +1570,27 @@ void ViewManager::transition_multicast_group(
     const auto num_subgroups = next_view->subgroup_shard_views.size();
     const std::size_t signature_size = persistence_manager.get_signature_size();
 
+    // Members that stay in the group keep their SST connections; only the
+    // buffers behind them change. Every node derives the same set from the
+    // views, which the connection handover requires.
+    std::map<uint32_t, std::shared_ptr<sst::resources>> reused_connections;
+    for(int rank = 0; rank < next_view->num_members; ++rank) {
+        const node_id_t member = next_view->members[rank];
+        if(rank == next_view->my_rank || next_view->failed[rank]
+           || curr_view->rank_of(member) == -1
+           || std::find(next_view->joined.begin(), next_view->joined.end(), member) != next_view->joined.end()) {
+            continue;
+        }
+        reused_connections[member] = curr_view->gmsSST->detach_connection(member);
+    }
+    dbg_default_debug("Reusing SST connections to {} of {} members in view {}",
+                      reused_connections.size(), next_view->num_members - 1, next_view->vid);
+
     next_view->gmsSST = std::make_shared<DerechoSST>(
             sst::SSTParams(
                     next_view->members, next_view->members[next_view->my_rank],
                     [this](const uint32_t node_id) { report_failure(node_id); },
-                    next_view->failed, false),
+                    next_view->failed, false, reused_connections),
             num_subgroups, signature_size, new_num_received_size, new_slot_size, new_index_field_size);
 
     next_view->multicast_group = std::make_unique<MulticastGroup>(
@@ -1708,38 +1741,72 @@ void ViewManager::send_objects_to_new_members(const vector_int64_2d& old_shard_l
     node_id_t my_id = next_view->members[next_view->my_rank];
     for(subgroup_id_t subgroup_id = 0; subgroup_id < old_shard_leaders.size(); ++subgroup_id) {
         for(uint32_t shard = 0; shard < old_shard_leaders[subgroup_id].size(); ++shard) {
-            //if I was the leader of the shard in the old view...
-            if(my_id == old_shard_leaders[subgroup_id][shard]) {
-                //send its object state to the new members
-                for(node_id_t shard_joiner : next_view->subgroup_shard_views[subgroup_id][shard].joined) {
-                    if(shard_joiner != my_id) {
-                        send_subgroup_object(subgroup_id, shard_joiner);
-                    }
+            if(old_shard_leaders[subgroup_id][shard] < 0) {
+                continue;
+            }
+            const SubView& shard_view = next_view->subgroup_shard_views[subgroup_id][shard];
+            //send the object state to each new member that this node was chosen to serve
+            for(node_id_t shard_joiner : shard_view.joined) {
+                if(shard_joiner != my_id
+                   && choose_state_transfer_sender(*next_view, subgroup_id, shard, shard_joiner,
+                                                   old_shard_leaders[subgroup_id][shard])
+                              == my_id) {
+                    //If this node is no longer in the shard, Group keeps its retired
+                    //object alive until transfer_objects() has finished sending it
+                    send_subgroup_object(subgroup_id, shard_joiner);
                 }
             }
         }
     }
 }
 
-/* Note for the future: Since this "send" requires first receiving the log tail length,
- * it's really a blocking receive-then-send. Since all nodes call send_subgroup_object
- * before initialize_subgroup_objects, there's a small chance of a deadlock: node A could
- * be attempting to send an object to node B at the same time as B is attempting to send a
- * different object to A, and neither node will be able to send the log tail length that
- * the other one is waiting on. */
 void ViewManager::send_subgroup_object(subgroup_id_t subgroup_id, node_id_t new_node_id) {
-    LockedReference<std::unique_lock<std::mutex>, tcp::socket> joiner_socket = tcp_sockets.get_socket(new_node_id);
-    assert(subgroup_objects.find(subgroup_id) != subgroup_objects.end());
-    ReplicatedObject* subgroup_object = subgroup_objects.at(subgroup_id);
-    if(subgroup_object->is_persistent()) {
-        //First, read the log tail length sent by the joining node
-        persistent::version_t persistent_log_length = 0;
-        joiner_socket.get().read(persistent_log_length);
-        persistent::PersistentRegistry::setEarliestVersionToSerialize(persistent_log_length);
-        dbg_default_debug("Got log tail length {}", persistent_log_length);
+    if(!state_transfer) {
+        state_transfer = std::make_unique<StateTransfer>(tcp_sockets,
+                                                         getConfUInt64(CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE),
+                                                         getConfUInt32(CONF_DERECHO_STATE_TRANSFER_PROGRESS_INTERVAL_MS));
     }
+    assert(subgroup_objects.find(subgroup_id) != subgroup_objects.end());
     dbg_default_debug("Sending Replicated Object state for subgroup {} to node {}", subgroup_id, new_node_id);
-    subgroup_object->send_object(joiner_socket.get());
+    state_transfer->add_send(subgroup_id, new_node_id, subgroup_objects.at(subgroup_id));
+}
+
+void ViewManager::transfer_objects(const std::set<std::pair<subgroup_id_t, node_id_t>>& subgroups_and_senders) {
+    if(!state_transfer && subgroups_and_senders.empty()) {
+        return;
+    }
+    // Take ownership here so the sockets are released even if a transfer fails
+    std::unique_ptr<StateTransfer> transfer = std::move(state_transfer);
+    if(!transfer) {
+        transfer = std::make_unique<StateTransfer>(tcp_sockets,
+                                                   getConfUInt64(CONF_DERECHO_STATE_TRANSFER_CHUNK_SIZE),
+                                                   getConfUInt32(CONF_DERECHO_STATE_TRANSFER_PROGRESS_INTERVAL_MS));
+    }
+    for(const auto& subgroup_and_sender : subgroups_and_senders) {
+        transfer->add_receive(subgroup_and_sender.first, subgroup_and_sender.second,
+                              subgroup_objects.at(subgroup_and_sender.first));
+    }
+    transfer->finish();
+    dbg_default_debug("Done transferring all Replicated Objects");
+}
+
+node_id_t ViewManager::choose_state_transfer_sender(const View& view, subgroup_id_t subgroup_id,
+                                                    uint32_t shard_num, node_id_t new_member,
+                                                    node_id_t old_shard_leader) {
+    const SubView& shard_view = view.subgroup_shard_views[subgroup_id][shard_num];
+    //Members that were already in this shard in the previous view have its state
+    std::vector<node_id_t> survivors;
+    for(node_id_t member : shard_view.members) {
+        if(std::find(shard_view.joined.begin(), shard_view.joined.end(), member) == shard_view.joined.end()
+           && std::find(view.joined.begin(), view.joined.end(), member) == view.joined.end()) {
+            survivors.emplace_back(member);
+        }
+    }
+    auto joiner_position = std::find(shard_view.joined.begin(), shard_view.joined.end(), new_member);
+    if(survivors.empty() || joiner_position == shard_view.joined.end()) {
+        return old_shard_leader;
+    }
+    return survivors[std::distance(shard_view.joined.begin(), joiner_position) % survivors.size()];
 }
 
 void ViewManager::update_tcp_connections() {
@@ -2365,13 +2432,79 @@ void ViewManager::leave() {
     thread_shutdown = true;
 }
 
-void ViewManager::send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+bool ViewManager::send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
                        const std::function<void(char* buf)>& msg_generator, bool cooked_send) {
     shared_lock_t lock(view_mutex);
+    bool is_member = true;
     view_change_cv.wait(lock, [&]() {
-        return curr_view->multicast_group->send(subgroup_num, payload_size,
-                                                msg_generator, cooked_send);
+        //A view change may have removed this node from the subgroup while it waited
+        is_member = curr_view->my_subgroups.count(subgroup_num) > 0;
+        return !is_member
+               || curr_view->multicast_group->send(subgroup_num, payload_size,
+                                                   msg_generator, cooked_send);
     });
+    return is_member;
+}
+
+bool ViewManager::try_send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
+                           const std::function<void(char* buf)>& msg_generator, bool cooked_send) {
+    shared_lock_t lock(view_mutex);
+    if(curr_view->my_subgroups.count(subgroup_num) == 0) {
+        return false;
+    }
+    if(curr_view->multicast_group->try_send(subgroup_num, payload_size, msg_generator, cooked_send)) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> ready_lock(send_ready_mutex);
+        send_blocked_subgroups.insert(subgroup_num);
+    }
+    send_blocked = true;
+    // The window may have reopened before the subgroup was marked blocked, in which case
+    // no notification would come; try once more so the caller can't miss the wakeup
+    if(curr_view->multicast_group->try_send(subgroup_num, payload_size, msg_generator, cooked_send)) {
+        std::lock_guard<std::mutex> ready_lock(send_ready_mutex);
+        send_blocked_subgroups.erase(subgroup_num);
+        return true;
+    }
+    return false;
+}
+
+bool ViewManager::is_subgroup_member(subgroup_id_t subgroup_num) {
+    shared_lock_t lock(view_mutex);
+    return curr_view->my_subgroups.count(subgroup_num) > 0;
+}
+
+void ViewManager::set_send_ready_callback(subgroup_id_t subgroup_num, std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(send_ready_mutex);
+    if(callback) {
+        send_ready_callbacks[subgroup_num] = std::move(callback);
+    } else {
+        send_ready_callbacks.erase(subgroup_num);
+    }
+}
+
+void ViewManager::notify_send_ready(subgroup_id_t subgroup_num) {
+    if(!send_blocked) {
+        return;
+    }
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(send_ready_mutex);
+        if(send_blocked_subgroups.erase(subgroup_num) == 0) {
+            return;
+        }
+        if(send_blocked_subgroups.empty()) {
+            send_blocked = false;
+        }
+        auto callback_iter = send_ready_callbacks.find(subgroup_num);
+        if(callback_iter != send_ready_callbacks.end()) {
+            callback = callback_iter->second;
+        }
+    }
+    if(callback) {
+        callback();
+    }
 }
 
 const uint64_t ViewManager::compute_global_stability_frontier(subgroup_id_t subgroup_num) {
@@ -2453,10 +2586,6 @@ SharedLockedReference<const View> ViewManager::get_current_or_restart_view() {
     }
 }
 
-LockedReference<std::unique_lock<std::mutex>, tcp::socket> ViewManager::get_transfer_socket(node_id_t member_id) {
-    return tcp_sockets.get_socket(member_id);
-}
-
 void ViewManager::debug_print_status() const {
     std::cout << "curr_view = " << curr_view->debug_string() << std::endl;
 }
@@ -0,0 +1,48 @@
+#include <derecho/persistent/detail/DeltaStateCache.hpp>
+
+namespace persistent {
+
+DeltaStateCache::DeltaStateCache(std::size_t capacity) : m_capacity(capacity) {}
+
+DeltaStateCache::state_t DeltaStateCache::find(int64_t idx, int64_t min_idx, int64_t& found_idx) {
+    std::lock_guard<std::mutex> lck(m_mutex);
+    auto itr = m_states.upper_bound(idx);
+    if(itr == m_states.begin()) {
+        return nullptr;
+    }
+    --itr;
+    if(itr->first < min_idx) {
+        return nullptr;
+    }
+    // move it to the front
+    m_lru.splice(m_lru.begin(), m_lru, itr->second.second);
+    found_idx = itr->first;
+    return itr->second.first;
+}
+
+void DeltaStateCache::put(int64_t idx, state_t state) {
+    if(m_capacity == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lck(m_mutex);
+    auto itr = m_states.find(idx);
+    if(itr != m_states.end()) {
+        itr->second.first = std::move(state);
+        m_lru.splice(m_lru.begin(), m_lru, itr->second.second);
+        return;
+    }
+    if(m_states.size() >= m_capacity) {
+        m_states.erase(m_lru.back());
+        m_lru.pop_back();
+    }
+    m_lru.push_front(idx);
+    m_states.emplace(idx, std::make_pair(std::move(state), m_lru.begin()));
+}
+
+void DeltaStateCache::clear() {
+    std::lock_guard<std::mutex> lck(m_mutex);
+    m_states.clear();
+    m_lru.clear();
+}
+
+}  // namespace persistent
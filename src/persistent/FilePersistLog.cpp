@@ -4,7 +4,11 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string.h>
 #include <string>
 #include <sys/mman.h>
@@ -27,6 +31,115 @@ namespace persistent {
 // internal structures //
 /////////////////////////
 
+namespace {
+
+// The group meta file of a data path, as cached by this process.
+struct GroupMetaFile {
+    std::mutex mutex;
+    bool loaded = false;
+    // the latest meta header committed for each log, by log name
+    std::map<std::string, MetaHeader> headers;
+};
+
+GroupMetaFile& group_meta_file(const std::string& data_path) {
+    static std::mutex files_mutex;
+    static std::map<std::string, std::unique_ptr<GroupMetaFile>> files;
+    std::lock_guard<std::mutex> lock(files_mutex);
+    auto& file = files[data_path];
+    if(!file) {
+        file = std::make_unique<GroupMetaFile>();
+    }
+    return *file;
+}
+
+// Read the records of a group meta file: the length of the log name, the log
+// name and its meta header. A missing file has no records.
+void read_group_meta_file(const std::string& data_path, std::map<std::string, MetaHeader>& headers) {
+    headers.clear();
+    int fd = open((data_path + "/" GROUP_META_FILE).c_str(), O_RDONLY);
+    if(fd == -1) {
+        if(errno == ENOENT) {
+            return;
+        }
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    uint32_t name_len;
+    while(read(fd, &name_len, sizeof(name_len)) == sizeof(name_len)) {
+        std::string name(name_len, '\0');
+        MetaHeader header;
+        if(read(fd, &name[0], name_len) != (ssize_t)name_len
+           || read(fd, &header, sizeof(header)) != sizeof(header)) {
+            close(fd);
+            throw PERSIST_EXP_READ_FILE(errno);
+        }
+        headers[name] = header;
+    }
+    close(fd);
+}
+
+// Read a group meta file into its cache, unless it is cached already. The
+// mutex of the cache must be held.
+void load_group_meta_file(GroupMetaFile& file, const std::string& data_path) {
+    if(!file.loaded) {
+        read_group_meta_file(data_path, file.headers);
+        file.loaded = true;
+    }
+}
+
+// Write a group meta file atomically, like FilePersistLog::persistMetaHeaderAtomically().
+void write_group_meta_file(const std::string& data_path, const std::map<std::string, MetaHeader>& headers) {
+    std::vector<char> buf;
+    for(const auto& [name, header] : headers) {
+        uint32_t name_len = name.size();
+        buf.insert(buf.end(), (const char*)&name_len, (const char*)&name_len + sizeof(name_len));
+        buf.insert(buf.end(), name.begin(), name.end());
+        buf.insert(buf.end(), (const char*)&header, (const char*)&header + sizeof(header));
+    }
+    const string metaFile = data_path + "/" GROUP_META_FILE;
+    const string swpFile = metaFile + "." + SWAP_FILE_SUFFIX;
+    int fd = open(swpFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    if(fd == -1) {
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    ssize_t nWrite = write(fd, buf.data(), buf.size());
+    close(fd);
+    if(nWrite != (ssize_t)buf.size()) {
+        throw PERSIST_EXP_WRITE_FILE(errno);
+    }
+    if(rename(swpFile.c_str(), metaFile.c_str()) != 0) {
+        throw PERSIST_EXP_RENAME_FILE(errno);
+    }
+}
+
+// The syncfs() calls of group commits on a file system. The logs of a group that
+// share a file system are made durable by one call, started after all of them
+// were written back.
+struct FileSystemSyncs {
+    // the number of calls started
+    uint64_t started = 0;
+    // the highest number of a call that has completed
+    uint64_t completed = 0;
+};
+std::mutex file_system_syncs_mutex;
+std::map<dev_t, FileSystemSyncs> file_system_syncs;
+
+// Start writing back the part [start, start + len) of a ring buffer file that is
+// mapped twice from map_base, without waiting for it.
+void start_write_back(int fd, const void* map_base, uint64_t file_size, const void* start, uint64_t len) {
+    uint64_t offset = ((uint64_t)start - (uint64_t)map_base) % file_size;
+    len = std::min(len, file_size);
+    while(len > 0) {
+        uint64_t chunk = std::min(len, file_size - offset);
+        if(sync_file_range(fd, offset, chunk, SYNC_FILE_RANGE_WRITE) != 0) {
+            throw PERSIST_EXP_MSYNC(errno);
+        }
+        len -= chunk;
+        offset = 0;
+    }
+}
+
+}  // namespace
+
 ////////////////////////
 // visible to outside //
 ////////////////////////
@@ -42,13 +155,20 @@ FilePersistLog::FilePersistLog(const string& name, const string& dataPath, bool
           m_iLogFileDesc(-1),
           m_iDataFileDesc(-1),
           m_pLog(MAP_FAILED),
-          m_pData(MAP_FAILED) {
+          m_pData(MAP_FAILED),
+          m_iReservedSize(0),
+          m_bGroupNeedSync(false),
+          m_iFileSystemDev(0),
+          m_iGroupSyncTicket(0) {
     if(pthread_rwlock_init(&this->m_rwlock, NULL) != 0) {
         throw PERSIST_EXP_RWLOCK_INIT(errno);
     }
     if(pthread_mutex_init(&this->m_perslock, NULL) != 0) {
         throw PERSIST_EXP_MUTEX_INIT(errno);
     }
+    if(pthread_mutex_init(&this->m_ckptlock, NULL) != 0) {
+        throw PERSIST_EXP_MUTEX_INIT(errno);
+    }
     dbg_default_trace("{0} constructor: before load()", name);
     if(derecho::getConfBoolean(CONF_PERS_RESET)) {
         reset();
@@ -73,6 +193,10 @@ void FilePersistLog::reset() {
             throw PERSIST_EXP_REMOVE_FILE(errno);
         }
     }
+    if(fs::exists(this->m_sDataPath)) {
+        loadCheckpointVersions();
+        removeCheckpoints(INVALID_VERSION, INT64_MAX);
+    }
     dbg_default_trace("{0} reset state...done", this->m_sName);
 }
 
@@ -86,6 +210,7 @@ void FilePersistLog::load() {
     checkOrCreateLogFile();
     checkOrCreateDataFile();
     dbg_default_trace("{0}:checkOrCreateDataFile passed.", this->m_sName);
+    loadCheckpointVersions();
     // STEP 2: open files
     this->m_iLogFileDesc = open(this->m_sLogFile.c_str(), O_RDWR);
     if(this->m_iLogFileDesc == -1) {
@@ -95,6 +220,11 @@ void FilePersistLog::load() {
     if(this->m_iDataFileDesc == -1) {
         throw PERSIST_EXP_OPEN_FILE(errno);
     }
+    struct stat data_file_stat;
+    if(fstat(this->m_iDataFileDesc, &data_file_stat) != 0) {
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    this->m_iFileSystemDev = data_file_stat.st_dev;
     // STEP 3: mmap to memory
     //// we map the log entry and data twice to faciliate the search and data
     //// retrieving then the data is rewinding across the buffer end as follow:
@@ -135,11 +265,19 @@ void FilePersistLog::load() {
         m_persMetaHeader.fields.head = INVALID_INDEX;
         m_persMetaHeader.fields.tail = INVALID_INDEX;
         m_persMetaHeader.fields.ver = INVALID_VERSION;
+        m_persMetaHeader.fields.seq = 0;
         // persist the header
         FPL_RDLOCK;
         FPL_PERS_LOCK;
 
         try {
+            // drop what a group commit recorded for a log of the same name
+            GroupMetaFile& group_meta = group_meta_file(this->m_sDataPath);
+            std::lock_guard<std::mutex> lock(group_meta.mutex);
+            load_group_meta_file(group_meta, this->m_sDataPath);
+            if(group_meta.headers.erase(this->m_sName) > 0) {
+                write_group_meta_file(this->m_sDataPath, group_meta.headers);
+            }
             persistMetaHeaderAtomically(&m_currMetaHeader);
         } catch(uint64_t e) {
             FPL_PERS_UNLOCK;
@@ -163,6 +301,15 @@ void FilePersistLog::load() {
                 throw PERSIST_EXP_READ_FILE(errno);
             }
             close(fd);
+            // a group commit may have recorded a later header
+            GroupMetaFile& group_meta = group_meta_file(this->m_sDataPath);
+            std::lock_guard<std::mutex> lock(group_meta.mutex);
+            load_group_meta_file(group_meta, this->m_sDataPath);
+            auto group_header = group_meta.headers.find(this->m_sName);
+            if(group_header != group_meta.headers.end()
+               && group_header->second.fields.seq > m_persMetaHeader.fields.seq) {
+                m_persMetaHeader = group_header->second;
+            }
             m_currMetaHeader = m_persMetaHeader;
             // update mhlc index
             for(int64_t idx = m_currMetaHeader.fields.head; idx < m_currMetaHeader.fields.tail; idx++) {
@@ -195,6 +342,7 @@ void FilePersistLog::load() {
 FilePersistLog::~FilePersistLog() noexcept(true) {
     pthread_rwlock_destroy(&this->m_rwlock);
     pthread_mutex_destroy(&this->m_perslock);
+    pthread_mutex_destroy(&this->m_ckptlock);
     if(this->m_pData != MAP_FAILED) {
         munmap(m_pData, (size_t)(MAX_DATA_SIZE << 1));
     }
@@ -242,25 +390,39 @@ inline void FilePersistLog::do_append_validation(const uint64_t size, const int6
 
 void FilePersistLog::append(const void* pdat, uint64_t size, version_t ver, const HLC& mhlc) {
     dbg_default_trace("{0} append event ({1},{2})", this->m_sName, mhlc.m_rtc_us, mhlc.m_logic);
+    void* pdest = reserveAppend(size, ver);
+
+    // copy data
+    memcpy(pdest, pdat, size);
+    dbg_default_trace("{0} append:data ({1} bytes) is copied to log.", this->m_sName, size);
+
+    commitAppend(ver, mhlc);
+}
+
+void* FilePersistLog::reserveAppend(uint64_t size, version_t ver) {
     FPL_RDLOCK;
 
     do_append_validation(size, ver);
 
     FPL_UNLOCK;
-    dbg_default_trace("{0} append:validate check1 Finished.", this->m_sName);
+    dbg_default_trace("{0} reserve:validate check1 Finished.", this->m_sName);
 
+    // The write lock is held until commitAppend() or abortAppend().
     FPL_WRLOCK;
     do_append_validation(size, ver);
-    dbg_default_trace("{0} append:validate check2 Finished.", this->m_sName);
+    dbg_default_trace("{0} reserve:validate check2 Finished.", this->m_sName);
 
-    // copy data
+    m_iReservedSize = size;
     // we reserve the first 'signature_size' bytes at the beginning of NEXT_DATA.
-    memcpy(reinterpret_cast<void*>(reinterpret_cast<uint64_t>(NEXT_DATA) + signature_size), pdat, size);
-    dbg_default_trace("{0} append:data ({1} bytes) is copied to log.", this->m_sName, size);
+    // The data ringbuffer is mapped twice, so the reserved range is contiguous
+    // even if it rewinds across the end of the buffer.
+    return reinterpret_cast<void*>(reinterpret_cast<uint64_t>(NEXT_DATA) + signature_size);
+}
 
+void FilePersistLog::commitAppend(version_t ver, const HLC& mhlc) {
     // fill the log entry
     NEXT_LOG_ENTRY->fields.ver = ver;
-    NEXT_LOG_ENTRY->fields.sdlen = signature_size + size;
+    NEXT_LOG_ENTRY->fields.sdlen = signature_size + m_iReservedSize;
     NEXT_LOG_ENTRY->fields.ofst = NEXT_DATA_OFST;
     NEXT_LOG_ENTRY->fields.hlc_r = mhlc.m_rtc_us;
     NEXT_LOG_ENTRY->fields.hlc_l = mhlc.m_logic;
@@ -276,6 +438,7 @@ void FilePersistLog::append(const void* pdat, uint64_t size, version_t ver, cons
     this->hidx.insert(hlc_index_entry{mhlc, m_currMetaHeader.fields.tail});
     m_currMetaHeader.fields.tail++;
     m_currMetaHeader.fields.ver = ver;
+    m_iReservedSize = 0;
     dbg_default_trace("{0} append:log entry and meta data are updated.", this->m_sName);
     /* No sync
     if (msync(this->m_pMeta,sizeof(MetaHeader),MS_SYNC) != 0) {
@@ -288,6 +451,12 @@ void FilePersistLog::append(const void* pdat, uint64_t size, version_t ver, cons
     FPL_UNLOCK;
 }
 
+void FilePersistLog::abortAppend() {
+    dbg_default_trace("{0} abort reserved append of {1} bytes.", this->m_sName, m_iReservedSize);
+    m_iReservedSize = 0;
+    FPL_UNLOCK;
+}
+
 void FilePersistLog::advanceVersion(version_t ver) {
     FPL_WRLOCK;
     if(m_currMetaHeader.fields.ver < ver) {
@@ -299,6 +468,25 @@ void FilePersistLog::advanceVersion(version_t ver) {
     FPL_UNLOCK;
 }
 
+void FilePersistLog::shadowUnpersisted(MetaHeader& shadow_header,
+                                       void*& flush_dstart, size_t& flush_dlen,
+                                       void*& flush_lstart, size_t& flush_llen) {
+    flush_dstart = nullptr;
+    flush_lstart = nullptr;
+    flush_dlen = 0;
+    flush_llen = 0;
+    shadow_header = m_currMetaHeader;
+    if((NUM_USED_SLOTS > 0) && (NEXT_LOG_ENTRY > NEXT_LOG_ENTRY_PERS)) {
+        flush_dlen = (LOG_ENTRY_AT(CURR_LOG_IDX)->fields.ofst + LOG_ENTRY_AT(CURR_LOG_IDX)->fields.sdlen - NEXT_LOG_ENTRY_PERS->fields.ofst);
+        // flush data
+        flush_dstart = ALIGN_TO_PAGE(NEXT_DATA_PERS);
+        flush_dlen += ((int64_t)NEXT_DATA_PERS) % PAGE_SIZE;
+        // flush log
+        flush_lstart = ALIGN_TO_PAGE(NEXT_LOG_ENTRY_PERS);
+        flush_llen = ((size_t)NEXT_LOG_ENTRY - (size_t)NEXT_LOG_ENTRY_PERS) + ((int64_t)NEXT_LOG_ENTRY_PERS) % PAGE_SIZE;
+    }
+}
+
 version_t FilePersistLog::persist(version_t ver, bool preLocked) {
     int64_t ver_ret = INVALID_VERSION;
     if(!preLocked) {
@@ -322,18 +510,10 @@ version_t FilePersistLog::persist(version_t ver, bool preLocked) {
     dbg_default_trace("{0} flush data,log,and meta.", this->m_sName);
     try {
         // shadow the current state
-        void *flush_dstart = nullptr, *flush_lstart = nullptr;
-        size_t flush_dlen = 0, flush_llen = 0;
-        MetaHeader shadow_header = m_currMetaHeader;
-        if((NUM_USED_SLOTS > 0) && (NEXT_LOG_ENTRY > NEXT_LOG_ENTRY_PERS)) {
-            flush_dlen = (LOG_ENTRY_AT(CURR_LOG_IDX)->fields.ofst + LOG_ENTRY_AT(CURR_LOG_IDX)->fields.sdlen - NEXT_LOG_ENTRY_PERS->fields.ofst);
-            // flush data
-            flush_dstart = ALIGN_TO_PAGE(NEXT_DATA_PERS);
-            flush_dlen += ((int64_t)NEXT_DATA_PERS) % PAGE_SIZE;
-            // flush log
-            flush_lstart = ALIGN_TO_PAGE(NEXT_LOG_ENTRY_PERS);
-            flush_llen = ((size_t)NEXT_LOG_ENTRY - (size_t)NEXT_LOG_ENTRY_PERS) + ((int64_t)NEXT_LOG_ENTRY_PERS) % PAGE_SIZE;
-        }
+        void *flush_dstart, *flush_lstart;
+        size_t flush_dlen, flush_llen;
+        MetaHeader shadow_header;
+        shadowUnpersisted(shadow_header, flush_dstart, flush_dlen, flush_lstart, flush_llen);
         if(NUM_USED_SLOTS > 0) {
             //get the latest flushed version
             //ver_ret = LOG_ENTRY_AT(CURR_LOG_IDX)->fields.ver;
@@ -368,6 +548,125 @@ version_t FilePersistLog::persist(version_t ver, bool preLocked) {
     return ver_ret;
 }
 
+bool FilePersistLog::beginPersist(version_t ver) {
+    FPL_PERS_LOCK;
+    FPL_RDLOCK;
+
+    if(m_currMetaHeader == m_persMetaHeader) {
+        FPL_UNLOCK;
+        FPL_PERS_UNLOCK;
+        return false;
+    }
+
+    dbg_default_trace("{0} start writing back data and log.", this->m_sName);
+    try {
+        void *flush_dstart, *flush_lstart;
+        size_t flush_dlen, flush_llen;
+        shadowUnpersisted(m_groupMetaHeader, flush_dstart, flush_dlen, flush_lstart, flush_llen);
+        FPL_UNLOCK;
+        {
+            std::lock_guard<std::mutex> lock(file_system_syncs_mutex);
+            m_iGroupSyncTicket = file_system_syncs[m_iFileSystemDev].started;
+        }
+        // Only start the write back here. The caller starts it for all the
+        // logs in the group before waiting for any of them in syncPersist().
+        if(flush_dlen > 0) {
+            start_write_back(m_iDataFileDesc, m_pData, MAX_DATA_SIZE, flush_dstart, flush_dlen);
+        }
+        if(flush_llen > 0) {
+            start_write_back(m_iLogFileDesc, m_pLog, MAX_LOG_SIZE, flush_lstart, flush_llen);
+        }
+        m_bGroupNeedSync = (flush_dlen > 0) || (flush_llen > 0);
+    } catch(uint64_t e) {
+        FPL_PERS_UNLOCK;
+        throw e;
+    }
+    return true;
+}
+
+void FilePersistLog::syncPersist() {
+    if(!m_bGroupNeedSync) {
+        return;
+    }
+    // Skip the sync if another log of the group already synced the file
+    // system with a call started after this log was written back.
+    uint64_t sync_number;
+    {
+        std::lock_guard<std::mutex> lock(file_system_syncs_mutex);
+        FileSystemSyncs& syncs = file_system_syncs[m_iFileSystemDev];
+        if(syncs.completed > m_iGroupSyncTicket) {
+            m_bGroupNeedSync = false;
+            return;
+        }
+        sync_number = ++syncs.started;
+    }
+    if(syncfs(this->m_iDataFileDesc) != 0) {
+        throw PERSIST_EXP_MSYNC(errno);
+    }
+    {
+        std::lock_guard<std::mutex> lock(file_system_syncs_mutex);
+        FileSystemSyncs& syncs = file_system_syncs[m_iFileSystemDev];
+        syncs.completed = std::max(syncs.completed, sync_number);
+    }
+    m_bGroupNeedSync = false;
+}
+
+void FilePersistLog::commitPersist(GroupMetaCommit& meta_commit) {
+    meta_commit.add(this);
+}
+
+void FilePersistLog::abortPersist() {
+    releasePersist(false);
+}
+
+void FilePersistLog::releasePersist(bool committed) {
+    if(committed) {
+        m_persMetaHeader = m_groupMetaHeader;
+        dbg_default_trace("{0} commit meta...done.", this->m_sName);
+    }
+    m_bGroupNeedSync = false;
+    FPL_PERS_UNLOCK;
+}
+
+void GroupMetaCommit::add(FilePersistLog* log) {
+    m_logs.push_back(log);
+}
+
+void GroupMetaCommit::commit() {
+    std::vector<FilePersistLog*> logs;
+    logs.swap(m_logs);
+    std::map<std::string, std::vector<FilePersistLog*>> logs_by_path;
+    for(auto* log : logs) {
+        logs_by_path[log->m_sDataPath].push_back(log);
+    }
+    try {
+        for(auto& [data_path, path_logs] : logs_by_path) {
+            GroupMetaFile& group_meta = group_meta_file(data_path);
+            std::lock_guard<std::mutex> lock(group_meta.mutex);
+            try {
+                load_group_meta_file(group_meta, data_path);
+                for(auto* log : path_logs) {
+                    log->m_groupMetaHeader.fields.seq = log->m_persMetaHeader.fields.seq + 1;
+                    group_meta.headers[log->m_sName] = log->m_groupMetaHeader;
+                }
+                write_group_meta_file(data_path, group_meta.headers);
+            } catch(uint64_t e) {
+                // the cache may now be ahead of the file
+                group_meta.loaded = false;
+                throw e;
+            }
+        }
+    } catch(uint64_t e) {
+        for(auto* log : logs) {
+            log->releasePersist(false);
+        }
+        throw e;
+    }
+    for(auto* log : logs) {
+        log->releasePersist(true);
+    }
+}
+
 void FilePersistLog::addSignature(version_t version,
                                   const unsigned char* signature,
                                   version_t prev_signed_ver) {
@@ -670,6 +969,20 @@ void FilePersistLog::trim(version_t ver) {
     dbg_default_trace("{0} trim at version: {1}", this->m_sName, ver);
     this->trim<int64_t>(ver,
                         [&](const LogEntry* ple) { return ple->fields.ver; });
+    // Only the latest checkpoint at or before ver is still useful: the deltas
+    // following the earlier ones have been trimmed.
+    FPL_CKPT_LOCK;
+    auto ckpt = m_checkpoints.upper_bound(ver);
+    if(ckpt != m_checkpoints.begin()) {
+        --ckpt;
+        try {
+            removeCheckpoints(INVALID_VERSION, *ckpt);
+        } catch(uint64_t e) {
+            FPL_CKPT_UNLOCK;
+            throw e;
+        }
+    }
+    FPL_CKPT_UNLOCK;
     dbg_default_trace("{0} trim at version: {1}...done", this->m_sName, ver);
 }
 
@@ -695,6 +1008,7 @@ void FilePersistLog::persistMetaHeaderAtomically(MetaHeader* pShadowHeader) {
     if(fd == -1) {
         throw PERSIST_EXP_OPEN_FILE(errno);
     }
+    pShadowHeader->fields.seq = m_persMetaHeader.fields.seq + 1;
     ssize_t nWrite = write(fd, pShadowHeader, sizeof(MetaHeader));
     if(nWrite != sizeof(MetaHeader)) {
         throw PERSIST_EXP_WRITE_FILE(errno);
@@ -977,9 +1291,198 @@ void FilePersistLog::truncate(version_t ver) {
     }
     FPL_PERS_UNLOCK;
     FPL_UNLOCK;
+    // STEP 4: remove the checkpoints of the truncated versions
+    FPL_CKPT_LOCK;
+    try {
+        removeCheckpoints(ver + 1, INT64_MAX);
+    } catch(uint64_t e) {
+        FPL_CKPT_UNLOCK;
+        throw e;
+    }
+    FPL_CKPT_UNLOCK;
     dbg_default_trace("{0} truncate at version: {1}....done", this->m_sName, ver);
 }
 
+std::string FilePersistLog::getCheckpointFile(version_t ver) const {
+    return this->m_sDataPath + "/" + this->m_sName + "." + std::to_string(ver) + "." + CKPT_FILE_SUFFIX;
+}
+
+void FilePersistLog::loadCheckpointVersions() {
+    // checkpoint file name: <name>.<version>.ckpt
+    const string prefix = this->m_sName + ".";
+    const string suffix = string(".") + CKPT_FILE_SUFFIX;
+    FPL_CKPT_LOCK;
+    m_checkpoints.clear();
+    for(const auto& dent : fs::directory_iterator(this->m_sDataPath)) {
+        const string fname = dent.path().filename().string();
+        if(fname.length() <= prefix.length() + suffix.length()
+           || fname.compare(0, prefix.length(), prefix) != 0
+           || fname.compare(fname.length() - suffix.length(), suffix.length(), suffix) != 0) {
+            continue;
+        }
+        const string ver_str = fname.substr(prefix.length(), fname.length() - prefix.length() - suffix.length());
+        char* endptr = nullptr;
+        version_t ver = strtoll(ver_str.c_str(), &endptr, 10);
+        if(*endptr == '\0') {
+            m_checkpoints.insert(ver);
+        }
+    }
+    FPL_CKPT_UNLOCK;
+    dbg_default_trace("{0}:{1} checkpoints found.", this->m_sName, m_checkpoints.size());
+}
+
+void FilePersistLog::removeCheckpoints(version_t from, version_t to) {
+    auto itr = m_checkpoints.lower_bound(from);
+    while(itr != m_checkpoints.end() && *itr < to) {
+        const string ckptFile = getCheckpointFile(*itr);
+        if(unlink(ckptFile.c_str()) != 0 && errno != ENOENT) {
+            dbg_default_error("{0} failed to remove the checkpoint file:{1}", this->m_sName, ckptFile);
+            throw PERSIST_EXP_REMOVE_FILE(errno);
+        }
+        itr = m_checkpoints.erase(itr);
+    }
+}
+
+void FilePersistLog::saveCheckpoint(version_t ver, uint64_t size,
+                                    const std::function<void(char*)>& writer) {
+    dbg_default_trace("{0} save checkpoint at version: {1}, size: {2}.", this->m_sName, ver, size);
+    std::unique_ptr<char[]> buf = std::make_unique<char[]>(size);
+    writer(buf.get());
+
+    FPL_CKPT_LOCK;
+    // write to a swap file and rename it, so that a checkpoint file is either
+    // complete or absent.
+    const string ckptFile = getCheckpointFile(ver);
+    const string swpFile = ckptFile + "." + SWAP_FILE_SUFFIX;
+    int fd = open(swpFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    if(fd == -1) {
+        FPL_CKPT_UNLOCK;
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    uint64_t nTotal = 0;
+    while(nTotal < size) {
+        ssize_t nWrite = write(fd, buf.get() + nTotal, size - nTotal);
+        if(nWrite <= 0) {
+            close(fd);
+            FPL_CKPT_UNLOCK;
+            throw PERSIST_EXP_WRITE_FILE(errno);
+        }
+        nTotal += nWrite;
+    }
+    // the data must be on disk before the rename makes it visible
+    if(fsync(fd) != 0) {
+        close(fd);
+        FPL_CKPT_UNLOCK;
+        throw PERSIST_EXP_WRITE_FILE(errno);
+    }
+    close(fd);
+    if(rename(swpFile.c_str(), ckptFile.c_str()) != 0) {
+        FPL_CKPT_UNLOCK;
+        throw PERSIST_EXP_RENAME_FILE(errno);
+    }
+    // and the rename must be on disk before the checkpoint is used
+    int dirfd = open(this->m_sDataPath.c_str(), O_RDONLY | O_DIRECTORY);
+    if(dirfd == -1) {
+        FPL_CKPT_UNLOCK;
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    if(fsync(dirfd) != 0) {
+        close(dirfd);
+        FPL_CKPT_UNLOCK;
+        throw PERSIST_EXP_WRITE_FILE(errno);
+    }
+    close(dirfd);
+    m_checkpoints.insert(ver);
+    FPL_CKPT_UNLOCK;
+    dbg_default_trace("{0} save checkpoint at version: {1}...done", this->m_sName, ver);
+}
+
+int64_t FilePersistLog::loadCheckpoint(int64_t idx, int64_t min_idx,
+                                       const std::function<void(const char*, std::size_t)>& reader) {
+    version_t ckpt_ver = INVALID_VERSION;
+    int64_t ckpt_idx = INVALID_INDEX;
+
+    FPL_RDLOCK;
+    if(idx < m_currMetaHeader.fields.head || idx >= m_currMetaHeader.fields.tail) {
+        FPL_UNLOCK;
+        return INVALID_INDEX;
+    }
+    version_t ver = LOG_ENTRY_AT(idx)->fields.ver;
+    FPL_CKPT_LOCK;
+    // the latest checkpoint not newer than ver
+    auto itr = m_checkpoints.upper_bound(ver);
+    if(itr != m_checkpoints.begin()) {
+        ckpt_ver = *(--itr);
+        // A checkpoint is usable only if its version is still in the log,
+        // otherwise the deltas following it might have been trimmed.
+        int64_t l_idx = binarySearch<int64_t>(
+                [&](const LogEntry* ple) {
+                    return ple->fields.ver;
+                },
+                ckpt_ver,
+                m_currMetaHeader.fields.head,
+                m_currMetaHeader.fields.tail);
+        if(l_idx != INVALID_INDEX && LOG_ENTRY_AT(l_idx)->fields.ver == ckpt_ver && l_idx > min_idx) {
+            ckpt_idx = l_idx;
+        }
+    }
+    FPL_UNLOCK;
+
+    if(ckpt_idx == INVALID_INDEX) {
+        FPL_CKPT_UNLOCK;
+        return INVALID_INDEX;
+    }
+
+    // read the checkpoint file
+    const string ckptFile = getCheckpointFile(ckpt_ver);
+    int fd = open(ckptFile.c_str(), O_RDONLY);
+    if(fd == -1) {
+        FPL_CKPT_UNLOCK;
+        throw PERSIST_EXP_OPEN_FILE(errno);
+    }
+    struct stat sb;
+    if(fstat(fd, &sb) != 0) {
+        close(fd);
+        FPL_CKPT_UNLOCK;
+        throw PERSIST_EXP_READ_FILE(errno);
+    }
+    const std::size_t size = static_cast<std::size_t>(sb.st_size);
+    std::unique_ptr<char[]> buf = std::make_unique<char[]>(size);
+    std::size_t nTotal = 0;
+    while(nTotal < size) {
+        ssize_t nRead = read(fd, buf.get() + nTotal, size - nTotal);
+        if(nRead <= 0) {
+            close(fd);
+            FPL_CKPT_UNLOCK;
+            throw PERSIST_EXP_READ_FILE(errno);
+        }
+        nTotal += nRead;
+    }
+    close(fd);
+    FPL_CKPT_UNLOCK;
+
+    dbg_default_trace("{0} load checkpoint at version: {1}, index: {2}, for index: {3}.", this->m_sName, ckpt_ver, ckpt_idx, idx);
+    reader(buf.get(), size);
+    return ckpt_idx;
+}
+
+void FilePersistLog::getEntriesSinceCheckpoint(uint64_t& num_entries, uint64_t& num_bytes) {
+    num_entries = 0;
+    num_bytes = 0;
+    FPL_RDLOCK;
+    FPL_CKPT_LOCK;
+    const version_t ckpt_ver = m_checkpoints.empty() ? INVALID_VERSION : *m_checkpoints.rbegin();
+    for(int64_t idx = m_currMetaHeader.fields.tail - 1;
+        idx >= m_currMetaHeader.fields.head && LOG_ENTRY_AT(idx)->fields.ver > ckpt_ver; idx--) {
+        num_entries++;
+        num_bytes += LOG_ENTRY_AT(idx)->fields.sdlen - signature_size;
+    }
+    FPL_CKPT_UNLOCK;
+    FPL_UNLOCK;
+    dbg_default_trace("{0}:{1} entries and {2} bytes since the checkpoint at version {3}.",
+                      this->m_sName, num_entries, num_bytes, ckpt_ver);
+}
+
 const uint64_t FilePersistLog::getMinimumLatestPersistedVersion(const std::string& prefix) {
     // STEP 1: list all meta files in the path
     DIR* dir = opendir(getPersFilePath().c_str());
@@ -989,7 +1492,15 @@ const uint64_t FilePersistLog::getMinimumLatestPersistedVersion(const std::strin
                           __FILE__, __func__, errno, strerror(errno));
         return INVALID_VERSION;
     }
-    // STEP 2: get through the meta header for the minimum
+    // STEP 2: get through the meta header for the minimum, or the header
+    // recorded by a later group commit
+    std::map<std::string, MetaHeader> group_headers;
+    try {
+        read_group_meta_file(getPersFilePath(), group_headers);
+    } catch(uint64_t e) {
+        dbg_default_warn("{}:{} cannot load the group meta file, errno={}, err={}.",
+                         __FILE__, __func__, errno, strerror(errno));
+    }
     struct dirent* dent;
     bool found = false;
     int64_t ver = INVALID_VERSION;
@@ -1013,6 +1524,10 @@ const uint64_t FilePersistLog::getMinimumLatestPersistedVersion(const std::strin
                 continue;
             }
             close(fd);
+            auto group_header = group_headers.find(std::string(dent->d_name, name_len - strlen(META_FILE_SUFFIX) - 1));
+            if(group_header != group_headers.end() && group_header->second.fields.seq > mh.fields.seq) {
+                mh = group_header->second;
+            }
             if(!found || ver > mh.fields.ver)
                 ver = mh.fields.ver;
         }
@@ -12,6 +12,7 @@ PersistentRegistry::PersistentRegistry(
         uint32_t subgroup_index,
         uint32_t shard_num) : m_subgroupPrefix(generate_prefix(subgroup_type, subgroup_index, shard_num)),
                               m_temporalQueryFrontierProvider(tqfp),
+                              m_bGroupCommit(derecho::getConfBoolean(CONF_PERS_GROUP_COMMIT)),
                               m_lastSignedVersion(INVALID_VERSION) {
 }
 
@@ -121,9 +122,36 @@ bool PersistentRegistry::verify(version_t version, openssl::Verifier& verifier,
 }
 
 void PersistentRegistry::persist(version_t latest_version) {
-    for(auto& entry : m_registry) {
-        entry.second->persist(latest_version);
+    if(!m_bGroupCommit) {
+        for(auto& entry : m_registry) {
+            entry.second->persist(latest_version);
+        }
+        return;
+    }
+    // Group commit: start the write back of all fields, wait for all of them,
+    // then commit their meta data with one write, so that the flushes overlap
+    // instead of running one after another.
+    std::vector<PersistentObject*> group;
+    try {
+        for(auto& entry : m_registry) {
+            if(entry.second->beginPersist(latest_version)) {
+                group.push_back(entry.second);
+            }
+        }
+        for(auto* field : group) {
+            field->syncPersist();
+        }
+    } catch(uint64_t e) {
+        for(auto* field : group) {
+            field->abortPersist();
+        }
+        throw e;
+    }
+    GroupMetaCommit meta_commit;
+    for(auto* field : group) {
+        field->commitPersist(meta_commit);
     }
+    meta_commit.commit();
 };
 
 void PersistentRegistry::trim(version_t earliest_version) {
@@ -3,8 +3,10 @@
  * @file lf.cpp
  * Implementation of RDMA interface defined in lf.h.
  */
+#include <algorithm>
 #include <arpa/inet.h>
 #include <byteswap.h>
+#include <chrono>
 #include <errno.h>
 #include <iostream>
 #include <rdma/fabric.h>
@@ -92,6 +94,13 @@ public:
 #define LF_CONFIG_FILE "rdma.cfg"
 #define LF_USE_VADDR ((g_ctxt.fi->domain_attr->mr_mode) & (FI_MR_VIRT_ADDR | FI_MR_BASIC))
 static bool shutdown = false;
+
+/** The idle strategy of the polling thread */
+static util::IdleStrategy& polling_idle_strategy() {
+    static util::IdleStrategy idle_strategy;
+    return idle_strategy;
+}
+
 std::thread polling_thread;
 tcp::tcp_connections* sst_connections;
 tcp::tcp_connections* external_client_connections;
@@ -366,6 +375,75 @@ _resources::~_resources() {
     if(this->read_mr)
         fail_if_nonzero_retry_on_eagain("unregister read mr", REPORT_ON_FAILURE,
                                         fi_close, &this->read_mr->fid);
+    discard_next_buffers();
+    release_previous_buffers();
+}
+
+uint64_t _resources::register_next_buffers(char* write_addr, char* read_addr, int size_w, int size_r) {
+    fail_if_nonzero_retry_on_eagain("register next memory buffer for write", CRASH_ON_FAILURE,
+                                    fi_mr_reg, g_ctxt.domain, write_addr, size_w,
+                                    FI_SEND | FI_RECV | FI_READ | FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE,
+                                    0, 0, 0, &this->next_write_mr, nullptr);
+    fail_if_nonzero_retry_on_eagain("register next memory buffer for read", CRASH_ON_FAILURE,
+                                    fi_mr_reg, g_ctxt.domain, read_addr, size_r,
+                                    FI_SEND | FI_RECV | FI_READ | FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE,
+                                    0, 0, 0, &this->next_read_mr, nullptr);
+    dbg_default_trace("{}:{} registered next buffers for remote write: {}:{}, remote read: {}:{}",
+                      __FILE__, __func__, (void*)write_addr, size_w, (void*)read_addr, size_r);
+    this->next_write_buf = write_addr;
+    this->next_read_buf = read_addr;
+    const uint64_t next_lwkey = fi_mr_key(this->next_write_mr);
+    if(next_lwkey == FI_KEY_NOTAVAIL || fi_mr_key(this->next_read_mr) == FI_KEY_NOTAVAIL) {
+        crash_with_message("fail to get next memory keys.");
+    }
+    return next_lwkey;
+}
+
+void _resources::discard_next_buffers() {
+    if(this->next_write_mr) {
+        fail_if_nonzero_retry_on_eagain("unregister next write mr", REPORT_ON_FAILURE,
+                                        fi_close, &this->next_write_mr->fid);
+        this->next_write_mr = nullptr;
+    }
+    if(this->next_read_mr) {
+        fail_if_nonzero_retry_on_eagain("unregister next read mr", REPORT_ON_FAILURE,
+                                        fi_close, &this->next_read_mr->fid);
+        this->next_read_mr = nullptr;
+    }
+    this->next_write_buf = nullptr;
+    this->next_read_buf = nullptr;
+}
+
+void _resources::switch_buffers(uint64_t remote_key, uint64_t remote_addr) {
+    release_previous_buffers();
+    this->previous_write_mr = this->write_mr;
+    this->previous_read_mr = this->read_mr;
+    this->write_mr = this->next_write_mr;
+    this->read_mr = this->next_read_mr;
+    this->write_buf = this->next_write_buf;
+    this->read_buf = this->next_read_buf;
+    this->mr_lwkey = fi_mr_key(this->write_mr);
+    this->mr_lrkey = fi_mr_key(this->read_mr);
+    this->next_write_mr = nullptr;
+    this->next_read_mr = nullptr;
+    this->next_write_buf = nullptr;
+    this->next_read_buf = nullptr;
+    this->mr_rwkey = remote_key;
+    this->remote_fi_addr = (fi_addr_t)remote_addr;
+    dbg_default_debug("{}:{} switched buffers of the connection to node {}", __FILE__, __func__, this->remote_id);
+}
+
+void _resources::release_previous_buffers() {
+    if(this->previous_write_mr) {
+        fail_if_nonzero_retry_on_eagain("unregister previous write mr", REPORT_ON_FAILURE,
+                                        fi_close, &this->previous_write_mr->fid);
+        this->previous_write_mr = nullptr;
+    }
+    if(this->previous_read_mr) {
+        fail_if_nonzero_retry_on_eagain("unregister previous read mr", REPORT_ON_FAILURE,
+                                        fi_close, &this->previous_read_mr->fid);
+        this->previous_read_mr = nullptr;
+    }
 }
 
 int _resources::post_remote_send(
@@ -613,6 +691,39 @@ bool sync(uint32_t r_id) {
     return true;
 }
 
+bool switch_connection_buffers(resources* res, uint32_t r_id, char* write_addr, char* read_addr,
+                               int size_w, int size_r) {
+    struct buffer_switch_data_t {
+        uint64_t usable;  // zero if the sender can't reuse the connection
+        uint64_t mr_key;
+        uint64_t vaddr;
+    } __attribute__((packed));
+    buffer_switch_data_t local_data{0, 0, 0}, remote_data;
+    if(res) {
+        local_data.usable = htonll(1);
+        local_data.mr_key = htonll(res->register_next_buffers(write_addr, read_addr, size_w, size_r));
+        local_data.vaddr = htonll((uint64_t)write_addr);
+    }
+    try {
+        if(sst_connections->contains_node(r_id)) {
+            sst_connections->exchange(r_id, local_data, remote_data);
+        } else {
+            external_client_connections->exchange(r_id, local_data, remote_data);
+        }
+    } catch(tcp::socket_error&) {
+        remote_data.usable = 0;
+    }
+    if(!res) {
+        return false;
+    }
+    if(!ntohll(remote_data.usable)) {
+        res->discard_next_buffers();
+        return false;
+    }
+    res->switch_buffers(ntohll(remote_data.mr_key), ntohll(remote_data.vaddr));
+    return true;
+}
+
 void filter_external_to(const std::vector<node_id_t>& live_nodes_list) {
     external_client_connections->filter_to(live_nodes_list);
 }
@@ -645,7 +756,9 @@ void polling_loop() {
             }
         }
     }
-    dbg_default_trace("Polling thread ending.");
+    dbg_default_debug("Polling thread ending. Idle periods: spin={}, backoff={}, wait={}",
+                      polling_idle_strategy().get_counters().spins, polling_idle_strategy().get_counters().backoffs,
+                      polling_idle_strategy().get_counters().waits);
 }
 
 /**
@@ -661,19 +774,26 @@ std::pair<uint32_t, std::pair<int32_t, int32_t>> lf_poll_completion() {
     struct fi_cq_entry entry;
     int poll_result = 0;
 
-    struct timespec last_time, cur_time;
-    clock_gettime(CLOCK_REALTIME, &last_time);
-
-    while(!shutdown) {
-        clock_gettime(CLOCK_REALTIME, &cur_time);
-        // check if the system has been inactive for enough time to induce sleep
-        double time_elapsed_in_ms = (cur_time.tv_sec - last_time.tv_sec) * 1e3
-                                    + (cur_time.tv_nsec - last_time.tv_nsec) / 1e6;
-        if(time_elapsed_in_ms > 1) {
-            using namespace std::chrono_literals;
-            std::this_thread::sleep_for(1ms);
+    util::IdleStrategy& idle_strategy = polling_idle_strategy();
+    // fi_cq_sread() needs a wait object, which not every provider supports
+    static bool cq_sread_supported = true;
+    auto wait_for_completion = [&](std::chrono::microseconds timeout) {
+        if(!cq_sread_supported) {
+            std::this_thread::sleep_for(timeout);
+            return;
+        }
+        const int timeout_ms = std::max(1, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(timeout).count()));
+        poll_result = fi_cq_sread(g_ctxt.cq, &entry, 1, nullptr, timeout_ms);
+        if(poll_result == -FI_ENOSYS || poll_result == -FI_EOPNOTSUPP) {
+            dbg_default_info("fi_cq_sread() is not supported by the provider, waiting with sleep instead.");
+            cq_sread_supported = false;
+            poll_result = 0;
+        } else if(poll_result == -FI_ETIMEDOUT || poll_result == -FI_EINTR) {
+            poll_result = 0;
         }
+    };
 
+    while(!shutdown) {
         poll_result = 0;
         for(int i = 0; i < 50; ++i) {
             poll_result = fi_cq_read(g_ctxt.cq, &entry, 1);
@@ -684,8 +804,12 @@ std::pair<uint32_t, std::pair<int32_t, int32_t>> lf_poll_completion() {
         if(poll_result && (poll_result != -FI_EAGAIN)) {
             break;
         }
-        // util::polling_data.wait_for_requests();
+        idle_strategy.idle(wait_for_completion);
+        if(poll_result && (poll_result != -FI_EAGAIN)) {
+            break;
+        }
     }
+    idle_strategy.work_done();
     // not sure what to do when we cannot read entries off the CQ
     // this means that something is wrong with the local node
     if((poll_result < 0) && (poll_result != -FI_EAGAIN)) {
@@ -2,6 +2,7 @@
 #include <numeric>
 #include <functional>
 
+#include <derecho/conf/conf.hpp>
 #include <derecho/sst/detail/poll_utils.hpp>
 
 namespace sst {
@@ -64,5 +65,13 @@ void PollingData::wait_for_requests() {
     // poll_cv.wait(lk, check_waiting);
     poll_cv.wait(lk, std::bind(&PollingData::check_waiting, this));
 }
+
+IdleStrategy::IdleStrategy()
+        : spin_time(derecho::getConfUInt64(CONF_DERECHO_IDLE_SPIN_US)),
+          backoff_time(derecho::getConfUInt64(CONF_DERECHO_IDLE_BACKOFF_US)),
+          wait_timeout(std::max(derecho::getConfUInt64(CONF_DERECHO_IDLE_WAIT_US), (uint64_t)1)),
+          tier(Tier::working),
+          last_work_time(std::chrono::steady_clock::now()),
+          num_pauses(1) {}
 }  // namespace util
 }  // namespace sst
@@ -2,8 +2,10 @@
  * @file verbs.cpp
  * Contains the implementation of the IB Verbs adapter layer of %SST.
  */
+#include <algorithm>
 #include <arpa/inet.h>
 #include <byteswap.h>
+#include <chrono>
 #include <cstring>
 #include <endian.h>
 #include <errno.h>
@@ -12,6 +14,7 @@
 #include <inttypes.h>
 #include <iostream>
 #include <netdb.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -72,6 +75,8 @@ struct global_resources {
     struct ibv_pd* pd;
     /** Completion Queue handle. */
     struct ibv_cq* cq;
+    /** Completion channel of cq, or null if it could not be created. */
+    struct ibv_comp_channel* comp_channel;
 };
 /** The single instance of global_resources for the %SST system */
 struct global_resources* g_res;
@@ -79,6 +84,12 @@ struct global_resources* g_res;
 std::thread polling_thread;
 static bool shutdown = false;
 
+/** The idle strategy of the polling thread */
+static util::IdleStrategy& polling_idle_strategy() {
+    static util::IdleStrategy idle_strategy;
+    return idle_strategy;
+}
+
 /**
  * Initializes the resources. Registers write_addr and read_addr as the read
  * and write buffers and connects a queue pair with the specified remote node.
@@ -180,6 +191,61 @@ _resources::~_resources() {
             cout << "Could not de-register memory region : read_mr, error code is " << rc << endl;
         }
     }
+    discard_next_buffers();
+    release_previous_buffers();
+}
+
+uint64_t _resources::register_next_buffers(char *write_addr, char *read_addr, int size_w, int size_r) {
+    int mr_flags = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    next_write_mr = ibv_reg_mr(g_res->pd, write_addr, size_w, mr_flags);
+    next_read_mr = ibv_reg_mr(g_res->pd, read_addr, size_r, mr_flags);
+    if(!next_write_mr || !next_read_mr) {
+        cout << "Could not register next memory regions, error code is: " << errno << endl;
+        exit(-1);
+    }
+    next_write_buf = write_addr;
+    next_read_buf = read_addr;
+    return next_write_mr->rkey;
+}
+
+void _resources::discard_next_buffers() {
+    if(next_write_mr) {
+        ibv_dereg_mr(next_write_mr);
+        next_write_mr = nullptr;
+    }
+    if(next_read_mr) {
+        ibv_dereg_mr(next_read_mr);
+        next_read_mr = nullptr;
+    }
+    next_write_buf = nullptr;
+    next_read_buf = nullptr;
+}
+
+void _resources::switch_buffers(uint64_t remote_key, uint64_t remote_addr) {
+    release_previous_buffers();
+    previous_write_mr = write_mr;
+    previous_read_mr = read_mr;
+    write_mr = next_write_mr;
+    read_mr = next_read_mr;
+    write_buf = next_write_buf;
+    read_buf = next_read_buf;
+    next_write_mr = nullptr;
+    next_read_mr = nullptr;
+    next_write_buf = nullptr;
+    next_read_buf = nullptr;
+    remote_props.rkey = static_cast<uint32_t>(remote_key);
+    remote_props.addr = remote_addr;
+}
+
+void _resources::release_previous_buffers() {
+    if(previous_write_mr) {
+        ibv_dereg_mr(previous_write_mr);
+        previous_write_mr = nullptr;
+    }
+    if(previous_read_mr) {
+        ibv_dereg_mr(previous_read_mr);
+        previous_read_mr = nullptr;
+    }
 }
 
 /**
@@ -552,6 +618,9 @@ void polling_loop() {
         util::polling_data.insert_completion_entry(ce.first, ce.second);
     }
     cout << "Polling thread ending" << endl;
+    dbg_default_debug("Polling thread idle periods: spin={}, backoff={}, wait={}",
+                      polling_idle_strategy().get_counters().spins, polling_idle_strategy().get_counters().backoffs,
+                      polling_idle_strategy().get_counters().waits);
 }
 
 /**
@@ -568,6 +637,36 @@ std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
     int poll_result;
     verbs_sender_ctxt* sctxt;
 
+    util::IdleStrategy& idle_strategy = polling_idle_strategy();
+    // Whether a notification is requested on the completion channel for the next completion
+    static bool cq_notify_armed = false;
+    auto wait_for_completion = [](std::chrono::microseconds timeout) {
+        if(!g_res->comp_channel) {
+            std::this_thread::sleep_for(timeout);
+            return;
+        }
+        if(!cq_notify_armed) {
+            // A completion added before the request raises no event, so poll
+            // the CQ once more before blocking on the channel
+            if(ibv_req_notify_cq(g_res->cq, 0)) {
+                std::this_thread::sleep_for(timeout);
+            } else {
+                cq_notify_armed = true;
+            }
+            return;
+        }
+        struct pollfd channel_fd = {g_res->comp_channel->fd, POLLIN, 0};
+        const int timeout_ms = std::max(1, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(timeout).count()));
+        if(poll(&channel_fd, 1, timeout_ms) > 0) {
+            struct ibv_cq* event_cq;
+            void* event_context;
+            if(ibv_get_cq_event(g_res->comp_channel, &event_cq, &event_context) == 0) {
+                ibv_ack_cq_events(event_cq, 1);
+                cq_notify_armed = false;
+            }
+        }
+    };
+
     while(!shutdown) {
         poll_result = 0;
         for(int i = 0; i < 50; ++i) {
@@ -577,6 +676,7 @@ std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
             }
         }
         if(poll_result) {
+            idle_strategy.work_done();
             // not sure what to do when we cannot read entries off the CQ
             // this means that something is wrong with the local node
             if(poll_result < 0) {
@@ -620,8 +720,9 @@ std::pair<uint32_t, std::pair<int, int>> verbs_poll_completion() {
                 // this should not happen.
                 cerr << "WARNING: unknown sender context type:" << sctxt->type << "." << std::endl;
             }
+        } else {
+            idle_strategy.idle(wait_for_completion);
         }
-        // util::polling_data.wait_for_requests();
     }
     return {sctxt->ce_idx(), {sctxt->remote_id(), 1}};
 }
@@ -698,7 +799,12 @@ void resources_create() {
 
     // set to many entries
     int cq_size = 1000;
-    g_res->cq = ibv_create_cq(g_res->ib_ctx, cq_size, NULL, NULL, 0);
+    // the polling thread blocks on the channel once it has been idle for a while
+    g_res->comp_channel = ibv_create_comp_channel(g_res->ib_ctx);
+    if(!g_res->comp_channel) {
+        cout << "Could not create completion channel, the polling thread will sleep when idle, error code is " << errno << endl;
+    }
+    g_res->cq = ibv_create_cq(g_res->ib_ctx, cq_size, NULL, g_res->comp_channel, 0);
     if(!g_res->cq) {
         cout << "Could not create completion queue, error code is " << errno << endl;
     }
@@ -738,6 +844,39 @@ bool sync(uint32_t r_index) {
     return true;
 }
 
+bool switch_connection_buffers(resources* res, uint32_t r_index, char* write_addr, char* read_addr,
+                               int size_w, int size_r) {
+    struct buffer_switch_data_t {
+        uint64_t usable;  // zero if the sender can't reuse the connection
+        uint64_t mr_key;
+        uint64_t vaddr;
+    } __attribute__((packed));
+    buffer_switch_data_t local_data{0, 0, 0}, remote_data;
+    if(res) {
+        local_data.usable = htonll(1);
+        local_data.mr_key = htonll(res->register_next_buffers(write_addr, read_addr, size_w, size_r));
+        local_data.vaddr = htonll((uint64_t)write_addr);
+    }
+    try {
+        if(sst_connections->contains_node(r_index)) {
+            sst_connections->exchange(r_index, local_data, remote_data);
+        } else {
+            external_client_connections->exchange(r_index, local_data, remote_data);
+        }
+    } catch(tcp::socket_error&) {
+        remote_data.usable = 0;
+    }
+    if(!res) {
+        return false;
+    }
+    if(!ntohll(remote_data.usable)) {
+        res->discard_next_buffers();
+        return false;
+    }
+    res->switch_buffers(ntohll(remote_data.mr_key), ntohll(remote_data.vaddr));
+    return true;
+}
+
 void filter_external_to(const std::vector<node_id_t>& live_nodes_list) {
     external_client_connections->filter_to(live_nodes_list);
 }
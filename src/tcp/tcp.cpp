@@ -171,6 +171,12 @@ bool socket::probe() {
     return count > 0;
 }
 
+void socket::shutdown() {
+    if(sock >= 0) {
+        ::shutdown(sock, SHUT_RDWR);
+    }
+}
+
 void socket::write(const char* buffer, size_t size) {
     if(sock < 0) {
         throw socket_closed_error("Attempted to write to closed socket");